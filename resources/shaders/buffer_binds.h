@@ -7,8 +7,29 @@
 #define SSBO_BIND_AFFECTING_LIGHTS_BITFIELD   7
 #define SSBO_BIND_RELEVANT_LIGHTS_INDEX       8
 #define SSBO_BIND_SHADOW_SLOTS_INFO           9
+#define SSBO_BIND_LIGHTS_SCATTER_INDEX       10
+#define SSBO_BIND_LIGHTS_SCATTER_DATA        11
+#define SSBO_BIND_LIGHTS_CULL                12
+#define SSBO_BIND_LIGHTS_SCATTER_CULL        13
+#define SSBO_BIND_CLUSTER_CULL_STATS         14
+#define SSBO_BIND_CLUSTER_TILE_LIGHT_RANGE   15
+#define SSBO_BIND_CLUSTER_TILE_ALL_LIGHTS    16
+#define SSBO_BIND_ZBIN_RANGES                17
+#define SSBO_BIND_ZBIN_LIGHTS_INDEX          18
+#define SSBO_BIND_ZBIN_TILE_BITS             19
 
 #define SSBO_BIND_ALL_VOLUMETRIC_LIGHTS_INDEX       20
 #define SSBO_BIND_VOLUMETRIC_TILE_LIGHTS_INDEX      21
 #define SSBO_BIND_VOLUMETRIC_ALL_TILE_LIGHTS_INDEX  22
 
+#define SSBO_BIND_SDSM_REDUCTION             23
+#define SSBO_BIND_VSM_PAGE_TABLE             24
+#define SSBO_BIND_VSM_PAGE_REQUESTS          25
+
+#define SSBO_BIND_VOLUMETRIC_CACHED_LIGHTS_MASK     26
+#define SSBO_BIND_VOLUMETRIC_CACHED_LIGHTS_INDEX    27
+#define SSBO_BIND_VOLUMETRIC_CACHE_VALIDITY         28
+#define SSBO_BIND_VOLUMETRIC_CACHE_BAKE_BRICKS      29
+
+#define SSBO_BIND_SPD_COUNTER                30
+
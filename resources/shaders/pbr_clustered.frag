@@ -1,6 +1,7 @@
 #version 460 core
 
 #include "light.glh"
+#include "light_packing.glh"
 #include "pbr_lighting.glh"
 #include "shadows.glh"
 #include "volumetrics.glh"  // 'tile_grid' for the debug mode
@@ -49,16 +50,36 @@ const vec3 debug_colors[8] = vec3[]
 
 layout(std430, binding = SSBO_BIND_LIGHTS) readonly buffer LightsSSBO
 {
-	GPULight ssbo_lights[];
+	GPULightPacked ssbo_lights[];
 };
 
 layout(std430, binding = SSBO_BIND_CLUSTER_LIGHT_RANGE) readonly buffer ClusterLightsSSBO
 {
-	IndexRange ssbo_cluster_lights[];
+	ClusterLightRange ssbo_cluster_lights[];
 };
 
 SSBO_ALL_CLUSTER_LIGHTS_ro;
 
+// z-binned light assignment (alternative to the per-cluster lists), see clustered_zbin_tiles.comp
+layout(std430, binding = SSBO_BIND_ZBIN_RANGES) readonly buffer ZBinRangesSSBO
+{
+	uint ssbo_zbin_num_words;        // bitmask words per tile
+	uint ssbo_zbin_num_directional;  // leading directional lights, in all z-bins
+	uvec2 ssbo_zbins[];              // per z-slice: [first, last] index into 'ssbo_zbin_lights'; first > last: empty
+};
+
+layout(std430, binding = SSBO_BIND_ZBIN_LIGHTS_INDEX) readonly buffer ZBinLightsSSBO
+{
+	uint ssbo_zbin_lights[];
+};
+
+layout(std430, binding = SSBO_BIND_ZBIN_TILE_BITS) readonly buffer ZBinTileBitsSSBO
+{
+	uint ssbo_zbin_tile_bits[];
+};
+
+uniform bool u_zbin_lights;
+
 layout(std430, binding = SSBO_BIND_SHADOW_SLOTS_INFO) readonly buffer ShadowParamsSSBO
 {
 	ShadowSlotInfo ssbo_shadow_slots[];
@@ -77,6 +98,7 @@ vec3 falseColor(float value);
 uint computeClusterIndex(uvec3 cluster_coord);
 uvec3 computeClusterCoord(vec2 screen_pos, float view_z);
 
+vec3 shadeLight(uint light_index, MaterialProperties material, float camera_distance);
 vec3 pointLightVisibility(GPULight light, vec3 world_pos, float camera_distance);
 vec3 dirLightVisibility(GPULight light, vec3 world_pos, float camera_distance);
 vec3 spotLightVisibility(GPULight light, vec3 world_pos, float camera_distance);
@@ -98,97 +120,71 @@ void main()
     uvec3 cluster_coord = computeClusterCoord(gl_FragCoord.xy, in_view_pos.z);
     uint cluster_index = computeClusterIndex(cluster_coord);
 
-    IndexRange lights_range = ssbo_cluster_lights[cluster_index];
-
-    uint num_clusters = u_cluster_resolution.x*u_cluster_resolution.y*u_cluster_resolution.z;
-    uint num_lights = min(lights_range.count, CLUSTER_MAX_LIGHTS);
-
     float camera_distance = distance(u_cam_pos, in_world_pos);
 
     vec3 radiance = calcAmbience(u_ambient_radiance, material);
 
-    // too many lights?
-    if(lights_range.count > CLUSTER_MAX_LIGHTS)
-		radiance += vec3(1, 0, 1);
-	else if(u_debug_unshaded_clusters && num_lights == 0)
-		radiance += vec3(int((gl_FragCoord.x + gl_FragCoord.y)/10) % 2 == 0? 2: 0, 0, 0); // TODO: draw a simple pattern
+    IndexRange lights_range = IndexRange(0, 0);
 
-    for (uint idx = 0; idx < num_lights; ++idx)
+    if(u_zbin_lights)
     {
-	    uint light_index = all_lights_index[lights_range.start_index + idx];
-
-        GPULight light = ssbo_lights[light_index];
-        if(! IS_ENABLED(light))
-        	continue;
-
-        vec3 visibility = vec3(1);
-		vec3 contribution = vec3(0);
-
-       	switch(GET_LIGHT_TYPE(light))
-       	{
-			case LIGHT_TYPE_POINT:
-			{
-		        visibility = pointLightVisibility(light, in_world_pos, camera_distance);
-		        if(visibility.x + visibility.y + visibility.z > s_min_visibility)
-		        	contribution = calcPointLight(light, in_world_pos, material);
-			}
-			break;
-
-	        case LIGHT_TYPE_DIRECTIONAL:
-			{
-		        visibility = dirLightVisibility(light, in_world_pos, camera_distance);
-		        if(visibility.x + visibility.y + visibility.z > s_min_visibility)
-		        	contribution = calcDirectionalLight(light, in_world_pos, material);
-			}
-			break;
-
-			case LIGHT_TYPE_SPOT:
-			{
-				visibility = spotLightVisibility(light, in_world_pos, camera_distance);
-			    if(visibility.x + visibility.y + visibility.z > s_min_visibility)
-    				contribution = calcSpotLight(light, in_world_pos, material);
-        	}
-         	break;
-
-          	case LIGHT_TYPE_RECT:
-           	{
-	           	visibility = rectLightVisibility(light, camera_distance);
-		        if(visibility.x + visibility.y + visibility.z > s_min_visibility)
-		        	contribution = calcRectLight(light, in_world_pos, material);
-            }
-            break;
-
-           	case LIGHT_TYPE_TUBE:
-            {
-	           	visibility = tubeLightVisibility(light, camera_distance);
-		        if(visibility.x + visibility.y + visibility.z > s_min_visibility)
-		        	contribution = calcTubeLight(light, in_world_pos, material);
-            }
-            break;
-
-           	case LIGHT_TYPE_SPHERE:
-            {
-	           	visibility = sphereLightVisibility(light, camera_distance);
-		        if(visibility.x + visibility.y + visibility.z > s_min_visibility)
-		        	contribution = calcSphereLight(light, in_world_pos, material);
-            }
-            break;
-
-           	case LIGHT_TYPE_DISC:
-            {
-	           	visibility = discLightVisibility(light, camera_distance);
-		        if(visibility.x + visibility.y + visibility.z > s_min_visibility)
-		        	contribution = calcDiscLight(light, in_world_pos, material);
-            }
-            break;
-
-            default:
-            	// unexpected light type, set an "error" color
-	            contribution = vec3(5, 0, 5);
-				return;
-		}
-
-       	radiance += visibility * contribution;
+    	for(uint idx = 0; idx < ssbo_zbin_num_directional; ++idx)
+	    	radiance += shadeLight(ssbo_zbin_lights[idx], material, camera_distance);
+
+	    // the tile's lights, within the z-slice's (depth sorted) light range
+	    uvec2 zbin = ssbo_zbins[min(cluster_coord.z, u_cluster_resolution.z - 1)];
+	    if(zbin.x <= zbin.y)
+	    {
+		    uint tile_index = cluster_coord.y*u_cluster_resolution.x + cluster_coord.x;
+		    uint tile_offset = tile_index*ssbo_zbin_num_words;
+		    uint first_word = zbin.x >> 5;
+		    uint last_word = zbin.y >> 5;
+
+		    for(uint word = first_word; word <= last_word; ++word)
+		    {
+			    uint bits = ssbo_zbin_tile_bits[tile_offset + word];
+			    if(word == first_word)
+			    	bits &= ~0u << (zbin.x & 31u);
+			    if(word == last_word)
+			    	bits &= ~0u >> (31u - (zbin.y & 31u));
+
+			    lights_range.count += uint(bitCount(bits));  // (only) for the occupancy debug view
+
+			    while(bits != 0)
+			    {
+				    uint light_index = ssbo_zbin_lights[(word << 5) + uint(findLSB(bits))];
+				    bits &= bits - 1;
+
+				    radiance += shadeLight(light_index, material, camera_distance);
+			    }
+		    }
+	    }
+    }
+    else
+    {
+	    lights_range = unpack_cluster_range(ssbo_cluster_lights[cluster_index]);
+	    uint num_lights = min(lights_range.count, CLUSTER_MAX_LIGHTS);
+
+	    // too many lights?
+	    if(lights_range.count > CLUSTER_MAX_LIGHTS)
+			radiance += vec3(1, 0, 1);
+		else if(u_debug_unshaded_clusters && num_lights == 0)
+			radiance += vec3(int((gl_FragCoord.x + gl_FragCoord.y)/10) % 2 == 0? 2: 0, 0, 0); // TODO: draw a simple pattern
+
+#if CLUSTER_COMPACT_LIGHTS
+	    // two 16-bit light indices per uint (the start index is always even)
+	    uint first_pair = lights_range.start_index >> 1;
+	    for (uint idx = 0; idx < num_lights; idx += 2)
+	    {
+		    uint pair = all_lights_index[first_pair + (idx >> 1)];
+		    radiance += shadeLight(pair & 0xffffu, material, camera_distance);
+		    if(idx + 1 < num_lights)
+			    radiance += shadeLight(pair >> 16, material, camera_distance);
+	    }
+#else
+	    for (uint idx = 0; idx < num_lights; ++idx)
+		    radiance += shadeLight(all_lights_index[lights_range.start_index + idx], material, camera_distance);
+#endif
     }
 
     radiance += indirectLightingIBL(in_world_pos, material);
@@ -251,6 +247,81 @@ void main()
     }
 }
 
+vec3 shadeLight(uint light_index, MaterialProperties material, float camera_distance)
+{
+	GPULight light = unpack_light(ssbo_lights[light_index]);
+	if(! IS_ENABLED(light))
+		return vec3(0);
+
+	vec3 visibility = vec3(1);
+	vec3 contribution = vec3(0);
+
+	switch(GET_LIGHT_TYPE(light))
+	{
+		case LIGHT_TYPE_POINT:
+		{
+			visibility = pointLightVisibility(light, in_world_pos, camera_distance);
+			if(visibility.x + visibility.y + visibility.z > s_min_visibility)
+				contribution = calcPointLight(light, in_world_pos, material);
+		}
+		break;
+
+		case LIGHT_TYPE_DIRECTIONAL:
+		{
+			visibility = dirLightVisibility(light, in_world_pos, camera_distance);
+			if(visibility.x + visibility.y + visibility.z > s_min_visibility)
+				contribution = calcDirectionalLight(light, in_world_pos, material);
+		}
+		break;
+
+		case LIGHT_TYPE_SPOT:
+		{
+			visibility = spotLightVisibility(light, in_world_pos, camera_distance);
+			if(visibility.x + visibility.y + visibility.z > s_min_visibility)
+				contribution = calcSpotLight(light, in_world_pos, material);
+		}
+		break;
+
+		case LIGHT_TYPE_RECT:
+		{
+			visibility = rectLightVisibility(light, camera_distance);
+			if(visibility.x + visibility.y + visibility.z > s_min_visibility)
+				contribution = calcRectLight(light, in_world_pos, material);
+		}
+		break;
+
+		case LIGHT_TYPE_TUBE:
+		{
+			visibility = tubeLightVisibility(light, camera_distance);
+			if(visibility.x + visibility.y + visibility.z > s_min_visibility)
+				contribution = calcTubeLight(light, in_world_pos, material);
+		}
+		break;
+
+		case LIGHT_TYPE_SPHERE:
+		{
+			visibility = sphereLightVisibility(light, camera_distance);
+			if(visibility.x + visibility.y + visibility.z > s_min_visibility)
+				contribution = calcSphereLight(light, in_world_pos, material);
+		}
+		break;
+
+		case LIGHT_TYPE_DISC:
+		{
+			visibility = discLightVisibility(light, camera_distance);
+			if(visibility.x + visibility.y + visibility.z > s_min_visibility)
+				contribution = calcDiscLight(light, in_world_pos, material);
+		}
+		break;
+
+		default:
+			// unexpected light type, set an "error" color
+			return vec3(5, 0, 5);
+	}
+
+	return visibility * contribution;
+}
+
 uint computeClusterIndex(uvec3 cluster_coord)
 {
     return cluster_coord.x + (u_cluster_resolution.x * (cluster_coord.y + u_cluster_resolution.y * cluster_coord.z));
@@ -300,9 +371,9 @@ vec3 pointLightVisibility(GPULight light, vec3 world_pos, float camera_distance)
 	mat4 view_proj;
 	vec4 slot_rect; // shadow slot rectangle in atlas, in absolute pixels
 	float texel_size;
-	uint cube_face = detectCubeFaceSlot(light_to_frag, slot_info, view_proj, slot_rect, texel_size);
+	uint face = detectPointShadowSlot(light_to_frag, slot_info, view_proj, slot_rect, texel_size);
 
-	vec4 clip_pos = view_proj * vec4(world_pos, 1);
+	vec4 clip_pos = pointShadowClipPos(slot_info.projection, view_proj, world_pos);
 	vec3 ndc_pos = clip_pos.xyz / clip_pos.w; // [-1, 1]
 	vec3 uv_pos = ndc_pos * 0.5 + 0.5; // [0, 1]
 	float uv_depth = uv_pos.z;
@@ -339,7 +410,7 @@ vec3 pointLightVisibility(GPULight light, vec3 world_pos, float camera_distance)
 	float shadow_faded = 1 - (1 - shadow_visibility) * shadow_fade * u_shadow_occlusion;
 	float visible = light_fade * shadow_faded;
 
-	return vec3(visible) * (u_shadow_colorize? s_shadow_tints[cube_face]: vec3(1));
+	return vec3(visible) * (u_shadow_colorize? s_shadow_tints[face]: vec3(1));
 }
 
 vec3 dirLightVisibility(GPULight light, vec3 world_pos, float camera_distance)
@@ -9,11 +9,14 @@ layout(location = 0) out vec3 out_world_pos;
 layout(location = 1) out vec2 out_texcoord;
 layout(location = 2) out vec3 out_normal;
 
+out float gl_ClipDistance[1];
+
 uniform mat4 u_model;
 uniform mat3 u_normal_matrix;
 
 uniform uint u_light_shadow_index;
 uniform uint u_shadow_slot_index;
+uniform mat4 u_page_crop = mat4(1);  // a virtual shadow map page's part of the projection (see VirtualShadowMaps)
 
 layout(std430, binding = SSBO_BIND_SHADOW_SLOTS_INFO) readonly buffer ShadowSlotsInfoSSBO
 {
@@ -30,5 +33,19 @@ void main()
 
 	mat4 light_vp = slot_info.view_proj[u_shadow_slot_index];
 
-	gl_Position = light_vp * u_model * vec4(in_pos, 1);
+	if(slot_info.projection == SHADOW_PROJECTION_DUAL_PARABOLOID)
+	{
+		// 'light_vp' is only the view, scaled by 1/far; warp it to the hemisphere's paraboloid
+		//   the warp isn't linear; large triangles are a bit off (they're straight in the map)
+		vec3 pos_ls = vec3(light_vp * u_model * vec4(in_pos, 1));
+		float dist = length(pos_ls);
+		vec3 dir = pos_ls / dist;
+		gl_Position = vec4(dir.xy / (1 - dir.z), dist*2 - 1, 1);  // same as paraboloidClipPos() in shadows.glh
+		// cut at the hemisphere (with a small overlap), the other side would wrap around
+		gl_ClipDistance[0] = 0.1 - dir.z;
+		return;
+	}
+
+	gl_Position = u_page_crop * light_vp * u_model * vec4(in_pos, 1);
+	gl_ClipDistance[0] = 1;  // only the paraboloids clip
 }
@@ -13,6 +13,7 @@
 #include "game_time.h"
 #include "gui/gui.h"   // IWYU pragma: keep
 
+#include "component/bounds.h"
 #include "component/model.h"
 #include "component/transform.h"
 #include "component/light_general.h"
@@ -22,7 +23,10 @@
 #include <glm/gtc/random.hpp>
 // #include <glm/gtx/string_cast.hpp>  // glm::to_string
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <format>
 #include <ranges>
 #include <vector>
 
@@ -58,6 +62,13 @@ static_assert(s_light_affect_fraction > s_light_shadow_max_fraction);
 static_assert(s_light_affect_fraction > s_light_volumetric_fraction);
 static_assert(s_light_shadow_max_fraction > s_light_shadow_affect_fraction);
 
+#if CLUSTER_COMPACT_LIGHTS
+// all light indices (incl. aggregates) fit in 16 bits, and all start indices in the packed range
+static_assert(MAX_POINT_LIGHTS + MAX_SPOT_LIGHTS + MAX_RECT_LIGHTS + MAX_TUBE_LIGHTS + MAX_SPHERE_LIGHTS + MAX_DISC_LIGHTS + MAX_LIGHT_AGGREGATES < 0xffff);
+static_assert(uint64_t(CLUSTER_MAX_COUNT) * CLUSTER_AVERAGE_LIGHTS <= (1ull << (32 - CLUSTER_RANGE_COUNT_BITS)));
+static_assert(CLUSTER_MAX_LIGHTS < CLUSTER_RANGE_COUNT_MASK);
+#endif
+
 glm::mat3 make_common_space_from_direction(const glm::vec3 &direction)
 {
 	glm::vec3 space_x;
@@ -84,14 +95,24 @@ ZigApp::ZigApp() :
 	_scene(_entities),
 	_light_mgr(_entities),
 	_shadow_atlas(8192, _light_mgr),
+	_virtual_shadow_maps(_light_mgr),
 	m_cluster_aabb_ssbo("cluster-aabb"sv),
 	m_cluster_discovery_ssbo("cluster-discovery"sv),
 	m_cull_lights_args_ssbo("cull-lights"sv),
 	m_cluster_light_ranges_ssbo("cluster-lights"sv),
 	m_cluster_all_lights_index_ssbo("cluster-all-lights"sv),
+	_cluster_tile_light_ranges_ssbo("cluster-tile-lights"sv),
+	_cluster_tile_lights_index_ssbo("cluster-tile-all-lights"sv),
+	_zbin_ranges_ssbo("zbin-ranges"sv),
+	_zbin_lights_index_ssbo("zbin-lights"sv),
+	_zbin_tile_bits_ssbo("zbin-tile-bits"sv),
 	m_affecting_lights_bitfield_ssbo("affecting-lights-bitfield"sv),
+	_cluster_cull_stats_ssbo("cluster-cull-stats"sv),
+	_sdsm_reduction_ssbo("sdsm-reduction"sv),
+	_vsm_requests_ssbo("vsm-page-requests"sv),
 	_relevant_lights_index_ssbo("relevant-lights-index"sv),
 	m_shadow_map_slots_ssbo("shadow-map-slots"sv),
+	_frame_graph(_rt_pool),
 	m_gamma               (2.2f),
 	_ibl_mip_level        (1.2f),
 	m_skybox_vao          (0),
@@ -109,7 +130,15 @@ ZigApp::ZigApp() :
 	m_cluster_discovery_ssbo.bindAt(SSBO_BIND_CLUSTER_DISCOVERY);
 	m_cluster_light_ranges_ssbo.bindAt(SSBO_BIND_CLUSTER_LIGHT_RANGE);
 	m_cluster_all_lights_index_ssbo.bindAt(SSBO_BIND_CLUSTER_ALL_LIGHTS);
+	_cluster_tile_light_ranges_ssbo.bindAt(SSBO_BIND_CLUSTER_TILE_LIGHT_RANGE);
+	_cluster_tile_lights_index_ssbo.bindAt(SSBO_BIND_CLUSTER_TILE_ALL_LIGHTS);
+	_zbin_ranges_ssbo.bindAt(SSBO_BIND_ZBIN_RANGES);
+	_zbin_lights_index_ssbo.bindAt(SSBO_BIND_ZBIN_LIGHTS_INDEX);
+	_zbin_tile_bits_ssbo.bindAt(SSBO_BIND_ZBIN_TILE_BITS);
 	m_affecting_lights_bitfield_ssbo.bindAt(SSBO_BIND_AFFECTING_LIGHTS_BITFIELD);
+	_cluster_cull_stats_ssbo.bindAt(SSBO_BIND_CLUSTER_CULL_STATS);
+	_sdsm_reduction_ssbo.bindAt(SSBO_BIND_SDSM_REDUCTION);
+	_vsm_requests_ssbo.bindAt(SSBO_BIND_VSM_PAGE_REQUESTS);
 	m_cull_lights_args_ssbo.bindAt(SSBO_BIND_CULL_LIGHTS_ARGS);
 	_relevant_lights_index_ssbo.bindAt(SSBO_BIND_RELEVANT_LIGHTS_INDEX);
 
@@ -231,6 +260,14 @@ void ZigApp::init_app()
 	m_shadow_depth_shader->link();
 	assert(*m_shadow_depth_shader);
 
+	m_sdsm_reduce_shader = std::make_shared<Shader>(core_shaders/"shadow_depth_reduce.comp");
+	m_sdsm_reduce_shader->link();
+	assert(*m_sdsm_reduce_shader);
+
+	m_vsm_mark_shader = std::make_shared<Shader>(core_shaders/"vsm_mark_pages.comp");
+	m_vsm_mark_shader->link();
+	assert(*m_vsm_mark_shader);
+
 	m_generate_clusters_shader = std::make_shared<Shader>(core_shaders/"clustered_generate.comp");
 	m_generate_clusters_shader->link();
 	assert(*m_generate_clusters_shader);
@@ -250,6 +287,21 @@ void ZigApp::init_app()
 	assert(*m_cull_lights_shader);
 	m_cull_lights_shader->setPostBarrier(Shader::Barrier::SSBO);  // config, only once
 
+	m_cull_tiles_shader = std::make_shared<Shader>(core_shaders/"clustered_tile_cull.comp");
+	m_cull_tiles_shader->link();
+	assert(*m_cull_tiles_shader);
+	m_cull_tiles_shader->setPostBarrier(Shader::Barrier::SSBO);  // config, only once
+
+	m_cull_lights_tiled_shader = std::make_shared<Shader>(core_shaders/"clustered_cull.comp", string_set{ "TILED"s });
+	m_cull_lights_tiled_shader->link();
+	assert(*m_cull_lights_tiled_shader);
+	m_cull_lights_tiled_shader->setPostBarrier(Shader::Barrier::SSBO);  // config, only once
+
+	m_zbin_tiles_shader = std::make_shared<Shader>(core_shaders/"clustered_zbin_tiles.comp");
+	m_zbin_tiles_shader->link();
+	assert(*m_zbin_tiles_shader);
+	m_zbin_tiles_shader->setPostBarrier(Shader::Barrier::SSBO);  // config, only once
+
 	m_clustered_pbr_shader = std::make_shared<Shader>(core_shaders/"pbr_lighting.vert", core_shaders/"pbr_clustered.frag");
     m_clustered_pbr_shader->link();
 	assert(*m_clustered_pbr_shader);
@@ -282,6 +334,8 @@ void ZigApp::init_app()
 	assert(*m_background_shader);
 
 	// Post-processing steps
+	PP::PostProcess::setTargetPool(_rt_pool);
+
 	m_tmo_pp.create();
 	assert(m_tmo_pp);
 
@@ -291,9 +345,16 @@ void ZigApp::init_app()
 	m_volumetrics_pp.create();
 	assert(m_volumetrics_pp);
 
-	m_blur3_pp.create(Window::width(), Window::height());
+	m_blur3_pp.create();
 	assert(m_blur3_pp);
 
+	_bench_blur_fixed_15.create();
+	assert(_bench_blur_fixed_15);
+	_bench_blur_tiled_15.create();
+	assert(_bench_blur_tiled_15);
+	_bench_blur_tiled_3.create();
+	assert(_bench_blur_tiled_3);
+
 	m_line_draw_shader = std::make_shared<Shader>(core_shaders/"line_draw.vert", core_shaders/"line_draw.frag");
 	m_line_draw_shader->link();
 	assert(*m_line_draw_shader);
@@ -377,17 +438,6 @@ void ZigApp::init_app()
 	_rt.create("rt", Window::width(), Window::height());
 	_rt.SetFiltering(TextureFiltering::Minify, TextureFilteringParam::LinearMipNearest); // not necessary?
 
-	static constexpr auto pp_downscale = 2;
-	_pp_low_rt.create("pp-low", Window::width() / pp_downscale, Window::height() / pp_downscale, C::HalfFloat | C::Texture, D::None);
-	_pp_low_rt.SetFiltering(TextureFiltering::Minify, TextureFilteringParam::LinearMipNearest); // not necessary?
-
-	_pp_full_rt.create("pp-full", Window::width(), Window::height(), C::Default, D::None);
-	_pp_full_rt.SetFiltering(TextureFiltering::Minify, TextureFilteringParam::LinearMipNearest); // not necessary?
-
-	// TODO: final_rt.cloneFrom(_rt);
-	_final_rt.create("final", Window::width(), Window::height(), C::Default, D::None);
-	_final_rt.SetFiltering(TextureFiltering::Minify, TextureFilteringParam::LinearMipNearest); // not necessary?
-
 	// IBL precomputations.
     GenSkyboxGeometry();
 
@@ -395,6 +445,7 @@ void ZigApp::init_app()
 	m_env_cubemap_rt->create("env", 2048, 2048);
 
 	_shadow_atlas.create();
+	_virtual_shadow_maps.create();
 	_contact_shadow_buffer.Create(Window::width(), Window::height(), GL_R16F, 1);
 	assert(_contact_shadow_buffer);
 
@@ -443,36 +494,27 @@ void ZigApp::init_app()
 	loadScene("test");
 }
 
-void ZigApp::calculateShadingClusterGrid()
+RGL::ClusterGrid ZigApp::clusterGridFor(const RGL::ClusterGridConfig &config) const
 {
-	const auto cluster_count_before = m_cluster_count;
-
 	// TODO: these should be properties related to the camera  (a component!)
 
-	static constexpr uint32_t screen_division = 16;    // more than 20 might be overkill
-	static constexpr float    depth_scale     = 1.f;   // default 1
-
-
-
-	m_cluster_resolution.x = screen_division;
-
-	m_cluster_block_size = uint32_t(std::ceil(float(Window::width()) / float(m_cluster_resolution.x)));
-	m_cluster_resolution.y = uint32_t(glm::ceil(float(Window::height()) / float(m_cluster_block_size)));
-
-	// The depth of the cluster grid during clustered rendering is dependent on the
-	// number of clusters subdivisions in the screen Y direction.
-	// Source: Clustered Deferred and Forward Shading (2012) (Ola Olsson, Markus Billeter, Ulf Assarsson).
+	return cluster_grid(config, glm::uvec2(Window::width(), Window::height()),
+						glm::radians(m_camera.verticalFov()), m_camera.nearPlane(), m_camera.farPlane());
+}
 
-	const float half_fov   = glm::radians(m_camera.verticalFov() * 0.5f);
-	const float sD         = 2.0f * glm::tan(half_fov) / float(m_cluster_resolution.y) * depth_scale;
-	m_near_k               = 1.0f + sD;  // used by "generate clusters" shader; apply scale factor to 'sD' to change the number of depth slices
-	m_log_cluster_res_y    = 1.0f / glm::log(m_near_k);
+void ZigApp::calculateShadingClusterGrid()
+{
+	const auto grid = clusterGridFor(_cluster_grid_config);
 
-	const float z_near     = m_camera.nearPlane();
-	const float z_far      = m_camera.farPlane();
-	const float log_depth  = glm::log(z_far / z_near);
-	m_cluster_resolution.z = uint32_t(glm::floor(log_depth * m_log_cluster_res_y));
+	const auto grid_changed = m_cluster_count == 0
+		or grid.resolution != m_cluster_resolution
+		or grid.block_size != m_cluster_block_size
+		or grid.near_k != m_near_k;
 
+	m_cluster_resolution = grid.resolution;
+	m_cluster_block_size = grid.block_size;
+	m_near_k             = grid.near_k;  // used by "generate clusters" shader
+	m_log_cluster_res_y  = grid.log_near_k_inv;
 
 	// TODO:
 	// Maybe use the grid depth calculation used by Doom 2016
@@ -489,11 +531,11 @@ void ZigApp::calculateShadingClusterGrid()
 	// 	return size_t(std::log(z_slice) * (float(num_slices) / far_near) - float(num_slices) * std::log(near_z) / far_near);
 	// };
 
-	const auto cluster_count = m_cluster_resolution.x * m_cluster_resolution.y * m_cluster_resolution.z;
+	const auto cluster_count = grid.count();
 
 	assert(cluster_count < CLUSTER_MAX_COUNT);
 
-	if(cluster_count != cluster_count_before)
+	if(grid_changed)
 	{
 		m_cluster_count = cluster_count;
 		Log::info("Shading clusters: {}   ({} x {} x {})", m_cluster_count, m_cluster_resolution.x, m_cluster_resolution.y, m_cluster_resolution.z);
@@ -529,12 +571,45 @@ void ZigApp::calculateShadingClusterGrid()
 	}
 }
 
+void ZigApp::adaptClusterGrid()
+{
+	const auto cull_time    = m_light_tile_cull_time.average() + m_light_cull_time.average();
+	const auto shading_time = m_shading_time.average();
+
+	const auto next = _cluster_grid_tuner.update(_cluster_grid_config, {
+		.num_clusters = _cluster_active_count,
+		.avg_lights   = _cluster_avg_lights,
+		.max_lights   = _cluster_max_lights,
+		.overflowed   = _cluster_overflowed,
+		.cull_time    = float(cull_time.count()),
+		.shading_time = float(shading_time.count()),
+	}, [this](const ClusterGridConfig &config) {
+		return clusterGridFor(config).count();
+	});
+
+	if(next)
+	{
+		Log::info("Adapting cluster grid: division {} -> {}, depth scale {:.2f} -> {:.2f}  (avg lights {:.1f}, max {}, overflowed {})",
+				  _cluster_grid_config.screen_division, next->screen_division, _cluster_grid_config.depth_scale, next->depth_scale,
+				  _cluster_avg_lights, _cluster_max_lights, _cluster_overflowed);
+		_cluster_grid_config = *next;
+		calculateShadingClusterGrid();
+	}
+}
+
 void ZigApp::prepareClusterBuffers()
 {
 	m_cluster_aabb_ssbo.resize(m_cluster_count);
 	m_cluster_discovery_ssbo.resize(1 + m_cluster_count*2);  // num_active, nonempty[N], active[N]
 	m_cluster_light_ranges_ssbo.resize(m_cluster_count);
+#if CLUSTER_COMPACT_LIGHTS
+	m_cluster_all_lights_index_ssbo.resize(1 + m_cluster_count * CLUSTER_AVERAGE_LIGHTS / 2); // all_lights_start_index, all_lights_index[] (16-bit pairs)
+#else
 	m_cluster_all_lights_index_ssbo.resize(1 + m_cluster_count * CLUSTER_AVERAGE_LIGHTS); // all_lights_start_index, all_lights_index[]
+#endif
+	const auto num_tiles = m_cluster_resolution.x * m_cluster_resolution.y;
+	_cluster_tile_light_ranges_ssbo.resize(num_tiles);
+	_cluster_tile_lights_index_ssbo.resize(1 + num_tiles * CLUSTER_TILE_AVERAGE_LIGHTS); // tile_lights_start_index, tile_lights_index[]
 	m_cull_lights_args_ssbo.resize(1);
 
 	/// Generate AABBs for clusters
@@ -1083,12 +1158,43 @@ void ZigApp::GenSkyboxGeometry()
 
 void ZigApp::downloadAffectingLightSet()
 {
+	// the captures of earlier frames, if the GPU is done with them (otherwise, keep using the previous results)
+
+	if(const auto stats_result = _cluster_cull_stats_ssbo.poll(); stats_result)
+	{
+		// average lights per (non-empty) cluster, before & after the shape tests
+		const auto &stats = stats_result->data;
+		_cluster_active_count = stats[0];
+		if(const auto num_clusters = stats[0]; num_clusters > 0)
+		{
+			_cluster_avg_sphere_lights = float(stats[1]) / float(num_clusters);
+			_cluster_avg_lights        = float(stats[2]) / float(num_clusters);
+		}
+		_cluster_max_lights = stats[3];
+		_cluster_overflowed = stats[4];
+
+		// (captures from before switching to the z-bin assignment might still arrive)
+		if(_adaptive_cluster_grid and not _zbin_light_assignment)
+			adaptClusterGrid();
+	}
+
+	if(const auto sdsm_result = _sdsm_reduction_ssbo.poll(); sdsm_result)
+		_shadow_atlas.set_sdsm_reduction(sdsm_result->frame, sdsm_result->data);
+
+	if(const auto vsm_result = _vsm_requests_ssbo.poll(); vsm_result and _shadow_paged)
+		_virtual_shadow_maps.process_requests(vsm_result->frame, vsm_result->data);
+
+	const auto result = m_affecting_lights_bitfield_ssbo.poll();
+	if(not result)
+		return;
+
 	_affecting_lights.clear();
+	_affecting_lights_frame = result->frame;
 
 	// Log::info("  affecting lights:");
 
 	// "decode" the bitfield into actual light indices
-	for(const auto &[bucket, bucket_bits]: std::views::enumerate(m_affecting_lights_bitfield_ssbo))
+	for(const auto &[bucket, bucket_bits]: std::views::enumerate(result->data))
 	{
 		auto bits = bucket_bits;
 		while(bits)
@@ -1118,6 +1224,9 @@ void ZigApp::render()
 
 	const auto now = steady_clock::now();
 
+	++_frame_number;
+	_rt_pool.next_frame();
+
 	downloadAffectingLightSet();
 
 	m_camera.setFov(m_camera_fov);
@@ -1146,6 +1255,9 @@ void ZigApp::render()
 
 	if(auto d = _gl_timers["z-prepass"].elapsed<microseconds>(); d)
 		m_depth_time.add(*d);
+
+	reduceShadowDepth();
+	markShadowPages();
 	// ------------------------------------------------------------------
 	_gl_timers["cluster-find"].start();
 
@@ -1187,22 +1299,74 @@ void ZigApp::render()
 	if(auto d = _gl_timers["cluster-index"].elapsed<microseconds>(); d)
 		m_cluster_index_time.add(*d);
 	// ------------------------------------------------------------------
+	_gl_timers["cluster-tiles"].start();
+
+	const auto light_max_distance = std::min(100.f, m_camera.farPlane());
+
+	// Assign lights to tiles (columns of clusters), to shorten the per-cluster light lists
+	if(_tiled_light_culling and not _zbin_light_assignment)
+	{
+		_cluster_tile_lights_index_ssbo.clear();
+		m_cull_tiles_shader->setUniform("u_cluster_resolution"sv, m_cluster_resolution);
+		m_cull_tiles_shader->setUniform("u_cam_pos"sv, m_camera.position());
+		m_cull_tiles_shader->setUniform("u_light_max_distance"sv, light_max_distance);
+		m_cull_tiles_shader->setUniform("u_view_matrix"sv, m_camera.viewTransform());
+		m_cull_tiles_shader->invoke(m_cluster_resolution.x, m_cluster_resolution.y);
+	}
+
+	if(auto d = _gl_timers["cluster-tiles"].elapsed<microseconds>(); d)
+		m_light_tile_cull_time.add(*d);
+	// ------------------------------------------------------------------
 	_gl_timers["cluster-cull"].start();
 
 	// Assign lights to clusters (cull lights)
-	m_cluster_light_ranges_ssbo.clear();
-	m_cluster_all_lights_index_ssbo.clear();
-	m_affecting_lights_bitfield_ssbo.clear();
-	m_cull_lights_shader->setUniform("u_cam_pos"sv, m_camera.position());
-	m_cull_lights_shader->setUniform("u_light_max_distance"sv, std::min(100.f, m_camera.farPlane()));
-	m_cull_lights_shader->setUniform("u_view_matrix"sv, m_camera.viewTransform());
-	m_cull_lights_shader->setUniform("u_num_clusters"sv, m_cluster_count);
-	m_cull_lights_shader->setUniform("u_max_cluster_avg_lights"sv, uint32_t(CLUSTER_AVERAGE_LIGHTS));
-	m_cull_lights_shader->invoke(m_cull_lights_args_ssbo);
+	if(not _zbin_light_assignment)
+	{
+		m_cluster_light_ranges_ssbo.clear();
+		m_cluster_all_lights_index_ssbo.clear();
+		m_affecting_lights_bitfield_ssbo.clear();
+		_cluster_cull_stats_ssbo.clear();
+		auto &cull_lights_shader = _tiled_light_culling? *m_cull_lights_tiled_shader: *m_cull_lights_shader;
+		cull_lights_shader.setUniform("u_cam_pos"sv, m_camera.position());
+		cull_lights_shader.setUniform("u_light_max_distance"sv, light_max_distance);
+		cull_lights_shader.setUniform("u_view_matrix"sv, m_camera.viewTransform());
+		cull_lights_shader.setUniform("u_num_clusters"sv, m_cluster_count);
+		cull_lights_shader.setUniform("u_max_cluster_avg_lights"sv, uint32_t(CLUSTER_AVERAGE_LIGHTS));
+		cull_lights_shader.setUniform("u_shape_culling"sv, _light_shape_culling);
+		if(_tiled_light_culling)
+			cull_lights_shader.setUniform("u_num_tiles"sv, m_cluster_resolution.x * m_cluster_resolution.y);
+		cull_lights_shader.invoke(m_cull_lights_args_ssbo);
+
+		m_affecting_lights_bitfield_ssbo.capture(_frame_number);
+		_cluster_cull_stats_ssbo.capture(_frame_number);
+	}
 
 	if(auto d = _gl_timers["cluster-cull"].elapsed<microseconds>(); d)
 		m_light_cull_time.add(*d);
 	// ------------------------------------------------------------------
+	_gl_timers["cluster-zbin"].start();
+
+	// Assign lights to tiles & z-bins (instead of the clusters)
+	if(_zbin_light_assignment)
+	{
+		binLightsByDepth(m_camera);
+
+		m_affecting_lights_bitfield_ssbo.clear();
+		_zbin_tile_bits_ssbo.clear();
+		m_zbin_tiles_shader->setUniform("u_cluster_resolution"sv, m_cluster_resolution);
+		m_zbin_tiles_shader->setUniform("u_cam_pos"sv, m_camera.position());
+		m_zbin_tiles_shader->setUniform("u_light_max_distance"sv, light_max_distance);
+		m_zbin_tiles_shader->setUniform("u_view_matrix"sv, m_camera.viewTransform());
+		m_zbin_tiles_shader->setUniform("u_num_lights"sv, uint32_t(_zbin_lights.size()));
+		m_zbin_tiles_shader->setUniform("u_num_words"sv, _zbin_ranges[0]);
+		m_zbin_tiles_shader->invoke(m_cluster_resolution.x, m_cluster_resolution.y);
+
+		m_affecting_lights_bitfield_ssbo.capture(_frame_number);
+	}
+
+	if(auto d = _gl_timers["cluster-zbin"].elapsed<microseconds>(); d)
+		m_light_zbin_time.add(*d);
+	// ------------------------------------------------------------------
 	_gl_timers["shading"].start();
 
 	_rt.bindRenderTarget(RenderTarget::ColorBuffer);
@@ -1222,6 +1386,22 @@ void ZigApp::render()
 	if(auto d = _gl_timers["skybox"].elapsed<microseconds>(); d)
 		m_skybox_time.add(*d);
 	// ------------------------------------------------------------------
+	// from here, the passes are declared to the frame graph (executed below)
+	//   the intermediate render targets are transient, i.e. shared when their lifetimes don't overlap
+
+	namespace C = RenderTarget::Color;
+	using Access = FrameGraph::Access;
+	using Builder = FrameGraph::Builder;
+	using Resources = FrameGraph::Resources;
+
+	static constexpr auto pp_downscale = 2u;
+	const glm::uvec2 screen_size { Window::width(), Window::height() };
+
+	_frame_graph.clear();
+	const auto rt = _frame_graph.import_texture("rt", _rt);
+	FrameGraph::Handle pp_low_rt { FrameGraph::Invalid };
+	FrameGraph::Handle pp_full_rt { FrameGraph::Invalid };
+	FrameGraph::Handle final_rt { FrameGraph::Invalid };
 
 	if(m_volumetrics_pp.enabled() and _fog_density > 0 and _fog_strength > 0)
 	{
@@ -1233,34 +1413,60 @@ void ZigApp::render()
 		if(auto d = _gl_timers["volumetrics-cull"].elapsed<microseconds>(); d)
 			m_volumetrics_cull_time.add(*d);
 		// ------------------------------------------------------------------
-		_gl_timers["volumetrics-inject"].start();
-
 		m_volumetrics_pp.setStrength(_fog_strength);
 		m_volumetrics_pp.setDensity(_fog_density);
 		m_volumetrics_pp.setTemporalBlendWeight(_fog_blend_weight);  // if blending is enabled
 
-		auto &shader = m_volumetrics_pp.shader();
-		shader.setUniform("u_light_max_distance"sv,  m_camera.farPlane() * s_light_affect_fraction);
-		shader.setUniform("u_shadow_max_distance"sv, m_camera.farPlane() * s_light_shadow_affect_fraction);
-		shader.setUniform("u_falloff_power"sv, _light_mgr.falloff_power());
+		// the static lights' cache is baked using the same light & shadow uniforms as the injection
+		for(auto *shader: { &m_volumetrics_pp.shader(), &m_volumetrics_pp.cacheShader() })
+		{
+			shader->setUniform("u_light_max_distance"sv,  m_camera.farPlane() * s_light_affect_fraction);
+			shader->setUniform("u_shadow_max_distance"sv, m_camera.farPlane() * s_light_shadow_affect_fraction);
+			shader->setUniform("u_falloff_power"sv, _light_mgr.falloff_power());
 
 
-		if(const auto &csm = _shadow_atlas.csm_params(); csm)
-		{
-			shader.setUniform("u_csm_num_cascades"sv,     uint32_t(csm.num_cascades));
-			shader.setUniform("u_csm_split_depth"sv,      csm.split_depth);
-			// shader.setUniform("u_csm_cascade_near_far"sv, csm.near_far_plane); // PCSS
-			shader.setUniform("u_csm_light_radius_uv"sv,  csm.light_radius_uv); // PCSS
-			// needed in vertex shader
-			shader.setUniform("u_csm_light_view_space"sv, csm.light_view);
-			shader.setUniform("u_csm_light_clip_space"sv, csm.light_view_projection); // also in SSBO, but we'd like to avoid accessing that from the vertex shader
+			if(const auto &csm = _shadow_atlas.csm_params(); csm)
+			{
+				shader->setUniform("u_csm_num_cascades"sv,     uint32_t(csm.num_cascades));
+				shader->setUniform("u_csm_split_depth"sv,      csm.split_depth);
+				// shader->setUniform("u_csm_cascade_near_far"sv, csm.near_far_plane); // PCSS
+				shader->setUniform("u_csm_light_radius_uv"sv,  csm.light_radius_uv); // PCSS
+				// needed in vertex shader
+				shader->setUniform("u_csm_light_view_space"sv, csm.light_view);
+				shader->setUniform("u_csm_light_clip_space"sv, csm.light_view_projection); // also in SSBO, but we'd like to avoid accessing that from the vertex shader
+			}
+			else
+				shader->setUniform("u_csm_num_cascades"sv,     0u);
+
+			shader->setUniform("u_vsm_pages_per_dim"sv, VirtualShadowMaps::PAGES_PER_DIM);
+			shader->setUniform("u_vsm_page_size"sv,     _virtual_shadow_maps.page_size());
 		}
-		else
-			shader.setUniform("u_csm_num_cascades"sv,     0u);
 
 
 		_shadow_atlas.bindDepthTextureSampler(22); // just using single-sample, no PCF
+		_virtual_shadow_maps.bindShadowSampler(24);
 		m_depth_pass_rt.bindDepthTextureSampler(2); // HUH?!?
+		// ------------------------------------------------------------------
+		_gl_timers["volumetrics-cache"].start();
+
+		// lights whose shadows may change any frame can't be cached
+		_fog_uncacheable_lights.clear();
+		for(auto light_index = 0u; light_index < _light_mgr.size(); ++light_index)
+		{
+			const auto &L = _light_mgr.at(light_index);
+			if(IS_VOLUMETRIC(L) and IS_SHADOW_CASTER(L))
+			{
+				const auto light_id = _light_mgr.light_id(light_index);
+				if(_shadow_atlas.has_dynamic_casters(light_id))
+					_fog_uncacheable_lights.insert(light_id);
+			}
+		}
+		m_volumetrics_pp.updateCache(_light_mgr, _scene.static_generation(), _fog_uncacheable_lights);
+
+		if(auto d = _gl_timers["volumetrics-cache"].elapsed<microseconds>(); d)
+			m_volumetrics_cache_time.add(*d);
+		// ------------------------------------------------------------------
+		_gl_timers["volumetrics-inject"].start();
 
 		m_volumetrics_pp.inject();
 
@@ -1274,39 +1480,47 @@ void ZigApp::render()
 		if(auto d = _gl_timers["volumetrics-accum"].elapsed<microseconds>(); d)
 			m_volumetrics_accum_time.add(*d);
 		// ------------------------------------------------------------------
-		_gl_timers["volumetrics-render"].start();
-
-		_pp_low_rt.clear();
-		m_volumetrics_pp.render(_rt, _pp_low_rt);  // '_rt' actually isn't used but the API expects an argument
-
+		_frame_graph.add_pass("volumetrics-render", [&](Builder &builder) {
+			pp_low_rt = builder.create("pp_low_rt", { .size = screen_size / pp_downscale, .color = C::HalfFloat | C::Texture });
+			builder.write(pp_low_rt, Access::Transfer);
+			builder.write(pp_low_rt, Access::Image);
+		}, [&](const Resources &res) {
+			_gl_timers["volumetrics-render"].start();
+
+			auto &pp_low = res.texture(pp_low_rt);
+			pp_low.clear();
+			m_volumetrics_pp.render(_rt, pp_low);  // '_rt' actually isn't used but the API expects an argument
+		});
 
-		// _pp_low_rt.copyTo(_pp_full_rt);  // copy and upscale
+		// pp_low.copyTo(pp_full);  // copy and upscale
 		// NOTE: draw b/c copy(blit) doesn't work!?!?
 		//   no biggie though, it's often faster in practice
-#if 0
-		// blur low-res target
-		m_blur3_pp.render(_pp_low_rt, _pp_low_rt);
-#endif
-		// upscale to full-size
-		draw2d(_pp_low_rt.color_texture(), _pp_full_rt);
-
-#if 0
-		// TODO: change to MipmapBlur
-		// m_blur3_pp.render(_pp_full_rt, _pp_full_rt);
-		// m_blur3_pp.render(_pp_full_rt, _pp_full_rt);
-		// m_blur3_pp.render(_pp_full_rt, _pp_full_rt);
-#endif
+		_frame_graph.add_pass("volumetrics-upscale", [&](Builder &builder) {
+			builder.read(pp_low_rt, Access::Sampled);
+			pp_full_rt = builder.create("pp_full_rt", { .size = screen_size });
+			builder.write(pp_full_rt, Access::Attachment);
+		}, [&](const Resources &res) {
+			// upscale to full-size
+			draw2d(res.texture(pp_low_rt).color_texture(), res.texture(pp_full_rt));
+		});
 
-		// add the scattering effect on to the final image
-		draw2d(_pp_full_rt.color_texture(), _rt, BlendMode::Add);  // TODO: should be Alpha bland! no scatter should be just sample fog color
-		// m_pp_blur_time.add(_gl_timer.elapsed<microseconds>());
+		_frame_graph.add_pass("volumetrics-composite", [&](Builder &builder) {
+			builder.read(pp_full_rt, Access::Sampled);
+			builder.read(rt, Access::Attachment);  // blended
+			builder.write(rt, Access::Attachment);
+		}, [&](const Resources &res) {
+			// add the scattering effect on to the final image
+			draw2d(res.texture(pp_full_rt).color_texture(), _rt, BlendMode::Add);  // TODO: should be Alpha bland! no scatter should be just sample fog color
 
-		if(auto d = _gl_timers["volumetrics-render"].elapsed<microseconds>(); d)
-			m_volumetrics_render_time.add(*d);
+			if(auto d = _gl_timers["volumetrics-render"].elapsed<microseconds>(); d)
+				m_volumetrics_render_time.add(*d);
+		});
 	}
 	else
 	{
+		m_volumetrics_pp.invalidateHistory();
 		m_volumetrics_cull_time.clear();
+		m_volumetrics_cache_time.clear();
 		m_volumetrics_inject_time.clear();
 		m_volumetrics_accum_time.clear();
 		m_volumetrics_render_time.clear();
@@ -1323,29 +1537,54 @@ void ZigApp::render()
 
 	// ------------------------------------------------------------------
 	// Bloom
-	_gl_timers["bloom-tonemap"].start();
-
 	if (m_bloom_pp.enabled())
     {
-		m_bloom_pp.setThreshold(m_bloom_threshold);
-		m_bloom_pp.setIntensity(m_bloom_intensity);
-		m_bloom_pp.setKnee(m_bloom_knee);
-		m_bloom_pp.setDirtIntensity(m_bloom_dirt_intensity);
-
-		m_bloom_pp.render(_rt, _rt);
+		_frame_graph.add_pass("bloom", [&](Builder &builder) {
+			builder.read(rt, Access::Sampled);
+			builder.write(rt, Access::Image);
+		}, [&](const Resources &) {
+			_gl_timers["bloom-tonemap"].start();
+
+			m_bloom_pp.setThreshold(m_bloom_threshold);
+			m_bloom_pp.setIntensity(m_bloom_intensity);
+			m_bloom_pp.setKnee(m_bloom_knee);
+			m_bloom_pp.setDirtIntensity(m_bloom_dirt_intensity);
+
+			m_bloom_pp.render(_rt, _rt);
+		});
 	}
 
 	// Apply tone mapping
-	// TODO: continuously adjust 'm_exposure' depending on how bright the image is (see above)
-	m_tmo_pp.setExposure(m_camera.exposure());
-	m_tmo_pp.setGamma(m_gamma);
-	m_tmo_pp.render(_rt, _final_rt);
+	_frame_graph.add_pass("tonemap", [&](Builder &builder) {
+		builder.read(rt, Access::Sampled);
+		final_rt = builder.create("final_rt", { .size = screen_size });
+		builder.write(final_rt, Access::Attachment);
+	}, [&](const Resources &res) {
+		if(not m_bloom_pp.enabled())
+			_gl_timers["bloom-tonemap"].start();
+
+		// TODO: continuously adjust 'm_exposure' depending on how bright the image is (see above)
+		m_tmo_pp.setExposure(m_camera.exposure());
+		m_tmo_pp.setGamma(m_gamma);
+		m_tmo_pp.render(_rt, res.texture(final_rt));
+	});
 
 	// draw the final result to the screen
-	draw2d(_final_rt.color_texture(), BlendMode::Replace);
+	_frame_graph.add_pass("present", [&](Builder &builder) {
+		builder.read(final_rt, Access::Sampled);
+		builder.side_effect();
+	}, [&](const Resources &res) {
+		draw2d(res.texture(final_rt).color_texture(), BlendMode::Replace);
+
+		if(auto d = _gl_timers["bloom-tonemap"].elapsed<microseconds>(); d)
+			m_tonemap_time.add(*d);
+	});
+
+	_frame_graph.compile();
+	_frame_graph.execute();
 
-	if(auto d = _gl_timers["bloom-tonemap"].elapsed<microseconds>(); d)
-		m_tonemap_time.add(*d);
+	if(_blur_benchmark)
+		benchmarkBlur();
 	// ------------------------------------------------------------------
 	_gl_timers["debug-draw"].start();
 
@@ -1360,6 +1599,34 @@ void ZigApp::render()
 		m_debug_draw_time.add(*d);
 }
 
+void ZigApp::benchmarkBlur()
+{
+	// the same input for all methods; the content doesn't matter
+	static constexpr std::array<glm::uvec2, 2> resolutions { glm::uvec2{ 1920, 1080 }, glm::uvec2{ 3840, 2160 } };
+	static constexpr auto color_cfg = RenderTarget::Color::HalfFloat | RenderTarget::Color::Texture;
+
+	for(auto res_idx = 0u; res_idx < resolutions.size(); ++res_idx)
+	{
+		auto &in = _rt_pool.acquire({ .size = resolutions[res_idx], .color = color_cfg }, "blur-bench-in"sv);
+		auto &out = _rt_pool.acquire({ .size = resolutions[res_idx], .color = color_cfg }, "blur-bench-out"sv);
+
+		const std::array<PP::PostProcess *, 4> methods { &_bench_blur_fixed_15, &_bench_blur_tiled_15, &m_blur3_pp, &_bench_blur_tiled_3 };
+		static constexpr std::array<std::string_view, 4> timer_names { "blur-fixed-1.5"sv, "blur-tiled-1.5"sv, "blur-fixed-3"sv, "blur-tiled-3"sv };
+
+		for(auto method = 0u; method < methods.size(); ++method)
+		{
+			auto &timer = _gl_timers[std::format("{}-{}", timer_names[method], res_idx)];
+			timer.start();
+			methods[method]->render(in, out);
+			if(auto d = timer.elapsed<microseconds>(); d)
+				_blur_benchmark_time[res_idx*4 + method].add(*d);
+		}
+
+		_rt_pool.release(out);
+		_rt_pool.release(in);
+	}
+}
+
 void ZigApp::renderShadowMaps()
 {
 	// render shadow-maps if light or meshes within its radius/frustum moved (the latter is TODO)
@@ -1375,7 +1642,8 @@ void ZigApp::renderShadowMaps()
 
 	const auto now = steady_clock::now();
 
-	static steady_clock::time_point last_eval_time;
+	// casters that can't shadow the (shadowed part of the) view are culled
+	_shadow_atlas.set_receiver_volume(m_camera, m_camera.farPlane() * s_light_shadow_max_fraction);
 
 	// if there's a sun allocated, update its shadow parameters
 	if(const auto &sun_id = _light_mgr.sun_id(); sun_id != NO_LIGHT_ID)
@@ -1385,17 +1653,27 @@ void ZigApp::renderShadowMaps()
 		_shadow_atlas.update_csm_params(sun_id, m_camera);//, _sun_radius_uv);
 	}
 
-	if(now - last_eval_time > 100ms)
+	// the planning runs on a worker thread; a finished plan is applied, then a new one started
+	//   i.e. the measured time is only the snapshot & apply part
+	_shadow_atlas.set_max_distance(m_camera.farPlane() * s_light_shadow_max_fraction);
+	_shadow_atlas.set_point_projection_bands(_shadow_band_tetrahedral, _shadow_band_paraboloid);
+	const auto T0 = steady_clock::now();
+	if(_shadow_paged)
 	{
-		last_eval_time = now;
-
-		_shadow_atlas.set_max_distance(m_camera.farPlane() * s_light_shadow_max_fraction);
-		const auto T0 = steady_clock::now();
-		_shadow_atlas.update_allocations(_lightsPvs, m_camera.position(), m_camera.forwardVector());
-		m_shadow_alloc_time.add(duration_cast<microseconds>(steady_clock::now() - T0));
+		// the atlas only has the sun; the point & spot lights get virtual maps
+		_atlasLights.clear();
+		std::ranges::copy_if(_lightsPvs, std::back_inserter(_atlasLights), [this](LightIndex light_index) {
+			return IS_DIR_LIGHT(_light_mgr[light_index]);
+		});
+		_shadow_atlas.update_allocations_async(_atlasLights, m_camera.position(), m_camera.forwardVector());
+		_virtual_shadow_maps.update_lights(_lightsPvs, m_camera.position());
 	}
 	else
-		m_shadow_alloc_time.add(microseconds(0));
+		_shadow_atlas.update_allocations_async(_lightsPvs, m_camera.position(), m_camera.forwardVector());
+	m_shadow_alloc_time.add(duration_cast<microseconds>(steady_clock::now() - T0));
+
+	// make room for denied lights, relocating (copying) slots as needed; before the slots' SSBO is updated
+	_shadow_atlas.defragment();
 
 	// light projections needs to be updated more often than the atlas allocations.
 	//   it also needs to be updated when the light has moved (new view-projection),
@@ -1412,6 +1690,8 @@ void ZigApp::renderShadowMaps()
 
 	_light_shadow_maps_rendered = 0;
 	_shadow_atlas_slots_rendered = 0;
+	_shadow_proxy_draws = 0;
+	_shadow_full_draws = 0;
 
 	// TODO: limit the number of shadow maps to render in one frame, e.g. top N most important lights
 	//    the remaining will still by "dirty" so they will be rendered eventually.
@@ -1423,6 +1703,9 @@ void ZigApp::renderShadowMaps()
 	seen_shadow_idx.clear();
 #endif
 
+	// dual-paraboloid slots cut their triangles at the hemisphere (see shadow_depth.vert)
+	glEnable(GL_CLIP_DISTANCE0);
+
 	for(auto &[light_id, atlas_light]: _shadow_atlas.allocated_lights())
 	{
 		const auto light_index = _light_mgr.light_index(light_id);
@@ -1440,9 +1723,8 @@ void ZigApp::renderShadowMaps()
 			continue;
 		}
 
-		auto light_hash = _light_mgr.hash(light_id, general, transform);
-		if(general.light_type == LightType::Directional)  // also affected by the camera's frustum
-			light_hash = hash_combine(light_hash, m_camera.hash());
+		// for directional lights, the camera's influence is tracked per cascade (see ShadowAtlas::update_csm_params())
+		const auto light_hash = _light_mgr.hash(light_id, general, transform);
 
 		// TODO: keep TWO shadow maps, one static-object only (cache) and one active (all objects)
 		//   1. render static objects first, to both maps (copy to active afterwards?)
@@ -1487,23 +1769,65 @@ void ZigApp::renderShadowMaps()
 
 					const auto &pvs = _shadow_atlas.pvs(_scene, light_id, slot_idx);
 
-					renderSceneShadow(pvs, shadow_idx, slot_idx, dynamic_only);
+					renderSceneShadow(pvs, shadow_idx, slot_idx, _shadow_atlas.slot_texel_scale(atlas_light, slot_idx), dynamic_only);
 					++_shadow_atlas_slots_rendered;
 					++slots_rendered;
 				}
 			}
-			assert(slots_rendered == atlas_light.num_slots);
+			assert(int(slots_rendered) == std::popcount(uint32_t(need_render & ((1u << atlas_light.num_slots) - 1))));
 
-			atlas_light.on_rendered(now, light_hash);
+			_shadow_atlas.on_rendered(atlas_light, now, light_hash, need_render);
 			++_light_shadow_maps_rendered;
 		}
 	}
 
+	glDisable(GL_CLIP_DISTANCE0);
+
+	if(_shadow_paged)
+		renderShadowPages();
+
 	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);  // back to default; write all color channels
 	glDisable(GL_SCISSOR_TEST);
 	glCullFace(GL_BACK);
 }
 
+void ZigApp::renderShadowPages()
+{
+	// the requested pages (see markShadowPages()) that aren't cached, in the page pool
+	_shadow_pages_rendered = 0;
+
+	const auto &pages = _virtual_shadow_maps.pages_to_render();
+	if(not pages.empty())
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);  // the slots' SSBO
+
+	for(const auto &page: pages)
+	{
+		const auto light_ = _light_mgr.get_light(page.light_id);
+		if(not light_)
+			continue;
+		const auto &light = *light_;
+		const auto shadow_idx = light.general.shadow_index;
+		if(shadow_idx == LIGHT_NO_SHADOW)
+			continue;
+
+		// only the objects within the page's part of the frustum
+		const auto &[view, proj, near_z, far_z] = _shadow_atlas.light_view_projection(light, page.face);
+		Frustum frustum;
+		frustum.setFromView(page.crop * proj, view, light.transform.position());
+		_shadow_page_pvs.created_at = {};  // i.e. always query
+		_scene.query(frustum, _shadow_page_pvs);
+
+		_virtual_shadow_maps.bindRenderTarget(glm::ivec4(page.rect), RenderTarget::DepthBuffer);
+		// the pages are requested at the resolution the view needs; i.e. full detail
+		renderSceneShadow(_shadow_page_pvs, shadow_idx, page.face, {}, false, page.crop);
+
+		_virtual_shadow_maps.on_rendered(page, not _shadow_page_pvs.dynamic_entities.empty());
+		++_shadow_pages_rendered;
+	}
+
+	_virtual_shadow_maps.update_page_table_ssbo();
+}
+
 void ZigApp::renderSkybox()
 {
 	glEnable(GL_DEPTH_TEST);
@@ -1794,6 +2118,78 @@ void ZigApp::cullScene(const Camera &view, QueryResult &pvs)
 	m_cull_scene_time.add(duration_cast<microseconds>(steady_clock::now() - T0));
 }
 
+void ZigApp::reduceShadowDepth()
+{
+	// the visible depth range & the cascades' light-space bounds, for the next frames' CSM (SDSM)
+	//   i.e. using this frame's cascade splits, to bin the samples
+	if(not _shadow_atlas.sdsm() or not _shadow_atlas.csm_params())
+		return;
+
+	const auto &params = _shadow_atlas.sdsm_reduce_params(_frame_number);
+
+	auto &shader = *m_sdsm_reduce_shader;
+	shader.setUniform("u_near_z"sv,                m_camera.nearPlane());
+	shader.setUniform("u_far_z"sv,                 m_camera.farPlane());
+	shader.setUniform("u_inv_view_projection"sv,   glm::inverse(m_camera.projectionTransform() * m_camera.viewTransform()));
+	shader.setUniform("u_light_rotation"sv,        params.light_rotation);
+	shader.setUniform("u_split_depth"sv,           params.num_cascades, params.split_depth.data());
+	shader.setUniform("u_num_cascades"sv,          params.num_cascades);
+
+	_sdsm_reduction_ssbo.clear();
+	m_depth_pass_rt.bindDepthTextureSampler(0);
+	shader.invoke(size_t(glm::ceil(float(m_depth_pass_rt.width()) / 16.f)),
+				  size_t(glm::ceil(float(m_depth_pass_rt.height()) / 16.f)));
+
+	_sdsm_reduction_ssbo.capture(_frame_number);
+}
+
+void ZigApp::markShadowPages()
+{
+	// the virtual shadow map pages the visible samples need; rendered in a later frame (see renderShadowPages())
+	if(not _shadow_paged)
+		return;
+
+	static constexpr auto max_lights = VirtualShadowMaps::MAX_LIGHTS;
+	std::array<glm::vec4, max_lights> pos_radius;
+	std::array<int, max_lights>       shadow_index;
+	std::array<int, max_lights>       num_faces;
+	uint32_t num_lights { 0 };
+
+	for(const auto &[light_id, vlight]: _virtual_shadow_maps.lights())
+	{
+		const auto light_ = _light_mgr.get_light(light_id);
+		if(not light_ or light_->general.shadow_index == LIGHT_NO_SHADOW)
+			continue;
+		const auto &light = *light_;
+
+		pos_radius[num_lights]   = glm::vec4(light.transform.position(), light.gpu_light.affect_radius);
+		shadow_index[num_lights] = int(light.general.shadow_index);
+		num_faces[num_lights]    = int(vlight.num_maps);
+		++num_lights;
+	}
+
+	_vsm_requests_ssbo.clear();
+
+	if(num_lights > 0)
+	{
+		auto &shader = *m_vsm_mark_shader;
+		shader.setUniform("u_inv_view_projection"sv, glm::inverse(m_camera.projectionTransform() * m_camera.viewTransform()));
+		shader.setUniform("u_vsm_pages_per_dim"sv,   VirtualShadowMaps::PAGES_PER_DIM);
+		shader.setUniform("u_vsm_page_size"sv,       _virtual_shadow_maps.page_size());
+		shader.setUniform("u_num_lights"sv,          num_lights);
+		shader.setUniform("u_light_pos_radius"sv,    num_lights, pos_radius.data());
+		shader.setUniform("u_light_shadow_index"sv,  num_lights, shadow_index.data());
+		shader.setUniform("u_light_num_faces"sv,     num_lights, num_faces.data());
+
+		// one sample per 2x2 pixels
+		m_depth_pass_rt.bindDepthTextureSampler(0);
+		shader.invoke(size_t(glm::ceil(float(m_depth_pass_rt.width()) / 32.f)),
+					  size_t(glm::ceil(float(m_depth_pass_rt.height()) / 32.f)));
+	}
+
+	_vsm_requests_ssbo.capture(_frame_number);
+}
+
 void ZigApp::collectRelevantLights(const Camera &view)
 {
 	const auto T0 = steady_clock::now();
@@ -1809,6 +2205,11 @@ void ZigApp::collectRelevantLights(const Camera &view)
 		{
 			last_update = T0;
 
+			// merge distant lights into aggregates (if enabled)
+			//   flush right away, the aggregates are referenced below
+			_light_mgr.update_lod(view_pos);
+			_light_mgr.flush();
+
 			// static dense_set<uint> previous_pvs;
 			// previous_pvs.insert(_lightsPvs.begin(), _lightsPvs.end());
 			_lightsPvs.clear();
@@ -1817,7 +2218,7 @@ void ZigApp::collectRelevantLights(const Camera &view)
 			{
 				const auto light_index = LightIndex(l_index);
 
-				if(not IS_ENABLED(L))
+				if(not IS_ENABLED(L) or _light_mgr.is_aggregated(light_index))
 					continue;
 
 				if(IS_DIR_LIGHT(L))
@@ -1841,12 +2242,95 @@ void ZigApp::collectRelevantLights(const Camera &view)
 					}
 				}
 			}
+
+			// the aggregates are GPU-only; they're not part of the PVS
+			_lightsPvsGpu.assign(_lightsPvs.begin(), _lightsPvs.end());
+			for(const auto light_index: _light_mgr.aggregate_indices())
+			{
+				const auto &A = _light_mgr.aggregate_at(light_index);
+				const auto edge_distance = std::max(0.f, glm::distance(A.position, view_pos) - A.affect_radius);
+				if(edge_distance < max_view_distance)
+					_lightsPvsGpu.push_back(light_index);
+			}
+
 			// TODO: ideally these should be sorted by distance from camera
-			_relevant_lights_index_ssbo.set(_lightsPvs);
+			_relevant_lights_index_ssbo.set(_lightsPvsGpu);
 		}
 	}
 }
 
+void ZigApp::binLightsByDepth(const Camera &view)
+{
+	static_assert(MAX_POINT_LIGHTS + MAX_SPOT_LIGHTS + MAX_RECT_LIGHTS + MAX_TUBE_LIGHTS + MAX_SPHERE_LIGHTS + MAX_DISC_LIGHTS + MAX_LIGHT_AGGREGATES <= ZBIN_MAX_LIGHTS);
+
+	const auto &view_transform = view.viewTransform();
+	const auto near_z = view.nearPlane();
+	const auto far_z = view.farPlane();
+	const auto num_slices = m_cluster_resolution.z;
+
+	// directional lights first (they're in all bins), then the rest sorted by view depth
+	_zbin_lights.clear();
+	_zbin_sort.clear();
+	for(const auto light_index: _lightsPvsGpu)
+	{
+		const auto &C = _light_mgr.cull_record(light_index);
+		if(not IS_ENABLED(C))
+			continue;
+
+		if(GET_LIGHT_TYPE(C) == LightType::Directional)
+			_zbin_lights.push_back(light_index);
+		else
+			_zbin_sort.emplace_back(-(view_transform * glm::vec4(C.position, 1)).z, light_index);
+	}
+	const auto num_directional = uint32_t(_zbin_lights.size());
+
+	std::ranges::sort(_zbin_sort, {}, &std::pair<float, LightIndex>::first);
+
+	// the same depth -> slice mapping as computeClusterCoord() in pbr_clustered.frag
+	auto depth_slice = [this, near_z, num_slices](float depth) {
+		const auto slice = std::log(std::max(depth, near_z) / near_z) * m_log_cluster_res_y;
+		return uint32_t(std::clamp(slice, 0.f, float(num_slices - 1)));
+	};
+
+	_zbin_ranges.resize(2 + 2*num_slices);
+	for(auto slice = 0u; slice < num_slices; ++slice)
+	{
+		_zbin_ranges[2 + slice*2]     = ~0u;  // first > last: empty
+		_zbin_ranges[2 + slice*2 + 1] = 0;
+	}
+
+	for(const auto &[depth, light_index]: _zbin_sort)
+	{
+		const auto index = uint32_t(_zbin_lights.size());
+		_zbin_lights.push_back(light_index);
+
+		const auto radius = _light_mgr.cull_record(light_index).radius;
+		if(depth + radius < near_z or depth - radius > far_z)
+			continue;  // not in any bin
+
+		const auto last_slice = depth_slice(depth + radius);
+		for(auto slice = depth_slice(depth - radius); slice <= last_slice; ++slice)
+		{
+			auto &first = _zbin_ranges[2 + slice*2];
+			auto &last  = _zbin_ranges[2 + slice*2 + 1];
+			first = std::min(first, index);
+			last  = std::max(last, index);
+		}
+	}
+	assert(_zbin_lights.size() <= ZBIN_MAX_LIGHTS);
+
+	const auto num_words = uint32_t((_zbin_lights.size() + 31) / 32);
+	_zbin_ranges[0] = num_words;
+	_zbin_ranges[1] = num_directional;
+
+	_zbin_ranges_ssbo.set(_zbin_ranges);
+	_zbin_lights_index_ssbo.set(_zbin_lights);
+
+	const auto bits_size = std::max(1u, m_cluster_resolution.x * m_cluster_resolution.y * num_words);
+	if(_zbin_tile_bits_ssbo.size() < bits_size)
+		_zbin_tile_bits_ssbo.resize(bits_size);
+}
+
 void ZigApp::renderScene(const glm::mat4 &view_projection, Shader &shader, RGL::MaterialCtrl materialCtrl)
 {
 	// TODO: in c++26: std::views::concat(_cameraPvs.static_ids, _cameraPvs.dynamic_ids)
@@ -1904,35 +2388,42 @@ void ZigApp::renderDepth(const glm::mat4 &view_projection, RenderTarget::Texture
 	renderScene(view_projection, *m_depth_prepass_shader, NoMaterials);
 }
 
-void ZigApp::renderSceneShadow(const QueryResult &objects, uint16_t shadow_idx, uint_fast8_t slot_idx, bool dynamic_only)
+void ZigApp::renderSceneShadow(const QueryResult &objects, uint16_t shadow_idx, uint_fast8_t slot_idx, const ShadowAtlas::SlotTexelScale &texel_scale, bool dynamic_only, const glm::mat4 &page_crop)
 {
 	m_shadow_depth_shader->bind();
 
 	// TODO: probably, it would be better (for perf) to pass the 'light_vp' as a uniform...
 	m_shadow_depth_shader->setUniform("u_light_shadow_index"sv, uint32_t(shadow_idx)); // for 'mvp'
 	m_shadow_depth_shader->setUniform("u_shadow_slot_index"sv, uint32_t(slot_idx));
+	m_shadow_depth_shader->setUniform("u_page_crop"sv, page_crop);
 
-	if(not dynamic_only)
-	{
-		for(const auto &entity_id: objects.static_entities)
-		{
-			const auto &[transform, model] = _entities.get<component::Transform, component::Model>(entity_id);
-			const auto &tfm = transform.transform();
-
-			m_shadow_depth_shader->setUniform("u_model"sv, tfm);
-			m_shadow_depth_shader->setUniform("u_normal_matrix"sv, transform.normal_matrix());
-			model.Render();
-		}
-	}
-	for(const auto &entity_id: objects.dynamic_entities)
-	{
-		const auto &[transform, model] = _entities.get<component::Transform, component::Model>(entity_id);
+	auto render = [this, &texel_scale](EntityID entity_id) {
+		const auto &[transform, model, bounds] = _entities.get<component::Transform, component::Model, component::SphereBounds>(entity_id);
 		const auto &tfm = transform.transform();
 
 		m_shadow_depth_shader->setUniform("u_model"sv, tfm);
 		m_shadow_depth_shader->setUniform("u_normal_matrix"sv, transform.normal_matrix());
-		model.Render();
+
+		// the full detail would be wasted; e.g. a small slot or far from the light
+		if(model.has_shadow_proxy() and texel_scale.texels(bounds) < _shadow_proxy_texels)
+		{
+			model.RenderShadowProxy();
+			++_shadow_proxy_draws;
+		}
+		else
+		{
+			model.Render();
+			++_shadow_full_draws;
+		}
+	};
+
+	if(not dynamic_only)
+	{
+		for(const auto &entity_id: objects.static_entities)
+			render(entity_id);
 	}
+	for(const auto &entity_id: objects.dynamic_entities)
+		render(entity_id);
 
 }
 
@@ -1950,6 +2441,7 @@ void ZigApp::renderShading(const Camera &camera)
 	shader.setUniform("u_cluster_resolution"sv,         m_cluster_resolution);
 	shader.setUniform("u_cluster_size_ss"sv,            glm::uvec2(m_cluster_block_size));
 	shader.setUniform("u_log_cluster_res_y"sv,          m_log_cluster_res_y);
+	shader.setUniform("u_zbin_lights"sv,                _zbin_light_assignment);
 	shader.setUniform("u_light_max_distance"sv,         m_camera.farPlane() * s_light_affect_fraction);
 	shader.setUniform("u_shadow_max_distance"sv,        m_camera.farPlane() * s_light_shadow_affect_fraction);
 	shader.setUniform("u_shadow_contact_max_distance"sv, 10.f);
@@ -2000,6 +2492,9 @@ void ZigApp::renderShading(const Camera &camera)
 	_shadow_atlas.bindTextureSampler(21);   // encoded normals
 	_shadow_atlas.bindDepthTextureSampler(22);
 	m_depth_pass_rt.bindDepthTextureSampler(23); // for screen-space/contact shadows
+	_virtual_shadow_maps.bindShadowSampler(24);
+	shader.setUniform("u_vsm_pages_per_dim"sv, VirtualShadowMaps::PAGES_PER_DIM);
+	shader.setUniform("u_vsm_page_size"sv,     _virtual_shadow_maps.page_size());
 
 
 	// we need updated textures (shadow maps) and SSBO data
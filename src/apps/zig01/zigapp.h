@@ -4,6 +4,7 @@
 
 #include "common.h"
 #include "camera.h"
+#include "cluster_grid.h"
 #include "sample_window.h"
 #include "scene.h"
 #include "ssbo.h"
@@ -14,12 +15,17 @@
 #include "rendertarget_2d.h"
 #include "rendertarget_cube.h"
 #include "gl_timer.h"
+#include "frame_graph.h"
+#include "rendertarget_pool.h"
 #include "pp_bloom.h"
 #include "pp_gaussian_blur_fixed.h"
+#include "pp_gaussian_blur_tiled.h"
 #include "pp_volumetrics.h"
 #include "pp_tonemapping.h"
 #include "shadow_atlas.h"
+#include "virtual_shadow_maps.h"
 #include "light_manager.h"
+#include "light_packing.h"
 
 #include <memory>
 #include <vector>
@@ -90,7 +96,9 @@ public:
 	void debug_message(GLenum type, std::string_view severity, std::string_view message) const;
 
 private:
+	RGL::ClusterGrid clusterGridFor(const RGL::ClusterGridConfig &config) const;
 	void calculateShadingClusterGrid();
+	void adaptClusterGrid();
 	void prepareClusterBuffers();
 	void createLights();
 	void updateLightsSSBOs();
@@ -104,14 +112,19 @@ private:
     void GenSkyboxGeometry();
 
 	void collectRelevantLights(const RGL::Camera &view);
+	void binLightsByDepth(const RGL::Camera &view);
 	void cullScene(const RGL::Camera &camera, RGL::QueryResult &pvs);
 	void renderScene(const glm::mat4 &view_projection, RGL::Shader &shader, RGL::MaterialCtrl matCtrl=RGL::UseMaterials);
 	void renderDepth(const glm::mat4 &view_projection, RGL::RenderTarget::Texture2d &target, const glm::ivec4 &rect={0,0,0,0});
 	void renderShadowMaps();
-	void renderSceneShadow(const RGL::QueryResult &objects, uint16_t shadow_idx, uint_fast8_t slot_idx, bool dynamic_only=false);
+	void renderShadowPages();
+	void reduceShadowDepth();
+	void markShadowPages();
+	void renderSceneShadow(const RGL::QueryResult &objects, uint16_t shadow_idx, uint_fast8_t slot_idx, const RGL::ShadowAtlas::SlotTexelScale &texel_scale, bool dynamic_only=false, const glm::mat4 &page_crop=glm::mat4(1));
 	void renderShading(const RGL::Camera &camera);
 	void renderSkybox();
 	void renderLightGeometry();
+	void benchmarkBlur();
 	void downloadAffectingLightSet();
 	void draw2d(const RGL::Texture &texture, BlendMode mode=BlendMode::Replace); // TODO: move to CoreApp
 	void draw2d(const RGL::Texture &source, RGL::RenderTarget::Texture2d &target, BlendMode blend=BlendMode::Replace); // TODO: move to CoreApp
@@ -138,9 +151,17 @@ private:
 
 	RGL::LightManager _light_mgr;
 	RGL::ShadowAtlas _shadow_atlas;
+	RGL::VirtualShadowMaps _virtual_shadow_maps;
+	bool _shadow_paged { false };  // point & spot lights use the virtual shadow maps (the sun stays in the atlas)
+	float _shadow_band_tetrahedral { 0.25f };  // point lights beyond these fractions of the shadow distance use fewer slots
+	float _shadow_band_paraboloid { 0.5f };
+	float _shadow_proxy_texels { 48.f };  // casters smaller than this, in a slot, use their shadow proxy (if any)
+	RGL::QueryResult _shadow_page_pvs;
 	RGL::Texture2D _contact_shadow_buffer;
 
 	std::vector<LightIndex>   _lightsPvs;  // basically all lights within theoretical range
+	std::vector<LightIndex>   _lightsPvsGpu;  // '_lightsPvs' + relevant aggregate lights (light LOD)
+	std::vector<LightIndex>   _atlasLights;   // the lights of '_lightsPvs' allocated in the shadow atlas (paged shadows)
 	std::vector<StaticObject> _lightModels;
 
 	RGL::Camera m_camera;
@@ -164,8 +185,13 @@ private:
 	std::shared_ptr<RGL::Shader> m_find_nonempty_clusters_shader;
 	std::shared_ptr<RGL::Shader> m_collect_nonempty_clusters_shader;
     std::shared_ptr<RGL::Shader> m_cull_lights_shader;
+    std::shared_ptr<RGL::Shader> m_cull_tiles_shader;         // two-level culling: lights vs. tiles ...
+    std::shared_ptr<RGL::Shader> m_cull_lights_tiled_shader;  // ... then clusters vs. their tile's lights
+    std::shared_ptr<RGL::Shader> m_zbin_tiles_shader;         // z-binned light assignment (instead of the cluster cull)
     std::shared_ptr<RGL::Shader> m_clustered_pbr_shader;
 	std::shared_ptr<RGL::Shader> m_shadow_depth_shader;
+	std::shared_ptr<RGL::Shader> m_sdsm_reduce_shader;
+	std::shared_ptr<RGL::Shader> m_vsm_mark_shader;
 
 	std::shared_ptr<RGL::Shader> m_light_geometry_shader;
 	std::shared_ptr<RGL::Shader> m_line_draw_shader;
@@ -188,6 +214,9 @@ private:
 	float      m_near_k;                       // ( 1 + ( 2 * tan( fov * 0.5 ) / ClusterGridDim.y ) ) // Used to compute the near plane for clusters at depth k.
 	float      m_log_cluster_res_y;               // 1.0f / log( NearK )  // Used to compute the k index of the cluster from the view depth of a pixel sample.
 	uint32_t   m_cluster_count { 0 };
+	RGL::ClusterGridConfig _cluster_grid_config;
+	bool                   _adaptive_cluster_grid { false };  // re-pick the grid resolution from the light density & timings
+	RGL::ClusterGridTuner  _cluster_grid_tuner;
 
 
 	LightID _pov_light_id { NO_LIGHT_ID };
@@ -228,10 +257,32 @@ private:
 	RGL::buffer::Storage<AABB>       m_cluster_aabb_ssbo;
 	RGL::buffer::Storage<uint>       m_cluster_discovery_ssbo;
 	RGL::buffer::Storage<glm::uvec3> m_cull_lights_args_ssbo;
-	RGL::buffer::Storage<IndexRange> m_cluster_light_ranges_ssbo;
+	RGL::buffer::Storage<RGL::lights::ClusterLightRange> m_cluster_light_ranges_ssbo;
 	RGL::buffer::Storage<uint>       m_cluster_all_lights_index_ssbo;
-	RGL::buffer::ReadBack<uint, 32>  m_affecting_lights_bitfield_ssbo;
+	RGL::buffer::Storage<IndexRange> _cluster_tile_light_ranges_ssbo;
+	RGL::buffer::Storage<uint>       _cluster_tile_lights_index_ssbo;
+	bool                             _tiled_light_culling { true };
+	// z-binned light assignment: per-tile bitmasks + per z-slice light index ranges, instead of the per-cluster lists
+	bool                             _zbin_light_assignment { false };
+	std::vector<std::pair<float, LightIndex>> _zbin_sort;  // view depth, light index
+	std::vector<uint>                _zbin_lights;          // directional lights first, then sorted by view depth
+	std::vector<uint>                _zbin_ranges;          // num_words, num_directional, [first, last] per z-slice
+	RGL::buffer::Storage<uint>       _zbin_ranges_ssbo;
+	RGL::buffer::Storage<uint>       _zbin_lights_index_ssbo;
+	RGL::buffer::Storage<uint>       _zbin_tile_bits_ssbo;
+	uint64_t                         _frame_number { 0 };
+	RGL::buffer::AsyncReadBack<uint, 32> m_affecting_lights_bitfield_ssbo;
 	dense_set<uint>                  _affecting_lights;
+	uint64_t                         _affecting_lights_frame { 0 };  // the frame '_affecting_lights' was captured in
+	RGL::buffer::AsyncReadBack<uint, 5> _cluster_cull_stats_ssbo;  // num clusters, lights passing the sphere test, lights passing all tests, max lights, overflowed clusters
+	RGL::buffer::AsyncReadBack<uint, RGL::ShadowAtlas::SDSM_REDUCTION_SIZE> _sdsm_reduction_ssbo;  // see ShadowAtlas::set_sdsm_reduction()
+	RGL::buffer::AsyncReadBack<uint, RGL::VirtualShadowMaps::REQUEST_WORDS> _vsm_requests_ssbo;  // see VirtualShadowMaps::process_requests()
+	bool  _light_shape_culling { true };
+	float _cluster_avg_sphere_lights { 0 };
+	float _cluster_avg_lights { 0 };
+	uint32_t _cluster_active_count { 0 };
+	uint32_t _cluster_max_lights { 0 };
+	uint32_t _cluster_overflowed { 0 };
 	RGL::buffer::Storage<uint>       _relevant_lights_index_ssbo;
 	RGL::buffer::Mapped<ShadowSlotInfo, MAX_POINT_LIGHTS + MAX_SPOT_LIGHTS + MAX_RECT_LIGHTS> m_shadow_map_slots_ssbo;
 
@@ -243,12 +294,13 @@ private:
 
 	// Tonemapping variables
 	RGL::RenderTarget::Texture2d _rt;
-	RGL::RenderTarget::Texture2d _pp_low_rt;
-	RGL::RenderTarget::Texture2d _pp_full_rt;
+	// intermediate & temporary render targets, e.g. of the post-processing effects
+	RGL::RenderTargetPool _rt_pool;
+	// post-processing passes; the intermediate render targets are transient (see render())
+	RGL::FrameGraph _frame_graph;
 	RGL::PP::Tonemapping m_tmo_pp;
 	float m_gamma;
 	RGL::PP::Volumetrics m_volumetrics_pp;
-	RGL::RenderTarget::Texture2d _final_rt;
 
 	float _ibl_mip_level;
 	// TODO: need to test with actual HDR jpeg xl image (converting from hdr wasn't successful)
@@ -267,6 +319,12 @@ private:
 	RGL::PP::Bloom m_bloom_pp;
 	RGL::PP::BlurFixed<3.f> m_blur3_pp;
 
+	// compares the tiled blur against the fixed blur (see benchmarkBlur())
+	bool _blur_benchmark { false };
+	RGL::PP::BlurFixed<1.5f> _bench_blur_fixed_15;
+	RGL::PP::BlurTiled<1.5f> _bench_blur_tiled_15;  // fused
+	RGL::PP::BlurTiled<3.f> _bench_blur_tiled_3;    // two passes
+
 	RGL::seconds_f _running_time { 0 };
 
 	float m_bloom_threshold;
@@ -277,6 +335,7 @@ private:
 	float _fog_strength;
 	float _fog_density;
 	float _fog_blend_weight;
+	dense_set<LightID> _fog_uncacheable_lights;  // their shadows have dynamic casters (see Volumetrics::updateCache())
 
 	float _polygon_offset_factor { 0.f };
 	float _polygon_offset_unit { 0.f };
@@ -285,21 +344,29 @@ private:
 	SampleWindow<std::chrono::microseconds, 30> m_depth_time;
 	SampleWindow<std::chrono::microseconds, 30> m_cluster_find_time;
 	SampleWindow<std::chrono::microseconds, 30> m_cluster_index_time;
+	SampleWindow<std::chrono::microseconds, 30> m_light_tile_cull_time;
 	SampleWindow<std::chrono::microseconds, 30> m_light_cull_time;
+	SampleWindow<std::chrono::microseconds, 30> m_light_zbin_time;
 	SampleWindow<std::chrono::microseconds, 30> m_shadow_alloc_time;
 	SampleWindow<std::chrono::microseconds, 30> m_shadow_time;
 	SampleWindow<std::chrono::microseconds, 30> m_shading_time;
 	SampleWindow<std::chrono::microseconds, 30> m_skybox_time;
 	SampleWindow<std::chrono::microseconds, 30> m_volumetrics_cull_time;
+	SampleWindow<std::chrono::microseconds, 30> m_volumetrics_cache_time;
 	SampleWindow<std::chrono::microseconds, 30> m_volumetrics_inject_time;
 	SampleWindow<std::chrono::microseconds, 30> m_volumetrics_accum_time;
 	SampleWindow<std::chrono::microseconds, 30> m_volumetrics_render_time;
 	SampleWindow<std::chrono::microseconds, 30> m_tonemap_time;
 	SampleWindow<std::chrono::microseconds, 30> m_debug_draw_time;
+	// [resolution * 4 + method]; see benchmarkBlur()
+	std::array<SampleWindow<std::chrono::microseconds, 30>, 8> _blur_benchmark_time;
 
 	// SampleWindow<std::chrono::microseconds, 30> m_pp_blur_time;
 	size_t _shadow_atlas_slots_rendered;
 	size_t _light_shadow_maps_rendered;
+	size_t _shadow_pages_rendered { 0 };
+	size_t _shadow_proxy_draws { 0 };
+	size_t _shadow_full_draws { 0 };
 
 	string_map<RGL::GLTimer<4>> _gl_timers;
 
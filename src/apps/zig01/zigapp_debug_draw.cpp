@@ -6,6 +6,7 @@
 #include "component/light_general.h"
 #include "component/transform.h"
 #include "instance_attributes.h"
+#include "light_packing.h"
 #include "light_wrapper.h"
 #include "window.h"
 #define GLM_ENABLE_EXPERIMENTAL
@@ -615,9 +616,9 @@ void ZigApp::debugDrawClusterGrid()
 	{
 		const auto coord = index2coord(index);
 
-			   // first uint is number of lights
-		const auto start_index = (*c_lights_view)[index].start_index;
-		const auto num_lights = (*c_lights_view)[index].count;
+		const auto range = lights::unpack_cluster_range((*c_lights_view)[index]);
+		const auto start_index = range.start_index;
+		const auto num_lights = range.count;
 
 		const auto front_coord = glm::uvec2{ coord.x, m_cluster_resolution.y - 1 - coord.y };
 		if(not visited_front.contains(front_coord))
@@ -644,7 +645,12 @@ void ZigApp::debugDrawClusterGrid()
 			light_indices.clear();
 			for(auto idx = start_index; idx < start_index + num_lights; ++idx)
 			{
+#if CLUSTER_COMPACT_LIGHTS
+				const auto pair = all_light_index[index_offset + idx/2];
+				const auto light_index = (idx & 1)? pair >> 16: pair & 0xffffu;
+#else
 				const auto light_index = all_light_index[index_offset + idx];
+#endif
 				light_indices.push_back(light_index);
 				assert(light_index < _light_mgr.num_lights(LIGHT_TYPE_POINT));
 			}
@@ -673,6 +679,9 @@ void ZigApp::debugDrawClusterGrid()
 		else if(range.start_index < current)
 			std::print("\x1b[31;1mOVERLAP\x1b[m {} < {}\n", range.start_index, current);
 		current = range.start_index + range.count;
+#if CLUSTER_COMPACT_LIGHTS
+		current += range.count & 1;  // allocated in pairs
+#endif
 	}
 
 
@@ -79,18 +79,30 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 		TIMING("  alloc", m_shadow_alloc_time.average());
 		TIMING("  render", m_shadow_time.average());
 
-		TIMING("Clusters", m_cluster_find_time.average() + m_cluster_index_time.average() + m_light_cull_time.average());
+		TIMING("Clusters", m_cluster_find_time.average() + m_cluster_index_time.average() + m_light_tile_cull_time.average() + m_light_cull_time.average() + m_light_zbin_time.average());
 		TIMING("  find", m_cluster_find_time.average());
 		TIMING("  collect", m_cluster_index_time.average());
-		TIMING("  cull", m_light_cull_time.average());
+		if(_zbin_light_assignment)
+		{
+			TIMING("  z-bin", m_light_zbin_time.average());
+		}
+		else
+		{
+			if(_tiled_light_culling)
+			{
+				TIMING("  tiles", m_light_tile_cull_time.average());
+			}
+			TIMING("  cull", m_light_cull_time.average());
+		}
 
 		TIMING("Shading", m_shading_time.average());
 		TIMING("Skybox", m_skybox_time.average());
 
 		if(m_volumetrics_pp.enabled())
 		{
-			TIMING("Volumetrics", m_volumetrics_cull_time.average() + m_volumetrics_inject_time.average() + m_volumetrics_accum_time.average() + m_volumetrics_render_time.average());
+			TIMING("Volumetrics", m_volumetrics_cull_time.average() + m_volumetrics_cache_time.average() + m_volumetrics_inject_time.average() + m_volumetrics_accum_time.average() + m_volumetrics_render_time.average());
 			TIMING("  cull", m_volumetrics_cull_time.average());
+			TIMING("  cache", m_volumetrics_cache_time.average());
 			TIMING("  inject", m_volumetrics_inject_time.average());
 			TIMING("  accum",  m_volumetrics_accum_time.average());
 			TIMING("  render", m_volumetrics_render_time.average());
@@ -100,6 +112,20 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 		TIMING("Debug draw", m_debug_draw_time.average());
 		// TIMING("PP blur", m_pp_blur_time.average());
 
+		if(_blur_benchmark)
+		{
+			ROW(); COL(0); ImGui::Text("Blur 1080p");
+			TIMING("  fixed 1.5", _blur_benchmark_time[0].average());
+			TIMING("  tiled 1.5 (fused)", _blur_benchmark_time[1].average());
+			TIMING("  fixed 3", _blur_benchmark_time[2].average());
+			TIMING("  tiled 3", _blur_benchmark_time[3].average());
+			ROW(); COL(0); ImGui::Text("Blur 4K");
+			TIMING("  fixed 1.5", _blur_benchmark_time[4].average());
+			TIMING("  tiled 1.5 (fused)", _blur_benchmark_time[5].average());
+			TIMING("  fixed 3", _blur_benchmark_time[6].average());
+			TIMING("  tiled 3", _blur_benchmark_time[7].average());
+		}
+
 		ImGui::EndTable();
 	}
 
@@ -129,9 +155,17 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 						cam_right.x, cam_right.y, cam_right.z,
 						cam_up.x, cam_up.y, cam_up.z);
 			ImGui::Text("PVS size : %lu", _cameraPvs.size());
-			ImGui::Text("Lights PVS size : %lu", _lightsPvs.size());
+			ImGui::Text("Lights PVS size : %lu (+%lu aggregates)", _lightsPvs.size(), _lightsPvsGpu.size() - _lightsPvs.size());
+			const auto &graph = _frame_graph.stats();
+			ImGui::Text("Frame graph: %u passes (%u culled), %u barriers", graph.passes, graph.culled_passes, graph.barriers);
+			ImGui::Text("  transient targets: %u -> %u  (%.1f -> %.1f MiB)", graph.transient_textures, graph.physical_textures,
+						float(graph.transient_bytes) / (1024.f*1024.f), float(graph.physical_bytes) / (1024.f*1024.f));
+			const auto pool = _rt_pool.stats();
+			ImGui::Text("RT pool: %u targets (%.1f MiB), %u created, %u evicted", pool.targets,
+						float(pool.bytes) / (1024.f*1024.f), pool.created, pool.evicted);
 
 			ImGui::Checkbox("Draw AABB", &m_debug_draw_aabb);
+			ImGui::Checkbox("Blur benchmark (1080p & 4K)", &_blur_benchmark);
 
 			if(ImGui::SliderFloat("FOV", &m_camera_fov, 25.f, 150.f))
 				calculateShadingClusterGrid();
@@ -202,6 +236,63 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 			ImGui::Checkbox   ("Animate Lights",    &m_animate_lights);
 			ImGui::SliderFloat("Animation Speed",   &m_animation_speed, 0.0f, 15.0f, "%.1f");
 
+			auto upload_policy = _light_mgr.upload_policy();
+			if(ImGui::Checkbox("GPU scatter light uploads", &upload_policy.gpu_scatter))
+				_light_mgr.set_upload_policy(upload_policy);
+			const auto &upload = _light_mgr.upload_stats();
+			ImGui::Text("Light upload: %lu dirty -> %lu lights in %lu calls%s",
+						upload.dirty, upload.lights, upload.calls, upload.scattered? " (scatter)": "");
+
+			auto lod_policy = _light_mgr.lod_policy();
+			bool lod_changed = ImGui::Checkbox("Light LOD", &lod_policy.enabled);
+			if(lod_policy.enabled)
+			{
+				lod_changed |= ImGui::SliderFloat("LOD distance",  &lod_policy.distance,  5.f, 100.f, "%.0f");
+				lod_changed |= ImGui::SliderFloat("LOD cell size", &lod_policy.cell_size, 0.5f, 16.f, "%.1f");
+			}
+			if(lod_changed)
+				_light_mgr.set_lod_policy(lod_policy);
+			const auto &lod = _light_mgr.lod_stats();
+			ImGui::Text("Light LOD: %lu lights in %lu aggregates (%lu rebuilt, %lu starved)",
+						lod.aggregated_lights, lod.aggregates, lod.rebuilt, lod.starved);
+
+			ImGui::Text("Affecting lights: %lu (%lu frames old)", _affecting_lights.size(), _frame_number - _affecting_lights_frame);
+
+			auto stop_adaptive_cluster_grid = [this]() {
+				_adaptive_cluster_grid = false;
+				_cluster_grid_tuner.reset();
+				_cluster_grid_config = {};
+				calculateShadingClusterGrid();
+			};
+
+			// the z-bin assignment doesn't produce the cluster cull stats, i.e. nothing to adapt the grid by
+			if(ImGui::Checkbox("Z-binned light assignment", &_zbin_light_assignment) and _zbin_light_assignment and _adaptive_cluster_grid)
+				stop_adaptive_cluster_grid();
+			if(_zbin_light_assignment)
+			{
+				const auto zbin_bytes = (_zbin_ranges_ssbo.size() + _zbin_lights_index_ssbo.size() + _zbin_tile_bits_ssbo.size()) * sizeof(uint);
+				ImGui::Text("Light assignment memory: %.1f KiB", float(zbin_bytes) / 1024.f);
+			}
+			else
+			{
+				ImGui::Checkbox("Tiled light culling", &_tiled_light_culling);
+				ImGui::Checkbox("Light shape culling", &_light_shape_culling);
+				ImGui::Text("Lights / cluster: %.1f (sphere) -> %.1f  (max %u, %u overflowed)", _cluster_avg_sphere_lights, _cluster_avg_lights, _cluster_max_lights, _cluster_overflowed);
+
+				if(ImGui::Checkbox("Adaptive cluster grid", &_adaptive_cluster_grid))
+				{
+					_cluster_grid_tuner.reset();
+					if(not _adaptive_cluster_grid)
+						stop_adaptive_cluster_grid();
+				}
+				ImGui::Text("Cluster grid: %u x %u x %u = %u  (%u px tiles)", m_cluster_resolution.x, m_cluster_resolution.y, m_cluster_resolution.z, m_cluster_count, m_cluster_block_size);
+
+				auto lists_bytes = m_cluster_light_ranges_ssbo.size() * sizeof(lights::ClusterLightRange) + m_cluster_all_lights_index_ssbo.size() * sizeof(uint);
+				if(_tiled_light_culling)
+					lists_bytes += _cluster_tile_light_ranges_ssbo.size() * sizeof(IndexRange) + _cluster_tile_lights_index_ssbo.size() * sizeof(uint);
+				ImGui::Text("Light assignment memory: %.1f KiB", float(lists_bytes) / 1024.f);
+			}
+
 			ImGui::PopItemWidth();
 		}
 
@@ -241,6 +332,9 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 				ImGui::SliderFloat("Knee",           &m_bloom_knee,           0,  1.f, "%.1f");
 				ImGui::SliderFloat("Intensity",      &m_bloom_intensity,      0,  2.f, "%.1f");
 				ImGui::SliderFloat("Dirt intensity", &m_bloom_dirt_intensity, 0, 10.f, "%.1f");
+				bool single_pass = m_bloom_pp.singlePassDownscale();
+				if(ImGui::Checkbox("Single pass downscale", &single_pass))
+					m_bloom_pp.setSinglePassDownscale(single_pass);
 			}
 		}
 
@@ -296,6 +390,20 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 					m_volumetrics_pp.setTemporalBlending(blend_enabled);
 				if(blend_enabled)
 					ImGui::SliderFloat("Temporal blend", &_fog_blend_weight, 0.f, 0.99f, "%.2f");  // lerp: <current> - <previous>
+				static int interleave { 0 };
+				if(ImGui::Combo("Injected froxels", &interleave, "All\0Half (checkerboard)\0Quarter\0"))
+					m_volumetrics_pp.setInterleave(1u << interleave);
+				auto history_reject = m_volumetrics_pp.historyRejection();
+				if(ImGui::SliderFloat("History rejection", &history_reject, 0.f, 1.f, "%.2f"))
+					m_volumetrics_pp.setHistoryRejection(history_reject);
+				auto cache_enabled = m_volumetrics_pp.cacheEnabled();
+				if(ImGui::Checkbox("Cache static lights", &cache_enabled))
+					m_volumetrics_pp.setCacheEnabled(cache_enabled);
+				if(cache_enabled)
+				{
+					const auto &cache = m_volumetrics_pp.cacheStats();
+					ImGui::Text("  cached: %u  baked: %u  pending: %u", cache.lights, cache.baked, cache.invalid);
+				}
 				float shadow_bias = m_volumetrics_pp.shadowBias();
 				if(ImGui::SliderFloat("Shadow bias", &shadow_bias, -0.01f, 0.05f, "%.4f"))
 					m_volumetrics_pp.setShadowBias(shadow_bias);
@@ -328,6 +436,30 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 			static auto stabilize = _shadow_atlas.csm_stabilization();
 			ImGui::Checkbox("Stabilize light view", &stabilize);
 			_shadow_atlas.set_csm_stabilization(stabilize);
+			auto sdsm = _shadow_atlas.sdsm();
+			if(ImGui::Checkbox("Fit cascades to visible depth (SDSM)", &sdsm))
+				_shadow_atlas.set_sdsm(sdsm);
+			if(const auto range = _shadow_atlas.sdsm_depth_range(); sdsm and range.y > 0)
+				ImGui::Text("  depth range: %.1f - %.1f", double(range.x), double(range.y));
+			if(ImGui::Checkbox("Virtual (paged) point & spot shadows", &_shadow_paged))
+			{
+				if(not _shadow_paged)
+					_virtual_shadow_maps.clear();
+				_shadow_atlas.set_virtual_maps(_shadow_paged? &_virtual_shadow_maps: nullptr);
+			}
+			auto caster_culling = _shadow_atlas.caster_culling();
+			if(ImGui::Checkbox("Cull casters outside the view", &caster_culling))
+				_shadow_atlas.set_caster_culling(caster_culling);
+			if(const auto culled = _shadow_atlas.caster_cull_totals(); caster_culling)
+			{
+				ImGui::Text("  casters: %u  culled: %u", culled.casters, culled.culled);
+				const auto &counters = _shadow_atlas.caster_cull_counters();
+				ImGui::Text("  per frame: %u culls  %u checks (%u skipped)  %u tested", counters.culls, counters.checks, counters.skipped, counters.tested);
+			}
+			ImGui::SliderFloat("Point: tetrahedral from", &_shadow_band_tetrahedral, 0.f, 1.f, "%.2f");
+			ImGui::SliderFloat("Point: paraboloid from",  &_shadow_band_paraboloid,  0.f, 1.f, "%.2f");
+			_shadow_band_paraboloid = std::max(_shadow_band_paraboloid, _shadow_band_tetrahedral);
+			ImGui::SliderFloat("Proxy casters below", &_shadow_proxy_texels, 0.f, 256.f, "%.0f texels");
 			ImGui::Checkbox("Colorize shadow slots", &_debug_colorize_shadows);
 			ImGui::Checkbox("Contact shadows", &_shadow_contacts);
 			if(_shadow_contacts)
@@ -347,6 +479,15 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 				ImGui::Text("  %s", size_line.c_str());
 
 			ImGui::Text("Rendered:  Lights: %3lu  Slots: %lu", _light_shadow_maps_rendered, _shadow_atlas_slots_rendered);
+			ImGui::Text("  casters: full %lu  proxy %lu", _shadow_full_draws, _shadow_proxy_draws);
+			if(_shadow_paged)
+			{
+				const auto &pages = _virtual_shadow_maps.last_counters();
+				ImGui::Text("Pages:  requested %u  cached %u  rendered %lu", pages.requested, pages.cached, _shadow_pages_rendered);
+				ImGui::Text("        deferred %u  evicted %u  exhausted %u", pages.deferred, pages.evicted, pages.exhausted);
+			}
+			const auto &defrag = _shadow_atlas.defrag_stats();
+			ImGui::Text("Defrag:  moved %u (%lu kB)  pending %lu", defrag.moves, defrag.bytes >> 10, defrag.pending);
 		}
 
 		if(ImGui::CollapsingHeader("Textures", ImGuiTreeNodeFlags_DefaultOpen))
@@ -374,7 +515,7 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 			static int current_image = 9;
 			ImGui::Combo("Render target", &current_image, rt_names, std::size(rt_names));
 
-			RenderTarget::Texture2d *rt = nullptr;
+			const RenderTarget::Texture2d *rt = nullptr;
 			RenderTarget::Cube *rtc = nullptr;
 			const Texture3D *t3 = nullptr;
 			switch(current_image)
@@ -384,9 +525,9 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 			case  3: rtc = m_prefiltered_env_map_rt.get(); break;
 			case  4: rt = &m_depth_pass_rt; break;
 			case  5: rt = &_rt; break;
-			case  6: rt = &_pp_low_rt; break;
-			case  7: rt = &_pp_full_rt; break;
-			case  8: rt = &_final_rt; break;
+			case  6: rt = _frame_graph.find_texture("pp_low_rt"); break;
+			case  7: rt = _frame_graph.find_texture("pp_full_rt"); break;
+			case  8: rt = _frame_graph.find_texture("final_rt"); break;
 			case  9: rt = &_shadow_atlas; break;
 			case 10: t3 = &m_volumetrics_pp.froxel_texture(0); break;
 			case 11: t3 = &m_volumetrics_pp.froxel_texture(1); break;
@@ -609,6 +750,23 @@ COL(1); ImGui::Text("%4ld µs", (time).count())
 				.inner_angle = glm::radians(m_camera.verticalFov() - 10) / 3,
 			});
 		}
+		ImGui::SameLine();
+		// a grid of static fog lights around the camera; e.g. to compare the volumetrics timings with and without the cache
+		if(ImGui::Button("+ fog lights"))
+		{
+			static constexpr auto grid = 8u;
+			static constexpr auto spacing = 4.f;
+			for(auto idx = 0u; idx < grid*grid; ++idx)
+			{
+				const auto offset = glm::vec3(float(idx % grid), 0, float(idx / grid)) * spacing - glm::vec3(spacing*(grid - 1)/2, 0, spacing*(grid - 1)/2);
+				_light_mgr.add(PointLightParams{
+					.color = hsv2rgb(float(idx) * 360.f / float(grid*grid), 0.6f, 1.f),
+					.intensity = 10.f,
+					.fog = 1.f,
+					.position = m_camera.position() + offset,
+				});
+			}
+		}
 
 		static std::string selected_light_label = "< select light >";
 		static auto selected_light_id { NO_LIGHT_ID };
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace RGL::blur_kernel
+{
+
+/*
+ Gaussian blur kernels, generated at compile time.
+
+   The weights are one-sided ([0] is the center) and normalized over [-radius, radius].
+   The taps (1, 2), (3, 4), ... are also folded into single bilinear fetches, i.e. a fetch between the two
+   texels, at the offset where the hardware's linear interpolation yields their weighted sum
+   (an odd last tap is kept as is).
+*/
+
+namespace detail
+{
+
+// exp(x) for x <= 0; exp(x/2^n)^(2^n), with a Taylor series for the small argument
+constexpr double exp_negative(double x)
+{
+	uint32_t squarings = 0;
+	while(x < -0.5)
+	{
+		x *= 0.5;
+		++squarings;
+	}
+
+	double term = 1;
+	double sum = 1;
+	for(auto k = 1u; k < 16; ++k)
+	{
+		term *= x / double(k);
+		sum += term;
+	}
+
+	while(squarings-- > 0)
+		sum *= sum;
+
+	return sum;
+}
+
+constexpr uint32_t ceil(float value)
+{
+	const auto whole = uint32_t(value);
+	return float(whole) < value? whole + 1: whole;
+}
+
+} // detail
+
+// covers > 99.7% of the gaussian
+constexpr uint32_t radius(float sigma)
+{
+	return detail::ceil(3.f * sigma);
+}
+
+constexpr uint32_t num_folded(uint32_t radius)
+{
+	return (radius + 1) / 2;
+}
+
+template<uint32_t Radius>
+struct Kernel
+{
+	std::array<float, Radius + 1> weights;
+	std::array<float, num_folded(Radius)> folded_offsets;  // in texels
+	std::array<float, num_folded(Radius)> folded_weights;
+};
+
+template<float Sigma>
+constexpr auto make()
+{
+	static_assert(Sigma > 0);
+	constexpr auto R = radius(Sigma);
+
+	std::array<double, R + 1> weights {};
+	double sum = 0;
+	for(auto idx = 0u; idx <= R; ++idx)
+	{
+		weights[idx] = detail::exp_negative(-0.5 * double(idx*idx) / double(Sigma*Sigma));
+		sum += idx == 0? weights[idx]: 2*weights[idx];
+	}
+	for(auto &weight: weights)
+		weight /= sum;
+
+	Kernel<R> kernel {};
+	for(auto idx = 0u; idx <= R; ++idx)
+		kernel.weights[idx] = float(weights[idx]);
+
+	for(auto idx = 0u; idx < num_folded(R); ++idx)
+	{
+		const auto first = 1 + 2*idx;
+		const auto second = first + 1;
+		const auto first_weight = weights[first];
+		const auto second_weight = second <= R? weights[second]: 0.0;
+		const auto weight = first_weight + second_weight;
+
+		kernel.folded_weights[idx] = float(weight);
+		kernel.folded_offsets[idx] = float((double(first)*first_weight + double(second)*second_weight) / weight);
+	}
+
+	return kernel;
+}
+
+} // RGL::blur_kernel
@@ -1,7 +1,9 @@
 #include "bounds.h"
+#include <glm/common.hpp>
 #include <glm/geometric.hpp>
 #include <glm/gtc/constants.hpp>
 #include <glm/mat4x4.hpp>
+#include <cmath>
 #include <numbers>
 
 namespace bounds
@@ -201,6 +203,33 @@ void bounds::Sphere::clear()
 	_squaredRadius = -1.f;
 }
 
+Cone::Cone(const glm::vec3 &apex, const glm::vec3 &axis, float range, float angle) :
+	_apex(apex),
+	_axis(glm::normalize(axis)),
+	_range(range),
+	_cos_angle(std::cos(angle)),
+	_sin_angle(std::sin(angle))
+{
+}
+
+OBB::OBB(const glm::vec3 &center, const glm::mat3 &axes, const glm::vec3 &half_extents) :
+	_center(center),
+	_axes(axes),
+	_half_extents(half_extents)
+{
+}
+
+OBB OBB::areaLight(const glm::vec3 &center, const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec2 &half_size, float range, bool double_sided)
+{
+	// GLSL counterpart: shapeIntersectsAABB() in clustered_cull.comp
+	const glm::mat3 axes(tangent, glm::cross(normal, tangent), normal);
+
+	if(double_sided)
+		return OBB(center, axes, glm::vec3(half_size + range, range));
+
+	return OBB(center + normal * range * 0.5f, axes, glm::vec3(half_size + range, range * 0.5f));
+}
+
 }
 
 
@@ -260,6 +289,54 @@ bool check(const bounds::Sphere &sphere, const glm::vec3 &point)
 	return sqDistance < sphere.squaredRadius();
 }
 
+bool check(const bounds::AABB &box, const bounds::Cone &cone)
+{
+	// the box is approximated by its bounding sphere
+	//   https://bartwronski.com/2017/04/13/cull-that-cone/
+	const auto center = box.center();
+	const auto radius = glm::length(box.max() - box.min()) * 0.5f;
+
+	const auto V = center - cone.apex();
+	const auto V_sq_length = glm::dot(V, V);
+	const auto V1_length = glm::dot(V, cone.axis());
+	const auto distance_closest = cone.cosAngle() * std::sqrt(std::max(V_sq_length - V1_length*V1_length, 0.f)) - V1_length * cone.sinAngle();
+
+	const auto angle_cull = distance_closest > radius;
+	const auto front_cull = V1_length > radius + cone.range();
+	const auto back_cull  = V1_length < -radius;
+
+	return not (angle_cull or front_cull or back_cull);
+}
+
+bool check(const bounds::AABB &box, const bounds::OBB &obb)
+{
+	const auto box_center = box.center();
+	const auto box_half = (box.max() - box.min()) * 0.5f;
+	const auto offset = obb.center() - box_center;
+	const auto &axes = obb.axes();
+	const auto &half = obb.halfExtents();
+
+	// the box's axes
+	for(auto axis = 0; axis < 3; ++axis)
+	{
+		const auto obb_radius = std::abs(axes[0][axis]) * half[0] \
+			+ std::abs(axes[1][axis]) * half[1] \
+			+ std::abs(axes[2][axis]) * half[2];
+		if(std::abs(offset[axis]) > box_half[axis] + obb_radius)
+			return false;
+	}
+
+	// the OBB's axes
+	for(auto axis = 0; axis < 3; ++axis)
+	{
+		const auto box_radius = glm::dot(box_half, glm::abs(axes[axis]));
+		if(std::abs(glm::dot(offset, axes[axis])) > half[axis] + box_radius)
+			return false;
+	}
+
+	return true;
+}
+
 } // intersect
 
 } // RGL
@@ -2,7 +2,9 @@
 
 #include <array>
 #include <glm/fwd.hpp>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/mat3x3.hpp>
 
 namespace bounds
 {
@@ -86,6 +88,50 @@ protected:
 	float _squaredRadius;
 };
 
+// =======================================================================
+
+// a (spot light) cone, capped at 'range' along the axis
+class Cone
+{
+public:
+	Cone(const glm::vec3 &apex, const glm::vec3 &axis, float range, float angle);
+
+	[[nodiscard]] inline const glm::vec3 &apex() const { return _apex; }
+	[[nodiscard]] inline const glm::vec3 &axis() const { return _axis; }
+	[[nodiscard]] inline float range() const { return _range; }
+	[[nodiscard]] inline float cosAngle() const { return _cos_angle; }
+	[[nodiscard]] inline float sinAngle() const { return _sin_angle; }
+
+protected:
+	glm::vec3 _apex;
+	glm::vec3 _axis;   // normalized
+	float _range;
+	float _cos_angle;
+	float _sin_angle;
+};
+
+// =======================================================================
+
+// oriented bounding box
+class OBB
+{
+public:
+	OBB(const glm::vec3 &center, const glm::mat3 &axes, const glm::vec3 &half_extents);
+
+	// the space affected by a rect or disc light: its surface, expanded by 'range'
+	//   a one-sided light only affects the half-space its 'normal' points to
+	static OBB areaLight(const glm::vec3 &center, const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec2 &half_size, float range, bool double_sided);
+
+	[[nodiscard]] inline const glm::vec3 &center() const { return _center; }
+	[[nodiscard]] inline const glm::mat3 &axes() const { return _axes; }  // orthonormal columns
+	[[nodiscard]] inline const glm::vec3 &halfExtents() const { return _half_extents; }
+
+protected:
+	glm::vec3 _center;
+	glm::mat3 _axes;
+	glm::vec3 _half_extents;
+};
+
 } // bounds
 
 namespace RGL
@@ -99,6 +145,10 @@ bool check(const bounds::AABB   &box,     const bounds::Sphere &sphere);
 bool check(const bounds::AABB   &box,     const    glm::vec3   &point);
 bool check(const bounds::Sphere &sphereA, const bounds::Sphere &sphereB);
 bool check(const bounds::Sphere &sphere,  const    glm::vec3   &point);
+// conservative; may report an intersection for boxes just outside the cone's sides
+bool check(const bounds::AABB   &box,     const bounds::Cone   &cone);
+// separating axis test using the face axes only; conservative (no edge-edge axes)
+bool check(const bounds::AABB   &box,     const bounds::OBB    &obb);
 
 } // intersect
 
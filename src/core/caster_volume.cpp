@@ -0,0 +1,131 @@
+#include "caster_volume.h"
+
+#include <glm/geometric.hpp>
+
+#include <cassert>
+
+namespace RGL
+{
+
+// corner index bit of each axis (see CasterVolume)
+static constexpr uint32_t s_axis_bit[3] = { 4, 2, 1 };
+
+void CasterVolume::set_point(const Corners &receiver, const glm::vec3 &light_pos)
+{
+	build(receiver, light_pos, false);
+}
+
+void CasterVolume::set_directional(const Corners &receiver, const glm::vec3 &light_direction)
+{
+	// towards the light
+	build(receiver, -glm::normalize(light_direction), true);
+}
+
+void CasterVolume::build(const Corners &receiver, const glm::vec3 &light, bool is_directional)
+{
+	_num_planes = 0;
+
+	glm::vec3 center { 0 };
+	for(const auto &corner: receiver)
+		center += corner;
+	center /= 8.f;
+
+	// faces; index = axis*2 + side
+	std::array<Plane, 6> faces;
+	std::array<bool, 6> kept;
+
+	for(auto axis = 0u; axis < 3; ++axis)
+	{
+		const auto bit_u = s_axis_bit[(axis + 1) % 3];
+		const auto bit_v = s_axis_bit[(axis + 2) % 3];
+
+		for(auto side = 0u; side < 2; ++side)
+		{
+			const auto base = side? s_axis_bit[axis]: 0u;
+			const auto &c0 = receiver[base];
+			const auto normal = glm::cross(receiver[base | bit_u] - c0, receiver[base | bit_v] - c0);
+
+			const auto face = axis*2 + side;
+			auto n = glm::normalize(normal);
+			auto offset = -glm::dot(n, c0);
+			if(glm::dot(n, center) + offset < 0)
+			{
+				n = -n;
+				offset = -offset;
+			}
+			faces[face] = Plane(n, offset);
+
+			// the light is inside the face's half-space; the hull (or extrusion) is bound by it as well
+			if(is_directional)
+				kept[face] = glm::dot(n, light) >= 0;
+			else
+				kept[face] = math::facing(faces[face], light);
+
+			if(kept[face])
+				_planes[_num_planes++] = faces[face];
+		}
+	}
+
+	// silhouette edges; an edge along 'axis' is shared by a face of each of the other two axes
+	for(auto axis = 0u; axis < 3; ++axis)
+	{
+		const auto axis_u = (axis + 1) % 3;
+		const auto axis_v = (axis + 2) % 3;
+
+		for(auto side_u = 0u; side_u < 2; ++side_u)
+		{
+			for(auto side_v = 0u; side_v < 2; ++side_v)
+			{
+				if(kept[axis_u*2 + side_u] == kept[axis_v*2 + side_v])
+					continue;
+
+				const auto a = (side_u? s_axis_bit[axis_u]: 0u) | (side_v? s_axis_bit[axis_v]: 0u);
+				const auto &edge_start = receiver[a];
+				const auto edge = receiver[a | s_axis_bit[axis]] - edge_start;
+
+				const auto to_light = is_directional? light: light - edge_start;
+				add_plane(edge_start, glm::cross(edge, to_light), center);
+			}
+		}
+	}
+}
+
+void CasterVolume::add_plane(const glm::vec3 &point, const glm::vec3 &normal, const glm::vec3 &inside)
+{
+	const auto length = glm::length(normal);
+	if(length < 1e-6f)  // e.g. the light is on the edge's line; the adjacent faces bound it anyway
+		return;
+
+	auto n = normal / length;
+	auto offset = -glm::dot(n, point);
+	if(glm::dot(n, inside) + offset < 0)
+	{
+		n = -n;
+		offset = -offset;
+	}
+
+	assert(_num_planes < MAX_PLANES);
+	_planes[_num_planes++] = Plane(n, offset);
+}
+
+bool CasterVolume::contains(const bounds::Sphere &sphere) const
+{
+	for(const auto &plane: planes())
+	{
+		if(math::distance(plane, sphere.center()) < -sphere.radius())
+			return false;
+	}
+	return true;
+}
+
+bool CasterVolume::contains(const glm::vec3 &point) const
+{
+	for(const auto &plane: planes())
+	{
+		if(not math::facing(plane, point))
+			return false;
+	}
+	return true;
+}
+
+} // RGL
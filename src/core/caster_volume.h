@@ -0,0 +1,55 @@
+#pragma once
+
+#include "bounds.h"
+#include "plane.h"
+
+#include <glm/vec3.hpp>
+
+#include <array>
+#include <span>
+
+namespace RGL
+{
+
+/*
+ The volume of the shadow casters that may cast a shadow into a receiver volume (e.g. the camera's view).
+
+   For a point (or spot) light, it's the convex hull of the receiver volume and the light's position.
+   For a directional light, it's the receiver volume extruded (infinitely) towards the light.
+
+   The receiver volume is a convex hexahedron (e.g. a frustum), given by its 8 corners in the order
+   of the NDC cube's corners, i.e. index = (x > 0) << 2 | (y > 0) << 1 | (z > 0)
+
+   The planes are the receiver's faces the light is inside of, and one through each silhouette edge
+   (i.e. between a kept and a dropped face) and the light.
+   A default constructed (or cleared) volume contains everything.
+*/
+class CasterVolume
+{
+public:
+	static constexpr size_t MAX_PLANES = 6 + 12;  // faces + edges
+	using Corners = std::array<glm::vec3, 8>;
+
+public:
+	CasterVolume() = default;
+
+	void set_point(const Corners &receiver, const glm::vec3 &light_pos);
+	// 'light_direction' is the direction the light travels
+	void set_directional(const Corners &receiver, const glm::vec3 &light_direction);
+	inline void clear() { _num_planes = 0; }
+
+	[[nodiscard]] bool contains(const bounds::Sphere &sphere) const;
+	[[nodiscard]] bool contains(const glm::vec3 &point) const;
+
+	[[nodiscard]] inline std::span<const Plane> planes() const { return { _planes.data(), _num_planes }; }
+
+private:
+	void build(const Corners &receiver, const glm::vec3 &light, bool is_directional);
+	void add_plane(const glm::vec3 &point, const glm::vec3 &normal, const glm::vec3 &inside);
+
+private:
+	std::array<Plane, MAX_PLANES> _planes;
+	size_t _num_planes { 0 };
+};
+
+} // RGL
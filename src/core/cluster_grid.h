@@ -0,0 +1,211 @@
+#pragma once
+
+#include "light_constants.h"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+
+namespace RGL
+{
+
+struct ClusterGridConfig
+{
+	uint32_t screen_division { 16 };   // number of tiles across the screen width
+	float    depth_scale     { 1.f };  // scales the depth slices' thickness, i.e. smaller -> more slices
+
+	bool operator == (const ClusterGridConfig &) const = default;
+};
+
+struct ClusterGrid
+{
+	glm::uvec3 resolution;
+	uint32_t   block_size;      // size of a tile, in pixels
+	float      near_k;          // ( 1 + ( 2 * tan( fov * 0.5 ) / resolution.y ) ) * depth_scale
+	float      log_near_k_inv;  // 1 / log( near_k )
+
+	inline uint32_t count() const { return resolution.x * resolution.y * resolution.z; }
+};
+
+// The depth of the cluster grid is dependent on the number of subdivisions in the screen Y direction.
+// Source: Clustered Deferred and Forward Shading (2012) (Ola Olsson, Markus Billeter, Ulf Assarsson).
+inline ClusterGrid cluster_grid(const ClusterGridConfig &config, glm::uvec2 screen_size, float vertical_fov, float z_near, float z_far)
+{
+	ClusterGrid grid;
+
+	grid.resolution.x = config.screen_division;
+	grid.block_size   = uint32_t(std::ceil(float(screen_size.x) / float(grid.resolution.x)));
+	grid.resolution.y = uint32_t(std::ceil(float(screen_size.y) / float(grid.block_size)));
+
+	const float sD      = 2.0f * std::tan(vertical_fov * 0.5f) / float(grid.resolution.y) * config.depth_scale;
+	grid.near_k         = 1.0f + sD;
+	grid.log_near_k_inv = 1.0f / std::log(grid.near_k);
+
+	grid.resolution.z = uint32_t(std::floor(std::log(z_far / z_near) * grid.log_near_k_inv));
+
+	return grid;
+}
+
+/*
+ Adapts the cluster grid resolution to the light density and the GPU timings.
+
+   Dense: clusters overflowing (or getting close to) CLUSTER_MAX_LIGHTS, or an average exceeding what the
+     global light index list is sized for  ->  a finer grid.
+   Sparse: few lights per cluster while the cull dominates the (cull + shading) time  ->  a coarser grid.
+
+ The condition must hold for a number of consecutive updates, and after a change the timings are given
+ time to settle, so the (costly) rebuild of the cluster buffers is only done when it's likely worth it.
+ Of the candidate grids, the one closest to the current cluster count is picked, i.e. small steps.
+*/
+class ClusterGridTuner
+{
+public:
+	struct Policy
+	{
+		uint32_t min_division     { 8 };
+		uint32_t max_division     { 32 };
+		uint32_t division_step    { 4 };
+		float    min_depth_scale  { 0.5f };
+		float    max_depth_scale  { 2.f };
+		float    depth_scale_step { 1.25f };  // factor
+		uint32_t max_clusters     { CLUSTER_MAX_COUNT - 1 };
+
+		uint32_t dense_max_lights  { CLUSTER_MAX_LIGHTS * 3 / 4 };
+		float    dense_avg_lights  { CLUSTER_AVERAGE_LIGHTS * 3 / 4 };
+		float    sparse_avg_lights { 4 };
+		float    sparse_cull_share { 0.35f };  // of (cull + shading) time
+
+		uint32_t settle_updates   { 30 };  // consecutive updates a condition must hold
+		uint32_t cooldown_updates { 60 };  // updates ignored after a change
+	};
+
+	struct Feedback
+	{
+		uint32_t num_clusters;   // non-empty clusters
+		float    avg_lights;     // per non-empty cluster
+		uint32_t max_lights;     // in a single cluster
+		uint32_t overflowed;     // clusters with more than CLUSTER_MAX_LIGHTS lights
+		float    cull_time;      // including tile culling; unit doesn't matter, as long as it's the same for both
+		float    shading_time;
+	};
+
+public:
+	ClusterGridTuner() = default;
+	inline ClusterGridTuner(const Policy &policy) : _policy(policy) {}
+
+	inline const Policy &policy() const { return _policy; }
+	inline void setPolicy(const Policy &policy) { _policy = policy; reset(); }
+
+	inline void reset() { _dense = _sparse = _cooldown = 0; }
+
+	// returns a new configuration, if the grid should change
+	//   'grid_count' returns the cluster count of a configuration (i.e. cluster_grid(...).count())
+	template<typename CountFn>
+	std::optional<ClusterGridConfig> update(const ClusterGridConfig &current, const Feedback &feedback, CountFn &&grid_count);
+
+private:
+	template<typename CountFn>
+	std::optional<ClusterGridConfig> closest(const ClusterGridConfig &a, const ClusterGridConfig &b, uint32_t current_count, CountFn &grid_count) const;
+
+private:
+	Policy _policy;
+	uint32_t _dense { 0 };
+	uint32_t _sparse { 0 };
+	uint32_t _cooldown { 0 };
+};
+
+template<typename CountFn>
+std::optional<ClusterGridConfig> ClusterGridTuner::update(const ClusterGridConfig &current, const Feedback &feedback, CountFn &&grid_count)
+{
+	if(_cooldown > 0)
+	{
+		--_cooldown;
+		return std::nullopt;
+	}
+	if(feedback.num_clusters == 0)
+	{
+		_dense = _sparse = 0;
+		return std::nullopt;
+	}
+
+	const auto overflow = feedback.overflowed > 0;
+	const auto dense = overflow
+		or feedback.max_lights > _policy.dense_max_lights
+		or feedback.avg_lights > _policy.dense_avg_lights;
+
+	const auto total_time = feedback.cull_time + feedback.shading_time;
+	const auto sparse = not dense
+		and feedback.avg_lights < _policy.sparse_avg_lights
+		and total_time > 0
+		and feedback.cull_time > _policy.sparse_cull_share * total_time;
+
+	_dense  = dense?  _dense + 1:  0;
+	_sparse = sparse? _sparse + 1: 0;
+
+	// overflowing clusters drop lights (visible artifacts), react immediately
+	const auto dense_settle = overflow? 1u: _policy.settle_updates;
+
+	std::optional<ClusterGridConfig> next;
+	const auto current_count = grid_count(current);
+
+	if(_dense >= dense_settle)
+	{
+		auto finer_xy = current;
+		finer_xy.screen_division = std::min(current.screen_division + _policy.division_step, _policy.max_division);
+		auto finer_z = current;
+		finer_z.depth_scale = std::max(current.depth_scale / _policy.depth_scale_step, _policy.min_depth_scale);
+
+		next = closest(finer_xy, finer_z, current_count, grid_count);
+		if(next and grid_count(*next) <= current_count)
+			next.reset();
+		_dense = 0;
+	}
+	else if(_sparse >= _policy.settle_updates)
+	{
+		auto coarser_xy = current;
+		coarser_xy.screen_division = std::max(current.screen_division, _policy.min_division + _policy.division_step) - _policy.division_step;
+		auto coarser_z = current;
+		coarser_z.depth_scale = std::min(current.depth_scale * _policy.depth_scale_step, _policy.max_depth_scale);
+
+		next = closest(coarser_xy, coarser_z, current_count, grid_count);
+		if(next and grid_count(*next) >= current_count)
+			next.reset();
+		_sparse = 0;
+	}
+
+	if(next)
+		_cooldown = _policy.cooldown_updates;
+
+	return next;
+}
+
+template<typename CountFn>
+std::optional<ClusterGridConfig> ClusterGridTuner::closest(const ClusterGridConfig &a, const ClusterGridConfig &b, uint32_t current_count, CountFn &grid_count) const
+{
+	auto distance = [current_count](uint32_t count) {
+		return count > current_count? count - current_count: current_count - count;
+	};
+
+	std::optional<ClusterGridConfig> best;
+	uint32_t best_distance { 0 };
+
+	for(const auto &candidate: { a, b })
+	{
+		const auto count = grid_count(candidate);
+		if(count == current_count or count > _policy.max_clusters)
+			continue;
+		if(not best or distance(count) < best_distance)
+		{
+			best = candidate;
+			best_distance = distance(count);
+		}
+	}
+
+	return best;
+}
+
+} // RGL
@@ -0,0 +1,352 @@
+#include "frame_graph.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <iterator>
+
+namespace RGL
+{
+
+static GLbitfield barrier_bit(FrameGraph::Access access, bool buffer)
+{
+	using A = FrameGraph::Access;
+
+	switch(access)
+	{
+	case A::Sampled:    return GL_TEXTURE_FETCH_BARRIER_BIT;
+	case A::Image:      return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+	case A::Attachment: return GL_FRAMEBUFFER_BARRIER_BIT;
+	case A::Storage:    return GL_SHADER_STORAGE_BARRIER_BIT;
+	case A::Indirect:   return GL_COMMAND_BARRIER_BIT;
+	case A::Transfer:   return buffer? GL_BUFFER_UPDATE_BARRIER_BIT: GL_TEXTURE_UPDATE_BARRIER_BIT;
+	}
+	return 0;
+}
+
+// writes that need a barrier before they're visible to later accesses
+static inline bool is_incoherent(FrameGraph::Access access)
+{
+	return access == FrameGraph::Access::Image or access == FrameGraph::Access::Storage;
+}
+
+
+FrameGraph::Handle FrameGraph::Builder::create(std::string_view name, const TextureDesc &desc)
+{
+	assert(desc.size.x > 0 and desc.size.y > 0);
+	assert(desc.color != RenderTarget::Color::None or desc.depth != RenderTarget::Depth::None);
+
+	_graph._resources.push_back({
+		.name = std::string(name),
+		.kind = Kind::Transient,
+		.desc = desc,
+	});
+	return Handle(_graph._resources.size() - 1);
+}
+
+void FrameGraph::Builder::read(Handle resource, Access access)
+{
+	assert(resource < _graph._resources.size());
+	_graph._passes[_pass].uses.push_back({ resource, access, false });
+}
+
+void FrameGraph::Builder::write(Handle resource, Access access)
+{
+	assert(resource < _graph._resources.size());
+	_graph._passes[_pass].uses.push_back({ resource, access, true });
+}
+
+void FrameGraph::Builder::side_effect()
+{
+	_graph._passes[_pass].side_effect = true;
+}
+
+RenderTarget::Texture2d &FrameGraph::Resources::texture(Handle resource) const
+{
+	const auto &res = _graph._resources[resource];
+	assert(res.kind != Kind::Buffer);
+
+	if(res.kind == Kind::Texture)
+		return *res.imported;
+
+	assert(res.physical != Invalid and _graph._physical[res.physical].rt);
+	return *_graph._physical[res.physical].rt;
+}
+
+FrameGraph::Handle FrameGraph::import_texture(std::string_view name, RenderTarget::Texture2d &rt)
+{
+	_resources.push_back({
+		.name = std::string(name),
+		.kind = Kind::Texture,
+		.desc = { .size = rt.size() },
+		.imported = &rt,
+	});
+	return Handle(_resources.size() - 1);
+}
+
+FrameGraph::Handle FrameGraph::import_buffer(std::string_view name)
+{
+	_resources.push_back({
+		.name = std::string(name),
+		.kind = Kind::Buffer,
+	});
+	return Handle(_resources.size() - 1);
+}
+
+void FrameGraph::add_pass(std::string_view name, const SetupFunc &setup, ExecuteFunc execute)
+{
+	_passes.push_back({
+		.name = std::string(name),
+		.execute = std::move(execute),
+	});
+	_compiled = false;
+
+	Builder builder(*this, uint32_t(_passes.size() - 1));
+	setup(builder);
+}
+
+void FrameGraph::mark_output(Handle resource)
+{
+	assert(resource < _resources.size());
+	_resources[resource].output = true;
+}
+
+void FrameGraph::compile()
+{
+	_stats = {};
+	_stats.passes = uint32_t(_passes.size());
+
+	cull();
+	compute_lifetimes();
+	alias_transients();
+	compute_barriers();
+
+	_compiled = true;
+}
+
+void FrameGraph::execute()
+{
+	assert(_compiled);
+
+	for(auto &phys: _physical)
+		phys.rt = &_pool.acquire(phys.desc, phys.name);
+
+	const Resources resources(*this);
+
+	for(const auto &pass: _passes)
+	{
+		if(pass.culled)
+			continue;
+
+		if(pass.barrier)
+			glMemoryBarrier(pass.barrier);
+
+		pass.execute(resources);
+	}
+
+	_last_frame_textures.clear();
+	for(const auto &res: _resources)
+	{
+		if(res.kind == Kind::Transient and res.physical != Invalid)
+			_last_frame_textures[res.name] = _physical[res.physical].rt;
+	}
+
+	for(auto &phys: _physical)
+	{
+		_pool.release(*phys.rt);
+		phys.rt = nullptr;
+	}
+	_compiled = false;
+}
+
+void FrameGraph::clear()
+{
+	_passes.clear();
+	_resources.clear();
+	_physical.clear();
+	_compiled = false;
+}
+
+bool FrameGraph::is_culled(uint32_t pass) const
+{
+	return _passes[pass].culled;
+}
+
+GLbitfield FrameGraph::barrier(uint32_t pass) const
+{
+	return _passes[pass].barrier;
+}
+
+uint32_t FrameGraph::physical_index(Handle resource) const
+{
+	return _resources[resource].physical;
+}
+
+std::string_view FrameGraph::pass_name(uint32_t pass) const
+{
+	return _passes[pass].name;
+}
+
+const RenderTarget::Texture2d *FrameGraph::find_texture(std::string_view name) const
+{
+	const auto found = _last_frame_textures.find(std::string(name));
+	return found != _last_frame_textures.end()? found->second: nullptr;
+}
+
+void FrameGraph::cull()
+{
+	// backwards from the outputs; a pass is needed if it writes something that is read later
+	std::vector<bool> needed(_resources.size(), false);
+	for(auto idx = 0u; idx < _resources.size(); ++idx)
+		needed[idx] = _resources[idx].output;
+
+	for(auto pass_idx = _passes.size(); pass_idx-- > 0; )
+	{
+		auto &pass = _passes[pass_idx];
+
+		pass.culled = not pass.side_effect and std::ranges::none_of(pass.uses, [&needed](const Use &use) {
+			return use.write and needed[use.resource];
+		});
+		if(pass.culled)
+		{
+			++_stats.culled_passes;
+			continue;
+		}
+
+		// overwritten; the previous writers aren't needed (by this pass)
+		for(const auto &use: pass.uses)
+		{
+			if(use.write)
+				needed[use.resource] = false;
+		}
+		for(const auto &use: pass.uses)
+		{
+			if(not use.write)
+				needed[use.resource] = true;
+		}
+	}
+}
+
+void FrameGraph::compute_lifetimes()
+{
+	for(auto &res: _resources)
+	{
+		res.first_use = Invalid;
+		res.last_use = Invalid;
+		res.physical = Invalid;
+	}
+
+	for(auto pass_idx = 0u; pass_idx < _passes.size(); ++pass_idx)
+	{
+		if(_passes[pass_idx].culled)
+			continue;
+
+		for(const auto &use: _passes[pass_idx].uses)
+		{
+			auto &res = _resources[use.resource];
+			if(res.first_use == Invalid)
+				res.first_use = pass_idx;
+			res.last_use = pass_idx;
+		}
+	}
+}
+
+void FrameGraph::alias_transients()
+{
+	_physical.clear();
+
+	// in order of first use, each takes the first compatible physical texture that is free by then
+	std::vector<Handle> transients;
+	for(auto idx = 0u; idx < _resources.size(); ++idx)
+	{
+		const auto &res = _resources[idx];
+		if(res.kind == Kind::Transient and res.first_use != Invalid)
+			transients.push_back(idx);
+	}
+	std::ranges::stable_sort(transients, [this](Handle A, Handle B) {
+		return _resources[A].first_use < _resources[B].first_use;
+	});
+
+	for(const auto handle: transients)
+	{
+		auto &res = _resources[handle];
+
+		auto found = std::ranges::find_if(_physical, [&res](const auto &phys) {
+			return phys.desc == res.desc and phys.last_use < res.first_use;
+		});
+		if(found == _physical.end())
+		{
+			_physical.push_back({ .desc = res.desc, .name = res.name, .last_use = res.last_use });
+			found = std::prev(_physical.end());
+			_stats.physical_bytes += RenderTargetPool::estimated_size(res.desc);
+		}
+
+		found->last_use = res.last_use;
+		res.physical = uint32_t(std::distance(_physical.begin(), found));
+
+		++_stats.transient_textures;
+		_stats.transient_bytes += RenderTargetPool::estimated_size(res.desc);
+	}
+
+	_stats.physical_textures = uint32_t(_physical.size());
+}
+
+void FrameGraph::compute_barriers()
+{
+	// hazard key -> the pass that last wrote it incoherently
+	dense_map<uint32_t, uint32_t> incoherent_writes;
+	// bit index -> the pass before which that barrier bit was last issued
+	std::array<uint32_t, 32> issued;
+	issued.fill(Invalid);
+
+	for(auto pass_idx = 0u; pass_idx < _passes.size(); ++pass_idx)
+	{
+		auto &pass = _passes[pass_idx];
+		pass.barrier = 0;
+		if(pass.culled)
+			continue;
+
+		for(const auto &use: pass.uses)
+		{
+			const auto found = incoherent_writes.find(hazard_key(use.resource));
+			if(found == incoherent_writes.end())
+				continue;
+
+			const auto bit = barrier_bit(use.access, _resources[use.resource].kind == Kind::Buffer);
+			const auto bit_idx = std::countr_zero(bit);
+			// not needed if the same barrier was already issued after the write
+			if(issued[size_t(bit_idx)] == Invalid or issued[size_t(bit_idx)] <= found->second)
+				pass.barrier |= bit;
+		}
+
+		if(pass.barrier)
+		{
+			++_stats.barriers;
+			for(auto bits = pass.barrier; bits; bits &= bits - 1)
+				issued[size_t(std::countr_zero(bits))] = pass_idx;
+		}
+
+		for(const auto &use: pass.uses)
+		{
+			if(not use.write)
+				continue;
+
+			const auto key = hazard_key(use.resource);
+			if(is_incoherent(use.access))
+				incoherent_writes[key] = pass_idx;
+			else
+				incoherent_writes.erase(key);
+		}
+	}
+}
+
+uint32_t FrameGraph::hazard_key(Handle resource) const
+{
+	const auto &res = _resources[resource];
+	if(res.kind == Kind::Transient and res.physical != Invalid)
+		return uint32_t(_resources.size()) + res.physical;
+	return resource;
+}
+
+} // RGL
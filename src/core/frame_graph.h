@@ -0,0 +1,189 @@
+#pragma once
+
+#include "rendertarget_2d.h"
+#include "rendertarget_pool.h"
+
+#include "container_types.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace RGL
+{
+
+/*
+ A per-frame graph of render passes.
+
+   Each frame the passes are (re-)declared, in execution order, with the resources they read and write.
+   compile() then:
+     - culls the passes whose results aren't used (i.e. no side effects and no output is read later)
+     - determines the memory barriers needed between the remaining passes; only after incoherent writes
+       (image stores, SSBOs) and only the barrier bits not already issued since the write
+     - assigns the transient textures to physical textures, by lifetime; textures with the same
+       descriptor whose lifetimes don't overlap share the same physical texture
+
+   Imported resources (textures and buffers) are owned elsewhere and are only tracked for barriers.
+   A write that doesn't also read the resource is assumed to overwrite all of it.
+   The physical textures are acquired from a RenderTargetPool, for the duration of execute().
+*/
+class FrameGraph
+{
+public:
+	using Handle = uint32_t;
+	static constexpr Handle Invalid = ~Handle(0);
+
+	// how a pass accesses a resource; determines the barrier needed by the next access
+	enum class Access : uint8_t
+	{
+		Sampled,     // texture fetch
+		Image,       // image load/store
+		Attachment,  // draw calls, i.e. framebuffer
+		Storage,     // shader storage buffer
+		Indirect,    // indirect dispatch/draw arguments
+		Transfer,    // clear, copy, blit, upload
+	};
+
+	using TextureDesc = RenderTargetPool::Desc;
+
+	class Builder
+	{
+	public:
+		Handle create(std::string_view name, const TextureDesc &desc);
+		void read(Handle resource, Access access=Access::Sampled);
+		void write(Handle resource, Access access=Access::Attachment);
+		// e.g. draws to the screen; never culled
+		void side_effect();
+
+	private:
+		friend class FrameGraph;
+		Builder(FrameGraph &graph, uint32_t pass) : _graph(graph), _pass(pass) {}
+
+		FrameGraph &_graph;
+		uint32_t _pass;
+	};
+
+	class Resources
+	{
+	public:
+		RenderTarget::Texture2d &texture(Handle resource) const;
+
+	private:
+		friend class FrameGraph;
+		explicit Resources(const FrameGraph &graph) : _graph(graph) {}
+
+		const FrameGraph &_graph;
+	};
+
+	using SetupFunc = std::function<void (Builder &)>;
+	using ExecuteFunc = std::function<void (const Resources &)>;
+
+	struct Stats
+	{
+		uint32_t passes;
+		uint32_t culled_passes;
+		uint32_t barriers;             // glMemoryBarrier() calls
+		uint32_t transient_textures;
+		uint32_t physical_textures;    // after aliasing
+		size_t transient_bytes;        // without aliasing
+		size_t physical_bytes;
+	};
+
+public:
+	explicit FrameGraph(RenderTargetPool &pool) : _pool(pool) {}
+	FrameGraph(const FrameGraph &) = delete;
+	FrameGraph &operator = (const FrameGraph &) = delete;
+
+	Handle import_texture(std::string_view name, RenderTarget::Texture2d &rt);
+	Handle import_buffer(std::string_view name);
+
+	void add_pass(std::string_view name, const SetupFunc &setup, ExecuteFunc execute);
+	// the resource is used after the graph (e.g. by the UI); its writers are kept
+	void mark_output(Handle resource);
+
+	void compile();
+	void execute();
+	// forget the passes and the resources, to declare the next frame
+	void clear();
+
+	// after compile()
+	[[nodiscard]] bool is_culled(uint32_t pass) const;
+	// the barrier issued before 'pass' (0 = none)
+	[[nodiscard]] GLbitfield barrier(uint32_t pass) const;
+	// index of the physical texture of a transient texture (Invalid if not transient or unused)
+	//   the same (physical) index is the same render target, during execute()
+	[[nodiscard]] uint32_t physical_index(Handle resource) const;
+	[[nodiscard]] inline const Stats &stats() const { return _stats; }
+
+	[[nodiscard]] inline size_t num_passes() const { return _passes.size(); }
+	[[nodiscard]] std::string_view pass_name(uint32_t pass) const;
+	// the texture a transient texture was assigned to, in the last executed frame (for debugging)
+	//   it's back in the pool, i.e. it might since have been used for something else
+	[[nodiscard]] const RenderTarget::Texture2d *find_texture(std::string_view name) const;
+
+private:
+	struct Use
+	{
+		Handle resource;
+		Access access;
+		bool write;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		ExecuteFunc execute;
+		small_vec<Use, 8> uses;
+		bool side_effect { false };
+
+		// compile() results
+		bool culled { false };
+		GLbitfield barrier { 0 };
+	};
+
+	enum class Kind : uint8_t { Texture, Buffer, Transient };
+
+	struct Resource
+	{
+		std::string name;
+		Kind kind;
+		TextureDesc desc;
+		RenderTarget::Texture2d *imported { nullptr };
+		bool output { false };
+
+		// compile() results
+		uint32_t first_use { Invalid };  // pass index
+		uint32_t last_use { Invalid };
+		uint32_t physical { Invalid };
+	};
+
+	struct PhysicalTexture
+	{
+		TextureDesc desc;
+		std::string_view name;  // of the first resource assigned to it
+		uint32_t last_use;      // pass index
+		RenderTarget::Texture2d *rt { nullptr };  // during execute()
+	};
+
+private:
+	void cull();
+	void compute_lifetimes();
+	void alias_transients();
+	void compute_barriers();
+	// the key for the resource's hazard tracking; aliased transients share their physical texture's
+	uint32_t hazard_key(Handle resource) const;
+
+private:
+	RenderTargetPool &_pool;
+
+	std::vector<Pass> _passes;
+	std::vector<Resource> _resources;
+	std::vector<PhysicalTexture> _physical;
+	dense_map<std::string, const RenderTarget::Texture2d *> _last_frame_textures;  // see find_texture()
+	Stats _stats {};
+	bool _compiled { false };
+};
+
+} // RGL
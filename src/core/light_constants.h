@@ -7,6 +7,8 @@
 #define MAX_SPHERE_LIGHTS            32
 #define MAX_DISC_LIGHTS              32
 
+#define MAX_LIGHT_AGGREGATES        256  // distant lights merged into one (light LOD)
+
 #define MAX_POINT_SHADOW_CASTERS    256
 #define MAX_SPOT_SHADOW_CASTERS      32
 #define MAX_RECT_SHADOW_CASTERS       2
@@ -18,6 +20,20 @@
 
 #define CLUSTER_AVERAGE_LIGHTS         32
 
+// compact cluster light lists (0 = disabled): 16-bit light indices, two per uint, and each cluster's
+//   light range packed in a single uint; a 20-bit start index and a 12-bit (saturated) count
+#define CLUSTER_COMPACT_LIGHTS          1
+#define CLUSTER_RANGE_COUNT_BITS       12u
+#define CLUSTER_RANGE_COUNT_MASK   0x0fffu
+
+// two-level culling: lights are first culled per screen tile (a column of clusters)
+#define CLUSTER_TILE_MAX_LIGHTS      1024
+#define CLUSTER_TILE_AVERAGE_LIGHTS   128
+#define CLUSTER_TILE_OVERFLOW  0xffffffffu  // IndexRange::count of a tile whose list didn't fit; use all relevant lights
+
+// z-binned light assignment: per-tile bitmasks of the (depth sorted) relevant lights
+#define ZBIN_MAX_LIGHTS              4096  // >= all lights + aggregates, i.e. never overflows
+
 
 // 'type_flags' bits:
 //                       16 15
@@ -101,6 +117,11 @@ void SET_SHADOW_IDX(auto &light, auto idx)
 #define SHADOW_COMPRESSION(light)  ((light).shape_data[4].x)
 #define SET_SHADOW_COMPRESSION(light, sc)  ((light).shape_data[4].x = (sc))
 
+// ShadowSlotInfo::projection; a point light's shadow map layout (see ShadowAtlas::SlotConfig)
+#define SHADOW_PROJECTION_CUBE             0u  // 6 faces
+#define SHADOW_PROJECTION_TETRAHEDRAL      1u  // 4 faces
+#define SHADOW_PROJECTION_DUAL_PARABOLOID  2u  // 2 hemispheres
+
 #define FROXEL_GRID_W      160
 #define FROXEL_GRID_H      90
 #define FROXEL_GRID_D      64
@@ -112,3 +133,10 @@ void SET_SHADOW_IDX(auto &light, auto idx)
 #define FROXELS_PER_TILE   10
 #define FROXEL_TILE_AVG_LIGHTS 64
 #define FROXEL_TILE_MAX_LIGHTS 256
+
+// the static lights' scattering cache (see PP::Volumetrics); a window of bricks around the camera
+#define VOLUMETRIC_CACHE_BRICK_TEXELS  8     // per axis
+#define VOLUMETRIC_CACHE_TEXEL_SIZE    0.5   // meters
+#define VOLUMETRIC_CACHE_BRICKS_XZ     12
+#define VOLUMETRIC_CACHE_BRICKS_Y      4
+#define VOLUMETRIC_CACHE_MAX_BAKE      16    // bricks per frame
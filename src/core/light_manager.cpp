@@ -13,8 +13,11 @@
 #include "component/light_sphere.h"
 #include "component/light_disc.h"
 
+#include "filesystem.h"
+#include "light_packing.h"
 #include "light_wrapper.h"
 #include "hash_combine.h"
+#include "shader.h"
 // #include "scoped_timer.h"
 #include "hash_vec3.h"  // IWYU pragma: keep
 #include "hash_vec4.h"  // IWYU pragma: keep
@@ -44,14 +47,27 @@ static_assert(LIGHT_TYPE__COUNT == 7);
 
 float LightManager::s_radius_power { 0.7f };
 
+// bytes uploaded per light (the shading & culling records)
+static constexpr size_t s_upload_elem_size = GPULightPacked::_struct_size + GPULightCull::_struct_size;
+
 LightManager::LightManager(entt::registry &entities) :
 	_lights_ssbo("lights"sv),
+	_lights_cull_ssbo("lights-cull"sv),
+	_scatter_lights_ssbo("lights-scatter"sv),
+	_scatter_cull_ssbo("lights-scatter-cull"sv),
+	_scatter_index_ssbo("lights-scatter-index"sv),
 	_entities(entities)
 {
 	_lights_ssbo.bindAt(SSBO_BIND_LIGHTS);
+	_lights_cull_ssbo.bindAt(SSBO_BIND_LIGHTS_CULL);
+	_scatter_lights_ssbo.bindAt(SSBO_BIND_LIGHTS_SCATTER_DATA);
+	_scatter_cull_ssbo.bindAt(SSBO_BIND_LIGHTS_SCATTER_CULL);
+	_scatter_index_ssbo.bindAt(SSBO_BIND_LIGHTS_SCATTER_INDEX);
 
 	reserve(1024);
 
+	_lod_reset();
+
 	// byt default, no limits on number of lights
 	for(auto idx = 0u; idx < LIGHT_TYPE__COUNT; ++idx)
 	{
@@ -62,6 +78,8 @@ LightManager::LightManager(entt::registry &entities) :
 	_connect_signals();
 }
 
+LightManager::~LightManager() = default;  // here b/c Shader is incomplete in the header
+
 void LightManager::reserve(size_t count)
 {
 	_id_to_index.reserve(count);
@@ -69,6 +87,8 @@ void LightManager::reserve(size_t count)
 	_dirty.reserve(count);
 	_dirty_list.reserve(count);
 	_lights.reserve(count);
+	_lights_packed.reserve(count);
+	_lights_cull.reserve(count);
 }
 
 bool LightManager::remove(LightID light_id)
@@ -116,6 +136,8 @@ void LightManager::clear()
 	_id_to_index.clear();
 	_index_to_id.clear();
 	_lights.clear();
+	_lights_packed.clear();
+	_lights_cull.clear();
 	_dirty.clear();
 	_dirty_list.clear();
 
@@ -124,6 +146,8 @@ void LightManager::clear()
 
 	for(auto idx = 0u; idx < LIGHT_TYPE__COUNT; ++idx)
 		_num_light_type[idx] = 0;
+
+	_lod_reset();
 }
 
 // std::tuple<LightID, const GPULight &> LightManager::gpu_at(LightIndex light_index) const
@@ -160,40 +184,128 @@ void LightManager::clear()
 
 void LightManager::flush()
 {
+	_upload_stats = {};
+
+	for(const auto light_index: _dirty_list)
+	{
+		if(light_index < _index_to_id.size())
+			_changed_generation[_index_to_id[light_index]] = _generation;
+	}
+
+	// the aggregate lights (see update_lod()) are stored after the regular lights
+	const auto ssbo_size = _lights.size() + _lod_aggregates.size();
+
 	// more/less lights than before; upload all  (hpefully, this doesn't happen often)
-	if(_lights.size() != _lights_ssbo.size() or _dirty.size() == _lights.size())
+	if(ssbo_size != _lights_ssbo.size() or (not _dirty.empty() and _dirty.size() == _lights.size()))
 	{
 		_gpu_build(0, LightIndex(_lights.size()));
-		_lights_ssbo.set(_lights);
+		_lights_ssbo.resize(ssbo_size);
+		_lights_cull_ssbo.resize(ssbo_size);
+		if(not _lights.empty())
+			_gpu_upload(0, LightIndex(_lights.size()));
+		_lights_ssbo.set(_lod_packed.begin(), _lod_packed.end(), _lights.size());
+		_lights_cull_ssbo.set(_lod_cull.begin(), _lod_cull.end(), _lights.size());
+		_lod_dirty_slots.clear();
+
+		_upload_stats.calls  = _lights.empty()? 2: 4;
+		_upload_stats.lights = _lights.size();
+		_upload_stats.dirty  = _dirty.size();
 	}
 	else if(not _dirty.empty())
 	{
 		// no lights were added or removed, but some are dirty
 
-		// make as few .update() calls as possible to the SSBO, using contiguous ranges
 		std::ranges::sort(_dirty_list);
 
-		auto contiguous = [](auto a, auto b){
-			return b == a + 1;
-		};
-		for(auto subrange : _dirty_list | std::views::chunk_by(contiguous))
+		// only the dirty lights need rebuilding; the lights in the gaps are already up to date
+		for(const auto light_index: _dirty_list)
+			_gpu_build(light_index);
+
+		_upload_stats.dirty = _dirty_list.size();
+
+		// merge ranges separated by small gaps (cheaper to re-upload the gap than to issue another call)
+		auto cost = _upload_policy.cost;
+		if(_upload_policy.gpu_scatter)
+			cost.max_calls = 0;  // check how many calls are needed first
+		buffer::coalesce(_dirty_list, s_upload_elem_size, cost, _upload_ranges);
+
+		const auto max_calls = _upload_policy.cost.max_calls;
+		bool uploaded = false;
+
+		if(max_calls and _upload_ranges.size() > max_calls)
 		{
-			auto s = *subrange.begin();
-			auto e = *std::prev(subrange.end());
-			if (s == e)
-			{
-				_gpu_build(s);
-				_lights_ssbo.set(s, _lights[s]);
-			}
-			else
-			{
-				_gpu_build(s, e);
-				_lights_ssbo.set(_lights.begin() + s, _lights.begin() + e+ 1, s);
-			}
+			if(_upload_policy.gpu_scatter)
+				uploaded = _gpu_scatter_dirty();
+
+			if(not uploaded and _upload_policy.gpu_scatter)  // scatter not available; cap the number of calls instead
+				buffer::coalesce(_dirty_list, s_upload_elem_size, _upload_policy.cost, _upload_ranges);
+		}
+
+		if(not uploaded)
+		{
+			for(const auto &range: _upload_ranges)
+				_gpu_upload(range.start, range.end);
+			_upload_stats.calls  = _upload_ranges.size() * 2;
+			_upload_stats.lights = buffer::coalesced_count(_upload_ranges);
 		}
 	}
 	_dirty.clear();
 	_dirty_list.clear();
+	++_generation;
+
+	_lod_upload_dirty();
+}
+
+void LightManager::_gpu_upload(LightIndex start, LightIndex end)
+{
+	_lights_ssbo.set(_lights_packed.begin() + start, _lights_packed.begin() + end, start);
+	_lights_cull_ssbo.set(_lights_cull.begin() + start, _lights_cull.begin() + end, start);
+}
+
+bool LightManager::_gpu_scatter_dirty()
+{
+	if(not _scatter_shader and not _scatter_shader_failed)
+	{
+		static const std::filesystem::path dir = FileSystem::getResourcesPath() / "shaders";
+
+		_scatter_shader = std::make_unique<Shader>(dir / "lights_scatter.comp");
+		_scatter_shader->link();
+		_scatter_shader_failed = not *_scatter_shader;
+		if(_scatter_shader_failed)
+		{
+			Log::error("LightManager: scatter shader failed; falling back to ranged uploads");
+			_scatter_shader.reset();
+		}
+		else
+			_scatter_shader->setPostBarrier(Shader::Barrier::SSBO);
+	}
+	if(not _scatter_shader)
+		return false;
+
+	// stage only the dirty lights, packed, along with their destination indices
+	_scatter_lights.clear();
+	_scatter_cull.clear();
+	for(const auto light_index: _dirty_list)
+	{
+		_scatter_lights.push_back(_lights_packed[light_index]);
+		_scatter_cull.push_back(_lights_cull[light_index]);
+	}
+
+	_scatter_lights_ssbo.set(_scatter_lights);
+	_scatter_cull_ssbo.set(_scatter_cull);
+	_scatter_index_ssbo.set(_dirty_list);
+
+	static constexpr auto group_size = 64u;  // must match 'local_size_x' in the shader
+
+	const auto num_lights = uint32_t(_dirty_list.size());
+	_scatter_shader->setUniform("u_num_lights"sv, num_lights);
+	_scatter_shader->invoke(size_t(std::ceil(float(num_lights) / float(group_size))));
+
+	_upload_stats.calls     = 3;  // staging uploads (the dispatch is cheap)
+	_upload_stats.lights    = num_lights;
+	_upload_stats.scattered = true;
+
+	return true;
 }
 
 uint_fast16_t LightManager::shadow_index(LightID light_id) const
@@ -485,10 +597,15 @@ void LightManager::_light_added(entt::registry &, entt::entity light_ent)
 
 	_id_to_index[light_id] = light_index;
 	_index_to_id.push_back(light_id);
+	_changed_generation[light_id] = _generation;
 
 	_lights.emplace_back();
+	_lights_packed.emplace_back();
+	_lights_cull.emplace_back();
 
 	_gpu_build(light_index);
+
+	_lod_reset();
 }
 
 void LightManager::_light_removed(entt::registry &, entt::entity light_ent)
@@ -513,14 +630,24 @@ void LightManager::_light_removed(entt::registry &, entt::entity light_ent)
 	const auto last_index_id = _index_to_id.back();
 
 	_id_to_index.erase(found);
+	_changed_generation.erase(light_id);
 
-	 // the last-index light is now at this index
-	_id_to_index[last_index_id] = removed_index;
-	_set_dirty_index(removed_index);  // where the now-moved light reside
+	if(last_index_id != light_id)
+	{
+		// the last-index light is now at this index
+		_id_to_index[last_index_id] = removed_index;
+		_index_to_id[removed_index] = last_index_id;
+		_set_dirty_index(removed_index);  // where the now-moved light reside
+	}
+	_index_to_id.pop_back();
 
-	// truncate CPU & GPU lists
+	// truncate CPU list  (the SSBO is resized by flush())
 	_lights.resize(_id_to_index.size());
-	_lights_ssbo.resize(_id_to_index.size());
+	_lights_packed.resize(_lights.size());
+	_lights_cull.resize(_lights.size());
+
+	// light indices changed; the aggregates are no longer valid
+	_lod_reset();
 }
 
 void LightManager::_general_changed(entt::registry &, entt::entity light_ent)
@@ -692,6 +819,15 @@ LightID LightManager::light_id(LightIndex light_index) const
 	return _index_to_id[light_index];
 }
 
+uint64_t LightManager::changed_generation(LightID light_id) const
+{
+	const auto found = _changed_generation.find(light_id);
+	assert(found != _changed_generation.end());
+	if(found == _changed_generation.end())
+		return _generation;
+	return found->second;
+}
+
 LightIndex LightManager::light_index(LightID light_id) const
 {
 	auto found = _id_to_index.find(light_id);
@@ -814,6 +950,8 @@ void LightManager::_gpu_build(LightIndex start, LightIndex end)
 #endif
 
 		_gpu_set_properties(L, light_id);
+		lights::pack(L, _lights_packed[light_index]);
+		lights::pack(L, _lights_cull[light_index]);
 
 #if 0//defined(_DEBUG)
 		if(std::memcmp(&L, &Lcopy, sizeof(L)) == 0)
@@ -9,6 +9,7 @@
 #include "lights.h"
 #include "log.h"
 #include "ssbo.h"
+#include "upload_ranges.h"
 
 #include "generated/shared-structs.h"
 
@@ -20,6 +21,8 @@
 #include <glm/gtx/compatibility.hpp>
 
 #include <cstddef>
+#include <memory>
+#include <span>
 
 
 // TODO: 'lights' namespace
@@ -30,6 +33,8 @@
 namespace RGL
 {
 
+class Shader;
+
 namespace component
 {
 	struct LightGeneral;
@@ -122,6 +127,8 @@ public:
 
 	inline const entt::registry &entities() const { return _entities; }
 
+	~LightManager();
+
 	void reserve(size_t count);
 
 	// create light entity, return to augmented instance (e.g. with uuid set)
@@ -153,6 +160,60 @@ public:
 	// update dirty lights in the SSBO
 	void flush();
 
+	// incremented by every flush()
+	inline uint64_t generation() const { return _generation; }
+	// the generation in which the light was last added or modified (a "moved" light counts as modified)
+	uint64_t changed_generation(LightID light_id) const;
+
+	struct UploadPolicy
+	{
+		buffer::UploadCost cost { .call_overhead_bytes = 2048, .max_calls = 8 };
+		// when more than 'cost.max_calls' ranges are needed, scatter the dirty lights using a compute shader
+		//   (if false, or the shader is unavailable, the ranges are instead merged to 'cost.max_calls')
+		bool gpu_scatter { true };
+	};
+	inline void set_upload_policy(const UploadPolicy &policy) { _upload_policy = policy; }
+	inline const UploadPolicy &upload_policy() const { return _upload_policy; }
+
+	struct UploadStats
+	{
+		size_t calls { 0 };
+		size_t lights { 0 };     // number of lights uploaded (including coalesced gaps)
+		size_t dirty { 0 };      // number of lights that actually changed
+		bool   scattered { false };
+	};
+	inline const UploadStats &upload_stats() const { return _upload_stats; }
+
+	// light LOD: distant point & sphere lights close to each other are merged into aggregate lights
+	//   the aggregates are stored in the SSBO after the regular lights, i.e. at index >= size()
+	struct LodPolicy
+	{
+		bool  enabled { false };
+		float distance { 30.f };    // lights closer than this are never aggregated
+		float cell_size { 4.f };    // size of the aggregation cells at 'distance'; doubles for every doubling of the distance
+	};
+	void set_lod_policy(const LodPolicy &policy);
+	inline const LodPolicy &lod_policy() const { return _lod_policy; }
+
+	// re-evaluate which lights are aggregated and rebuild the affected aggregates (call before flush())
+	void update_lod(const glm::vec3 &view_pos);
+	bool is_aggregated(LightIndex light_index) const;
+	// SSBO indices of the active aggregate lights
+	inline std::span<const LightIndex> aggregate_indices() const { return _lod_aggregate_indices; }
+	inline const GPULight &aggregate_at(LightIndex index) const { return _lod_aggregates.at(index - _lights.size()); }
+
+	// the culling record of a light or an aggregate (as uploaded by flush())
+	inline const GPULightCull &cull_record(LightIndex index) const { return index < _lights_cull.size()? _lights_cull[index]: _lod_cull.at(index - _lights_cull.size()); }
+
+	struct LodStats
+	{
+		size_t aggregates { 0 };
+		size_t aggregated_lights { 0 };
+		size_t rebuilt { 0 };    // aggregates rebuilt by the last update
+		size_t starved { 0 };    // cells that should be aggregated, but there were no free slots
+	};
+	inline const LodStats &lod_stats() const { return _lod_stats; }
+
 	inline size_t size() const { return _lights.size(); }
 
 	inline const_iterator cbegin() const { return _lights.cbegin(); }
@@ -220,6 +281,7 @@ private:
 	void create_components(LightID light_id, const DiscLightParams &lp);
 	inline void _gpu_build(LightIndex index) { _gpu_build(index, index + 1); }
 	void _gpu_build(LightIndex start, LightIndex end);
+	void _gpu_upload(LightIndex start, LightIndex end);
 	void _gpu_set_properties(GPULight &L, LightID light_id) const;
 	static void _gpu_set_surface(GPULight &L, const component::Transform &transform, const component::RectLight &rect);
 	static void _gpu_set_surface(GPULight &L, const component::Transform &transform, const component::TubeLight &tube);
@@ -257,18 +319,63 @@ private:
 	inline void _set_dirty_index(LightIndex key);
 	inline void _set_dirty_id(LightID light_id);
 
+	bool _gpu_scatter_dirty();
+
+	struct LodCell
+	{
+		small_vec<LightIndex, 8> members;
+		uint32_t slot { NO_AGGREGATE_SLOT };
+		bool dirty { false };
+	};
+	static constexpr uint32_t NO_AGGREGATE_SLOT = ~0u;
+	static constexpr uint64_t NO_LOD_CELL = ~0ull;
+	void _lod_reset();
+	void _lod_mark_dirty(uint64_t cell_key, LodCell &cell);
+	void _lod_build(const LodCell &cell);
+	void _lod_upload_dirty();
+
 private:
 	dense_map<LightID, LightIndex> _id_to_index;
 	std::vector<LightID> _index_to_id;
 
 	dense_set<LightIndex> _dirty;
 	std::vector<LightIndex> _dirty_list;
+	uint64_t _generation { 0 };
+	dense_map<LightID, uint64_t> _changed_generation;
 	// essentially a CPU-side mirror of the SSBO  (otherwise we'd use a mapping container)
 	LightList _lights;
+	// what's actually uploaded; packed from '_lights' by _gpu_build()
+	std::vector<GPULightPacked> _lights_packed;
+	std::vector<GPULightCull> _lights_cull;
 	LightID _sun_light_id { NO_LIGHT_ID };
 	float   _sun_light_intensity { 0.f };
 
-	buffer::Storage<GPULight> _lights_ssbo;
+	buffer::Storage<GPULightPacked> _lights_ssbo;
+	buffer::Storage<GPULightCull> _lights_cull_ssbo;
+
+	UploadPolicy _upload_policy;
+	UploadStats _upload_stats;
+	std::vector<buffer::UploadRange> _upload_ranges;
+	// staging for the compute scatter upload
+	std::vector<GPULightPacked> _scatter_lights;
+	std::vector<GPULightCull> _scatter_cull;
+	buffer::Storage<GPULightPacked> _scatter_lights_ssbo;
+	buffer::Storage<GPULightCull> _scatter_cull_ssbo;
+	buffer::Storage<uint32_t> _scatter_index_ssbo;
+	std::unique_ptr<Shader> _scatter_shader;
+	bool _scatter_shader_failed { false };
+
+	LodPolicy _lod_policy;
+	LodStats _lod_stats;
+	dense_map<LightIndex, uint64_t> _lod_light_cell;
+	dense_map<uint64_t, LodCell> _lod_cells;
+	std::vector<uint64_t> _lod_dirty_cells;
+	std::vector<GPULight> _lod_aggregates;  // MAX_LIGHT_AGGREGATES slots
+	std::vector<GPULightPacked> _lod_packed;
+	std::vector<GPULightCull> _lod_cull;
+	std::vector<uint32_t> _lod_free_slots;
+	std::vector<uint32_t> _lod_dirty_slots;
+	std::vector<LightIndex> _lod_aggregate_indices;
 
 	entt::registry &_entities;
 
@@ -0,0 +1,361 @@
+#include "light_manager.h"
+
+#include "light_constants.h"
+#include "light_packing.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// light LOD, a.k.a. "aggregate lights"
+//
+//   Lights farther than 'LodPolicy::distance' are bucketed into a hierarchical grid; the cell size doubles
+//   each time the distance doubles, which keeps the angular size of the cells (i.e. the error) roughly constant,
+//   similar to a lightcut.
+//   Cells with two or more lights are represented by a single aggregate light (a point light at the
+//   intensity-weighted centroid, with the combined intensity and averaged color), and its members are skipped.
+//
+//   Both the level and the cell have some hysteresis, i.e. a light moving along a border doesn't flip
+//   between two aggregates every frame.
+//   Only cells whose membership changed, or whose member lights changed, are rebuilt.
+
+namespace RGL
+{
+
+static constexpr int   s_lod_max_level   = 15;     // stored in 4 bits of the cell key
+static constexpr float s_lod_hysteresis  = 0.1f;   // fraction of a level's distance range
+static constexpr float s_lod_cell_margin = 0.1f;   // fraction of a cell's size
+
+static constexpr uint64_t s_lod_coord_bits = 20;
+static constexpr uint64_t s_lod_coord_mask = (1ull << s_lod_coord_bits) - 1;
+static constexpr int64_t  s_lod_coord_bias = 1ll << (s_lod_coord_bits - 1);
+
+static inline uint64_t lod_cell_key(const glm::vec3 &position, int level, float base_cell_size)
+{
+	const auto cell_size = base_cell_size * float(1u << level);
+	const auto cell = glm::floor(position / cell_size);
+
+	auto coord = [](float c) {
+		return uint64_t(int64_t(c) + s_lod_coord_bias) & s_lod_coord_mask;
+	};
+
+	return (uint64_t(level) << (3*s_lod_coord_bits)) \
+		| (coord(cell.x) << (2*s_lod_coord_bits)) \
+		| (coord(cell.y) << s_lod_coord_bits) \
+		|  coord(cell.z);
+}
+
+static inline int lod_cell_level(uint64_t key)
+{
+	return int(key >> (3*s_lod_coord_bits));
+}
+
+// whether 'position' is inside the cell, expanded by 'margin' (fraction of the cell size) on each side
+static inline bool lod_cell_contains(uint64_t key, const glm::vec3 &position, float base_cell_size, float margin)
+{
+	const auto cell_size = base_cell_size * float(1u << lod_cell_level(key));
+
+	auto coord = [key](uint64_t shift) {
+		return float(int64_t((key >> shift) & s_lod_coord_mask) - s_lod_coord_bias);
+	};
+
+	const auto cell_min = glm::vec3(coord(2*s_lod_coord_bits), coord(s_lod_coord_bits), coord(0)) * cell_size;
+	const auto pad = cell_size * margin;
+
+	return glm::all(glm::greaterThanEqual(position, cell_min - pad))
+		and glm::all(glm::lessThan(position, cell_min + cell_size + pad));
+}
+
+static inline bool lod_eligible(const GPULight &L)
+{
+	const auto light_type = GET_LIGHT_TYPE(L);
+
+	// shadow casters keep their identity, otherwise their shadow maps would be lost
+	return IS_ENABLED(L)
+		and L.intensity > 0
+		and not IS_SHADOW_CASTER(L)
+		and (light_type == LightType::Point or light_type == LightType::Sphere);
+}
+
+void LightManager::set_lod_policy(const LodPolicy &policy)
+{
+	const auto grid_changed = policy.distance != _lod_policy.distance or policy.cell_size != _lod_policy.cell_size;
+
+	_lod_policy = policy;
+
+	if(grid_changed or not policy.enabled)
+		_lod_reset();
+}
+
+bool LightManager::is_aggregated(LightIndex light_index) const
+{
+	const auto found_light = _lod_light_cell.find(light_index);
+	if(found_light == _lod_light_cell.end())
+		return false;
+
+	const auto found_cell = _lod_cells.find(found_light->second);
+	assert(found_cell != _lod_cells.end());
+
+	return found_cell->second.slot != NO_AGGREGATE_SLOT;
+}
+
+void LightManager::update_lod(const glm::vec3 &view_pos)
+{
+	_lod_stats.rebuilt = 0;
+
+	if(not _lod_policy.enabled)
+		return;
+
+	assert(_lod_policy.distance > 0 and _lod_policy.cell_size > 0);
+
+	// the aggregates need current positions & intensities  (flush() rebuilds the dirty lights again, but it's cheap)
+	for(const auto light_index: _dirty_list)
+		_gpu_build(light_index);
+
+	const auto lod_distance = _lod_policy.distance;
+
+	for(auto light_index = 0u; light_index < _lights.size(); ++light_index)
+	{
+		const auto &L = _lights[light_index];
+
+		const auto found = _lod_light_cell.find(light_index);
+		const auto current_key = found != _lod_light_cell.end()? found->second: NO_LOD_CELL;
+
+		auto key = NO_LOD_CELL;
+
+		if(lod_eligible(L))
+		{
+			const auto distance = glm::distance(L.position, view_pos);
+
+			int level = -1;
+
+			if(current_key != NO_LOD_CELL)
+			{
+				// stay on the current level unless the light moved clearly outside of it
+				const auto current_level = lod_cell_level(current_key);
+				const auto level_start = lod_distance * float(1u << current_level);
+				if(distance > level_start*(1 - s_lod_hysteresis) and distance < 2*level_start*(1 + s_lod_hysteresis))
+					level = current_level;
+			}
+
+			if(level < 0 and distance >= lod_distance)
+				level = std::min(int(std::log2(distance / lod_distance)), s_lod_max_level);
+
+			if(level >= 0)
+			{
+				// likewise, stay in the current cell unless the light moved clearly outside of it
+				if(current_key != NO_LOD_CELL and level == lod_cell_level(current_key)
+				   and lod_cell_contains(current_key, L.position, _lod_policy.cell_size, s_lod_cell_margin))
+					key = current_key;
+				else
+					key = lod_cell_key(L.position, level, _lod_policy.cell_size);
+			}
+		}
+
+		if(key != current_key)
+		{
+			if(current_key != NO_LOD_CELL)
+			{
+				auto &cell = _lod_cells[current_key];
+				auto member = std::ranges::find(cell.members, light_index);
+				assert(member != cell.members.end());
+				*member = cell.members.back();
+				cell.members.pop_back();
+				_lod_mark_dirty(current_key, cell);
+			}
+
+			if(key != NO_LOD_CELL)
+			{
+				auto &cell = _lod_cells[key];
+				cell.members.push_back(light_index);
+				_lod_mark_dirty(key, cell);
+				_lod_light_cell[light_index] = key;
+			}
+			else
+				_lod_light_cell.erase(light_index);
+		}
+		else if(key != NO_LOD_CELL and _dirty.contains(light_index))
+			_lod_mark_dirty(key, _lod_cells[key]);
+	}
+
+	// rebuild the dirty cells
+	//   starved cells (no free slot) are kept in the dirty list, to be retried in the next update
+
+	_lod_stats.starved = 0;
+	size_t write_idx = 0;
+
+	for(const auto key: _lod_dirty_cells)
+	{
+		auto found = _lod_cells.find(key);
+		if(found == _lod_cells.end())
+			continue;
+
+		auto &cell = found->second;
+
+		if(cell.members.size() < 2)
+		{
+			// a single light is better off as itself
+			if(cell.slot != NO_AGGREGATE_SLOT)
+			{
+				_lod_aggregates[cell.slot].type_flags = 0;
+				_lod_packed[cell.slot].type_flags = 0;
+				_lod_cull[cell.slot].type_flags = 0;
+				_lod_dirty_slots.push_back(cell.slot);
+				_lod_free_slots.push_back(cell.slot);
+			}
+			if(cell.members.empty())
+				_lod_cells.erase(found);
+			else
+			{
+				cell.slot = NO_AGGREGATE_SLOT;
+				cell.dirty = false;
+			}
+			continue;
+		}
+
+		if(cell.slot == NO_AGGREGATE_SLOT)
+		{
+			if(_lod_free_slots.empty())
+			{
+				++_lod_stats.starved;
+				_lod_dirty_cells[write_idx++] = key;
+				continue;
+			}
+			cell.slot = _lod_free_slots.back();
+			_lod_free_slots.pop_back();
+		}
+
+		_lod_build(cell);
+		cell.dirty = false;
+		++_lod_stats.rebuilt;
+	}
+	_lod_dirty_cells.resize(write_idx);
+
+	_lod_aggregate_indices.clear();
+	_lod_stats.aggregated_lights = 0;
+	for(const auto &[_, cell]: _lod_cells)
+	{
+		if(cell.slot != NO_AGGREGATE_SLOT)
+		{
+			_lod_aggregate_indices.push_back(LightIndex(_lights.size() + cell.slot));
+			_lod_stats.aggregated_lights += cell.members.size();
+		}
+	}
+	std::ranges::sort(_lod_aggregate_indices);
+	_lod_stats.aggregates = _lod_aggregate_indices.size();
+}
+
+void LightManager::_lod_mark_dirty(uint64_t cell_key, LodCell &cell)
+{
+	if(not cell.dirty)
+	{
+		cell.dirty = true;
+		_lod_dirty_cells.push_back(cell_key);
+	}
+}
+
+void LightManager::_lod_build(const LodCell &cell)
+{
+	assert(cell.slot < _lod_aggregates.size());
+
+	float total_intensity { 0 };
+	glm::vec3 position { 0 };
+	glm::vec3 color { 0 };
+	float fog { 0 };
+	bool volumetric { false };
+
+	for(const auto light_index: cell.members)
+	{
+		const auto &L = _lights[light_index];
+		total_intensity += L.intensity;
+		position        += L.position * L.intensity;
+		color           += L.color * L.intensity;
+		fog             += L.fog_intensity * L.intensity;
+		volumetric      |= IS_VOLUMETRIC(L);
+	}
+	assert(total_intensity > 0);
+
+	position /= total_intensity;
+	color    /= total_intensity;
+	fog      /= total_intensity;
+
+	// bounds of all members, but at least the range of the combined intensity
+	auto radius = _intensity_to_range(total_intensity);
+	for(const auto light_index: cell.members)
+	{
+		const auto &L = _lights[light_index];
+		radius = std::max(radius, glm::distance(position, L.position) + L.affect_radius);
+	}
+
+	auto &A = _lod_aggregates[cell.slot];
+	A.type_flags    = LIGHT_TYPE_POINT | LIGHT_ENABLED | (volumetric? LIGHT_VOLUMETRIC: 0);
+	CLR_SHADOW_IDX(A);
+	SET_SHADOW_COMPRESSION(A, 0);
+	A.position      = position;
+	A.color         = color;
+	A.intensity     = total_intensity;
+	A.fog_intensity = fog;
+	A.affect_radius = radius;
+
+	lights::pack(A, _lod_packed[cell.slot]);
+	lights::pack(A, _lod_cull[cell.slot]);
+
+	_lod_dirty_slots.push_back(cell.slot);
+}
+
+void LightManager::_lod_reset()
+{
+	_lod_light_cell.clear();
+	_lod_cells.clear();
+	_lod_dirty_cells.clear();
+	_lod_aggregate_indices.clear();
+	_lod_stats = {};
+
+	if(_lod_aggregates.size() == MAX_LIGHT_AGGREGATES and _lod_free_slots.size() == MAX_LIGHT_AGGREGATES)
+		return;  // nothing allocated
+
+	_lod_aggregates.resize(MAX_LIGHT_AGGREGATES);
+	_lod_packed.resize(MAX_LIGHT_AGGREGATES);
+	_lod_cull.resize(MAX_LIGHT_AGGREGATES);
+	for(auto slot = 0u; slot < MAX_LIGHT_AGGREGATES; ++slot)
+	{
+		// i.e. disabled
+		_lod_aggregates[slot].type_flags = 0;
+		_lod_packed[slot].type_flags = 0;
+		_lod_cull[slot].type_flags = 0;
+	}
+
+	_lod_free_slots.resize(MAX_LIGHT_AGGREGATES);
+	for(auto slot = 0u; slot < MAX_LIGHT_AGGREGATES; ++slot)
+		_lod_free_slots[slot] = MAX_LIGHT_AGGREGATES - 1 - slot;  // allocate from the front
+
+	_lod_dirty_slots.resize(MAX_LIGHT_AGGREGATES);
+	for(auto slot = 0u; slot < MAX_LIGHT_AGGREGATES; ++slot)
+		_lod_dirty_slots[slot] = slot;
+}
+
+void LightManager::_lod_upload_dirty()
+{
+	if(_lod_dirty_slots.empty())
+		return;
+
+	std::ranges::sort(_lod_dirty_slots);
+	const auto [first, last] = std::ranges::unique(_lod_dirty_slots);
+	_lod_dirty_slots.erase(first, last);
+
+	buffer::coalesce(_lod_dirty_slots, GPULightPacked::_struct_size + GPULightCull::_struct_size, _upload_policy.cost, _upload_ranges);
+
+	const auto offset = _lights.size();
+	for(const auto &range: _upload_ranges)
+	{
+		_lights_ssbo.set(_lod_packed.begin() + range.start, _lod_packed.begin() + range.end, offset + range.start);
+		_lights_cull_ssbo.set(_lod_cull.begin() + range.start, _lod_cull.begin() + range.end, offset + range.start);
+	}
+
+	_upload_stats.calls  += _upload_ranges.size() * 2;
+	_upload_stats.lights += buffer::coalesced_count(_upload_ranges);
+
+	_lod_dirty_slots.clear();
+}
+
+} // RGL
@@ -0,0 +1,221 @@
+#pragma once
+
+#include "light_constants.h"
+#include "light_type.h"
+
+#include "generated/shared-structs.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+// packing of GPULight into the compact SSBO records; GLSL counterpart: light_packing.glh
+//   (glm's pack/unpack functions are bit-exact with the GLSL built-ins)
+
+namespace RGL::lights
+{
+
+// octahedral encoding of a unit vector
+inline uint32_t oct_encode(const glm::vec3 &dir)
+{
+	const auto sum = std::abs(dir.x) + std::abs(dir.y) + std::abs(dir.z);
+	if(sum < 1e-8f)
+		return glm::packSnorm2x16(glm::vec2(0));
+
+	const auto n = dir / sum;
+	auto p = glm::vec2(n.x, n.y);
+	if(n.z < 0)
+	{
+		const auto sign = glm::vec2(p.x >= 0? 1.f: -1.f, p.y >= 0? 1.f: -1.f);
+		p = (1.f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+	}
+	return glm::packSnorm2x16(p);
+}
+
+inline glm::vec3 oct_decode(uint32_t packed)
+{
+	const auto p = glm::unpackSnorm2x16(packed);
+	auto n = glm::vec3(p, 1.f - std::abs(p.x) - std::abs(p.y));
+	const auto t = std::max(-n.z, 0.f);
+	n.x += n.x >= 0? -t: t;
+	n.y += n.y >= 0? -t: t;
+	return glm::normalize(n);
+}
+
+inline uint32_t pack_half2(float a, float b)
+{
+	return glm::packHalf2x16(glm::vec2(a, b));
+}
+
+/*
+ 'shape_data' halves, per light type:
+   rect:   [0-2] right (half width), [3-5] up (half height)
+   tube:   [0-2] half extent, [3] thickness
+   sphere: [0] radius
+   disc:   [0] radius
+   [6] shadow compression (shadow casters)
+ the surface orientation is not needed by the shaders
+*/
+inline void pack(const GPULight &L, GPULightPacked &P)
+{
+	P.position      = L.position;
+	P.affect_radius = L.affect_radius;
+	P.type_flags    = L.type_flags;
+	P.direction     = oct_encode(L.direction);
+	P.intensity     = L.intensity;
+	P.color_rg      = pack_half2(L.color.r, L.color.g);
+	P.color_b_fog   = pack_half2(L.color.b, L.fog_intensity);
+	P.angles        = pack_half2(L.outer_angle, L.inner_angle);
+
+	float shape[8] { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+	switch(GET_LIGHT_TYPE(L))
+	{
+	case LightType::Rect:
+	{
+		const auto right = glm::vec3(L.shape_data[0] - L.shape_data[1]) * 0.5f;
+		const auto up    = glm::vec3(L.shape_data[2] - L.shape_data[0]) * 0.5f;
+		shape[0] = right.x; shape[1] = right.y; shape[2] = right.z;
+		shape[3] = up.x;    shape[4] = up.y;    shape[5] = up.z;
+	}
+	break;
+	case LightType::Tube:
+		shape[0] = L.shape_data[0].x; shape[1] = L.shape_data[0].y; shape[2] = L.shape_data[0].z;
+		shape[3] = L.shape_data[2].x;
+	break;
+	case LightType::Sphere:
+	case LightType::Disc:
+		shape[0] = L.shape_data[0].x;
+	break;
+	default:
+		break;
+	}
+	if(IS_SHADOW_CASTER(L))
+		shape[6] = SHADOW_COMPRESSION(L);
+
+	for(auto idx = 0u; idx < 4; ++idx)
+		P.shape_data[idx] = pack_half2(shape[idx*2], shape[idx*2 + 1]);
+
+	P._reserved0 = 0;
+	P._reserved1 = 0;
+}
+
+/*
+ 'shape' halves, per light type (all lengths in world units):
+   spot:   cos & sin of the outer angle
+   rect:   half width (along 'tangent') & half height
+   disc:   radius & radius (shaded as a square, see calcDiscLight())
+   tube:   half length (along 'direction') & half thickness
+ 'radius' bounds the emitter's surface plus its affect radius.
+ Lights too weak to be visible are disabled in this record (only).
+*/
+inline void pack(const GPULight &L, GPULightCull &C)
+{
+	C.type_flags = L.type_flags;
+	C.direction  = oct_encode(L.direction);
+	C.tangent    = 0;
+	C.shape      = 0;
+	C.position   = L.position;
+	C.radius     = L.affect_radius;
+
+	if(L.intensity < 1e-1f)
+		C.type_flags &= ~LIGHT_ENABLED;
+
+	switch(GET_LIGHT_TYPE(L))
+	{
+	case LightType::Directional:
+		C.position = glm::vec3(0);
+		C.radius   = 0;
+	break;
+	case LightType::Spot:
+		if(L.spot_bounds_radius > 0)
+		{
+			// tighter bounds, along the spot's direction
+			C.position = L.position + L.direction * L.spot_bounds_radius;
+			C.radius   = L.spot_bounds_radius;
+			C.shape    = pack_half2(std::cos(L.outer_angle), std::sin(L.outer_angle));
+		}
+	break;
+	case LightType::Rect:
+	{
+		const auto right = glm::vec3(L.shape_data[0] - L.shape_data[1]) * 0.5f;
+		const auto up    = glm::vec3(L.shape_data[2] - L.shape_data[0]) * 0.5f;
+		const auto half_width  = glm::length(right);
+		const auto half_height = glm::length(up);
+		if(half_width > 0 and half_height > 0)
+		{
+			// the emitting side (see the winding in ltcEvaluate()), i.e. as a disc light's direction
+			C.direction = oct_encode(glm::normalize(glm::cross(up, right)));
+			C.tangent   = oct_encode(right / half_width);
+			C.shape     = pack_half2(half_width, half_height);
+			C.radius    = L.affect_radius + std::sqrt(half_width*half_width + half_height*half_height);
+		}
+	}
+	break;
+	case LightType::Disc:
+	{
+		// same basis as calcDiscLight()
+		auto orthogonal = glm::vec3(0, 1, 0);
+		if(orthogonal == L.direction)
+			orthogonal = glm::vec3(0, 0, 1);
+		const auto right  = glm::cross(L.direction, orthogonal);
+		const auto radius = L.shape_data[0].x;
+		if(glm::length(right) > 0 and radius > 0)
+		{
+			C.tangent = oct_encode(glm::normalize(right));
+			C.shape   = pack_half2(radius, radius);
+			C.radius  = L.affect_radius + radius * std::numbers::sqrt2_v<float>;
+		}
+	}
+	break;
+	case LightType::Tube:
+	{
+		const auto half_extent = glm::vec3(L.shape_data[0]);
+		const auto half_length = glm::length(half_extent);
+		const auto half_thickness = L.shape_data[2].x * 0.5f;
+		if(half_length > 0)
+		{
+			C.direction = oct_encode(half_extent / half_length);
+			C.shape     = pack_half2(half_length, half_thickness);
+			C.radius    = L.affect_radius + half_length + half_thickness;
+		}
+	}
+	break;
+	default:
+	break;
+	}
+}
+
+// cluster light ranges; GLSL: pack_cluster_range() & unpack_cluster_range()
+#if CLUSTER_COMPACT_LIGHTS
+using ClusterLightRange = PackedIndexRange;
+
+inline PackedIndexRange pack_cluster_range(uint32_t start_index, uint32_t count)
+{
+	return { (start_index << CLUSTER_RANGE_COUNT_BITS) | std::min(count, CLUSTER_RANGE_COUNT_MASK) };
+}
+
+inline IndexRange unpack_cluster_range(const PackedIndexRange &range)
+{
+	return { range.start_count >> CLUSTER_RANGE_COUNT_BITS, range.start_count & CLUSTER_RANGE_COUNT_MASK };
+}
+#else
+using ClusterLightRange = IndexRange;
+
+inline IndexRange pack_cluster_range(uint32_t start_index, uint32_t count)
+{
+	return { start_index, count };
+}
+
+inline IndexRange unpack_cluster_range(const IndexRange &range)
+{
+	return range;
+}
+#endif
+
+} // RGL::lights
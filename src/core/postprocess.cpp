@@ -1,6 +1,21 @@
-// #include "postprocess.h"
+#include "postprocess.h"
+
+#include <cassert>
 
 namespace RGL::PP
 {
 
+RenderTargetPool *PostProcess::s_target_pool { nullptr };
+
+void PostProcess::setTargetPool(RenderTargetPool &pool)
+{
+	s_target_pool = &pool;
+}
+
+RenderTargetPool &PostProcess::targetPool()
+{
+	assert(s_target_pool);
+	return *s_target_pool;
+}
+
 } // RGL
@@ -1,5 +1,10 @@
 #pragma once
 
+namespace RGL
+{
+class RenderTargetPool;
+}
+
 namespace RGL::RenderTarget
 {
 class Texture2d;
@@ -18,8 +23,14 @@ public:
 
 	virtual void render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out) = 0;
 
+	// where the effects get their temporary render targets; must be set before any render()
+	static void setTargetPool(RenderTargetPool &pool);
+	static RenderTargetPool &targetPool();
+
 private:
 	bool _enabled { true };
+
+	static RenderTargetPool *s_target_pool;
 };
 
 } // RGL::PP
@@ -28,6 +28,10 @@ bool Bloom::create()
 	assert(_upscale_shader);
 	_upscale_shader.setPostBarrier(Shader::Barrier::Image | Shader::Barrier::Texture);
 
+	_single_pass.create();
+	assert(_single_pass);
+	_single_pass.setKarisAverage(true);
+
 	_dirt_texture.Load(FileSystem::getResourcesPath() / "textures" / "bloom_dirt_mask.jxl");
 	assert(_dirt_texture);
 
@@ -38,10 +42,23 @@ static constexpr auto IMAGE_UNIT_WRITE = 0;
 
 Bloom::operator bool() const
 {
-	return _upscale_shader and _downscale_shader and _dirt_texture;
+	return _upscale_shader and _downscale_shader and _single_pass and _dirt_texture;
 }
 
 void Bloom::render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out)
+{
+	if(_single_pass_downscale)
+	{
+		_single_pass.setThreshold(_threshold, _knee);
+		_single_pass.render(in, out);
+	}
+	else
+		downscale(in, out);
+
+	upscale(in, out);
+}
+
+void Bloom::downscale(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out)
 {
 	// Bloom: downscale
 	_downscale_shader.bind();
@@ -67,7 +84,6 @@ void Bloom::render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &o
 	// if(not printed)
 	// 	std::printf("PP mip_levels: %d\n", in.mip_levels());
 
-	// TODO: couldn't these loops be made entirely in the compute shader, i.e. binding all mips at once
 	for (auto idx = 0u; idx < in.mip_levels() - mip_cap; ++idx)
 	{
 		// if(not printed)
@@ -88,12 +104,19 @@ void Bloom::render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &o
 
 		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT); // GL_TEXTURE_UPDATE_BARRIER_BIT ?
 	}
+}
+
+void Bloom::upscale(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out)
+{
+	static constexpr auto mip_cap = 1u;
+	glm::uvec2 mip_size;
 
 	// Bloom: upscale
 	_upscale_shader.bind();
 	_upscale_shader.setUniform("u_bloom_intensity"sv, _intensity);
 	_upscale_shader.setUniform("u_dirt_intensity"sv,  _dirt_intensity);
 	// m_tmo_ps->bindTextureSampler();
+	in.bindTextureSampler();
 	_dirt_texture.Bind(1);
 
 	for (auto idx = in.mip_levels() - mip_cap; idx >= mip_cap; --idx)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "postprocess.h"
+#include "pp_single_pass_downsample.h"
 
 #include "shader.h"
 #include "texture.h"
@@ -19,18 +20,27 @@ public:
 	inline void setIntensity(float intensity) { _intensity = intensity;}
 	inline void setKnee(float knee) { _knee = knee; }
 	inline void setDirtIntensity(float intensity) { _dirt_intensity = intensity; }
+	// all downscale levels in one dispatch (a luma weighted box filter), instead of the 13-tap filter per level
+	inline void setSinglePassDownscale(bool enabled) { _single_pass_downscale = enabled; }
+	inline bool singlePassDownscale() const { return _single_pass_downscale; }
 
 	void render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out) override;
 
+private:
+	void downscale(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out);
+	void upscale(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out);
+
 private:
 	Shader _downscale_shader;
 	Shader _upscale_shader;
 	Texture2D _dirt_texture;
+	SinglePassDownsample _single_pass;
 
 	float _threshold      { 0.8f };
 	float _intensity      { 1.5f };
 	float _knee           { 0.1f };
 	float _dirt_intensity { 0.1f };
+	bool  _single_pass_downscale { false };  // until its quality was compared to the 13-tap filter
 };
 
 } // RGL::PP
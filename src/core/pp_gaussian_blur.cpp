@@ -1,11 +1,13 @@
 #include "pp_gaussian_blur.h"
 
+#include "rendertarget_pool.h"
+
 using namespace std::literals;
 
 namespace RGL::PP
 {
 
-bool Blur::create(size_t width, size_t height)
+bool Blur::create()
 {
 	new (&_blur_horizontal) Shader("resources/shaders/gaussian_blur_parametric.comp", string_set{ "HORIZONTAL"s });
 	_blur_horizontal.link();
@@ -15,15 +17,12 @@ bool Blur::create(size_t width, size_t height)
 	_blur_vertical.link();
 	_blur_vertical.setPostBarrier(Shader::Barrier::Image);
 
-	_temp.create("blur-temp", width, height, RenderTarget::Color::Default, RenderTarget::Depth::None);
-	_temp.SetFiltering(TextureFiltering::Minify, TextureFilteringParam::LinearMipNearest);
-
-	return false;
+	return *this;
 }
 
 Blur::operator bool() const
 {
-	return _blur_horizontal and _blur_vertical and _temp;
+	return _blur_horizontal and _blur_vertical;
 }
 
 void Blur::setSigma(float sigma)
@@ -95,18 +94,22 @@ void Blur::render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &ou
 {
 	static constexpr size_t group_size = 64; // MAX_SIZE + 1 in shader code
 
+	auto &pool = targetPool();
+	auto &temp = pool.acquire({ .size = in.size(), .color = RenderTarget::Color::Default }, "blur-temp"sv);
 
 	// horizontal
 	in.bindImageRead(0);
-	_temp.bindImage(1, ImageAccess::Write);
+	temp.bindImage(1, ImageAccess::Write);
 
 	_blur_horizontal.invoke((in.width() + group_size - 1) / group_size, in.height());
 
 	// vertical
-	_temp.bindImageRead(0);
+	temp.bindImageRead(0);
 	out.bindImage(1, ImageAccess::Write);
 
 	_blur_vertical.invoke(in.width(), (in.height() + group_size - 1) / group_size, 1);
+
+	pool.release(temp);
 }
 
 } // RGL::PP
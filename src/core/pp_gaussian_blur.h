@@ -12,11 +12,12 @@ namespace RGL::PP
 class Blur : public PostProcess
 {
 public:
-	bool create(size_t width, size_t height);
+	bool create();
 	operator bool () const override;
 
 	void setSigma(float radius);
 
+	// the intermediate target is taken from the target pool, i.e. any size works
 	void render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out) override;
 
 private:
@@ -25,7 +26,6 @@ private:
 private:
 	Shader _blur_horizontal;
 	Shader _blur_vertical;
-	RenderTarget::Texture2d _temp;
 
 	static constexpr auto MAX_WEIGHTS = 33;  // MAX_SIZE + 1 in shader code
 
@@ -2,6 +2,7 @@
 
 #include "filesystem.h"
 #include "log.h"
+#include "rendertarget_pool.h"
 #include "zstr.h"
 
 using namespace std::literals;
@@ -9,7 +10,7 @@ using namespace std::literals;
 namespace RGL::PP
 {
 
-bool _blur_fixed_init(size_t width, size_t height, float sigma, Shader &horizontal, Shader &vertical, RenderTarget::Texture2d &temp)
+bool _blur_fixed_init(float sigma, Shader &horizontal, Shader &vertical)
 {
 	assert(sigma == 1.f or sigma == 1.5f or sigma == 2.f or sigma == 3.f);
 
@@ -62,16 +63,16 @@ bool _blur_fixed_init(size_t width, size_t height, float sigma, Shader &horizont
 	assert(bool(horizontal));
 	horizontal.setPostBarrier(Shader::Barrier::Image);
 
-	temp.create("blur temp", width, height, RenderTarget::Color::HalfFloat | RenderTarget::Color::Texture, RenderTarget::Depth::None);
-	temp.SetFiltering(TextureFiltering::Minify, TextureFilteringParam::LinearMipNearest);
-
-	return false;
+	return horizontal and vertical;
 }
 
-void _blur_fixed_render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out, Shader &horizontal, Shader &vertical, RenderTarget::Texture2d &temp)
+void _blur_fixed_render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out, Shader &horizontal, Shader &vertical)
 {
 	static constexpr size_t group_size = 64; // MAX_SIZE + 1 in shader code
 
+	auto &pool = PostProcess::targetPool();
+	auto &temp = pool.acquire({ .size = in.size(), .color = RenderTarget::Color::HalfFloat | RenderTarget::Color::Texture }, "blur-temp"sv);
+
 	// horizontal
 	in.bindImageRead(0);
 	temp.bindImage(1, ImageAccess::Write);
@@ -83,6 +84,8 @@ void _blur_fixed_render(const RenderTarget::Texture2d &in, RenderTarget::Texture
 	out.bindImage(1, ImageAccess::Write);
 
 	vertical.invoke(in.width(), (in.height() + group_size - 1) / group_size);
+
+	pool.release(temp);
 }
 
 } // RGL::PP
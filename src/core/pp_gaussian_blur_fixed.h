@@ -9,8 +9,8 @@
 namespace RGL::PP
 {
 
-bool _blur_fixed_init(size_t width, size_t height, float sigma, Shader &horizontal, Shader &vertical, RenderTarget::Texture2d &temp);
-void _blur_fixed_render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out, Shader &horizontal, Shader &vertical, RenderTarget::Texture2d &temp);
+bool _blur_fixed_init(float sigma, Shader &horizontal, Shader &vertical);
+void _blur_fixed_render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out, Shader &horizontal, Shader &vertical);
 
 template<float Sigma>
 class BlurFixed : public PostProcess
@@ -19,33 +19,33 @@ public:
 	static_assert(Sigma == 1.0f or Sigma == 1.5f or Sigma == 2.0f or Sigma == 3.0f);
 
 public:
-	bool create(size_t width, size_t height);
+	bool create();
 	operator bool () const override;
 
+	// the intermediate target is taken from the target pool, i.e. any size works
 	void render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out) override;
 
 private:
 	Shader _blur_horizontal;
 	Shader _blur_vertical;
-	RenderTarget::Texture2d _temp;
 };
 
 template<float Sigma>
 inline BlurFixed<Sigma>::operator bool() const
 {
-	return _blur_horizontal and _blur_vertical and _temp;
+	return _blur_horizontal and _blur_vertical;
 }
 
 template<float Sigma>
-inline bool BlurFixed<Sigma>::create(size_t width, size_t height)
+inline bool BlurFixed<Sigma>::create()
 {
-	return _blur_fixed_init(width, height, Sigma, _blur_horizontal, _blur_vertical, _temp);
+	return _blur_fixed_init(Sigma, _blur_horizontal, _blur_vertical);
 }
 
 template<float Sigma>
 inline void BlurFixed<Sigma>::render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out)
 {
-	_blur_fixed_render(in, out, _blur_horizontal, _blur_vertical, _temp);
+	_blur_fixed_render(in, out, _blur_horizontal, _blur_vertical);
 }
 
 } // RGL::PP
@@ -0,0 +1,145 @@
+#include "pp_gaussian_blur_tiled.h"
+
+#include "filesystem.h"
+#include "log.h"
+#include "rendertarget_pool.h"
+#include "zstr.h"
+
+#include <cassert>
+#include <format>
+
+using namespace std::literals;
+
+namespace RGL::PP
+{
+
+static constexpr uint32_t s_tile_size { 16 };   // TILE in shader code (fused)
+static constexpr uint32_t s_line_size { 128 };  // LINE in shader code
+
+static std::string float_list(std::span<const float> values)
+{
+	std::string list;
+	for(const auto value: values)
+	{
+		if(not list.empty())
+			list += ", ";
+		list += std::format("{:.8f}", value);
+	}
+	return list;
+}
+
+bool _blur_tiled_init(const BlurTiledKernel &kernel, BlurTiledShaders &shaders)
+{
+	assert(kernel.weights.size() == kernel.radius + 1);
+	assert(kernel.folded_offsets.size() == kernel.folded_weights.size());
+
+	string_set conditionals {
+		std::format("BLUR_RADIUS {}", kernel.radius),
+		std::format("BLUR_WEIGHTS {}", float_list(kernel.weights)),
+		std::format("BLUR_NUM_FOLDED {}", kernel.folded_weights.size()),
+		std::format("BLUR_FOLDED_OFFSETS {}", float_list(kernel.folded_offsets)),
+		std::format("BLUR_FOLDED_WEIGHTS {}", float_list(kernel.folded_weights)),
+	};
+
+	Log::debug("[PP Gaussian blur tiled] Conditionals:\n  {}", zstr::join(conditionals.begin(), conditionals.end(), "\n  "sv));
+
+	const auto shader_dir = FileSystem::getResourcesPath() / "shaders";
+
+	auto make_shader = [&shader_dir, &conditionals](Shader &shader, std::string_view mode, bool rgba32f) {
+		auto defines = conditionals;
+		if(not mode.empty())
+			defines.insert(std::string(mode));
+		if(rgba32f)
+			defines.insert("BLUR_FORMAT_RGBA32F");
+
+		new (&shader) Shader(shader_dir / "gaussian_blur_tiled.comp", defines);
+		shader.link();
+		assert(bool(shader));
+		shader.setPostBarrier(Shader::Barrier::Image | GL_TEXTURE_FETCH_BARRIER_BIT);
+	};
+
+	bool ok = true;
+
+	for(auto format = 0u; format < 2; ++format)
+	{
+		const bool rgba32f = format == 1;
+
+		make_shader(shaders.horizontal[format], "BLUR_HORIZONTAL"sv, rgba32f);
+		make_shader(shaders.vertical[format], ""sv, rgba32f);
+		ok = ok and shaders.horizontal[format] and shaders.vertical[format];
+
+		// the shared rows grow with the radius; not worth it for large radii
+		if(kernel.radius <= s_blur_tiled_max_fused_radius)
+		{
+			make_shader(shaders.fused[format], "BLUR_FUSED"sv, rgba32f);
+			ok = ok and shaders.fused[format];
+		}
+	}
+
+	if(not shaders.sampler)
+	{
+		shaders.sampler.Create();  // clamps to edge
+		shaders.sampler.SetFiltering(TextureFiltering::Minify, TextureFilteringParam::Linear);
+	}
+
+	return ok;
+}
+
+bool _blur_tiled_valid(const BlurTiledShaders &shaders, bool with_fused)
+{
+	if(shaders.sampler.sampler_id() == 0)
+		return false;
+
+	for(auto format = 0u; format < 2; ++format)
+	{
+		if(not shaders.horizontal[format] or not shaders.vertical[format])
+			return false;
+		if(with_fused and not shaders.fused[format])
+			return false;
+	}
+
+	return true;
+}
+
+void _blur_tiled_render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out, BlurTiledShaders &shaders, bool fused)
+{
+	assert(out.color_format() == GL_RGBA16F or out.color_format() == GL_RGBA32F);
+	const auto format = out.color_format() == GL_RGBA32F? 1u: 0u;
+
+	const auto width = in.width();
+	const auto height = in.height();
+
+	shaders.sampler.Bind(0);
+
+	// in-place can't be fused; the tiles' aprons would read pixels already written by other work groups
+	if(fused and shaders.fused[format] and &in != &out)
+	{
+		in.bindTextureSampler(0);
+		out.bindImage(1, ImageAccess::Write);
+
+		shaders.fused[format].invoke((width + s_tile_size - 1) / s_tile_size, (height + s_tile_size - 1) / s_tile_size);
+		glBindSampler(0, 0);
+		return;
+	}
+
+	auto &pool = PostProcess::targetPool();
+	const auto temp_color = (format == 1? RenderTarget::Color::Float: RenderTarget::Color::HalfFloat) | RenderTarget::Color::Texture;
+	auto &temp = pool.acquire({ .size = in.size(), .color = temp_color }, "blur-temp"sv);
+
+	// horizontal
+	in.bindTextureSampler(0);
+	temp.bindImage(1, ImageAccess::Write);
+
+	shaders.horizontal[format].invoke((width + s_line_size - 1) / s_line_size, height);
+
+	// vertical
+	temp.bindTextureSampler(0);
+	out.bindImage(1, ImageAccess::Write);
+
+	shaders.vertical[format].invoke(width, (height + s_line_size - 1) / s_line_size);
+
+	glBindSampler(0, 0);
+	pool.release(temp);
+}
+
+} // RGL::PP
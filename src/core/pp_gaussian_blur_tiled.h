@@ -0,0 +1,99 @@
+#pragma once
+
+#include "postprocess.h"
+
+#include "blur_kernel.h"
+#include "rendertarget_2d.h"
+#include "shader.h"
+
+#include <array>
+#include <span>
+
+
+namespace RGL::PP
+{
+
+/*
+ Gaussian blur using shared memory tiles (see gaussian_blur_tiled.comp).
+
+   Each work group loads its pixels, plus the kernel's apron, once into shared memory and
+   the taps are then read from there, instead of one texture fetch per tap.
+   For small radii, both directions are blurred in a single (fused) pass, where the horizontal
+   taps are folded into bilinear fetches (i.e. half the fetches), otherwise two passes via a
+   temporary target from the target pool.
+*/
+
+static constexpr uint32_t s_blur_tiled_max_fused_radius = 6;
+
+struct BlurTiledShaders
+{
+	// [rgba16f, rgba32f]
+	std::array<Shader, 2> fused;
+	std::array<Shader, 2> horizontal;
+	std::array<Shader, 2> vertical;
+	// linear, clamp to edge; the folded (bilinear) taps depend on it, regardless of the input's own sampling state
+	TextureSampler sampler;
+};
+
+struct BlurTiledKernel
+{
+	uint32_t radius;
+	std::span<const float> weights;
+	std::span<const float> folded_offsets;
+	std::span<const float> folded_weights;
+};
+
+bool _blur_tiled_init(const BlurTiledKernel &kernel, BlurTiledShaders &shaders);
+bool _blur_tiled_valid(const BlurTiledShaders &shaders, bool with_fused);
+void _blur_tiled_render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out, BlurTiledShaders &shaders, bool fused);
+
+template<float Sigma>
+class BlurTiled : public PostProcess
+{
+public:
+	static_assert(Sigma == 1.0f or Sigma == 1.5f or Sigma == 2.0f or Sigma == 3.0f);
+
+	static constexpr auto kernel = blur_kernel::make<Sigma>();
+	static constexpr uint32_t radius = blur_kernel::radius(Sigma);
+	static constexpr bool can_fuse = radius <= s_blur_tiled_max_fused_radius;
+
+public:
+	bool create();
+	operator bool () const override;
+
+	// fused H+V pass (if the radius allows); otherwise two passes
+	inline void setFused(bool fused=true) { _fused = fused and can_fuse; }
+	inline bool fused() const { return _fused; }
+
+	// the intermediate target (if any) is taken from the target pool, i.e. any size works
+	void render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out) override;
+
+private:
+	BlurTiledShaders _shaders;
+	bool _fused { can_fuse };
+};
+
+template<float Sigma>
+inline BlurTiled<Sigma>::operator bool() const
+{
+	return _blur_tiled_valid(_shaders, can_fuse);
+}
+
+template<float Sigma>
+inline bool BlurTiled<Sigma>::create()
+{
+	return _blur_tiled_init({
+		.radius = radius,
+		.weights = kernel.weights,
+		.folded_offsets = kernel.folded_offsets,
+		.folded_weights = kernel.folded_weights,
+	}, _shaders);
+}
+
+template<float Sigma>
+inline void BlurTiled<Sigma>::render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out)
+{
+	_blur_tiled_render(in, out, _shaders, _fused);
+}
+
+} // RGL::PP
@@ -12,12 +12,14 @@ bool MipmapBlur::create()
 	assert(_downscale_blur);
 	_downscale_blur.setPostBarrier(Shader::Barrier::Image);
 
-	return bool(_downscale_blur);
+	_mip_generator.create();
+
+	return bool(_downscale_blur) and bool(_mip_generator);
 }
 
 MipmapBlur::operator bool() const
 {
-	return _downscale_blur;
+	return _downscale_blur and _mip_generator;
 }
 
 void MipmapBlur::setLevelLimit(size_t limit)
@@ -67,9 +69,8 @@ void MipmapBlur::render(const RenderTarget::Texture2d &in, RenderTarget::Texture
 {
 	static constexpr size_t group_size = 16;
 
-	// TODO: 'in' must have a complete mip-map pyramid!
-	// const_cast<RenderTarget::Texture2d *>(&in)->color_texture().GenerateMipMaps();
-	assert(false);
+	// 'in' must have a complete mip-map pyramid
+	_mip_generator.generate(in);
 
 	in.bindTextureSampler();
 	out.bindImage(1, ImageAccess::Write);
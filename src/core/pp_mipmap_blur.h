@@ -1,6 +1,7 @@
 #pragma once
 
 #include "postprocess.h"
+#include "pp_single_pass_downsample.h"
 
 #include "rendertarget_2d.h"
 // #include "rendertarget_3d.h"
@@ -27,6 +28,7 @@ private:
 
 private:
 	Shader _downscale_blur;
+	SinglePassDownsample _mip_generator;
 
 	static constexpr auto MAX_WEIGHTS = 16u;  // MAX_SIZE + 1 in shader code
 
@@ -0,0 +1,132 @@
+#include "pp_single_pass_downsample.h"
+
+#include "buffer_binds.h"
+#include "filesystem.h"
+
+#include <glm/common.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <format>
+
+using namespace std::literals;
+
+namespace RGL::PP
+{
+
+static constexpr uint32_t s_tile_size { 64 };   // source texels per work group (per axis)
+static constexpr uint32_t s_tile_levels { 6 };  // i.e. 64x64 -> 1x1
+
+SinglePassDownsample::SinglePassDownsample() :
+	_counter("spd-counter"sv)
+{
+}
+
+bool SinglePassDownsample::create()
+{
+	const auto shader_dir = FileSystem::getResourcesPath() / "shaders";
+
+	// the levels are bound to separate image units, as an image array of the compute shader
+	GLint image_units { 0 };
+	glGetIntegerv(GL_MAX_IMAGE_UNITS, &image_units);
+	GLint compute_images { 0 };
+	glGetIntegerv(GL_MAX_COMPUTE_IMAGE_UNIFORMS, &compute_images);
+	_levels_per_dispatch = std::min({ MAX_LEVELS, uint32_t(image_units), uint32_t(compute_images) });
+	assert(_levels_per_dispatch >= s_tile_levels);
+
+	static constexpr std::array<std::string_view, s_formats.size()> format_defines { "SPD_FORMAT_RGBA32F"sv, "SPD_FORMAT_RGBA16F"sv, "SPD_FORMAT_RG16F"sv };
+
+	for(auto idx = 0u; idx < s_formats.size(); ++idx)
+	{
+		auto &shader = _shaders[idx];
+		new (&shader) Shader(shader_dir / "downsample_spd.comp", string_set{
+			std::string(format_defines[idx]),
+			std::format("SPD_MAX_LEVELS {}", _levels_per_dispatch),
+		});
+		shader.link();
+		assert(shader);
+		shader.setPostBarrier(Shader::Barrier::Image | GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	// reset by the shader, after each dispatch
+	_counter.set(std::array{ 0u });
+	_counter.bindAt(SSBO_BIND_SPD_COUNTER);
+
+	return *this;
+}
+
+SinglePassDownsample::operator bool() const
+{
+	return std::ranges::all_of(_shaders, [](const auto &shader) { return bool(shader); });
+}
+
+void SinglePassDownsample::setThreshold(float threshold, float knee)
+{
+	_use_threshold = true;
+	_threshold = { threshold, threshold - knee, 2.f * knee, 0.25f * knee };
+}
+
+void SinglePassDownsample::render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out)
+{
+	downsample(in, out);
+}
+
+void SinglePassDownsample::generate(const RenderTarget::Texture2d &rt)
+{
+	downsample(rt, rt);
+}
+
+void SinglePassDownsample::downsample(const RenderTarget::Texture2d &in, const RenderTarget::Texture2d &out)
+{
+	auto *spd = shader(out.color_format());
+	assert(spd);
+	if(not spd or out.mip_levels() < 2)
+		return;
+
+	assert(in.width() == out.width() and in.height() == out.height());
+
+	spd->setUniform("u_threshold"sv, _threshold);
+
+	// normally a single dispatch; more if the chain is longer than the image units allow
+	//   (or the source is larger than 4096, the last work group only reduces up to 64x64 tiles)
+	uint32_t source_level = 0;
+	bool first = true;
+
+	while(source_level + 1u < out.mip_levels())
+	{
+		const auto source_size = glm::max(out.size() >> source_level, glm::uvec2(1));
+		const auto num_groups = (source_size + (s_tile_size - 1)) / s_tile_size;
+
+		auto num_levels = std::min(uint32_t(out.mip_levels()) - 1 - source_level, _levels_per_dispatch);
+		if(num_groups.x > s_tile_size or num_groups.y > s_tile_size)
+			num_levels = std::min(num_levels, s_tile_levels);
+
+		// the following dispatches continue from the last level written
+		(first? in: out).bindTextureSampler(0);
+		for(auto level = 0u; level < num_levels; ++level)
+			out.bindImage(level, ImageAccess::ReadWrite, source_level + 1 + level);
+
+		spd->setUniform("u_source_level"sv, int(source_level));
+		spd->setUniform("u_num_levels"sv, num_levels);
+		spd->setUniform("u_num_groups"sv, num_groups.x * num_groups.y);
+		spd->setUniform("u_use_threshold"sv, _use_threshold and source_level == 0);
+		spd->setUniform("u_karis_average"sv, _karis_average and source_level == 0);
+
+		spd->invoke(num_groups.x, num_groups.y);
+
+		source_level += num_levels;
+		first = false;
+	}
+}
+
+Shader *SinglePassDownsample::shader(GLenum format)
+{
+	for(auto idx = 0u; idx < s_formats.size(); ++idx)
+	{
+		if(s_formats[idx] == format)
+			return &_shaders[idx];
+	}
+	return nullptr;
+}
+
+} // RGL::PP
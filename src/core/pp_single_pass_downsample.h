@@ -0,0 +1,66 @@
+#pragma once
+
+#include "postprocess.h"
+
+#include "rendertarget_2d.h"
+#include "shader.h"
+#include "ssbo.h"
+
+#include <glm/vec4.hpp>
+
+#include <array>
+
+
+namespace RGL::PP
+{
+
+/*
+ Builds a mip chain in a single dispatch (SPD style), instead of one dispatch (and barrier) per level.
+
+   Each work group reduces a 64x64 tile (6 levels) in shared memory, and the last work group to finish
+   reduces the tiles' results to the remaining levels (i.e. up to 12 levels, a 4096 source, per dispatch).
+   A level is a 2x2 box filter, optionally luma weighted (for bloom).
+
+   Supports the RGBA32F, RGBA16F and RG16F render targets.
+   If the GL implementation has fewer than 12 image units, longer chains take more than one dispatch.
+*/
+class SinglePassDownsample : public PostProcess
+{
+public:
+	static constexpr uint32_t MAX_LEVELS = 12;
+
+	SinglePassDownsample();
+
+	bool create();
+	operator bool () const override;
+
+	// luma weighted average of the first level [Karis2013]; reduces fireflies
+	inline void setKarisAverage(bool enabled) { _karis_average = enabled; }
+	// bloom's soft threshold, applied to the first level only
+	void setThreshold(float threshold, float knee);
+	inline void clearThreshold() { _use_threshold = false; }
+
+	// 'in' level 0 -> 'out' levels 1 .. N; 'in' and 'out' may be the same render target
+	void render(const RenderTarget::Texture2d &in, RenderTarget::Texture2d &out) override;
+	// completes the mip chain of 'rt', from its level 0
+	void generate(const RenderTarget::Texture2d &rt);
+
+	inline uint32_t levelsPerDispatch() const { return _levels_per_dispatch; }
+
+private:
+	void downsample(const RenderTarget::Texture2d &in, const RenderTarget::Texture2d &out);
+	Shader *shader(GLenum format);
+
+private:
+	static constexpr std::array<GLenum, 3> s_formats { GL_RGBA32F, GL_RGBA16F, GL_RG16F };
+	std::array<Shader, s_formats.size()> _shaders;
+	buffer::Storage<uint32_t> _counter;
+
+	uint32_t _levels_per_dispatch { MAX_LEVELS };  // limited by the number of image units
+
+	bool _karis_average { false };
+	bool _use_threshold { false };
+	glm::vec4 _threshold { 0 };
+};
+
+} // RGL::PP
@@ -5,10 +5,14 @@
 #include "camera.h"
 #include "texture.h"
 #include "filesystem.h"
+#include "light_manager.h"
 
 #include "light_constants.h"
 #include "buffer_binds.h"
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <array>
 
 using namespace std::literals;
 
@@ -18,14 +22,28 @@ namespace RGL::PP
 static constexpr glm::uvec3 s_froxels { FROXEL_GRID_W, FROXEL_GRID_H, FROXEL_GRID_D };
 static constexpr glm::uvec3 s_local_size { FROXEL_THREADS_X, FROXEL_THREADS_Y, FROXEL_THREADS_Z };
 
+static constexpr glm::uvec3 s_cache_bricks { VOLUMETRIC_CACHE_BRICKS_XZ, VOLUMETRIC_CACHE_BRICKS_Y, VOLUMETRIC_CACHE_BRICKS_XZ };
+static constexpr float s_cache_brick_size { float(VOLUMETRIC_CACHE_TEXEL_SIZE * VOLUMETRIC_CACHE_BRICK_TEXELS) };
+// a light is cached when it hasn't changed for this many LightManager::flush()es
+static constexpr uint64_t s_cache_settle_generations { 30 };
+
 Volumetrics::Volumetrics() :
 	_all_volumetric_lights("volumetric-lights"sv),  // list subset of all position-relevant lights that affect volumetrics
 	_all_tile_lights("volumetric-all-tile-lights"sv),  // index list of all lights assigned to affect 2d tiles
-	_tile_lights_ranges("volumetric-tile-light-ranges"sv)  // index list per 2d tile of lights that affect them
+	_tile_lights_ranges("volumetric-tile-light-ranges"sv),  // index list per 2d tile of lights that affect them
+	_cache_grid(s_cache_bricks, s_cache_brick_size),
+	_cached_mask_ssbo("volumetric-cached-lights-mask"sv),    // a bit per light index; set if the light is cached
+	_cached_index_ssbo("volumetric-cached-lights"sv),        // count + index list of the cached lights (for baking)
+	_cache_validity_ssbo("volumetric-cache-validity"sv),     // per brick slot of the cache
+	_cache_bake_ssbo("volumetric-cache-bake-bricks"sv)       // the bricks to bake
 {
 	_all_volumetric_lights.bindAt(SSBO_BIND_ALL_VOLUMETRIC_LIGHTS_INDEX);
 	_all_tile_lights.bindAt(SSBO_BIND_VOLUMETRIC_ALL_TILE_LIGHTS_INDEX);
 	_tile_lights_ranges.bindAt(SSBO_BIND_VOLUMETRIC_TILE_LIGHTS_INDEX);
+	_cached_mask_ssbo.bindAt(SSBO_BIND_VOLUMETRIC_CACHED_LIGHTS_MASK);
+	_cached_index_ssbo.bindAt(SSBO_BIND_VOLUMETRIC_CACHED_LIGHTS_INDEX);
+	_cache_validity_ssbo.bindAt(SSBO_BIND_VOLUMETRIC_CACHE_VALIDITY);
+	_cache_bake_ssbo.bindAt(SSBO_BIND_VOLUMETRIC_CACHE_BAKE_BRICKS);
 }
 
 bool Volumetrics::create()
@@ -63,6 +81,12 @@ bool Volumetrics::create()
 	assert(_bake_shader);
 	_bake_shader.setPreBarrier(Shader::Barrier::Image);
 
+	new (&_cache_shader) Shader(shader_dir / "volumetrics_inject.comp", string_set{ "VOLUMETRICS_CACHE_BAKE"s });
+	_cache_shader.link();
+	assert(_cache_shader);
+	_cache_shader.setPreBarrier(Shader::Barrier::SSBO);
+	_cache_shader.setPostBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);  // sampled by the inject pass
+
 
 	_blue_noise.Load("resources/textures/blue-noise.array");
 
@@ -90,6 +114,21 @@ bool Volumetrics::create()
 	_accumulation.SetWrapping(TextureWrappingAxis::V, TextureWrappingParam::ClampToEdge);
 	_accumulation.SetWrapping(TextureWrappingAxis::W, TextureWrappingParam::ClampToEdge);
 
+	// addressed toroidally, i.e. wrapping
+	const auto cache_size = s_cache_bricks * uint32_t(VOLUMETRIC_CACHE_BRICK_TEXELS);
+	for(auto *cache: { &_cache_radiance, &_cache_direction })
+	{
+		cache->Create(cache_size.x, cache_size.y, cache_size.z, GL_RGBA16F);
+		cache->SetFiltering(TextureFiltering::Magnify, TextureFilteringParam::Linear);
+		cache->SetFiltering(TextureFiltering::Minify, TextureFilteringParam::Linear);
+		cache->SetWrapping(TextureWrappingAxis::U, TextureWrappingParam::Repeat);
+		cache->SetWrapping(TextureWrappingAxis::V, TextureWrappingParam::Repeat);
+		cache->SetWrapping(TextureWrappingAxis::W, TextureWrappingParam::Repeat);
+		cache->clear();  // not all slots are baked
+	}
+	_cache_validity_ssbo.resize(_cache_grid.num_slots());
+	_cache_bake_ssbo.resize(VOLUMETRIC_CACHE_MAX_BAKE);
+
 	_all_volumetric_lights.resize(256); // that's a lot :)
 
 	const auto num_tiles = s_froxels.x / FROXELS_PER_TILE * s_froxels.y / FROXELS_PER_TILE;
@@ -106,6 +145,7 @@ Volumetrics::operator bool() const
 		and _inject_shader \
 		and _accumulate_shader \
 		and _bake_shader \
+		and _cache_shader \
 		and _blue_noise;
 }
 
@@ -116,6 +156,123 @@ void Volumetrics::setViewParams(const Camera &camera, float farPlane)   // TODO:
 		_camera.setFarPlane(farPlane);
 }
 
+void Volumetrics::setInterleave(uint32_t interleave)
+{
+	assert(interleave == 1 or interleave == 2 or interleave == 4);
+	_interleave = interleave;
+}
+
+void Volumetrics::setCacheEnabled(bool enabled)
+{
+	if(enabled and not _cache_enabled)
+		_cache_grid.invalidate_all();  // not maintained while disabled
+	_cache_enabled = enabled;
+}
+
+void Volumetrics::updateCache(const LightManager &lights, uint64_t static_generation, const dense_set<LightID> &uncacheable)
+{
+	_cache_stats.baked = 0;
+
+	if(not _cache_enabled)
+	{
+		_cache_stats = {};
+		return;
+	}
+
+	// the scattering fades by the distance (from the camera; when baked, the window's center), i.e. depends on the far plane
+	if(static_generation != _cache_static_generation or _camera.farPlane() != _cache_max_distance)
+	{
+		_cache_grid.invalidate_all();
+		_cache_static_generation = static_generation;
+		_cache_max_distance = _camera.farPlane();
+	}
+
+	_cache_grid.recenter(_camera.position());
+
+	// aggregated lights (see LightManager::set_lod_policy()) are evaluated via their aggregate, i.e. not cached
+	auto cacheable = [&](LightIndex light_index) {
+		const auto &L = lights.at(light_index);
+		const auto light_id = lights.light_id(light_index);
+		return IS_ENABLED(L) and IS_VOLUMETRIC(L) and not IS_DIR_LIGHT(L)
+			and not lights.is_aggregated(light_index)
+			and lights.generation() - lights.changed_generation(light_id) >= s_cache_settle_generations
+			and not uncacheable.contains(light_id);
+	};
+
+	// the light indices change when lights are removed; the mask is rebuilt every time
+	//   it covers the aggregates' indices as well (never cached), i.e. any index the shaders may look up
+	const auto aggregates = lights.aggregate_indices();  // sorted
+	const auto num_indices = aggregates.empty()? lights.size(): size_t(aggregates.back()) + 1;
+	_cached_mask.assign((num_indices + 31) / 32, 0);
+	_cached_index.assign(1, 0);  // the count first
+
+	for(auto light_index = 0u; light_index < lights.size(); ++light_index)
+	{
+		if(not cacheable(light_index))
+			continue;
+
+		const auto &L = lights.at(light_index);
+		// newly cached; the volume it affects must be baked (again)
+		if(const auto [found, added] = _cached_lights.try_emplace(lights.light_id(light_index), L.position, L.affect_radius); added)
+			_cache_grid.invalidate(found->second);
+
+		_cached_mask[light_index >> 5] |= 1u << (light_index & 31);
+		_cached_index.push_back(light_index);
+	}
+	_cached_index[0] = uint32_t(_cached_index.size() - 1);
+
+	// lights that changed (or were removed) are no longer cached; the volume they affected is baked again, without them
+	for(auto iter = _cached_lights.begin(); iter != _cached_lights.end(); )
+	{
+		const auto light_index = lights.contains(iter->first)? lights.light_index(iter->first): NO_LIGHT_INDEX;
+		if(light_index == NO_LIGHT_INDEX or (_cached_mask[light_index >> 5] & (1u << (light_index & 31))) == 0)
+		{
+			_cache_grid.invalidate(iter->second);
+			iter = _cached_lights.erase(iter);
+		}
+		else
+			++iter;
+	}
+
+	if(_cached_mask.empty())
+		_cached_mask.push_back(0);  // an empty buffer can't be bound
+	_cached_mask_ssbo.set(_cached_mask);
+
+	const auto bricks = _cache_grid.take_invalid(VOLUMETRIC_CACHE_MAX_BAKE);
+	if(not bricks.empty())
+	{
+		std::array<glm::ivec4, VOLUMETRIC_CACHE_MAX_BAKE> bake;
+		for(auto idx = 0u; idx < bricks.size(); ++idx)
+			bake[idx] = glm::ivec4(bricks[idx], 0);
+		_cache_bake_ssbo.set(bake.begin(), bake.begin() + ptrdiff_t(bricks.size()));
+		_cached_index_ssbo.set(_cached_index);
+
+		const auto cache_center = (glm::vec3(_cache_grid.origin()) + glm::vec3(s_cache_bricks) / 2.f) * s_cache_brick_size;
+
+		_camera.setUniforms(_cache_shader);
+		_cache_shader.setUniform("u_cam_pos"sv, cache_center);
+		_cache_shader.setUniform("u_fog_anisotropy"sv, 0.f);   // the phase is applied when sampled
+		_cache_shader.setUniform("u_volumetric_max_distance"sv, _camera.farPlane());
+		_cache_shader.setUniform("u_inject_shadow_bias"sv, _shadow_bias);
+		_cache_shader.setUniform("u_cache_origin"sv, _cache_grid.origin());
+		_cache_shader.setUniform("u_cache_origin_slot"sv, glm::ivec3(_cache_grid.slot_coord(_cache_grid.origin())));
+
+		_cache_radiance.BindImage(0, ImageAccess::Write);
+		_cache_direction.BindImage(1, ImageAccess::Write);
+
+		// a work group per brick slice
+		_cache_shader.invoke(1, 1, VOLUMETRIC_CACHE_BRICK_TEXELS * bricks.size());
+
+		_cache_stats.baked = uint32_t(bricks.size());
+	}
+
+	if(_cache_grid.take_validity_changed())
+		_cache_validity_ssbo.set(_cache_grid.validity());
+
+	_cache_stats.lights = _cached_index[0];
+	_cache_stats.invalid = _cache_grid.num_invalid();
+}
+
 void Volumetrics::cull_lights()
 {
 	// first pick the volumetric lights
@@ -160,9 +317,22 @@ void Volumetrics::inject()
 	_inject_shader.setUniform("u_fog_noise_offset"sv, _noise_offset);
 	_inject_shader.setUniform("u_fog_noise_frequency"sv, _noise_freq);
 	_inject_shader.setUniform("u_froxel_blend_previous"sv, _blend_previous);
-	_inject_shader.setUniform("u_froxel_blend_weight"sv, _blend_weight);
+	// a froxel is injected every N frames; i.e. the same convergence rate (per frame) as N = 1
+	_inject_shader.setUniform("u_froxel_blend_weight"sv, std::pow(_blend_weight, float(_interleave)));
+	_inject_shader.setUniform("u_froxel_interleave"sv, _interleave);
+	_inject_shader.setUniform("u_froxel_interleave_phase"sv, _frame % _interleave);
+	_inject_shader.setUniform("u_froxel_history_reject"sv, _history_reject);
 	_inject_shader.setUniform("u_inject_shadow_bias"sv, _shadow_bias);
 
+	_inject_shader.setUniform("u_cache_enabled"sv, _cache_enabled);
+	if(_cache_enabled)
+	{
+		_inject_shader.setUniform("u_cache_origin"sv, _cache_grid.origin());
+		_inject_shader.setUniform("u_cache_origin_slot"sv, glm::ivec3(_cache_grid.slot_coord(_cache_grid.origin())));
+		_cache_radiance.Bind(7);
+		_cache_direction.Bind(8);
+	}
+
 	_inject_shader.setUniform("u_volumetric_max_distance"sv, _camera.farPlane());
 
 	_inject_shader.setUniform("u_view"sv, _camera.viewTransform());
@@ -170,15 +340,23 @@ void Volumetrics::inject()
 	const auto inv_view_projection = glm::inverse(view_projection);
 	_inject_shader.setUniform("u_inv_view_projection"sv, inv_view_projection);
 
-	static glm::mat4 prev_view = _camera.viewTransform();  // use current view the first frame
-	_inject_shader.setUniform("u_prev_view"sv, prev_view);
-	prev_view = _camera.viewTransform(); // next frame: "prev" is from this frame
+	// the froxels' depth distribution depends on the near & far planes
+	const auto near_far = glm::vec2(_camera.nearPlane(), _camera.farPlane());
+	_history_valid = _history_valid and near_far == _prev_near_far;
+	_inject_shader.setUniform("u_froxel_history_valid"sv, _history_valid);
+	_inject_shader.setUniform("u_prev_view_projection"sv, _prev_view_projection);
+	// next frame: "prev" is from this frame
+	_prev_view_projection = view_projection;
+	_prev_near_far = near_far;
+	_history_valid = true;
 
 	_blue_noise.BindLayer(_frame % _blue_noise.num_layers(), 3);
 
+	// a thread per group of N froxels; 1x1, 2x1 or 2x2
+	const auto group_size = glm::uvec2(_interleave >= 2? 2: 1, _interleave == 4? 2: 1);
 	const auto num_groups = glm::uvec3(
-		size_t(std::ceil(float(s_froxels.x) / float(s_local_size.x))),
-		size_t(std::ceil(float(s_froxels.y) / float(s_local_size.y))),
+		size_t(std::ceil(float(s_froxels.x) / float(s_local_size.x * group_size.x))),
+		size_t(std::ceil(float(s_froxels.y) / float(s_local_size.y * group_size.y))),
 		size_t(std::ceil(float(s_froxels.z) / float(s_local_size.z)))
 	);
 
@@ -237,7 +415,7 @@ void Volumetrics::render(const RenderTarget::Texture2d &, RenderTarget::Texture2
 	{
 		if(not _blur3x3)
 		{
-			_blur3x3.create(out.width(), out.height());
+			_blur3x3.create();
 			assert(_blur3x3);
 		}
 		_blur3x3.render(out, out);
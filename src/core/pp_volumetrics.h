@@ -1,16 +1,20 @@
 #pragma once
 
 #include "camera.h"
+#include "container_types.h"
+#include "lights.h"
 #include "postprocess.h"
 #include "pp_gaussian_blur_fixed.h"
 #include "shader.h"
 #include "texture.h"
+#include "volumetric_cache_grid.h"
 
 #include "generated/shared-structs.h"
 
 namespace RGL
 {
 class Camera;
+class LightManager;
 } // RGL
 class ShadowAtlas;
 
@@ -26,6 +30,8 @@ public:
 	operator bool() const override;
 
 	inline Shader &shader() { return _inject_shader; }
+	// bakes the static lights' scattering cache; needs the same (light & shadow) uniforms as shader()
+	inline Shader &cacheShader() { return _cache_shader; }
 
 	inline void setShadowBias(float bias) { _shadow_bias = bias; }
 	inline float shadowBias() const { return _shadow_bias; }
@@ -49,9 +55,33 @@ public:
 	inline void setNoiseFrequency(glm::vec3 freq) { _noise_freq = freq; }
 	inline void setTemporalBlending(bool enable=true) { _blend_previous = enable; }
 	inline void setTemporalBlendWeight(float weight) { _blend_weight = weight; }
+	// inject only 1/N (1, 2 or 4) of the froxels per frame, the others are reprojected from the previous frame
+	void setInterleave(uint32_t interleave);
+	inline uint32_t interleave() const { return _interleave; }
+	// an injected froxel whose value changed more than this (relative) doesn't use the history, nor does its group
+	inline void setHistoryRejection(float max_change) { _history_reject = max_change; }
+	inline float historyRejection() const { return _history_reject; }
+	// e.g. after not being used for a while
+	inline void invalidateHistory() { _history_valid = false; }
 
 	inline void setDensity(float density) { _density = density; }
 
+	// static lights' scattering cache: the (volumetric) lights that haven't changed for a while are baked into
+	//   a low-res, world-aligned volume around the camera, which inject() then samples instead of evaluating them
+	void setCacheEnabled(bool enabled);
+	inline bool cacheEnabled() const { return _cache_enabled; }
+	// the cache is rebuilt when 'static_generation' changes (see Scene::static_generation()),
+	//   lights in 'uncacheable' are never cached (e.g. their shadows have dynamic casters)
+	//   bakes at most VOLUMETRIC_CACHE_MAX_BAKE bricks; call after setViewParams() & before inject()
+	void updateCache(const LightManager &lights, uint64_t static_generation, const dense_set<LightID> &uncacheable);
+	struct CacheStats
+	{
+		uint32_t lights { 0 };   // cached lights
+		uint32_t baked { 0 };    // bricks baked by the last update
+		uint32_t invalid { 0 };  // bricks left to bake
+	};
+	inline const CacheStats &cacheStats() const { return _cache_stats; }
+
 	void setViewParams(const Camera &camera, float farPlane=0.f);
 	void cull_lights();
 	void inject();
@@ -71,6 +101,7 @@ private:
 	Shader _3dblur_shader;
 	Shader _accumulate_shader;
 	Shader _bake_shader;
+	Shader _cache_shader;
 	Texture2DArray _blue_noise;
 	Texture3D _transmittance[2];  // read -> write, or write <- read
 	Texture3D _accumulation;
@@ -78,12 +109,32 @@ private:
 	uint32_t _read_index { 0 };  // ping-pong index into '_accumulation'
 	uint32_t _frame { 0 };
 	Camera _camera;
+	glm::mat4 _prev_view_projection;
+	glm::vec2 _prev_near_far { 0 };
+	bool _history_valid { false };
+	uint32_t _interleave { 1 };
+	float _history_reject { 0.8f };
 
 	buffer::Storage<uint> _all_volumetric_lights;
 	buffer::Storage<uint> _all_tile_lights;
 	buffer::Storage<IndexRange> _tile_lights_ranges;
 	RGL::PP::BlurFixed<3.f> _blur3x3;
 
+	bool _cache_enabled { true };
+	VolumetricCacheGrid _cache_grid;
+	Texture3D _cache_radiance;
+	Texture3D _cache_direction;
+	dense_map<LightID, bounds::Sphere> _cached_lights;  // the bounds it was baked with
+	uint64_t _cache_static_generation { 0 };
+	float _cache_max_distance { 0 };
+	std::vector<uint32_t> _cached_mask;
+	std::vector<uint32_t> _cached_index;
+	buffer::Storage<uint32_t> _cached_mask_ssbo;
+	buffer::Storage<uint32_t> _cached_index_ssbo;
+	buffer::Storage<uint32_t> _cache_validity_ssbo;
+	buffer::Storage<glm::ivec4> _cache_bake_ssbo;
+	CacheStats _cache_stats;
+
 	float _strength { 0.3f };
 	float _anisotropy { 0.2f };  // ~0.7 Thin haze / atmospheric fog
 	float _density { 0.1f };    // small values, less than ~0.2
@@ -0,0 +1,123 @@
+#include "rendertarget_pool.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <format>
+#include <iterator>
+
+namespace RGL
+{
+
+RenderTargetPool::RenderTargetPool(uint32_t max_age) :
+	_max_age(max_age)
+{
+}
+
+RenderTarget::Texture2d &RenderTargetPool::acquire(const Desc &desc, std::string_view name)
+{
+	assert(desc.size.x > 0 and desc.size.y > 0);
+
+	auto found = std::ranges::find_if(_entries, [&desc](const auto &entry) {
+		return not entry->in_use and entry->desc == desc;
+	});
+
+	if(found == _entries.end())
+	{
+		auto entry = std::make_unique<Entry>();
+		entry->desc = desc;
+		entry->name = name.empty()? std::format("pool-{}x{}", desc.size.x, desc.size.y): std::string(name);
+		entry->rt.create(entry->name.c_str(), desc.size.x, desc.size.y, desc.color, desc.depth);
+		++_created;
+
+		Log::debug("rt-pool| created {} ({}x{}, {:.1f} MiB)", entry->name, desc.size.x, desc.size.y, float(estimated_size(desc)) / (1024.f*1024.f));
+
+		_entries.push_back(std::move(entry));
+		found = std::prev(_entries.end());
+	}
+
+	auto &entry = **found;
+	entry.in_use = true;
+	entry.last_used = _frame;
+
+	return entry.rt;
+}
+
+void RenderTargetPool::release(const RenderTarget::Texture2d &rt)
+{
+	auto found = std::ranges::find_if(_entries, [&rt](const auto &entry) { return &entry->rt == &rt; });
+	assert(found != _entries.end() and (*found)->in_use);
+	if(found == _entries.end())
+		return;
+
+	(*found)->in_use = false;
+	(*found)->last_used = _frame;
+}
+
+void RenderTargetPool::next_frame()
+{
+	++_frame;
+
+	const auto evicted = std::erase_if(_entries, [this](const auto &entry) {
+		return not entry->in_use and _frame - entry->last_used > _max_age;
+	});
+	_evicted += uint32_t(evicted);
+}
+
+void RenderTargetPool::trim()
+{
+	_evicted += uint32_t(std::erase_if(_entries, [](const auto &entry) { return not entry->in_use; }));
+}
+
+RenderTargetPool::Stats RenderTargetPool::stats() const
+{
+	Stats stats {
+		.targets = uint32_t(_entries.size()),
+		.in_use = 0,
+		.bytes = 0,
+		.created = _created,
+		.evicted = _evicted,
+	};
+
+	for(const auto &entry: _entries)
+	{
+		if(entry->in_use)
+			++stats.in_use;
+		stats.bytes += estimated_size(entry->desc);
+	}
+
+	return stats;
+}
+
+size_t RenderTargetPool::estimated_size(const Desc &desc)
+{
+	namespace C = RenderTarget::Color;
+	namespace D = RenderTarget::Depth;
+
+	size_t texel_bytes = 0;
+	if(desc.color != C::None)
+	{
+		if(C::is_custom(desc.color))
+			texel_bytes += 8;  // a guess
+		else if((desc.color & C::Float2) == C::Float2)
+			texel_bytes += 4;  // RG16F
+		else if(desc.color & C::Float)
+			texel_bytes += 16; // RGBA32F
+		else if(desc.color & C::HalfFloat)
+			texel_bytes += 8;  // RGBA16F
+		else
+			texel_bytes += 4;  // RGBA8
+	}
+	if(desc.depth != D::None)
+		texel_bytes += 4;      // DEPTH_COMPONENT32F
+
+	auto bytes = size_t(desc.size.x) * desc.size.y * texel_bytes;
+	// textures get mip levels (see RenderTarget::Texture2d::create())
+	if((desc.color & C::Texture) or (desc.depth & D::Texture))
+		bytes += bytes / 3;
+
+	return bytes;
+}
+
+} // RGL
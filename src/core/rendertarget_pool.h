@@ -0,0 +1,90 @@
+#pragma once
+
+#include "rendertarget_2d.h"
+
+#include <glm/vec2.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace RGL
+{
+
+/*
+ A pool of 2d render targets, keyed by their descriptor.
+
+   The color & depth configs determine the formats, whether they're textures (or render buffers)
+   and thereby whether they have mip levels (see RenderTarget::Texture2d::create()).
+
+   A target is acquired for as long as it's needed (e.g. within a render() call, or a frame)
+   and then released back to the pool, to be reused by anyone asking for the same descriptor.
+   The free targets not acquired for 'max_age' frames are released (deleted).
+
+   The targets' sampler state is whatever the previous user left it as;
+   i.e. set it explicitly if it matters.
+*/
+class RenderTargetPool
+{
+public:
+	struct Desc
+	{
+		glm::uvec2 size { 0 };
+		RenderTarget::Color::Config color { RenderTarget::Color::Default };
+		RenderTarget::Depth::Config depth { RenderTarget::Depth::None };
+
+		bool operator == (const Desc &) const = default;
+	};
+
+	struct Stats
+	{
+		uint32_t targets;
+		uint32_t in_use;
+		size_t bytes;
+		// since the pool's creation
+		uint32_t created;
+		uint32_t evicted;
+	};
+
+	static constexpr uint32_t default_max_age { 120 };  // frames
+
+public:
+	explicit RenderTargetPool(uint32_t max_age=default_max_age);
+	RenderTargetPool(const RenderTargetPool &) = delete;
+	RenderTargetPool &operator = (const RenderTargetPool &) = delete;
+
+	// a free render target matching 'desc'; created if there's none ('name' is used only then)
+	[[nodiscard]] RenderTarget::Texture2d &acquire(const Desc &desc, std::string_view name={});
+	void release(const RenderTarget::Texture2d &rt);
+
+	// advances the frame; the free targets not used for 'max_age' frames are released
+	void next_frame();
+	// releases all free targets
+	void trim();
+
+	[[nodiscard]] inline uint64_t frame() const { return _frame; }
+	[[nodiscard]] Stats stats() const;
+
+	// estimated memory footprint of a render target (including its mip levels)
+	[[nodiscard]] static size_t estimated_size(const Desc &desc);
+
+private:
+	struct Entry
+	{
+		Desc desc;
+		std::string name;  // the render target keeps a pointer to it
+		RenderTarget::Texture2d rt;
+		uint64_t last_used { 0 };  // frame
+		bool in_use { false };
+	};
+
+	std::vector<std::unique_ptr<Entry>> _entries;
+	uint64_t _frame { 0 };
+	uint32_t _max_age;
+	uint32_t _created { 0 };
+	uint32_t _evicted { 0 };
+};
+
+} // RGL
@@ -1,6 +1,7 @@
 #include "scene.h"
 
 #include "frustum.h"
+#include "caster_volume.h"
 #include "log.h"
 
 #include <execution>
@@ -56,6 +57,7 @@ void Scene::clear()
 	_entities.clear();
 	// TODO: reset the whatever-tree
 	_spatial_items.clear();
+	++_static_generation;
 
 	// reconnect signals again
 	_connect_signals();
@@ -139,6 +141,20 @@ bool Scene::query(const glm::mat4 &view, const glm::mat4 &ortho, const bounds::A
 	return false;
 }
 
+size_t Scene::cull(QueryResult &result, const CasterVolume &volume) const
+{
+	auto outside = [this, &volume](EntityID entity_id) {
+		return not inside(entity_id, volume);
+	};
+	return std::erase_if(result.static_entities, outside) + std::erase_if(result.dynamic_entities, outside);
+}
+
+bool Scene::inside(EntityID entity_id, const CasterVolume &volume) const
+{
+	auto found = _spatial_items.find(entity_id);
+	return found == _spatial_items.end() or volume.contains(found->second.bounds);
+}
+
 bool Scene::start_query_maybe(QueryResult &result) const
 {
 	const auto now = steady_clock::now();
@@ -185,6 +201,8 @@ void Scene::_spatial_insert(entt::registry &, EntityID entity_id)
 
 	// TODO: component with model meta info
 	_spatial_items[entity_id] = { world_bounds, is_dynamic };
+	if(not is_dynamic)
+		++_static_generation;
 }
 
 void Scene::_spatial_update(entt::registry &e, EntityID entity_id)
@@ -196,7 +214,12 @@ void Scene::_spatial_update(entt::registry &e, EntityID entity_id)
 
 void Scene::_spatial_remove(entt::registry &, EntityID entity_id)
 {
-	_spatial_items.erase(entity_id);
+	const auto found = _spatial_items.find(entity_id);
+	if(found == _spatial_items.end())
+		return;
+	if(not found->second.is_dynamic)
+		++_static_generation;
+	_spatial_items.erase(found);
 }
 
 } // RGL
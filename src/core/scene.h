@@ -17,6 +17,7 @@ class GPULight;
 namespace RGL
 {
 class Frustum;
+class CasterVolume;
 
 struct QueryResult;
 using EntityID = entt::entity;
@@ -64,6 +65,9 @@ public:
 	inline size_t size() const { return _spatial_items.size(); }
 	void clear();
 
+	// incremented whenever a static entity is added, moved or removed (i.e. anything baked from the static scene is stale)
+	inline uint64_t static_generation() const { return _static_generation; }
+
 	bool closest(const    glm::vec3 &point,   QueryResult &result) const;
 
 	bool query(const bounds::Sphere &sphere,  QueryResult &result) const;
@@ -72,6 +76,12 @@ public:
 	bool query(const glm::mat4 &view, const glm::mat4 &ortho, const bounds::AABB &aabb, QueryResult &result) const;
 	// bool query(const bounds::OBB &obb, QueryResult &result);
 
+	// removes the entities outside 'volume' (e.g. casters that can't shadow the view), from a query's result
+	//   returns the number of entities removed
+	size_t cull(QueryResult &result, const CasterVolume &volume) const;
+	// whether the entity is inside 'volume' (unknown entities are)
+	bool inside(EntityID entity_id, const CasterVolume &volume) const;
+
 private:
 	void _connect_signals();
 	void _disconnect_signals();
@@ -98,6 +108,7 @@ private:
 	ItemMap _spatial_items;
 
 	size_t _min_result_reserve { 32 };
+	uint64_t _static_generation { 0 };
 
 	std::array<entt::scoped_connection, 3> _signals;
 };
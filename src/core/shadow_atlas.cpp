@@ -11,8 +11,14 @@
 #include "glm/gtc/epsilon.hpp"
 #include "camera.h"
 #include "scene.h"
+#include "hash_mat4.h"
+#include "hash_vec3.h"
+#include "virtual_shadow_maps.h"
 
+#include <algorithm>
+#include <bit>
 #include <chrono>
+#include <execution>
 #include <ranges>
 #include <string_view>
 #include <format>
@@ -33,9 +39,16 @@ static constexpr float s_min_light_value = 1e-2f;
 
 static const auto s_slot_max_size_shift = 1;
 static constexpr auto s_normal_shadow_shift = 2;  // point & spot shadow maps are shifted N down in size (e.g. from 4096 to 1024)
+static constexpr size_t s_atlas_texel_bytes = 4 + 4;  // D32F + RG16F normals (see create())
 
+// SDSM; the reduction's result is a frame or two old, i.e. pad it a bit
+static constexpr uint32_t s_sdsm_max_age = 8;         // update_csm_params() calls
+static constexpr float s_sdsm_depth_padding = 0.05f;   // fraction of the depth, also the quantization step
+static constexpr float s_sdsm_rect_padding = 0.05f;    // fraction of the rect size
+static constexpr float s_sdsm_split_tolerance = 0.05f; // max relative difference of the splits the samples were binned by
 
-#define SLOT_CONFIG(light_type)   ((light_type) == LightType::Point? SlotConfig::Cube: ((light_type) == LightType::Directional? SlotConfig::Cascades: SlotConfig::Single))
+static constexpr float s_point_band_hysteresis = 0.05f;  // fraction of the max distance; see point_slot_config()
+static constexpr float s_receiver_move_threshold = 0.01f;  // world units; smaller receiver (or cascade) volume changes keep the culled casters
 
 
 using namespace std::chrono;
@@ -94,6 +107,8 @@ ShadowAtlas::ShadowAtlas(uint32_t size, LightManager &lights) :
 
 ShadowAtlas::~ShadowAtlas()
 {
+	if(_plan_done.valid())
+		_plan_done.wait();
 	release();
 }
 
@@ -111,9 +126,44 @@ bool ShadowAtlas::create()
 	return bool(this);
 }
 
-uint32_t ShadowAtlas::update_allocations(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos, const glm::vec3 &view_forward)
+uint32_t ShadowAtlas::update_allocations(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos, const glm::vec3 &view_forward, TimeT now)
 {
-	const TimeT T0 = steady_clock::now();
+	// any plan in progress would be outdated by this one
+	if(_plan_done.valid())
+		_plan_done.get();
+
+	snapshot(relevant_lights, view_pos, view_forward, now, _plan);
+	plan_allocations(_plan);
+
+	return apply_plan(_plan);
+}
+
+uint32_t ShadowAtlas::update_allocations_async(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos, const glm::vec3 &view_forward)
+{
+	uint32_t num_changes { 0 };
+
+	if(_plan_done.valid())
+	{
+		if(_plan_done.wait_for(0s) != std::future_status::ready)
+			return 0;
+
+		_plan_done.get();
+		num_changes = apply_plan(_plan);
+	}
+
+	snapshot(relevant_lights, view_pos, view_forward, steady_clock::now(), _plan);
+	_plan_done = std::async(std::launch::async, [this]() {
+		plan_allocations(_plan);
+	});
+
+	return num_changes;
+}
+
+void ShadowAtlas::snapshot(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos, const glm::vec3 &view_forward, TimeT now, AllocationPlan &plan)
+{
+	plan.now        = now;
+	plan.start_time = steady_clock::now();
+	plan.generation = ++_snapshot_generation;
 
 	// has sun appeared or disappeared -> then we need to switch the current slots set
 	const auto has_sun_light = _lights.sun_id() != NO_LIGHT_ID and _lights.is_enabled(_lights.sun_id());
@@ -123,48 +173,118 @@ uint32_t ShadowAtlas::update_allocations(const std::vector<LightIndex> &relevant
 	else if(not has_sun_light and is_using_sun_slots)
 		switch_slots_set(NoSunSlots);
 
-	static std::vector<ValueLight> valued_lights;
-	valued_lights.reserve(std::max(64ul, relevant_lights.size()));
-	valued_lights.clear();
+	plan.slots_set        = _current_slot_set;
+	plan.distribution     = curr_distribution();
+	plan.view_pos         = view_pos;
+	plan.view_forward     = view_forward;
+	plan.value_params     = { _max_distance, _large_light_radius };
+	plan.sun_num_cascades = _sun_num_cascades;
 
-	static dense_set<LightID> seen_lights;
-	seen_lights.reserve(valued_lights.capacity());
-	seen_lights.clear();
+	plan.candidates.reserve(std::max(64ul, relevant_lights.size()));
+	plan.candidates.clear();
+	plan.sun = { s_min_light_value, NO_LIGHT_ID, SlotConfig::Cascades };  // only the strongest dir light may get a shadow allocation
 
-	// 1. assign a "value" to all shadow-casting lights
-	evaluate_lights(relevant_lights, view_pos, view_forward, valued_lights, seen_lights);
+	_seen_lights.reserve(plan.candidates.capacity());
+	_seen_lights.clear();
 
-	Counters counters;
+	for(const auto &light_index: relevant_lights)
+	{
+		const auto light_id = _lights.light_id(light_index);
+
+		const auto light_ent = entt::entity(light_id);
+		const auto &[general, transform] = _lights.entities().get<component::LightGeneral, component::Transform>(light_ent);
+
+		_seen_lights.insert(light_id);
+
+		if(general.light_type == LightType::Directional)
+		{
+			if(general.intensity > plan.sun.value)
+				plan.sun = { general.intensity, light_id, SlotConfig::Cascades };
+		}
+		else
+		{
+			const auto affect_radius = _lights.affect_radius(light_id, general);
+			auto config = SlotConfig::Single;
+			if(general.light_type == LightType::Point)
+			{
+				const auto edge_distance = std::max(0.f, glm::distance(transform.position(), view_pos) - affect_radius);
+				config = point_slot_config(light_id, edge_distance);
+			}
+			plan.candidates.push_back({ { transform.position(), affect_radius }, light_id, config });
+		}
+	}
 
 	// "drop" all allocations for lights we didn't even see
+	_scratch_ids.clear();
 	for(const auto &[light_id, _]: _id_to_allocated)
 	{
-		if(not seen_lights.contains(light_id))
-		{
-			if(remove_allocation(light_id))
-				++counters.dropped;
-		}
+		if(not _seen_lights.contains(light_id))
+			_scratch_ids.push_back(light_id);
 	}
-	if(seen_lights.empty())
-		return counters.dropped;
+	plan.num_unseen = 0;
+	for(const auto light_id: _scratch_ids)
+	{
+		if(remove_allocation(light_id))
+			++plan.num_unseen;
+	}
+}
+
+void ShadowAtlas::plan_allocations(AllocationPlan &plan) const
+{
+	plan.desired.reserve(std::max(64ul, plan.candidates.size()));
+	plan.desired.clear();
+	plan.drop.clear();
+	plan.denied.clear();
+
+	// 1. assign a "value" to all shadow-casting lights
+	evaluate_lights(plan);
 
 	// 2. "pour" the valued lights into the size-buckets.
 	//    NOTE: this is just a "desire"; not affected by already allocated slots
+	compute_desired(plan);
+	// debug_dump_desired(plan.desired);
+}
 
-	static std::vector<AtlasLight> desired_slots;
-	desired_slots.reserve(std::max(64ul, valued_lights.size()));
-	desired_slots.clear();
+uint32_t ShadowAtlas::apply_plan(AllocationPlan &plan)
+{
+	Counters counters;
+	counters.dropped = plan.num_unseen;
 
-	counters += compute_desired(valued_lights, desired_slots);
-	// _dump_desired(desired_slots);
+	if(plan.slots_set != _current_slot_set)
+	{
+		_last_counters = counters;
+		return counters.dropped;  // switched since the snapshot; everything was dropped anyway
+	}
+
+	for(const auto light_id: plan.drop)
+	{
+		if(remove_allocation(light_id))
+			++counters.dropped;
+	}
+	for(const auto &demand: plan.denied)
+	{
+		Log::warning("atlas| [{}] can't fit {} slots", demand.light_id, demand.num_slots);
+		if(remove_allocation(demand.light_id))
+			++counters.dropped;
+		else
+			++counters.denied;
+	}
+	_denied = plan.denied;  // defragment() might make room
+
+	// the slots might have been split/merged since the snapshot
+	const auto stale = not std::ranges::equal(plan.distribution, curr_distribution());
+
+	// this plan could allocate from the slots split before its snapshot; they may be merged again
+	std::erase_if(_pending_splits, [&plan](const PendingSplit &split) { return split.generation < plan.generation; });
 
 	// 3. apply the desired slots; actually allocate the slots & assign to the AtlasLight entry
-	counters += apply_desired_slots(desired_slots, T0);
+	counters += apply_desired_slots(plan.desired, plan.now, stale);
+	_last_counters = counters;
 
 	const auto num_changes = counters.changed();
 	if(num_changes)
 	{
-		log_changes(counters, valued_lights.size(), T0);
+		log_changes(counters, plan.valued.size(), plan.start_time);
 #if defined(DEBUG)
 		std::print(" ->");
 		debug_dump_allocated(false);
@@ -205,6 +325,19 @@ ShadowAtlas::SlotMask ShadowAtlas::need_render(const AtlasLight &atlas_light, Ti
 	if(atlas_light.is_dirty() or light_hash != atlas_light.hash)
 		return SlotMaskAll;
 
+	if(atlas_light.slot_config == SlotConfig::Cascades)
+	{
+		// the cascades are re-rendered when they moved (see update_csm_params()), or dynamic objects are in view
+		SlotMask stale_cascades { 0 };
+		for(uint_fast8_t cascade = 0; cascade < atlas_light.num_slots and cascade < _csm_params.num_cascades; ++cascade)
+		{
+			if(_csm_params.cascade_hash[cascade] != _csm_rendered_hash[cascade]
+			   or has_new_casters(scene, slot_pvs(scene, atlas_light.uuid, cascade), cascade))
+				stale_cascades |= 1u << cascade;
+		}
+		return stale_cascades;
+	}
+
 	// light has changed, check the view for each slot whether there are dynamic objects
 	// render if either:
 	// - there are dynamic objects in view
@@ -215,14 +348,6 @@ ShadowAtlas::SlotMask ShadowAtlas::need_render(const AtlasLight &atlas_light, Ti
 
 	for(uint_fast8_t slot_idx = 0; slot_idx < atlas_light.num_slots; ++slot_idx)
 	{
-		const auto &objects = pvs(scene, atlas_light.uuid, slot_idx);
-
-		if(not objects.dynamic_entities.empty())
-		{
-			stale_slots |= 1u << slot_idx;
-			continue;
-		}
-
 		const auto size_idx = slot_size_idx(atlas_light.slots[slot_idx].size);
 		assert(size_idx < _render_intervals.size());
 		const auto &[skip_frames, interval] = _render_intervals[size_idx];
@@ -231,7 +356,8 @@ ShadowAtlas::SlotMask ShadowAtlas::need_render(const AtlasLight &atlas_light, Ti
 		const auto overdue = (skip_frames == 0 or atlas_light._frames_skipped < skip_frames)
 			or (now - atlas_light._last_rendered) >= interval;
 
-		if(overdue)
+		// otherwise, casters not in the map, e.g. the camera moved; see set_receiver_volume()
+		if(overdue or has_new_casters(scene, slot_pvs(scene, atlas_light.uuid, slot_idx), slot_idx))
 			stale_slots |= 1u << slot_idx;
 		else if(atlas_light._frames_skipped)
 			--atlas_light._frames_skipped;
@@ -240,6 +366,33 @@ ShadowAtlas::SlotMask ShadowAtlas::need_render(const AtlasLight &atlas_light, Ti
 	return stale_slots;
 }
 
+void ShadowAtlas::on_rendered(const AtlasLight &atlas_light, TimeT now, size_t light_hash, SlotMask rendered) const
+{
+	atlas_light.on_rendered(now, light_hash);
+
+	for(uint_fast8_t slot_idx = 0; slot_idx < atlas_light.num_slots; ++slot_idx)
+	{
+		if((rendered & (1u << slot_idx)) == 0)
+			continue;
+		if(auto found = _light_pvs.find(LIGHT_PVS_KEY(atlas_light.uuid, slot_idx)); found != _light_pvs.end())
+		{
+			auto &slot = found->second;
+			slot.rendered.assign(slot.objects.static_entities.begin(), slot.objects.static_entities.end());
+			std::ranges::sort(slot.rendered);
+			slot.checked = {};
+		}
+	}
+
+	if(atlas_light.slot_config == SlotConfig::Cascades)
+	{
+		for(uint_fast8_t cascade = 0; cascade < _csm_params.num_cascades; ++cascade)
+		{
+			if((rendered & (1u << cascade)) > 0)
+				_csm_rendered_hash[cascade] = _csm_params.cascade_hash[cascade];
+		}
+	}
+}
+
 bool ShadowAtlas::remove_allocation(LightID light_id)
 {
 	auto found = _id_to_allocated.find(light_id);
@@ -354,11 +507,22 @@ void ShadowAtlas::debug_dump_desired(const std::vector<AtlasLight> &desired_slot
 		Log::debug("atlas|   {{{}}}: {}", atlas_light.uuid, sizes_count_summary(atlas_light));
 }
 
+static uint32_t shadow_projection(ShadowAtlas::SlotConfig config)
+{
+	using enum ShadowAtlas::SlotConfig;
+	switch(config)
+	{
+	case Tetrahedral:    return SHADOW_PROJECTION_TETRAHEDRAL;
+	case DualParaboloid: return SHADOW_PROJECTION_DUAL_PARABOLOID;
+	default:             return SHADOW_PROJECTION_CUBE;  // not used by spot & directional lights
+	}
+}
+
 void ShadowAtlas::update_slots_ssbo()
 {
 	static std::vector<decltype(_shadow_slots_info_ssbo)::value_type> slots_params;
 
-	slots_params.reserve(_id_to_allocated.size());
+	slots_params.reserve(_id_to_allocated.size() + (_virtual_maps? _virtual_maps->lights().size(): 0));
 	slots_params.clear();
 
 	for(auto &[light_id, atlas_light]: allocated_lights())
@@ -387,17 +551,49 @@ void ShadowAtlas::update_slots_ssbo()
 			}
 			else
 			{
-				const auto &[view, proj, nz, fz] = light_view_projection(light, idx);
+				const auto &[view, proj, nz, fz] = light_view_projection(light, idx, atlas_light.slot_config);
 				view_projs[idx] = proj * view;
 				texel_sizes[idx] = (fz - nz) / float(rects[idx].z);
 			}
 		}
 
 		const auto shadow_idx = uint16_t(slots_params.size());  // i.e. the entry we're about to add
-		slots_params.emplace_back(view_projs, rects, texel_sizes);
+		slots_params.emplace_back(view_projs, rects, texel_sizes, shadow_projection(atlas_light.slot_config));
 
 		_lights.set_shadow_index(light_id, shadow_idx);
 	}
+
+	if(_virtual_maps)
+	{
+		// 'atlas_rect' is the virtual map index; a zero width tells the shaders to use the page table
+		const auto virtual_size = float(_virtual_maps->virtual_size());
+
+		for(const auto &[light_id, vlight]: _virtual_maps->lights())
+		{
+			const auto light_ = _lights.get_light(light_id);
+			if(not light_)
+				continue;
+			const auto &light = *light_;
+
+			std::array<glm::mat4, MAX_SLOTS>  view_projs;
+			std::array<glm::uvec4, MAX_SLOTS> rects;
+			std::array<float, MAX_SLOTS>      texel_sizes;
+
+			for(auto face = 0u; face < vlight.num_maps; ++face)
+			{
+				const auto &[view, proj, nz, fz] = light_view_projection(light, face);
+				view_projs[face] = proj * view;
+				rects[face] = glm::uvec4(vlight.map_index[face], 0, 0, 0);
+				texel_sizes[face] = (fz - nz) / virtual_size;
+			}
+
+			const auto shadow_idx = uint16_t(slots_params.size());
+			slots_params.emplace_back(view_projs, rects, texel_sizes, SHADOW_PROJECTION_CUBE);
+
+			_lights.set_shadow_index(light_id, shadow_idx);
+		}
+	}
+
 	_shadow_slots_info_ssbo.set(slots_params);
 	_lights.flush();
 }
@@ -418,8 +614,17 @@ static constexpr glm::vec3 s_cube_face_up[] = {
 	-AXIS_Y,
 	-AXIS_Y,
 };
+// the tetrahedron's vertex directions; same order as tetrahedralFace() in shadows.glh
+static const glm::vec3 s_tetrahedral_forward[] = {
+	glm::normalize(glm::vec3( 1,  1,  1)),
+	glm::normalize(glm::vec3( 1, -1, -1)),
+	glm::normalize(glm::vec3(-1,  1, -1)),
+	glm::normalize(glm::vec3(-1, -1,  1)),
+};
+// a face's (spherical) triangle extends ~70.5 deg from its center; 2*atan(2*sqrt(2)) = ~141 deg, plus a margin for the filter kernel
+static const auto s_tetrahedral_fov = glm::radians(143.98f);
 
-ShadowAtlas::LightViewProjection ShadowAtlas::light_view_projection(const LightWrapper &light, uint32_t idx) const
+ShadowAtlas::LightViewProjection ShadowAtlas::light_view_projection(const LightWrapper &light, uint32_t idx, SlotConfig config) const
 {
 	// TODO: this is actually only needed if the light has changed. cache it where?
 
@@ -428,6 +633,29 @@ ShadowAtlas::LightViewProjection ShadowAtlas::light_view_projection(const LightW
 
 	const auto &position = light.transform.position();
 
+	if(light.general.light_type == LightType::Point and config == SlotConfig::Tetrahedral)
+	{
+		assert(idx < 4);
+		static constexpr auto square = 1.f;
+
+		// none of the faces point along the Y axis
+		const auto light_view      = glm::lookAt(position, position + s_tetrahedral_forward[idx], AXIS_Y);
+		const auto face_projection = glm::perspective(s_tetrahedral_fov, square, near_z, far_z);
+
+		return { light_view, face_projection, near_z, far_z };
+	}
+	if(light.general.light_type == LightType::Point and config == SlotConfig::DualParaboloid)
+	{
+		assert(idx < 2);
+
+		// hemisphere 0 faces down (i.e. the floor gets the best resolution), 1 faces up
+		//   the paraboloid warp is not linear; the shaders do it, using the distance (i.e. scaled by 1/far) as depth
+		const auto view_forward    = idx == 0? -AXIS_Y: AXIS_Y;
+		const auto light_view      = glm::lookAt(position, position + view_forward, AXIS_Z);
+		const auto face_projection = glm::scale(glm::mat4(1), glm::vec3(1.f / far_z));
+
+		return { light_view, face_projection, 0.f, far_z };
+	}
 	if(light.general.light_type == LightType::Point)
 	{
 		assert(idx < 6);
@@ -465,25 +693,86 @@ ShadowAtlas::LightViewProjection ShadowAtlas::light_view_projection(const LightW
 	return { glm::mat4(1), glm::mat4(1), -1, -1 };
 }
 
+ShadowAtlas::SlotTexelScale ShadowAtlas::slot_texel_scale(const AtlasLight &atlas_light, uint_fast8_t slot_idx) const
+{
+	assert(slot_idx < atlas_light.num_slots);
+	const auto slot_size = float(atlas_light.slots[slot_idx].rect.z);
+
+	if(atlas_light.slot_config == SlotConfig::Cascades)
+	{
+		if(not _csm_params or slot_idx >= _csm_params.num_cascades)
+			return {};
+		// orthographic, i.e. the same everywhere
+		return { glm::vec3(0), _csm_params.light_projection[slot_idx][0][0] * slot_size / 2, false };
+	}
+
+	const auto light_ = _lights.get_light(atlas_light.uuid);
+	if(not light_)
+		return {};
+	const auto &light = *light_;
+	const auto &position = light.transform.position();
+
+	if(atlas_light.slot_config == SlotConfig::DualParaboloid)
+	{
+		// the warp's scale at the hemisphere's center (the finest); 0.5 per radian
+		return { position, slot_size / 4, true };
+	}
+
+	const auto &[view, projection, near_z, far_z] = light_view_projection(light, slot_idx, atlas_light.slot_config);
+	return { position, projection[1][1] * slot_size / 2, true };
+}
+
+	   // frustum corners in NFC space (always the same)
+static constexpr std::array<glm::vec4, 8> s_frustum_corners_ndc = {
+	glm::vec4(-1, -1, -1,  1),
+	glm::vec4(-1, -1,  1,  1),
+	glm::vec4(-1,  1, -1,  1),
+	glm::vec4(-1,  1,  1,  1),
+	glm::vec4( 1, -1, -1,  1),
+	glm::vec4( 1, -1,  1,  1),
+	glm::vec4( 1,  1, -1,  1),
+	glm::vec4( 1,  1,  1,  1),
+};
+
 const QueryResult &ShadowAtlas::pvs(const Scene &scene, LightID light_id, uint_fast8_t slot_idx) const
 {
-	QueryResult *result { nullptr };
-	auto found = _light_pvs.find(LIGHT_PVS_KEY(light_id, slot_idx));
-	if(found != _light_pvs.end())
-		result = &found->second;
-	else
+	auto &slot = slot_pvs(scene, light_id, slot_idx);
+
+	// only the casters that may shadow the receivers (i.e. the view)
+	const SlotPVS::Stamp stamp { slot.query.created_at, _receiver_generation };
+	if(slot.culled != stamp)
 	{
-		QueryResult res;
-		// insert & get address of inserted object
-		// TODO: possibly to do in a cleaner way?
-		result = &((*_light_pvs.insert({ LIGHT_PVS_KEY(light_id, slot_idx), res }).first).second);
+		auto &culled = slot.objects;
+		culled.static_entities.assign(slot.query.static_entities.begin(), slot.query.static_entities.end());
+		culled.dynamic_entities.assign(slot.query.dynamic_entities.begin(), slot.query.dynamic_entities.end());
+		culled.created_at = slot.query.created_at;
+
+		const auto num_casters = uint32_t(culled.size());
+		uint32_t num_culled { 0 };
+		if(_caster_culling)
+		{
+			num_culled = uint32_t(scene.cull(culled, caster_volume(slot, slot_idx)));
+			_cull_counters.tested += num_casters;
+		}
+		++_cull_counters.culls;
+		slot.culling = { num_casters, num_culled };
+		slot.dynamic_casters = not culled.dynamic_entities.empty();
+		slot.culled = stamp;
 	}
 
+	return slot.objects;
+}
+
+ShadowAtlas::SlotPVS &ShadowAtlas::slot_pvs(const Scene &scene, LightID light_id, uint_fast8_t slot_idx) const
+{
+	auto &slot_pvs = _light_pvs.try_emplace(LIGHT_PVS_KEY(light_id, slot_idx)).first->second;
+	auto *result = &slot_pvs.query;
+
 	const auto light_ = _lights.get_light(light_id);
 	if(not light_) // e.g. not enabled
 	{
 		// any previous result is kept
-		return *result;
+		return slot_pvs;
 	}
 
 	const auto &light = *light_;
@@ -497,15 +786,29 @@ const QueryResult &ShadowAtlas::pvs(const Scene &scene, LightID light_id, uint_f
 		const auto &projection = _csm_params.light_projection[slot_idx];
 		const auto &aabb       = _csm_params.view_aabb[slot_idx];
 		scene.query(view, projection, aabb, *result);
+		slot_pvs.directional = true;
 	}
 	break;
 
 	case LightType::Point:
 	{
-		const auto &[view, proj, near, far] = light_view_projection(light, slot_idx);
-		Frustum frustum;
-		frustum.setFromView(proj, view, light.transform.position());
-		scene.query(frustum, *result);
+		auto config = SlotConfig::Cube;
+		if(auto found = _id_to_allocated.find(light_id); found != _id_to_allocated.end())
+			config = found->second.slot_config;
+
+		if(config == SlotConfig::DualParaboloid)
+		{
+			// no frustum for a hemisphere; the whole sphere will do
+			scene.query(bounds::Sphere(light.transform.position(), light.gpu_light.affect_radius), *result);
+		}
+		else
+		{
+			const auto &[view, proj, near, far] = light_view_projection(light, slot_idx, config);
+			Frustum frustum;
+			frustum.setFromView(proj, view, light.transform.position());
+			scene.query(frustum, *result);
+		}
+		slot_pvs.light_position = light.transform.position();
 	}
 	break;
 
@@ -515,6 +818,7 @@ const QueryResult &ShadowAtlas::pvs(const Scene &scene, LightID light_id, uint_f
 		Frustum frustum;
 		frustum.setFromView(proj, view, light.transform.position());
 		scene.query(frustum, *result);
+		slot_pvs.light_position = light.transform.position();
 	}
 	break;
 
@@ -522,20 +826,121 @@ const QueryResult &ShadowAtlas::pvs(const Scene &scene, LightID light_id, uint_f
 		assert(false);
 	}
 
-	return *result;
+	return slot_pvs;
 }
 
-	   // frustum corners in NFC space (always the same)
-static constexpr std::array<glm::vec4, 8> s_frustum_corners_ndc = {
-	glm::vec4(-1, -1, -1,  1),
-	glm::vec4(-1, -1,  1,  1),
-	glm::vec4(-1,  1, -1,  1),
-	glm::vec4(-1,  1,  1,  1),
-	glm::vec4( 1, -1, -1,  1),
-	glm::vec4( 1, -1,  1,  1),
-	glm::vec4( 1,  1, -1,  1),
-	glm::vec4( 1,  1,  1,  1),
-};
+CasterVolume ShadowAtlas::caster_volume(const SlotPVS &slot, uint_fast8_t slot_idx) const
+{
+	CasterVolume casters;  // contains everything, unless set below
+
+	if(slot.directional)
+	{
+		if(_csm_params)
+			casters = _csm_caster_volumes[slot_idx];
+	}
+	else if(_receiver_valid)
+		casters.set_point(_receiver_corners, slot.light_position);
+
+	return casters;
+}
+
+bool ShadowAtlas::has_new_casters(const Scene &scene, SlotPVS &slot, uint_fast8_t slot_idx) const
+{
+	// nothing changed since the previous check (the rendered set resets it, see on_rendered())
+	const SlotPVS::Stamp stamp { slot.query.created_at, _receiver_generation };
+	if(slot.checked == stamp)
+	{
+		++_cull_counters.skipped;
+		return slot.stale;
+	}
+	++_cull_counters.checks;
+
+	const auto casters = caster_volume(slot, slot_idx);
+	auto may_shadow = [this, &scene, &casters](EntityID entity_id) {
+		if(not _caster_culling)
+			return true;
+		++_cull_counters.tested;
+		return scene.inside(entity_id, casters);
+	};
+
+	slot.dynamic_casters = std::ranges::any_of(slot.query.dynamic_entities, may_shadow);
+	// fewer casters is fine; the ones no longer in the set don't shadow the view
+	slot.stale = slot.dynamic_casters or std::ranges::any_of(slot.query.static_entities, [&slot, &may_shadow](EntityID entity_id) {
+		return not std::ranges::binary_search(slot.rendered, entity_id) and may_shadow(entity_id);
+	});
+	slot.checked = stamp;
+
+	return slot.stale;
+}
+
+static bool corners_moved(const CasterVolume::Corners &from, const CasterVolume::Corners &to)
+{
+	for(auto idx = 0u; idx < from.size(); ++idx)
+	{
+		if(glm::distance(from[idx], to[idx]) > s_receiver_move_threshold)
+			return true;
+	}
+	return false;
+}
+
+void ShadowAtlas::set_receiver_volume(const Camera &camera, float max_distance)
+{
+	// the camera's view, up to where the shadows fade out
+	const auto far_z = std::min(camera.farPlane(), max_distance);
+	const auto inv_view_proj = glm::inverse(camera.projectionTransform(camera.nearPlane(), far_z) * camera.viewTransform());
+	CasterVolume::Corners corners;
+	for(auto idx = 0u; idx < 8; ++idx)
+	{
+		const auto corner = inv_view_proj * s_frustum_corners_ndc[idx];
+		corners[idx] = glm::vec3(corner) / corner.w;
+	}
+
+	// e.g. a still camera keeps the culled casters (see pvs())
+	if(not _receiver_valid or corners_moved(_receiver_corners, corners))
+	{
+		_receiver_corners = corners;
+		++_receiver_generation;
+	}
+	_receiver_valid = true;
+
+	_last_cull_counters = _cull_counters;
+	_cull_counters = {};
+}
+
+ShadowAtlas::CasterCullStats ShadowAtlas::caster_cull_stats(LightID light_id) const
+{
+	CasterCullStats stats;
+	for(auto slot = 0u; slot < MAX_SLOTS; ++slot)
+	{
+		if(auto found = _light_pvs.find(LIGHT_PVS_KEY(light_id, slot)); found != _light_pvs.end())
+		{
+			stats.casters += found->second.culling.casters;
+			stats.culled  += found->second.culling.culled;
+		}
+	}
+	return stats;
+}
+
+bool ShadowAtlas::has_dynamic_casters(LightID light_id) const
+{
+	for(auto slot = 0u; slot < MAX_SLOTS; ++slot)
+	{
+		if(auto found = _light_pvs.find(LIGHT_PVS_KEY(light_id, slot)); found != _light_pvs.end() and found->second.dynamic_casters)
+			return true;
+	}
+	return false;
+}
+
+ShadowAtlas::CasterCullStats ShadowAtlas::caster_cull_totals() const
+{
+	CasterCullStats stats;
+	for(const auto &[key, slot_pvs]: _light_pvs)
+	{
+		stats.casters += slot_pvs.culling.casters;
+		stats.culled  += slot_pvs.culling.culled;
+	}
+	return stats;
+}
 
 const ShadowAtlas::CSMParams &ShadowAtlas::update_csm_params(LightID light_id, const Camera &camera)//, float radius_uv)
 {
@@ -567,12 +972,60 @@ const ShadowAtlas::CSMParams &ShadowAtlas::update_csm_params(LightID light_id, c
 	assert(num_cascades >= 1 and num_cascades <= 6);
 	assert(num_cascades == _sun_num_cascades);
 
+	// nothing changed since the previous call, e.g. the camera is still
+	size_t inputs_hash = camera.hash();
+	inputs_hash = hash_combine(inputs_hash, sun.gpu_light.direction);
+	inputs_hash = hash_combine(inputs_hash, num_cascades);
+	for(auto cascade = 0u; cascade < num_cascades; ++cascade)
+		inputs_hash = hash_combine(inputs_hash, atlas_light.slots[cascade].size);
+	inputs_hash = hash_combine(inputs_hash, _max_distance);
+	inputs_hash = hash_combine(inputs_hash, _csm_frustum_split_mix);
+	inputs_hash = hash_combine(inputs_hash, _csm_cascade_backoff);
+	inputs_hash = hash_combine(inputs_hash, _csm_stabilization);
+	inputs_hash = hash_combine(inputs_hash, _sdsm? _sdsm_generation + 1: 0u);
+
+	// deferred (moved) cascades are still pending
+	const auto deferred = std::ranges::any_of(std::span(_csm_deferred).first(num_cascades), [](auto calls) { return calls > 0; });
+
+	if(_csm_params and inputs_hash == _csm_inputs_hash and not deferred)
+		return _csm_params;
+	_csm_inputs_hash = inputs_hash;
+
+	const auto previous = _csm_params;
 
 	_csm_params.num_cascades = num_cascades;
 
 	// this bit needs only be done when the frustum's near/far planes has changed
 	float near_z  = camera.nearPlane();
 	float far_z   = std::min(camera.farPlane(), _max_distance);//camera.farPlane() * range_scale;   // distance is limited below  (using _max_distance)
+
+	// light space, sans translation (i.e. same as the 'light_view' below)
+	const auto light_rotation = glm::mat3(glm::lookAt(glm::vec3(0), sun.gpu_light.direction, AXIS_Y));
+
+	// SDSM: split only the depth range of the visible samples
+	auto same_rotation = [](const glm::mat3 &a, const glm::mat3 &b) {
+		return glm::all(glm::epsilonEqual(a[0], b[0], 1e-4f))
+			and glm::all(glm::epsilonEqual(a[1], b[1], 1e-4f))
+			and glm::all(glm::epsilonEqual(a[2], b[2], 1e-4f));
+	};
+	++_sdsm_bounds.age;
+	const auto sdsm_valid = _sdsm and _sdsm_bounds.valid
+		and _sdsm_bounds.age <= s_sdsm_max_age
+		and _sdsm_bounds.params.num_cascades == num_cascades
+		and same_rotation(_sdsm_bounds.params.light_rotation, light_rotation);
+
+	_sdsm_depth_range = glm::vec2(0);
+	if(sdsm_valid)
+	{
+		// padded, and quantized to steps of the same size, so the splits don't change with every reduction
+		static const auto log_step = std::log(1 + s_sdsm_depth_padding);
+		const auto sample_near = std::exp(std::floor(std::log(_sdsm_bounds.depth_range.x) / log_step - 1) * log_step);
+		const auto sample_far  = std::exp(std::ceil(std::log(_sdsm_bounds.depth_range.y) / log_step + 1) * log_step);
+		near_z = std::max(near_z, sample_near);
+		far_z  = std::clamp(sample_far, near_z * 2, far_z);
+		_sdsm_depth_range = { near_z, far_z };
+	}
+
 	float z_range = far_z - near_z;
 	float z_ratio = far_z / near_z;
 
@@ -604,13 +1057,14 @@ const ShadowAtlas::CSMParams &ShadowAtlas::update_csm_params(LightID light_id, c
 		float d_mix    = _csm_frustum_split_mix*(d_log - d_linear) + d_linear;//glm::mix(d_linear, d_log, _csm_frustum_split_mix) + d_linear;
 
 
-		// const auto split_near = previous_split_far;
+		const auto split_near = previous_split_far;
 		const float split_far = camera.nearPlane() + (d_mix - camera.nearPlane());//*range_scale;
 		const float far_frac = (split_far - near_z) / z_range;
 		const float near_frac = (previous_split_far - near_z) / z_range;
 
 		// Log::debug("atlas|  [{}] lin: {:.4f}  log: {:.4f} -> {:.5f} frac.: {:.5f}", cascade, d_linear, d_log, split_far, far_frac);
 		_csm_params.split_depth[cascade] = -split_far; // store depth to the far side of the split (to deduce cascade index in the shader)
+		_sdsm_params.split_depth[cascade] = split_far;
 
 		previous_split_far = split_far;
 
@@ -644,6 +1098,15 @@ const ShadowAtlas::CSMParams &ShadowAtlas::update_csm_params(LightID light_id, c
 		slice_frustum(6u);
 		cascade_center_ws /= 8.f;
 
+		// the casters that may shadow the slice (see pvs()); the corners are in the NDC order
+		if(corners_moved(_csm_caster_corners[cascade], cascade_corners_ws) or sun.gpu_light.direction != _csm_caster_directions[cascade])
+		{
+			_csm_caster_volumes[cascade].set_directional(cascade_corners_ws, sun.gpu_light.direction);
+			_csm_caster_corners[cascade] = cascade_corners_ws;
+			_csm_caster_directions[cascade] = sun.gpu_light.direction;
+			++_receiver_generation;
+		}
+
 		// Log::debug("atlas|   light 'pos': {:.5f}; {:.5f}; {:.5f}", light_pos.x, light_pos.y, light_pos.z);
 		// Log::debug("atlas|   WS center: {:.5f}; {:.5f}; {:.5f}", cascade_center_ws.x, cascade_center_ws.y, cascade_center_ws.z);
 
@@ -660,9 +1123,39 @@ const ShadowAtlas::CSMParams &ShadowAtlas::update_csm_params(LightID light_id, c
 		// quantize slightly, probably for some good reason :)
 		cascade_radius = std::ceil(cascade_radius * 16.0f) / 16.0f;
 
+		// SDSM: fit (x, y) to the cascade's visible samples, if they were binned by (about) the same split
+		auto extents_xy = glm::vec2(cascade_radius);
+		if(sdsm_valid)
+		{
+			const auto &rect = _sdsm_bounds.rect_ls[cascade];
+			const auto binned_near = cascade > 0? _sdsm_bounds.params.split_depth[cascade - 1]: split_near;
+			const auto binned_far  = _sdsm_bounds.params.split_depth[cascade];
+			const auto same_split = std::abs(binned_near - split_near) <= split_near * s_sdsm_split_tolerance
+				and std::abs(binned_far - split_far) <= split_far * s_sdsm_split_tolerance;
+
+			if(same_split and rect.x <= rect.z and rect.y <= rect.w)
+			{
+				const auto center_ls = light_rotation * cascade_center_ws;
+				const auto padding = (glm::vec2(rect.z, rect.w) - glm::vec2(rect)) * s_sdsm_rect_padding;
+				// never larger than the frustum slice
+				const auto rect_min = glm::max(glm::vec2(rect) - padding, glm::vec2(center_ls) - cascade_radius);
+				const auto rect_max = glm::min(glm::vec2(rect.z, rect.w) + padding, glm::vec2(center_ls) + cascade_radius);
+				if(rect_min.x < rect_max.x and rect_min.y < rect_max.y)
+				{
+					// square (as the slots), quantized to reduce swimming when the samples change
+					const auto step = cascade_radius / 16.f;
+					const auto half_size = std::max(rect_max.x - rect_min.x, rect_max.y - rect_min.y) * 0.5f;
+					extents_xy = glm::vec2(std::min(std::ceil(half_size / step) * step, cascade_radius));
+
+					const auto rect_center = (rect_min + rect_max) * 0.5f;
+					cascade_center_ws = glm::transpose(light_rotation) * glm::vec3(rect_center, center_ls.z);
+				}
+			}
+		}
+
 		const auto z_offset = _csm_cascade_backoff;
 
-		const auto max_extents = glm::vec3(cascade_radius);
+		const auto max_extents = glm::vec3(extents_xy, cascade_radius);
 		const auto min_extents = -max_extents;
 
 		auto minZ = min_extents.z;
@@ -706,6 +1199,7 @@ const ShadowAtlas::CSMParams &ShadowAtlas::update_csm_params(LightID light_id, c
 		_csm_params.light_view[cascade]            = light_view;
 		_csm_params.light_projection[cascade]      = light_projection;
 		_csm_params.light_view_projection[cascade] = light_vp;
+		_csm_params.cascade_hash[cascade]          = std::hash<glm::mat4>{}(light_vp);
 
 #if 0
 		Log::debug("atlas| cascade {}  F:{: >7.3f}  C:{: >8.4f}  +{:6.1f} (D:{:5.1f}) -> L:{: >8.4f}  R:{: >7.3f}",
@@ -727,9 +1221,82 @@ const ShadowAtlas::CSMParams &ShadowAtlas::update_csm_params(LightID light_id, c
 
 	_csm_params.light_radius_uv = _csm_light_radius_uv / max_frustum_size;
 
+	// when the splits are the same, a moved cascade might wait a few calls (i.e. keeps its previous projection)
+	//   with the splits changed, all cascades must be updated (or there'd be gaps/overlaps between them)
+	const auto same_splits = previous.num_cascades == num_cascades
+		and std::ranges::equal(std::span(previous.split_depth).first(num_cascades), std::span(_csm_params.split_depth).first(num_cascades));
+
+	for(auto cascade = 0u; cascade < num_cascades; ++cascade)
+	{
+		if(not same_splits or _csm_params.cascade_hash[cascade] == previous.cascade_hash[cascade])
+			_csm_deferred[cascade] = 0;
+		else if(++_csm_deferred[cascade] >= _csm_update_intervals[cascade])
+			_csm_deferred[cascade] = 0;  // due, keep the new projection
+		else
+		{
+			_csm_params.light_view[cascade]            = previous.light_view[cascade];
+			_csm_params.light_projection[cascade]      = previous.light_projection[cascade];
+			_csm_params.light_view_projection[cascade] = previous.light_view_projection[cascade];
+			_csm_params.near_far_plane[cascade]        = previous.near_far_plane[cascade];
+			_csm_params.view_aabb[cascade]             = previous.view_aabb[cascade];
+			_csm_params.cascade_hash[cascade]          = previous.cascade_hash[cascade];
+		}
+	}
+
+	_sdsm_params.light_rotation = light_rotation;
+	_sdsm_params.num_cascades = num_cascades;
+
 	return _csm_params;
 }
 
+const ShadowAtlas::SDSMReduceParams &ShadowAtlas::sdsm_reduce_params(uint64_t frame)
+{
+	auto &in_flight = _sdsm_in_flight[frame % _sdsm_in_flight.size()];
+	in_flight = { frame, _sdsm_params };
+	return in_flight.second;
+}
+
+// inverse of the order-preserving float -> uint mapping in shadow_depth_reduce.comp
+static float decode_ordered_float(uint32_t bits)
+{
+	bits ^= (bits & 0x80000000u)? 0x80000000u: 0xffffffffu;
+	return std::bit_cast<float>(bits);
+}
+
+void ShadowAtlas::set_sdsm_reduction(uint64_t frame, std::span<const uint32_t, SDSM_REDUCTION_SIZE> reduced)
+{
+	const auto &[params_frame, params] = _sdsm_in_flight[frame % _sdsm_in_flight.size()];
+	if(params_frame != frame or params.num_cascades == 0)
+		return;  // too old; the parameters are gone
+
+	// all values are maximized; minimums are stored negated. zero means no samples
+	if(reduced[0] == 0)
+	{
+		_sdsm_bounds.valid = false;  // nothing visible (e.g. only sky)
+		return;
+	}
+
+	_sdsm_bounds.valid = true;
+	_sdsm_bounds.age = 0;
+	++_sdsm_generation;
+	_sdsm_bounds.params = params;
+	_sdsm_bounds.depth_range = { -decode_ordered_float(reduced[0]), decode_ordered_float(reduced[1]) };
+
+	for(auto cascade = 0u; cascade < MAX_CASCADES; ++cascade)
+	{
+		const auto bounds = reduced.subspan(2 + cascade*4, 4);
+		if(bounds[0] == 0)
+			_sdsm_bounds.rect_ls[cascade] = glm::vec4(1, 1, -1, -1);  // empty
+		else
+			_sdsm_bounds.rect_ls[cascade] = {
+				-decode_ordered_float(bounds[0]),
+				-decode_ordered_float(bounds[1]),
+				 decode_ordered_float(bounds[2]),
+				 decode_ordered_float(bounds[3]),
+			};
+	}
+}
+
 void ShadowAtlas::clear()
 {
 	// Counters counters;
@@ -743,61 +1310,53 @@ void ShadowAtlas::clear()
 //	_dump_changes(counters);
 }
 
-void ShadowAtlas::evaluate_lights(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos, const glm::vec3 &view_forward, std::vector<ShadowAtlas::ValueLight> &valued_lights, dense_set<LightID> &seen_lights)
+void ShadowAtlas::evaluate_lights(AllocationPlan &plan) const
 {
-	// calculate a "value" for each shadow-casting light
+	// calculate a "value" for each shadow-casting light (independently, i.e. in parallel)
 
-	float strongest_dir_value { s_min_light_value };  // only the strongest dir light may get a shadow allocation
-	LightID strongest_dir_id { NO_LIGHT_ID };
+	auto &valued_lights = plan.valued;
+	valued_lights.resize(plan.candidates.size());
 
-	for(const auto &light_index: relevant_lights)
-	{
-		const auto light_id = _lights.light_id(light_index);
-
-		const auto light_ent = entt::entity(light_id);
-		const auto &[general, transform] = _lights.entities().get<component::LightGeneral, component::Transform>(light_ent);
-
-		seen_lights.insert(light_id);
-
-		if(general.light_type == LightType::Directional and general.intensity > strongest_dir_value)
-		{
-			strongest_dir_id = light_id;
-			strongest_dir_value = general.intensity;
-		}
-		else
-		{
-			const auto affect_radius = _lights.affect_radius(light_id, general);
-			const bounds::Sphere light_sphere { transform.position(), affect_radius };
-			const auto value = evaluate_light(light_sphere, view_pos, view_forward);
+	std::transform(std::execution::par_unseq, plan.candidates.begin(), plan.candidates.end(), valued_lights.begin(), [&plan](const auto &candidate) {
+		const auto value = evaluate_light(candidate.sphere, plan.view_pos, plan.view_forward, plan.value_params);
+		return ValueLight{ value, candidate.light_id, candidate.config };
+	});
 
-			if(value > s_min_light_value)
-				valued_lights.emplace_back(value, light_id, SLOT_CONFIG(general.light_type));
-		}
-	}
+	std::erase_if(valued_lights, [](const ValueLight &valued) { return valued.value <= s_min_light_value; });
 
-	if(strongest_dir_value > s_min_light_value)
+	if(plan.sun.value > s_min_light_value)
 	{
 		// the "sun" should _always_ get a shadow slot
-		valued_lights.emplace_back(2.f, strongest_dir_id, SlotConfig::Cascades);
+		valued_lights.emplace_back(2.f, plan.sun.light_id, SlotConfig::Cascades);
 	}
 
+	// every light requires at least one slot; only the top K can possibly get one
+	uint32_t num_slots { 0 };
+	for(const auto count: plan.distribution)
+		num_slots += count;
+	const auto top_k = std::min(valued_lights.size(), size_t(num_slots));
+
 	// highest-valued light first
-	std::ranges::sort(valued_lights, std::greater<>{});
+	std::partial_sort(valued_lights.begin(), valued_lights.begin() + ptrdiff_t(top_k), valued_lights.end(), std::greater<>{});
+
+	for(auto iter = valued_lights.begin() + ptrdiff_t(top_k); iter != valued_lights.end(); ++iter)
+		plan.drop.push_back(iter->light_id);
+	valued_lights.resize(top_k);
 }
 
-float ShadowAtlas::evaluate_light(const bounds::Sphere &light_sphere, const glm::vec3 &view_pos, const glm::vec3 &view_forward) const
+float ShadowAtlas::evaluate_light(const bounds::Sphere &light_sphere, const glm::vec3 &view_pos, const glm::vec3 &view_forward, const ValueParams &params)
 {
 	// calculate the "value" of a light on a fixed scale  [0, 1]
 
-	assert(_max_distance > 0);
+	assert(params.max_distance > 0);
 
 	const auto edge_distance = std::max(0.f, glm::distance(light_sphere.center(), view_pos) - light_sphere.radius());
-	if(edge_distance >= _max_distance) // too far away
+	if(edge_distance >= params.max_distance) // too far away
 		return 0.f;
 
-	const auto normalized_dist = edge_distance / _max_distance;
+	const auto normalized_dist = edge_distance / params.max_distance;
 	// nrmalize the radius using a "large" radius
-	const auto normalized_radius = std::min(light_sphere.radius() / _large_light_radius, 1.f);
+	const auto normalized_radius = std::min(light_sphere.radius() / params.large_light_radius, 1.f);
 
 	const auto importance = std::min(1.2f * normalized_radius / glm::max(normalized_dist, 1e-4f), 1.f);
 	const auto base_weight = importance * importance; // inverse square falloff
@@ -835,11 +1394,13 @@ float ShadowAtlas::evaluate_light(const bounds::Sphere &light_sphere, const glm:
 	return value;
 }
 
-ShadowAtlas::Counters ShadowAtlas::compute_desired(const std::vector<ValueLight> &valued_lights, std::vector<AtlasLight> &desired_slots)
+void ShadowAtlas::compute_desired(AllocationPlan &plan) const
 {
-	Counters counters;
+	const auto &valued_lights = plan.valued;
+	auto &desired_slots = plan.desired;
+	const auto num_tiers = plan.distribution.size();
 	// make a local copy of the distribution, so we can modify it
-	auto distribution = curr_distribution();
+	auto distribution = plan.distribution;
 
 	// Log::debug("atlas|  start_size_idx: {}   top value: {}  [{}]", size_idx, top_light_value, prioritized.begin()->light_id);
 
@@ -847,13 +1408,14 @@ ShadowAtlas::Counters ShadowAtlas::compute_desired(const std::vector<ValueLight>
 
 	// if the first light is a "sun", allocate it separately (different logic, i.e. CSM)
 	//   and there's no need to check for available space since it's the first light
-	if(auto &valued_light = *valued_iter; valued_light.config == SlotConfig::Cascades)
+	if(valued_iter != valued_lights.end() and valued_iter->config == SlotConfig::Cascades)
 	{
+		const auto &valued_light = *valued_iter;
 		++valued_iter;
 
 		AtlasLight atlas_light;
 		atlas_light.uuid        = valued_light.light_id;
-		atlas_light.num_slots   = _sun_num_cascades;
+		atlas_light.num_slots   = plan.sun_num_cascades;
 		atlas_light.slot_config = SlotConfig::Cascades;
 
 		// allocate cascaded shadow map for the sun (N largest slot sizes)
@@ -867,7 +1429,7 @@ ShadowAtlas::Counters ShadowAtlas::compute_desired(const std::vector<ValueLight>
 		atlas_light.slots[1].size = slot_size >> cascade_slot_shift[1];
 		--distribution[slot_size_idx(slot_size >> cascade_slot_shift[0])];
 
-		for(auto cascade = 2u; cascade < _sun_num_cascades; ++cascade)
+		for(auto cascade = 2u; cascade < plan.sun_num_cascades; ++cascade)
 		{
 			atlas_light.slots[cascade].size = slot_size >> cascade_slot_shift[cascade];
 			--distribution[slot_size_idx(slot_size >> cascade_slot_shift[cascade])];
@@ -891,19 +1453,20 @@ ShadowAtlas::Counters ShadowAtlas::compute_desired(const std::vector<ValueLight>
 			assert(false); // should never happen; there can be only one! (see above)
 
 		// based on the light's value, deduce where to start searching for available slots
-		auto size_idx = s_normal_shadow_shift + static_cast<uint32_t>(std::floor(static_cast<float>(curr_distribution().size() - s_normal_shadow_shift) * (1 - std::min(prio_light.value, 1.f))));
+		auto size_idx = s_normal_shadow_shift + static_cast<uint32_t>(std::floor(static_cast<float>(num_tiers - s_normal_shadow_shift) * (1 - std::min(prio_light.value, 1.f))));
 		// initial slot size for the light's value
 		auto slot_size = _allocator.max_size() >> size_idx;
+		const auto desired_size_idx = size_idx;
 
 		// find a slot size tier that still has room for required slots
-		while(distribution[size_idx] < atlas_light.num_slots and size_idx < curr_distribution().size())
+		while(size_idx < num_tiers and distribution[size_idx] < atlas_light.num_slots)
 		{
 			// not enough available here, next size
 			++size_idx;
 			slot_size >>= 1;
 		}
 
-		const auto slot_found = size_idx < curr_distribution().size(); // above loop exited early, i.e. found available slots
+		const auto slot_found = size_idx < num_tiers; // above loop exited early, i.e. found available slots
 		if(slot_found)
 		{
 			// define the desired slot(s)
@@ -917,22 +1480,42 @@ ShadowAtlas::Counters ShadowAtlas::compute_desired(const std::vector<ValueLight>
 		}
 		else
 		{
-			// no slots available, remove any previous allocation
-			// TODO: ideally, this should not be done here (should be in update_allocations())
-			Log::warning("atlas| [{}] can't fit {} slots", atlas_light.uuid, atlas_light.num_slots);
-			if(remove_allocation(prio_light.light_id))
-				++counters.dropped;
-			else
-				++counters.denied;
+			// no slots available, remove any previous allocation (in apply_plan(), which also logs it; this might run on a worker thread)
+			plan.denied.push_back({ prio_light.light_id, desired_size_idx, atlas_light.num_slots });
 			if(atlas_light.num_slots == 1)
 				break;  // not even a sincle-slot could be alllocated
 		}
 	}
+}
 
-	return counters;
+ShadowAtlas::SlotConfig ShadowAtlas::point_slot_config(LightID light_id, float edge_distance) const
+{
+	if(auto found = _point_projection.find(light_id); found != _point_projection.end())
+		return found->second;
+
+	// the band of the current allocation; it's a bit easier to stay in it than to enter it
+	//   i.e. a light near a band's edge doesn't toggle between the projections
+	uint32_t current_band { 0 };
+	if(auto found = _id_to_allocated.find(light_id); found != _id_to_allocated.end())
+	{
+		if(found->second.slot_config == SlotConfig::Tetrahedral)
+			current_band = 1;
+		else if(found->second.slot_config == SlotConfig::DualParaboloid)
+			current_band = 2;
+	}
+	const auto band_start = [current_band](float start, uint32_t band) {
+		return start + (current_band >= band? -s_point_band_hysteresis: s_point_band_hysteresis);
+	};
+
+	const auto normalized_dist = edge_distance / _max_distance;
+	if(normalized_dist >= band_start(_point_band_paraboloid, 2))
+		return SlotConfig::DualParaboloid;
+	if(normalized_dist >= band_start(_point_band_tetrahedral, 1))
+		return SlotConfig::Tetrahedral;
+	return SlotConfig::Cube;
 }
 
-ShadowAtlas::Counters ShadowAtlas::apply_desired_slots(const std::vector<AtlasLight> &desired_slots, const TimeT now)
+ShadowAtlas::Counters ShadowAtlas::apply_desired_slots(const std::vector<AtlasLight> &desired_slots, const TimeT now, bool stale)
 {
 	// std::puts("-- apply_desired_slots()");
 
@@ -961,20 +1544,22 @@ ShadowAtlas::Counters ShadowAtlas::apply_desired_slots(const std::vector<AtlasLi
 			auto &atlas_light = found->second;
 
 			const auto size_diff = int32_t(desired.slots[0].size) - int32_t(atlas_light.slots[0].size);
+			// a point light's projection changed (e.g. cube -> tetrahedral), i.e. the number of slots
+			const auto config_changed = desired.slot_config != atlas_light.slot_config;
 			const auto change_age = now - atlas_light._last_size_change;
 
-			if(size_diff == 0 or change_age < _min_change_interval or not has_slots_available(desired, size_promised))
+			if((size_diff == 0 and not config_changed) or change_age < _min_change_interval or not has_slots_available(desired, size_promised))
 			{
 				++counters.retained;
 
-				if(size_diff != 0)
+				if(size_diff != 0 or config_changed)
 					++counters.change_pending;
 			}
 			else
 			{
 				changed_size.push_back(uint32_t(desired_index));
 
-				if(size_diff > 0)
+				if(size_diff > 0 or (size_diff == 0 and desired.num_slots > atlas_light.num_slots))
 					++counters.promoted;
 				else
 					++counters.demoted;
@@ -990,9 +1575,16 @@ ShadowAtlas::Counters ShadowAtlas::apply_desired_slots(const std::vector<AtlasLi
 				{
 					const auto &slot = atlas_light.slots[idx];
 					free_slot(slot.size, slot.node_index);
-
-					// and we promise to allocate the new size later (loop below)
+				}
+				// and we promise to allocate the new size later (loop below)
+				for(idx = 0; idx < desired.num_slots; ++idx)
 					++size_promised[slot_size_idx(desired.slots[idx].size)];
+
+				if(config_changed)
+				{
+					// the slots' views are different now
+					for(auto slot = 0u; slot < atlas_light.num_slots; ++slot)
+						_light_pvs.erase(LIGHT_PVS_KEY(light_id, slot));
 				}
 
 				// TODO: possible to blit-copy the existing rendered slots to the new ones for demotions
@@ -1017,6 +1609,8 @@ ShadowAtlas::Counters ShadowAtlas::apply_desired_slots(const std::vector<AtlasLi
 
 		// std::print("  [{}] alloc {} slots:  pro/de -> {}", light_id, atlas_light.num_slots, desired.slots[0].size);
 		// std::fflush(stdout);
+		atlas_light.slot_config = desired.slot_config;
+		atlas_light.num_slots   = desired.num_slots;
 		for(auto idx = 0u; idx < atlas_light.num_slots; ++idx)
 		{
 			auto &slot = atlas_light.slots[idx];
@@ -1050,6 +1644,13 @@ ShadowAtlas::Counters ShadowAtlas::apply_desired_slots(const std::vector<AtlasLi
 
 			if(not has_slots_available(desired, size_promised))
 			{
+				if(stale)
+				{
+					// planned for a different distribution; it'll sort itself out in the next plan
+					++counters.denied;
+					continue;
+				}
+
 				// this should not happen, I think...
 
 				if(remove_allocation(light_id))
@@ -1115,6 +1716,19 @@ void ShadowAtlas::switch_slots_set(SlotSetCategory to)
 
 	clear();
 	_current_slot_set = to;
+
+	// nothing allocated; start over from the configured distribution
+	auto &slots_set = _slots_sets[to];
+	slots_set.distribution = slots_set.configured;
+	slots_set.available_slots = slots_set.configured_slots;
+	slots_set.total_num_slots = 0;
+	for(const auto &free_slots: slots_set.available_slots)
+		slots_set.total_num_slots += uint32_t(free_slots.size());
+
+	_denied.clear();
+	_defrag_moves.clear();
+	_defrag_parent = allocator_t::BadIndex;
+	_pending_splits.clear();
 }
 
 std::string ShadowAtlas::sizes_count_summary(const small_vec<uint32_t, 6> &size_counts) const
@@ -1285,6 +1899,264 @@ void ShadowAtlas::free_all_slots(const AtlasLight &atlas_light)
 	}
 }
 
+uint32_t ShadowAtlas::defragment()
+{
+	_defrag_stats = {};
+
+	// lights that were denied a slot; split free, larger slots (no copying involved)
+	const auto had_denied = not _denied.empty();
+	for(const auto &demand: _denied)
+		split_for(demand);
+	_denied.clear();  // the next compute_desired() records them again, if still denied
+
+	if(had_denied)
+	{
+		// merging now would only undo the split(s)
+		_defrag_moves.clear();
+		_defrag_parent = allocator_t::BadIndex;
+	}
+	else if(_defrag_moves.empty() and _defrag_parent == allocator_t::BadIndex)
+		plan_merge();
+
+	// relocate slots, within the budget (but at least one per call, to always progress)
+	size_t bytes_copied { 0 };
+	auto num_done = 0u;
+	for(const auto &move: _defrag_moves)
+	{
+		if(move_slot(move, bytes_copied) == MoveResult::OverBudget)
+			break;
+		++num_done;
+	}
+	_defrag_moves.erase(_defrag_moves.begin(), _defrag_moves.begin() + num_done);
+
+	if(_defrag_moves.empty() and _defrag_parent != allocator_t::BadIndex)
+	{
+		// if a move was invalidated (e.g. its destination got allocated), it's simply planned again
+		merge_slots(_defrag_tier, _defrag_parent);
+		_defrag_parent = allocator_t::BadIndex;
+	}
+
+	_defrag_stats.bytes = bytes_copied;
+	_defrag_stats.pending = _defrag_moves.size();
+
+	if(_defrag_stats.splits or _defrag_stats.merges)
+		Log::debug("atlas| defragment: {} split, {} merged, {} moved ({} kB)", _defrag_stats.splits, _defrag_stats.merges, _defrag_stats.moves, bytes_copied >> 10);
+
+	return _defrag_stats.moves;
+}
+
+bool ShadowAtlas::split_for(const SlotDemand &demand)
+{
+	auto &available = curr_available();
+	auto &distribution = curr_distribution();
+	const auto num_tiers = uint32_t(available.size());
+	const auto target_idx = std::min(demand.size_idx, num_tiers - 1);
+
+	auto has_room = [&]() {
+		for(auto size_idx = target_idx; size_idx < num_tiers; ++size_idx)
+		{
+			if(available[size_idx].size() >= demand.num_slots)
+				return true;
+		}
+		return false;
+	};
+
+	while(not has_room())
+	{
+		// the nearest larger tier with a free slot (the largest tiers are reserved, e.g. for the sun's cascades)
+		auto donor_idx = target_idx;
+		do
+		{
+			if(donor_idx <= s_normal_shadow_shift)
+				return false;
+			--donor_idx;
+		}
+		while(available[donor_idx].empty());
+
+		auto &donor = available[donor_idx];
+		const auto parent = donor.back();
+		donor.pop_back();
+		_pending_splits.push_back({ donor_idx + 1, _snapshot_generation });
+
+		--distribution[donor_idx];
+		distribution[donor_idx + 1] += 4;
+		_slots_sets[_current_slot_set].total_num_slots += 3;
+
+		auto &children = available[donor_idx + 1];
+		children.reserve(distribution[donor_idx + 1]);
+		const auto first_child = _allocator.child_index(parent);
+		for(auto child = first_child; child < first_child + 4; ++child)
+			children.push_back(child);
+
+		++_defrag_stats.splits;
+	}
+
+	return true;
+}
+
+bool ShadowAtlas::plan_merge()
+{
+	const auto &distribution = curr_distribution();
+	const auto &configured = _slots_sets[_current_slot_set].configured;
+	const auto &available = curr_available();
+
+	auto &groups = _merge_groups;
+	auto &destinations = _merge_destinations;
+
+	// smallest tier first; its sibling groups might contain slots that were split further
+	for(auto size_idx = uint32_t(available.size()) - 1; size_idx > s_normal_shadow_shift; --size_idx)
+	{
+		if(distribution[size_idx - 1] >= configured[size_idx - 1])
+			continue;  // nothing was split from the tier above
+		if(std::ranges::contains(_pending_splits, size_idx, &PendingSplit::size_idx))
+			continue;  // split for denied lights, but not yet seen by a plan
+
+		const auto &free_slots = available[size_idx];
+
+		groups.clear();
+		for(const auto node_index: free_slots)
+			++groups[_allocator.parent_index(node_index)].num_free;
+		for(const auto &[light_id, atlas_light]: _id_to_allocated)
+		{
+			for(auto idx = 0u; idx < atlas_light.num_slots; ++idx)
+			{
+				const auto &slot = atlas_light.slots[idx];
+				if(slot_size_idx(slot.size) == size_idx)
+					++groups[_allocator.parent_index(slot.node_index)].num_live;
+			}
+		}
+
+		// the complete sibling group requiring the fewest moves
+		auto parent = allocator_t::BadIndex;
+		MergeGroup best;
+		for(const auto &[group_parent, group]: groups)
+		{
+			if(group.num_free + group.num_live != 4)
+				continue;
+			if(parent == allocator_t::BadIndex or group.num_live < best.num_live)
+			{
+				parent = group_parent;
+				best = group;
+			}
+		}
+		if(parent == allocator_t::BadIndex or free_slots.size() - best.num_free < best.num_live)
+			continue;
+
+		_defrag_tier = size_idx;
+		_defrag_parent = parent;
+
+		if(best.num_live == 0)
+			return true;  // merged right away
+
+		// move into the most occupied groups first, to keep free slots together
+		destinations.clear();
+		for(const auto node_index: free_slots)
+		{
+			if(_allocator.parent_index(node_index) != parent)
+				destinations.push_back(node_index);
+		}
+		std::ranges::sort(destinations, [this, &groups](SlotID A, SlotID B) {
+			return groups[_allocator.parent_index(A)].num_free < groups[_allocator.parent_index(B)].num_free;
+		});
+
+		auto dest_iter = destinations.begin();
+		for(const auto &[light_id, atlas_light]: _id_to_allocated)
+		{
+			for(auto idx = 0u; idx < atlas_light.num_slots; ++idx)
+			{
+				const auto &slot = atlas_light.slots[idx];
+				if(slot_size_idx(slot.size) == size_idx and _allocator.parent_index(slot.node_index) == parent)
+					_defrag_moves.push_back({ light_id, uint_fast8_t(idx), slot.node_index, *dest_iter++ });
+			}
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+bool ShadowAtlas::merge_slots(uint32_t size_idx, SlotID parent)
+{
+	auto &available = curr_available();
+	auto &distribution = curr_distribution();
+
+	auto &children = available[size_idx];
+	const auto first_child = _allocator.child_index(parent);
+	auto is_sibling = [first_child](SlotID node_index) {
+		return node_index >= first_child and node_index < first_child + 4;
+	};
+
+	if(std::ranges::count_if(children, is_sibling) != 4)
+		return false;  // not all free (anymore)
+
+	std::erase_if(children, is_sibling);
+	distribution[size_idx] -= 4;
+	++distribution[size_idx - 1];
+	_slots_sets[_current_slot_set].total_num_slots -= 3;
+
+	auto &merged = available[size_idx - 1];
+	merged.reserve(distribution[size_idx - 1]);
+	merged.push_back(parent);
+
+	++_defrag_stats.merges;
+
+	return true;
+}
+
+ShadowAtlas::MoveResult ShadowAtlas::move_slot(const SlotMove &move, size_t &bytes_copied)
+{
+	auto found = _id_to_allocated.find(move.light_id);
+	if(found == _id_to_allocated.end())
+		return MoveResult::Invalid;
+
+	auto &atlas_light = found->second;
+	if(move.slot_idx >= atlas_light.num_slots)
+		return MoveResult::Invalid;
+
+	auto &slot = atlas_light.slots[move.slot_idx];
+	if(slot.node_index != move.from)
+		return MoveResult::Invalid;
+
+	auto &free_slots = curr_available()[slot_size_idx(slot.size)];
+	auto dest_iter = std::ranges::find(free_slots, move.to);
+	if(dest_iter == free_slots.end())
+		return MoveResult::Invalid;
+
+	const auto &src_rect = slot.rect;
+	const auto dest_rect = mk_rect(_allocator.rect(move.to));
+
+	// if it'll be rendered anyway, there's nothing worth copying
+	if(not atlas_light.is_dirty())
+	{
+		const auto num_bytes = size_t(src_rect.z) * src_rect.w * s_atlas_texel_bytes;
+		if(bytes_copied > 0 and bytes_copied + num_bytes > _defrag_budget)
+			return MoveResult::OverBudget;
+
+		for(const auto texture_id: { color_texture().texture_id(), depth_texture().texture_id() })
+		{
+			glCopyImageSubData(texture_id, GL_TEXTURE_2D,
+							   0, // mip
+							   GLint(src_rect.x), GLint(src_rect.y), 0,
+							   texture_id, GL_TEXTURE_2D,
+							   0, // mip
+							   GLint(dest_rect.x), GLint(dest_rect.y), 0,
+							   GLsizei(src_rect.z),
+							   GLsizei(src_rect.w),
+							   1);
+		}
+		bytes_copied += num_bytes;
+	}
+
+	*dest_iter = move.from;  // the vacated slot takes its place in the pool
+	slot.node_index = move.to;
+	slot.rect = dest_rect;
+
+	++_defrag_stats.moves;
+
+	return MoveResult::Moved;
+}
+
 void ShadowAtlas::generate_slots(std::initializer_list<uint32_t> distribution, SlotSetCategory slots_cat)
 {
 	const auto T0 = steady_clock::now();
@@ -1358,6 +2230,9 @@ void ShadowAtlas::generate_slots(std::initializer_list<uint32_t> distribution, S
 	// write number of smallest-sized slots
 	slots_set.distribution.push_back(uint32_t(free_slots.size()));
 
+	slots_set.configured = slots_set.distribution;
+	slots_set.configured_slots = slots_set.available_slots;
+
 	const auto Td = steady_clock::now() - T0;
 
 	Log::info("atlas| {} slots defined for '{}', in {}", slots_set.total_num_slots, slots_cat == NoSunSlots?"no sun":"with sun", duration_cast<microseconds>(Td));
@@ -1,15 +1,23 @@
 #pragma once
 
 #include "bounds.h"
+#include "caster_volume.h"
 #include "rendertarget_2d.h"
 #include "container_types.h"
 #include "spatial_allocator.h"
 #include "lights.h"
+#include "scene.h"
 #include "ssbo.h"
 
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
 
+#include <future>
+#include <limits>
+#include <span>
+
 #include "generated/shared-structs.h"
 
 struct GPULight;
@@ -19,8 +27,7 @@ namespace RGL
 class LightManager;
 struct LightWrapper;
 class Camera;
-class Scene;
-struct QueryResult;
+class VirtualShadowMaps;
 
 
 class ShadowAtlas : public RenderTarget::Texture2d
@@ -52,9 +59,11 @@ public:
 	static_assert(sizeof(SlotDef) == 24);
 	enum class SlotConfig : uint_fast8_t
 	{
-		Cube     = 6,
-		Single   = 1,
-		Cascades = 3,
+		Cube           = 6,
+		Single         = 1,
+		Cascades       = 3,
+		Tetrahedral    = 4,  // point lights; 4 wide (~144 deg) frustums
+		DualParaboloid = 2,  // point lights; 2 hemispheres, warped in shadow_depth.vert
 	};
 	struct AtlasLight
 	{
@@ -101,12 +110,47 @@ public:
 		// std::array<glm::vec2, MAX_CASCADES> depth_range;
 		std::array<glm::vec2, MAX_CASCADES> near_far_plane;
 		std::array<bounds::AABB, MAX_CASCADES> view_aabb;
+		std::array<size_t, MAX_CASCADES> cascade_hash {};  // of the view-projection; changes when it moved (e.g. a snapped texel)
 		float light_radius_uv;
 
 		inline operator bool () const { return num_cascades >= 1 and num_cascades <= 4; }
 		inline void clear() { num_cascades = 0; }
 	};
 
+	struct Counters
+	{
+		inline Counters() :
+			allocated(0),
+			retained(0),
+			dropped(0),
+			denied(0),
+			promoted(0),
+			demoted(0),
+			change_pending(0)
+		{}
+		uint32_t allocated;
+		uint32_t retained;
+		uint32_t dropped;
+		uint32_t denied;
+		uint32_t promoted;
+		uint32_t demoted;
+		uint32_t change_pending;
+
+		inline Counters &operator += (const Counters &other)
+		{
+			allocated += other.allocated;
+			retained += other.retained;
+			dropped += other.dropped;
+			denied += other.denied;
+			promoted += other.promoted;
+			demoted += other.demoted;
+			change_pending += other.change_pending;
+			return *this;
+		}
+
+		inline uint32_t changed() const { return allocated + dropped + promoted + demoted; }
+	};
+
 public:
 
 	// TODO: specify which channels to use (e.g. depth & normals) ?
@@ -125,7 +169,28 @@ public:
 		_max_distance = std::max(max_distance, 10.f);
 		_large_light_radius = _max_distance;
 	}
+	// point lights further away than these fractions of the max distance use fewer slots;
+	//   tetrahedral (4 slots) and dual-paraboloid (2 slots) projections, instead of the cube (6 slots)
+	inline void set_point_projection_bands(float tetrahedral, float dual_paraboloid)
+	{
+		assert(tetrahedral >= 0 and dual_paraboloid >= tetrahedral);
+		_point_band_tetrahedral = tetrahedral;
+		_point_band_paraboloid = dual_paraboloid;
+	}
+	// per light; overrides the distance bands (Cube, Tetrahedral or DualParaboloid)
+	inline void set_point_projection(LightID light_id, SlotConfig config)
+	{
+		assert(config == SlotConfig::Cube or config == SlotConfig::Tetrahedral or config == SlotConfig::DualParaboloid);
+		_point_projection[light_id] = config;
+	}
+	inline void clear_point_projection(LightID light_id) { _point_projection.erase(light_id); }
 	inline void set_min_change_interval(std::chrono::milliseconds interval) { _min_change_interval = std::max(interval, std::chrono::milliseconds(100)); }
+	// minimum interval a slot of a size tier (0 = largest) is re-rendered; if only static objects are in view
+	inline void set_render_interval(uint32_t size_idx, uint32_t skip_frames, std::chrono::milliseconds interval)
+	{
+		assert(size_idx < _render_intervals.size());
+		_render_intervals[size_idx] = { skip_frames, interval };
+	}
 	inline void set_sun_cascades(uint_fast8_t num_cascades) {
 		assert(num_cascades >= 1 and num_cascades <= MAX_CASCADES);
 		_sun_num_cascades = num_cascades;
@@ -134,11 +199,61 @@ public:
 	inline void set_csm_backoff(float backoff) { _csm_cascade_backoff = backoff; }
 	inline bool csm_stabilization() const { return _csm_stabilization; }
 	inline void set_csm_stabilization(bool enabled) { _csm_stabilization = enabled; }
+	// a moved cascade is updated (and re-rendered) at most every N update_csm_params() calls (i.e. frames)
+	inline void set_csm_update_interval(uint32_t cascade, uint32_t frames)
+	{
+		assert(cascade < MAX_CASCADES);
+		_csm_update_intervals[cascade] = std::max(frames, 1u);
+	}
 
-	uint32_t update_allocations(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos, const glm::vec3 &view_forward);
+	// Sample distribution shadow maps (SDSM): cascade splits & bounds fitted to the visible samples,
+	//   i.e. a reduction of the depth pre-pass (see shadow_depth_reduce.comp), instead of the whole view frustum.
+	//   Falls back to the frustum slices when there's no (recent) reduction result.
+	static constexpr size_t SDSM_REDUCTION_SIZE = 2 + MAX_CASCADES*4;  // depth min/max, light-space rect per cascade
+	struct SDSMReduceParams
+	{
+		glm::mat3 light_rotation;                     // world -> light space (rotation only)
+		std::array<float, MAX_CASCADES> split_depth;  // view distance to the far side of each cascade
+		uint32_t num_cascades { 0 };
+	};
+	inline bool sdsm() const { return _sdsm; }
+	inline void set_sdsm(bool enabled) { _sdsm = enabled; _sdsm_bounds.valid = false; }
+	// parameters of the reduction of 'frame', i.e. after update_csm_params(); remembered until its result arrives
+	const SDSMReduceParams &sdsm_reduce_params(uint64_t frame);
+	// the reduction's result; typically a frame or two late (see buffer::AsyncReadBack)
+	void set_sdsm_reduction(uint64_t frame, std::span<const uint32_t, SDSM_REDUCTION_SIZE> reduced);
+	// view distance range of the visible samples, used by the latest update_csm_params(); zero if not used
+	inline glm::vec2 sdsm_depth_range() const { return _sdsm_depth_range; }
+
+	uint32_t update_allocations(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos, const glm::vec3 &view_forward, TimeT now=std::chrono::steady_clock::now());
+	// same as above, but the planning (light valuation & slot distribution) runs on a worker thread.
+	//   a finished plan (from a previous call) is applied first, then a new one is started.
+	//   returns the number of changes applied, i.e. 0 while a plan is still in progress.
+	uint32_t update_allocations_async(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos, const glm::vec3 &view_forward);
 
 	[[nodiscard]] const dense_map<LightID, AtlasLight> &allocated_lights() const { return _id_to_allocated; }
+	// of the latest applied allocations update
+	[[nodiscard]] inline const Counters &last_counters() const { return _last_counters; }
 	[[nodiscard]] SlotMask need_render(const AtlasLight &atlas_light, TimeT now, size_t hash, const Scene &scene) const;
+	// call after rendering the slots returned by need_render()
+	void on_rendered(const AtlasLight &atlas_light, TimeT now, size_t hash, SlotMask rendered) const;
+
+	// Incremental defragmentation; call every frame, before update_slots_ssbo().
+	//   Lights denied a slot get one by splitting a free, larger slot. Split tiers are merged back when
+	//   possible (but not before an allocation plan has seen the split), by relocating the (rendered)
+	//   slots of a sibling group (GPU copy, no re-render), at most 'defrag budget' bytes copied per call.
+	//   returns the number of slots moved
+	uint32_t defragment();
+	inline void set_defrag_budget(size_t bytes) { _defrag_budget = bytes; }
+	struct DefragStats
+	{
+		uint32_t moves { 0 };
+		uint32_t splits { 0 };
+		uint32_t merges { 0 };
+		size_t   bytes { 0 };    // copied
+		size_t   pending { 0 };  // moves queued
+	};
+	inline const DefragStats &defrag_stats() const { return _defrag_stats; }
 
 	void update_slots_ssbo();
 	const CSMParams &update_csm_params(LightID light_id, const Camera &camera);//, float radius_uv=0.5f);
@@ -158,40 +273,70 @@ public:
 
 	const QueryResult &pvs(const Scene &scene, LightID light_id, uint_fast8_t slot_idx=0) const;
 
-private:
-	struct Counters
+	// Receiver-aware caster culling: the casters of pvs() are culled to those that may cast a shadow into
+	//   the receiver volume (i.e. the view), see CasterVolume. The sun's cascades use their slice of the view.
+	//   A slot's casters are culled when it's rendered. A (static) slot that isn't due is re-rendered when its
+	//   set gains casters it wasn't rendered with; only those are tested, and only when the light's query was
+	//   refreshed or the receiver volume moved (noticeably). Casters leaving the set are still in the map, which is fine.
+	inline bool caster_culling() const { return _caster_culling; }
+	inline void set_caster_culling(bool enabled) { _caster_culling = enabled; ++_receiver_generation; }
+	// the camera's view, up to 'max_distance'; call every frame, before pvs()
+	void set_receiver_volume(const Camera &camera, float max_distance);
+	struct CasterCullStats
 	{
-		inline Counters() :
-			allocated(0),
-			retained(0),
-			dropped(0),
-			denied(0),
-			promoted(0),
-			demoted(0),
-			change_pending(0)
-		{}
-		uint32_t allocated;
-		uint32_t retained;
-		uint32_t dropped;
-		uint32_t denied;
-		uint32_t promoted;
-		uint32_t demoted;
-		uint32_t change_pending;
+		uint32_t casters { 0 };  // in the light's volume
+		uint32_t culled { 0 };   // of those, can't shadow the view
+	};
+	// of the latest culls of the light's slots
+	[[nodiscard]] CasterCullStats caster_cull_stats(LightID light_id) const;
+	[[nodiscard]] CasterCullStats caster_cull_totals() const;
+	// the caster culling work of the previous frame (i.e. between set_receiver_volume() calls)
+	struct CasterCullCounters
+	{
+		uint32_t culls { 0 };    // slots culled for rendering, see pvs()
+		uint32_t checks { 0 };   // slots checked for new casters, see need_render()
+		uint32_t skipped { 0 };  // checks answered by the previous one (nothing changed)
+		uint32_t tested { 0 };   // casters tested against a caster volume
+	};
+	[[nodiscard]] inline const CasterCullCounters &caster_cull_counters() const { return _last_cull_counters; }
+	// whether any of the light's slots (latest queries) has dynamic casters, i.e. its shadows may change any frame
+	[[nodiscard]] bool has_dynamic_casters(LightID light_id) const;
 
-		inline Counters &operator += (const Counters &other)
+	struct LightViewProjection
+	{
+		glm::mat4 projection;
+		glm::mat4 view;
+		float near_z;
+		float far_z;
+	};
+	// of a point light's face 'idx' (of the 'config' projection), or a spot light
+	//   a DualParaboloid 'projection' is only a scale (1/far); the warp is done by the shaders
+	LightViewProjection light_view_projection(const LightWrapper &light, uint32_t idx=0, SlotConfig config=SlotConfig::Cube) const;
+
+	// a slot's resolution, to pick the casters' level of detail (see StaticModel::has_shadow_proxy())
+	//   the default is infinitely fine, i.e. always full detail
+	struct SlotTexelScale
+	{
+		glm::vec3 eye { 0 };
+		float texels_per_unit { std::numeric_limits<float>::infinity() };  // at unit distance from 'eye' (perspective), or anywhere
+		bool perspective { false };
+
+		// approx. size of 'sphere' in the slot
+		inline float texels(const bounds::Sphere &sphere) const
 		{
-			allocated += other.allocated;
-			retained += other.retained;
-			dropped += other.dropped;
-			denied += other.denied;
-			promoted += other.promoted;
-			demoted += other.demoted;
-			change_pending += other.change_pending;
-			return *this;
+			const auto diameter = 2*sphere.radius();
+			if(not perspective)
+				return diameter*texels_per_unit;
+			const auto distance = glm::distance(eye, sphere.center()) - sphere.radius();  // to the nearest point
+			return distance > 0? diameter*texels_per_unit / distance: std::numeric_limits<float>::infinity();
 		}
-
-		inline uint32_t changed() const { return allocated + dropped + promoted + demoted; }
 	};
+	SlotTexelScale slot_texel_scale(const AtlasLight &atlas_light, uint_fast8_t slot_idx) const;
+
+	// lights shadowed by virtual maps get their ShadowSlotInfo entries in update_slots_ssbo() as well
+	inline void set_virtual_maps(const VirtualShadowMaps *virtual_maps) { _virtual_maps = virtual_maps; }
+
+private:
 	struct ValueLight
 	{
 		float value;
@@ -201,37 +346,114 @@ private:
 		inline bool operator > (const ValueLight &that) const { return value > that.value; }
 	};
 	static_assert(sizeof(ValueLight) == 12);
+	struct SlotDemand
+	{
+		LightID  light_id;
+		uint32_t size_idx;   // largest slot size tier the light may use
+		uint32_t num_slots;
+	};
+	struct ValueParams
+	{
+		float max_distance;
+		float large_light_radius;
+	};
+	// everything the planning needs, snapshotted on the calling thread (see update_allocations_async())
+	struct AllocationPlan
+	{
+		struct Candidate
+		{
+			bounds::Sphere sphere;
+			LightID light_id;
+			SlotConfig config;
+		};
+		// input
+		uint32_t                 slots_set;
+		small_vec<uint32_t, 6>   distribution;
+		std::vector<Candidate>   candidates;
+		ValueLight               sun { 0.f, NO_LIGHT_ID, SlotConfig::Cascades };
+		glm::vec3                view_pos;
+		glm::vec3                view_forward;
+		ValueParams              value_params;
+		uint_fast8_t             sun_num_cascades;
+		TimeT                    now;         // for the change intervals
+		TimeT                    start_time;  // for the timing log
+		uint32_t                 generation { 0 };  // see _pending_splits
+		// output
+		std::vector<ValueLight>  valued;   // highest value first
+		std::vector<AtlasLight>  desired;
+		std::vector<LightID>     drop;     // not in the top K, remove any allocation
+		small_vec<SlotDemand, 8> denied;   // won't fit, remove any allocation
+		uint32_t                 num_unseen { 0 };
+	};
 	struct SlotsSet
 	{
 		small_vec<uint32_t, 6>            distribution;  // slot counts for each of the levels (from largest to smallest)
 		small_vec<std::vector<SlotID>, 6> available_slots;
 		uint32_t total_num_slots { 0 };
+		// as generated; distribution & available_slots are changed by the defragmentation (split/merge)
+		small_vec<uint32_t, 6>            configured;
+		small_vec<std::vector<SlotID>, 6> configured_slots;
 	};
 	enum SlotSetCategory { NoSunSlots, WithSunSlots };
 
-	void evaluate_lights(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos, const glm::vec3 &view_forward, std::vector<ValueLight> &prioritized, dense_set<LightID> &seen_lights);
-	float evaluate_light(const bounds::Sphere &light_sphere, const glm::vec3 &view_pos, const glm::vec3 &view_forward) const;
-	Counters compute_desired(const std::vector<ValueLight> &valued_lights, std::vector<AtlasLight> &desired_slots);
-	Counters apply_desired_slots(const std::vector<AtlasLight> &desired_slots, TimeT now);
+	void snapshot(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos, const glm::vec3 &view_forward, TimeT now, AllocationPlan &plan);
+	void plan_allocations(AllocationPlan &plan) const;  // no side effects, may run on any thread
+	uint32_t apply_plan(AllocationPlan &plan);
+	void evaluate_lights(AllocationPlan &plan) const;
+	static float evaluate_light(const bounds::Sphere &light_sphere, const glm::vec3 &view_pos, const glm::vec3 &view_forward, const ValueParams &params);
+	void compute_desired(AllocationPlan &plan) const;
+	SlotConfig point_slot_config(LightID light_id, float edge_distance) const;
+	Counters apply_desired_slots(const std::vector<AtlasLight> &desired_slots, TimeT now, bool stale);
 	void log_changes(const Counters &counters, size_t num_prio, TimeT start_time);
 	void generate_slots(std::initializer_list<uint32_t> distribution, SlotSetCategory slots_cat);
 	bool has_slots_available(const AtlasLight &atlas_light, const small_vec<uint32_t, 6> &num_promised) const;
 	SlotID alloc_slot(SlotSize slot_size, bool first=true);
 	void free_slot(SlotSize slot_size, SlotID node_index);
 	void free_all_slots(const AtlasLight &atlas_light);
-	struct LightViewProjection
+
+	struct SlotMove
 	{
-		glm::mat4 projection;
-		glm::mat4 view;
-		float near_z;
-		float far_z;
+		LightID light_id;
+		uint_fast8_t slot_idx;
+		SlotID from;
+		SlotID to;
 	};
-	LightViewProjection light_view_projection(const LightWrapper &light, uint32_t idx=0) const;
+	bool split_for(const SlotDemand &demand);
+	bool plan_merge();
+	bool merge_slots(uint32_t size_idx, SlotID parent);
+	enum class MoveResult { Moved, Invalid, OverBudget };
+	MoveResult move_slot(const SlotMove &move, size_t &bytes_copied);
 	std::string sizes_count_summary(const AtlasLight &atlas_light) const;
 	std::string sizes_count_summary(const small_vec<uint32_t, 6> &size_counts) const;
 
+	struct SlotPVS
+	{
+		QueryResult query;    // the light's volume
+		QueryResult objects;  // of those, the casters that may shadow the view; culled by pvs()
+		CasterCullStats culling;
+		struct Stamp
+		{
+			TimeT query_at;               // 'query.created_at'
+			uint32_t generation { ~0u };  // '_receiver_generation'
+			bool operator == (const Stamp &) const = default;
+		};
+		Stamp culled;   // of 'objects'
+		Stamp checked;  // of 'stale'
+		bool stale { false };            // see has_new_casters()
+		bool dynamic_casters { false };  // of the latest cull or check
+		bool directional { false };      // i.e. a cascade
+		glm::vec3 light_position;        // of the latest query (point & spot lights)
+		EntityList rendered;  // the static casters when last rendered (sorted)
+	};
+	// refreshes the slot's query, at the scene's interval (not its culling)
+	SlotPVS &slot_pvs(const Scene &scene, LightID light_id, uint_fast8_t slot_idx) const;
+	CasterVolume caster_volume(const SlotPVS &slot, uint_fast8_t slot_idx) const;
+	// whether the slot's casters include any dynamic ones, or static ones it wasn't rendered with
+	bool has_new_casters(const Scene &scene, SlotPVS &slot, uint_fast8_t slot_idx) const;
+
 private:
 	LightManager &_lights;  // one could argue that the association should be the other way around...
+	const VirtualShadowMaps *_virtual_maps { nullptr };
 
 	SlotSetCategory _current_slot_set { NoSunSlots };
 	std::array<SlotsSet, 2> _slots_sets;
@@ -249,10 +471,32 @@ private:
 	bool _csm_stabilization { true };
 	float _csm_light_radius_uv { 0.5f };
 	CSMParams _csm_params;
+	size_t _csm_inputs_hash { 0 };  // of the latest update_csm_params(); unchanged -> nothing to do
+	std::array<uint32_t, MAX_CASCADES> _csm_update_intervals { 1, 1, 2, 4 };
+	std::array<uint32_t, MAX_CASCADES> _csm_deferred {};  // calls a moved cascade was not updated
+	mutable std::array<size_t, MAX_CASCADES> _csm_rendered_hash {};  // 'cascade_hash' when last rendered
+
+	struct SDSMBounds
+	{
+		bool valid { false };
+		uint32_t age { 0 };                            // update_csm_params() calls since received
+		glm::vec2 depth_range;                         // min, max view distance of the visible samples
+		std::array<glm::vec4, MAX_CASCADES> rect_ls;   // min xy, max xy (light space); empty if min > max
+		SDSMReduceParams params;                       // what the reduction used
+	};
+	bool _sdsm { false };
+	uint32_t _sdsm_generation { 0 };  // received reductions
+	SDSMReduceParams _sdsm_params;  // of the latest update_csm_params()
+	SDSMBounds _sdsm_bounds;
+	std::array<std::pair<uint64_t, SDSMReduceParams>, 4> _sdsm_in_flight {};
+	glm::vec2 _sdsm_depth_range { 0 };
 
 	float _min_light_radius { .5f };
 	float _max_distance { 50.f };
 	float _large_light_radius { 50.f };
+	float _point_band_tetrahedral { 1.f };  // fraction of '_max_distance'; i.e. beyond it, never
+	float _point_band_paraboloid { 1.f };
+	dense_map<LightID, SlotConfig> _point_projection;  // per-light overrides
 
 	// shortest interval an allocated slot can change size (toggle)
 	std::chrono::milliseconds _min_change_interval;
@@ -260,7 +504,46 @@ private:
 
 	buffer::Storage<ShadowSlotInfo> _shadow_slots_info_ssbo;
 
-	mutable dense_map<uint32_t, QueryResult> _light_pvs;
+	AllocationPlan _plan;
+	std::future<void> _plan_done;
+	std::vector<LightID> _scratch_ids;
+	dense_set<LightID> _seen_lights;
+	Counters _last_counters;
+
+	small_vec<SlotDemand, 8> _denied;  // from the latest compute_desired()
+	std::vector<SlotMove> _defrag_moves;
+	uint32_t _defrag_tier { 0 };       // size tier of the sibling group being merged
+	// plan_merge() scratch
+	struct MergeGroup
+	{
+		uint32_t num_free { 0 };
+		uint32_t num_live { 0 };
+	};
+	dense_map<SlotID, MergeGroup> _merge_groups;  // by parent
+	std::vector<SlotID> _merge_destinations;
+	SlotID _defrag_parent { allocator_t::BadIndex };
+	size_t _defrag_budget { 8 << 20 };
+	DefragStats _defrag_stats;
+	// splits for denied lights; their tiers aren't merged until a plan snapshotted after the split was applied
+	//   (otherwise a merge would undo the split before a plan could allocate from it)
+	struct PendingSplit
+	{
+		uint32_t size_idx;    // of the resulting slots
+		uint32_t generation;  // of the latest snapshot before the split
+	};
+	std::vector<PendingSplit> _pending_splits;
+	uint32_t _snapshot_generation { 0 };
+
+	mutable dense_map<uint32_t, SlotPVS> _light_pvs;
+	bool _caster_culling { true };
+	bool _receiver_valid { false };
+	uint32_t _receiver_generation { 0 };  // changed receiver (or cascade) volumes; see pvs()
+	CasterVolume::Corners _receiver_corners;
+	std::array<CasterVolume, MAX_CASCADES> _csm_caster_volumes;
+	std::array<CasterVolume::Corners, MAX_CASCADES> _csm_caster_corners {};
+	std::array<glm::vec3, MAX_CASCADES> _csm_caster_directions {};
+	mutable CasterCullCounters _cull_counters;
+	CasterCullCounters _last_cull_counters;
 
 	SpatialAllocator<uint32_t> _allocator;
 };
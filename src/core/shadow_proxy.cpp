@@ -0,0 +1,111 @@
+#include "shadow_proxy.h"
+
+#include "container_types.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace RGL
+{
+
+ShadowProxyMesh simplify_for_shadows(std::span<const glm::vec3> positions, std::span<const glm::vec3> normals, std::span<const uint32_t> indices, uint32_t grid_cells)
+{
+	assert(normals.empty() or normals.size() == positions.size());
+	assert(indices.size() % 3 == 0);
+
+	ShadowProxyMesh proxy;
+	if(positions.empty() or indices.empty())
+		return proxy;
+
+	glm::vec3 min { positions[0] };
+	glm::vec3 max { positions[0] };
+	for(const auto &pos: positions)
+	{
+		min = glm::min(min, pos);
+		max = glm::max(max, pos);
+	}
+
+	const auto extent = max - min;
+	const auto cell_size = std::max(std::max(extent.x, extent.y), extent.z) / float(std::max(grid_cells, 1u));
+	const auto dims = cell_size > 0? glm::max(glm::uvec3(glm::ceil(extent / cell_size)), glm::uvec3(1)): glm::uvec3(1);
+
+	auto cell_of = [&](const glm::vec3 &pos) {
+		const auto cell = cell_size > 0? glm::min(glm::uvec3((pos - min) / cell_size), dims - 1u): glm::uvec3(0);
+		return uint64_t(cell.x) + uint64_t(dims.x)*(uint64_t(cell.y) + uint64_t(dims.y)*uint64_t(cell.z));
+	};
+
+	// the merged vertex of each (used) cell; the average of the cell's vertices
+	dense_map<uint64_t, uint32_t> cell_vertex;
+	cell_vertex.reserve(positions.size() / 4);
+	std::vector<uint32_t> remap(positions.size());
+	std::vector<uint32_t> merged_count;
+
+	for(auto idx = 0u; idx < positions.size(); ++idx)
+	{
+		const auto [found, inserted] = cell_vertex.try_emplace(cell_of(positions[idx]), uint32_t(proxy.positions.size()));
+		const auto vertex = found->second;
+		if(inserted)
+		{
+			proxy.positions.push_back(glm::vec3(0));
+			proxy.normals.push_back(glm::vec3(0));
+			merged_count.push_back(0);
+		}
+		proxy.positions[vertex] += positions[idx];
+		if(not normals.empty())
+			proxy.normals[vertex] += normals[idx];
+		++merged_count[vertex];
+		remap[idx] = vertex;
+	}
+	for(auto idx = 0u; idx < proxy.positions.size(); ++idx)
+		proxy.positions[idx] /= float(merged_count[idx]);
+
+	// collapsed triangles are dropped, and duplicates (of the same winding)
+	std::vector<std::array<uint32_t, 3>> triangles;
+	triangles.reserve(indices.size() / 3);
+
+	for(auto idx = 0u; idx < indices.size(); idx += 3)
+	{
+		std::array<uint32_t, 3> tri { remap[indices[idx]], remap[indices[idx + 1]], remap[indices[idx + 2]] };
+		if(tri[0] == tri[1] or tri[1] == tri[2] or tri[2] == tri[0])
+			continue;
+		// smallest index first, the winding is kept
+		std::ranges::rotate(tri, std::ranges::min_element(tri));
+		triangles.push_back(tri);
+	}
+	std::ranges::sort(triangles);
+	const auto duplicates = std::ranges::unique(triangles);
+	triangles.erase(duplicates.begin(), duplicates.end());
+
+	proxy.indices.reserve(triangles.size() * 3);
+	for(const auto &tri: triangles)
+		proxy.indices.insert(proxy.indices.end(), tri.begin(), tri.end());
+
+	// vertices without (or with cancelled out) normals get the area weighted normal of their triangles
+	std::vector<glm::vec3> face_normals(proxy.positions.size(), glm::vec3(0));
+	for(const auto &tri: triangles)
+	{
+		const auto &p0 = proxy.positions[tri[0]];
+		const auto normal = glm::cross(proxy.positions[tri[1]] - p0, proxy.positions[tri[2]] - p0);
+		for(const auto vertex: tri)
+			face_normals[vertex] += normal;
+	}
+
+	for(auto idx = 0u; idx < proxy.normals.size(); ++idx)
+	{
+		auto &normal = proxy.normals[idx];
+		if(glm::dot(normal, normal) < 1e-12f)
+			normal = face_normals[idx];
+		if(glm::dot(normal, normal) > 1e-12f)
+			normal = glm::normalize(normal);
+		else
+			normal = glm::vec3(0, 1, 0);  // not used by any triangle
+	}
+
+	return proxy;
+}
+
+} // RGL
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace RGL
+{
+
+/*
+ A simplified version of a mesh, for rendering shadow maps where the full detail is wasted,
+   e.g. small slots or far away objects (see StaticModel::RenderShadowProxy()).
+
+   Made by vertex clustering: the vertices are snapped to a uniform grid (over the mesh's bounds),
+   the vertices of each cell are merged into one, and the triangles that collapsed (or became duplicates) are dropped.
+   Only positions & normals are kept (the normals are used by the shadow biasing), i.e. all the mesh parts
+   (material splits) are merged into one.
+*/
+struct ShadowProxyMesh
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<uint32_t>  indices;
+
+	inline size_t num_triangles() const { return indices.size() / 3; }
+};
+
+// 'indices' refer to 'positions' (i.e. with any base vertex already added), 'normals' may be empty
+//   'grid_cells' is the number of cells along the longest axis of the bounds
+[[nodiscard]] ShadowProxyMesh simplify_for_shadows(std::span<const glm::vec3> positions,
+												   std::span<const glm::vec3> normals,
+												   std::span<const uint32_t> indices,
+												   uint32_t grid_cells);
+
+} // RGL
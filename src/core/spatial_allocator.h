@@ -2,7 +2,11 @@
 
 #include "container_types.h"
 #include "log.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <bit>
 #include <glm/integer.hpp>
 #include <glm/vec3.hpp>
@@ -25,6 +29,12 @@
 bottom right:  index << 2 + 4
 
  # levels: log2( <max size> / <min size> )
+
+ Allocation is buddy-style: each level has a free list (a bitmap, plus a summary bitmap of its non-empty words)
+ of the maximal free nodes, i.e. free nodes whose parent isn't free.
+   allocate: take the lowest free node at the requested level, or split the nearest free ancestor-level node
+   free:     merge with the three siblings, as long as they're all free
+ Both are O(levels), no tree search.
 */
 
 // see https://gcc.gnu.org/onlinedocs/gcc/Bit-Operation-Builtins.html
@@ -55,7 +65,6 @@ public:
 	struct Node
 	{
 		bool     allocated;
-		uint32_t children_allocated;
 	};
 
 	struct Rect
@@ -97,10 +106,11 @@ public:
 
 	[[nodiscard]] inline uint32_t level_from_size(AxisT size) const { assert(std::has_single_bit(size) and size < _size); return std::countr_zero(uint32_t(_size / size)); }
 
+	[[nodiscard]] NodeIndex parent_index(NodeIndex child);
+	[[nodiscard]] NodeIndex child_index(NodeIndex parent, NodeChild child=NodeChild::TopLeft);
+
 private:
 	[[nodiscard]] uint32_t level(NodeIndex index) const;
-	[[nodiscard]] NodeIndex parent_index(NodeIndex child);
-	[[nodiscard]] NodeIndex child_index(NodeIndex parent, NodeChild child=NodeChild::TopRLeft);
 	[[nodiscard]] NodeChild node_child(NodeIndex index);
 	[[nodiscard]] inline AxisT size_at_level(uint32_t level) const { return _size >> level; }
 	[[nodiscard]] static inline uint32_t num_nodes_in_level(uint32_t level) { return 1u << 2u*level; };
@@ -108,11 +118,23 @@ private:
 	[[nodiscard]] static uint32_t level_from_index(NodeIndex index);
 	// [[nodiscard]] static NodeIndex index_of_descendant(NodeIndex index, uint32_t skip_levels);
 
-	// search the tree for a vacant "target_level"-sized slot
-	[[nodiscard]] NodeIndex find_available(uint32_t target_level, uint32_t current_level=0, NodeIndex index=0);
+	// allocate a "target_level"-sized slot, splitting a larger one if necessary
+	[[nodiscard]] NodeIndex allocate_at(uint32_t target_level);
+
+	struct FreeList
+	{
+		std::vector<uint64_t> bits;     // bit per node in the level
+		std::vector<uint64_t> summary;  // bit per non-zero word in 'bits'
+		uint32_t count { 0 };
+	};
+	void push_free(uint32_t level, NodeIndex index);
+	void remove_free(uint32_t level, NodeIndex index);
+	[[nodiscard]] bool is_free(uint32_t level, NodeIndex index) const;
+	[[nodiscard]] NodeIndex first_free(uint32_t level) const;
 
 private:
 	std::vector<Node> _nodes;
+	std::vector<FreeList> _free;  // per level
 	AxisT _size;
 	AxisT _max_size;
 	AxisT _min_size;
@@ -139,8 +161,18 @@ inline SpatialAllocator<AxisT>::SpatialAllocator(AxisT size, uint32_t min_block_
 	assert(num_nodes < 65536); // more nodes seems a bit excessive don't you think?
 	_nodes.resize(num_nodes);
 
+	_free.resize(num_levels + 1);
+	for(auto level = 0u; level <= num_levels; ++level)
+	{
+		const auto num_words = (num_nodes_in_level(level) + 63) / 64;
+		_free[level].bits.resize(num_words);
+		_free[level].summary.resize((num_words + 63) / 64);
+	}
+
 	_allocated.reserve(num_levels);
 
+	reset();
+
 	Log::info("SpatialAllocator[{}..{}]: {} levels; {} nodes", _min_size, _max_size, num_allocatable_levels(), num_nodes);
 }
 
@@ -149,6 +181,14 @@ void SpatialAllocator<AxisT>::reset()
 {
 	std::memset(_nodes.data(), 0, _nodes.size() * sizeof(Node));
 	_allocated.clear();
+
+	for(auto &free_list: _free)
+	{
+		std::ranges::fill(free_list.bits, 0);
+		std::ranges::fill(free_list.summary, 0);
+		free_list.count = 0;
+	}
+	push_free(0, 0);  // i.e. everything
 }
 
 template<IntT AxisT>
@@ -175,35 +215,17 @@ SpatialAllocator<AxisT>::NodeIndex SpatialAllocator<AxisT>::allocate(AxisT size,
 
 	min_size = glm::clamp(min_size, _min_size, size);
 
-	// auto allocated_size = size;
 	const auto max_level = level_from_size(min_size);
 	auto allocated_index = BadIndex;
 	auto lvl = level_from_size(size) - 1;
 
-	// TODO: optimization (if max_level < lvl): find_available() can "peek" if a lower level is possible
 	while(allocated_index == BadIndex and lvl < max_level)
-		allocated_index = find_available(++lvl);
+		allocated_index = allocate_at(++lvl);
 
 	if(allocated_index != BadIndex)
 	{
 		const auto allocated_size = size_at_level(lvl);
 		++_allocated[allocated_size];
-
-		auto &n = _nodes[allocated_index];
-		n.allocated = true;
-		assert(n.children_allocated == 0);
-		// std::print("  [sa] {} demoted {} -> {}\n", found, size, allocated_size);
-
-		auto index = allocated_index;
-		// increment 'children_allocated' for ancestors
-		while(index > 0)
-		{
-			index = parent_index(index);
-			auto &p = _nodes[index];
-			assert(not p.allocated);
-			++p.children_allocated;
-			// std::print("  [sa] {}.children_allocated++ -> {}\n", node, p.children_allocated);
-		}
 	}
 
 	return allocated_index;
@@ -214,58 +236,89 @@ SpatialAllocator<AxisT>::NodeIndex SpatialAllocator<AxisT>::allocate(AxisT size,
 template<IntT AxisT>
 uint32_t SpatialAllocator<AxisT>::level_from_index(NodeIndex index)
 {
-	return (uint32_t(std::countr_zero(index*3u + 1u)) + 1u) >> 1u;
+	return (uint32_t(std::bit_width(index*3u + 1u)) - 1u) >> 1u;
 }
 
 template<IntT AxisT>
-SpatialAllocator<AxisT>::NodeIndex SpatialAllocator<AxisT>::find_available(uint32_t target_level, uint32_t current_level, NodeIndex index)
+SpatialAllocator<AxisT>::NodeIndex SpatialAllocator<AxisT>::allocate_at(uint32_t target_level)
 {
-	// if(index == 0)
-	// {
-	// 	s_indent = 0;
-	// 	std::print("  [sa] find @ level {}\n", target_level);
-	// }
-
-	const auto &n = _nodes[index];
-
-	// skip branches that are fully allocated
-	if (n.allocated)// or n.children_allocated == num_nodes_in_levels(target_level - current_level))
+	// the nearest level (at or above the target) with a free node
+	auto level = target_level;
+	while(_free[level].count == 0)
 	{
-		// std::print("{:{}}  [sa] {}  branch not available ({} + {})\n", "", s_indent, index, n.allocated, n.children_allocated);
-		return BadIndex;
+		if(level == 0)
+			return BadIndex;
+		--level;
 	}
-	if (current_level == target_level)
+
+	auto index = first_free(level);
+	remove_free(level, index);
+
+	// split down to the target level; keep the first child, the others become free
+	while(level < target_level)
 	{
-		// if(n.children_allocated)
-		// 	std::print("{:{}}  [sa] {}  not available ({} + {})\n", "", s_indent, index, n.allocated, n.children_allocated);
-		// else
-		// 	std::print("{:{}}  [sa] {} found!\n", "", s_indent, index);
-		if(n.children_allocated == 0)
-			return index;
-		return BadIndex;
+		const auto first_child = child_index(index, NodeChild::TopLeft);
+		for(auto child = first_child + 1; child < first_child + 4; ++child)
+			push_free(level + 1, child);
+		index = first_child;
+		++level;
 	}
 
-	// if the whole subtree is available, we can skip to the first child at target_level
-	// if(not n.allocated and n.children_allocated == 0)
-	// {
-	// 	const auto skip_to_index = index_of_descendant(index, target_level - current_level);
-	// 	assert(level_from_index(skip_to_index) == target_level);
-	// 	// if(target_level > current_level + 1)
-	// 	// 	std::print("[sa] size={} direct hop {} -> {}  (level {} -> {})\n", size_at_level(target_level), index, skip_to_index, current_level, target_level);
-	// 	return find_available(target_level, target_level, skip_to_index);
-	// }
-
-	for(auto child = 1u; child <= 4; ++child)
+	auto &n = _nodes[index];
+	assert(not n.allocated);
+	n.allocated = true;
+
+	return index;
+}
+
+template<IntT AxisT>
+void SpatialAllocator<AxisT>::push_free(uint32_t level, NodeIndex index)
+{
+	auto &free_list = _free[level];
+	const auto bit = index - level_start_index(level);
+	assert((free_list.bits[bit >> 6] & (1ull << (bit & 63))) == 0);
+
+	free_list.bits[bit >> 6] |= 1ull << (bit & 63);
+	free_list.summary[bit >> 12] |= 1ull << ((bit >> 6) & 63);
+	++free_list.count;
+}
+
+template<IntT AxisT>
+void SpatialAllocator<AxisT>::remove_free(uint32_t level, NodeIndex index)
+{
+	auto &free_list = _free[level];
+	const auto bit = index - level_start_index(level);
+	assert((free_list.bits[bit >> 6] & (1ull << (bit & 63))) != 0);
+
+	auto &word = free_list.bits[bit >> 6];
+	word &= ~(1ull << (bit & 63));
+	if(word == 0)
+		free_list.summary[bit >> 12] &= ~(1ull << ((bit >> 6) & 63));
+	--free_list.count;
+}
+
+template<IntT AxisT>
+bool SpatialAllocator<AxisT>::is_free(uint32_t level, NodeIndex index) const
+{
+	const auto bit = index - level_start_index(level);
+	return (_free[level].bits[bit >> 6] & (1ull << (bit & 63))) != 0;
+}
+
+template<IntT AxisT>
+SpatialAllocator<AxisT>::NodeIndex SpatialAllocator<AxisT>::first_free(uint32_t level) const
+{
+	// the lowest index, i.e. the same node a depth-first search would find
+	const auto &free_list = _free[level];
+	for(auto summary_idx = 0u; summary_idx < free_list.summary.size(); ++summary_idx)
 	{
-		// std::print("{:{}}  [sa] {} -> child {}\n", "", s_indent, index, child);
-		// ++s_indent;
-		auto found = find_available(target_level, current_level + 1, child_index(index, NodeChild(child)));
-		// --s_indent;
-		if (found != BadIndex)
-			return found;
+		if(const auto summary = free_list.summary[summary_idx]; summary)
+		{
+			const auto word_idx = (summary_idx << 6) + uint32_t(std::countr_zero(summary));
+			const auto bit = (word_idx << 6) + uint32_t(std::countr_zero(free_list.bits[word_idx]));
+			return level_start_index(level) + bit;
+		}
 	}
-
-	// std::print("{:{}}  [sa] {}  branch not available\n", "", s_indent, index);
+	assert(false);
 	return BadIndex;
 }
 
@@ -277,22 +330,35 @@ bool SpatialAllocator<AxisT>::free(NodeIndex index)
 	auto &n = _nodes[index];
 	if(not n.allocated)
 		return false;
-	assert(n.children_allocated == 0);
 
 	n.allocated = false;
 
-	const auto allocated_size = size_at_level(level_from_index(index));
+	auto level = level_from_index(index);
+
+	const auto allocated_size = size_at_level(level);
 	--_allocated[allocated_size]; // remove the entry if 0?
 
-	// decrement child allocation counter in ancestors
-	while(index > 0)
+	// merge with the siblings, as long as they're all free
+	while(level > 0)
 	{
+		const auto first_sibling = child_index(parent_index(index), NodeChild::TopLeft);
+		auto all_free = true;
+		for(auto sibling = first_sibling; sibling < first_sibling + 4 and all_free; ++sibling)
+			all_free = sibling == index or is_free(level, sibling);
+		if(not all_free)
+			break;
+
+		for(auto sibling = first_sibling; sibling < first_sibling + 4; ++sibling)
+		{
+			if(sibling != index)
+				remove_free(level, sibling);
+		}
 		index = parent_index(index);
-		auto &n = _nodes[index];
-		assert(n.children_allocated > 0);
-		--n.children_allocated;
+		--level;
 	}
 
+	push_free(level, index);
+
 	return true;
 }
 
@@ -9,6 +9,9 @@
 #include <print>
 #include <cstring>  // std::memset
 #include <iterator>
+#include <array>
+#include <optional>
+#include <cstdint>
 
 #include "buffer.h"
 
@@ -374,6 +377,127 @@ public:
 // ============================================================================
 // ============================================================================
 
+/*
+ Non-blocking readback of a buffer written by the GPU.
+   capture() queues a copy of the buffer into one of N persistently mapped slots, followed by a fence.
+   poll() never waits; it returns the newest capture whose fence has signaled, tagged with its frame number.
+   I.e. the data is typically a frame or two old, but the CPU never stalls waiting for the GPU.
+*/
+template<typename T, size_t size, size_t N=3> requires (N > 1 && sizeof(T) >= 4)
+class AsyncReadBack
+{
+public:
+	struct Result
+	{
+		uint64_t frame;
+		std::span<const T, size> data;  // valid until the next capture()
+	};
+
+public:
+	AsyncReadBack(std::string_view name);
+	~AsyncReadBack();
+
+	inline void bindAt(GLuint index) { ensureSized(); _source.bindAt(index); }
+	inline void clear() { ensureSized(); _source.clear(); }
+
+	//! queue a copy of the buffer's current content; false if all slots are still in flight (i.e. skipped)
+	bool capture(uint64_t frame);
+	//! the newest completed capture, if any
+	std::optional<Result> poll();
+
+	inline size_t in_flight() const { return _in_flight; }
+
+private:
+	inline void ensureSized() { if(_source.size() != size) _source.resize(size); }
+
+	class Slot : public Mapped<T, size>
+	{
+	public:
+		Slot(std::string_view name) : Mapped<T, size>(name, BufferUsage::ReadBack) {}
+
+		using Buffer::id;
+		using Mapped<T, size>::begin;
+	};
+
+private:
+	Storage<T> _source;
+	std::array<std::unique_ptr<Slot>, N> _slots;
+	std::array<GLsync, N> _fences {};
+	std::array<uint64_t, N> _frames {};
+	size_t _first { 0 };       // oldest slot in flight
+	size_t _in_flight { 0 };
+};
+
+template<typename T, size_t size, size_t N> requires (N > 1 && sizeof(T) >= 4)
+AsyncReadBack<T, size, N>::AsyncReadBack(std::string_view name) :
+	_source(name)
+{
+	for(auto &slot: _slots)
+		slot = std::make_unique<Slot>(name);
+}
+
+template<typename T, size_t size, size_t N> requires (N > 1 && sizeof(T) >= 4)
+AsyncReadBack<T, size, N>::~AsyncReadBack()
+{
+	for(auto fence: _fences)
+	{
+		if(fence)
+			glDeleteSync(fence);
+	}
+}
+
+template<typename T, size_t size, size_t N> requires (N > 1 && sizeof(T) >= 4)
+bool AsyncReadBack<T, size, N>::capture(uint64_t frame)
+{
+	if(_in_flight == N)
+		return false;  // the GPU is falling behind, just skip this one
+
+	ensureSized();
+
+	const auto index = (_first + _in_flight) % N;
+	auto &slot = *_slots[index];
+	slot.begin();  // create & map, if needed
+
+	// the source was written by shaders
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glCopyNamedBufferSubData(_source.id(), slot.id(), 0, 0, GLsizeiptr(size*sizeof(T)));
+	glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+	_fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	_frames[index] = frame;
+	++_in_flight;
+
+	return true;
+}
+
+template<typename T, size_t size, size_t N> requires (N > 1 && sizeof(T) >= 4)
+auto AsyncReadBack<T, size, N>::poll() -> std::optional<Result>
+{
+	std::optional<Result> result;
+
+	// slots complete in order; consume all that are done, deliver the newest
+	while(_in_flight > 0)
+	{
+		auto &fence = _fences[_first];
+		const auto status = glClientWaitSync(fence, 0, 0);  // i.e. don't wait
+		if(status != GL_ALREADY_SIGNALED and status != GL_CONDITION_SATISFIED)
+			break;
+
+		glDeleteSync(fence);
+		fence = nullptr;
+
+		result = Result{ _frames[_first], std::span<const T, size>(_slots[_first]->begin(), size) };
+
+		_first = (_first + 1) % N;
+		--_in_flight;
+	}
+
+	return result;
+}
+
+// ============================================================================
+// ============================================================================
+
 template <typename S>
 concept StorageLike = requires { typename S::value_type; }
 	and std::is_base_of_v<Storage<typename S::value_type>, S>;
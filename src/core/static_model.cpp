@@ -9,7 +9,9 @@
 
 #include "container_types.h"
 #include "log.h"
+#include "shadow_proxy.h"
 
+#include <algorithm>
 #include <string_view>
 using namespace std::literals;
 
@@ -19,6 +21,23 @@ using namespace std::chrono;
 namespace RGL
 {
 
+static constexpr uint32_t s_shadow_proxy_grid_cells = 32;    // along the longest axis; see simplify_for_shadows()
+static constexpr float    s_shadow_proxy_max_ratio  = 0.5f;  // of the full triangle count, or no proxy
+
+// i.e. discards fragments; needs the texture coordinates (and textures), which the shadow proxy doesn't have
+static bool is_alpha_tested(const aiMaterial *material)
+{
+	if(material->GetTextureCount(aiTextureType_OPACITY) > 0)
+		return true;
+
+	float opacity;
+	if(AI_SUCCESS == material->Get(AI_MATKEY_OPACITY, opacity) and opacity < 1.f)
+		return true;
+
+	aiString alpha_mode;  // glTF: OPAQUE, MASK or BLEND
+	return AI_SUCCESS == material->Get("$mat.gltf.alphaMode", 0, 0, alpha_mode) and alpha_mode.C_Str() != "OPAQUE"sv;
+}
+
 void StaticModel::BindVAO() const
 {
 	glBindVertexArray(m_vao_name);
@@ -114,6 +133,15 @@ void StaticModel::Render(Shader& shader, uint32_t num_instances) const
 	glBindTextureUnit(0, 0);
 }
 
+void StaticModel::RenderShadowProxy() const
+{
+	assert(has_shadow_proxy());
+
+	glBindVertexArray(m_proxy_vao_name);
+	glBindTextureUnit(0, 0);  // i.e. nothing is alpha-tested
+	glDrawElements(GL_TRIANGLES, m_proxy_indices_count, GL_UNSIGNED_INT, nullptr);
+}
+
 bool StaticModel::Load(const std::filesystem::path& filepath)
 {
 	/* Release the previously loaded mesh if it was loaded. */
@@ -210,6 +238,19 @@ bool StaticModel::ParseScene(const aiScene *scene, const std::filesystem::path&
 	/* Populate buffers on the GPU with the model's data. */
 	CreateBuffers(vertex_data);
 
+	// shadow_depth.frag discards by the albedo texture's alpha, whatever the material says
+	auto has_albedo_alpha = [this](uint32_t material_index) {
+		const auto &textures = m_materials[material_index].m_texture_map;
+		const auto found = textures.find(Material::TextureType::ALBEDO);
+		return found != textures.end() and found->second and found->second->GetMetadata().channels == 4;
+	};
+	bool alpha_tested { false };
+	for(auto idx = 0u; idx < scene->mNumMaterials and not alpha_tested; ++idx)
+		alpha_tested = is_alpha_tested(scene->mMaterials[idx]) or has_albedo_alpha(idx);
+
+	if(not alpha_tested)
+		CreateShadowProxy(vertex_data);
+
 	const auto T1 = steady_clock::now();
 
 	Log::info("Loaded mesh {}  ({:.1f} x {:.1f} x {:.1f})  ({})", filepath.string().c_str(), _aabb.width(), _aabb.height(), _aabb.depth(), duration_cast<milliseconds>(T1 - T0));
@@ -466,6 +507,54 @@ void StaticModel::CreateBuffers(VertexData& vertex_data)
 	if (has_tangents) glVertexArrayAttribBinding(m_vao_name, 3 /*attribindex*/, 3 /*bindingindex*/); // tangents
 }
 
+void StaticModel::CreateShadowProxy(const VertexData& vertex_data)
+{
+	if(m_draw_mode != DrawMode::TRIANGLES)
+		return;
+
+	// all the mesh parts merged
+	std::vector<uint32_t> indices;
+	indices.reserve(vertex_data.indices.size());
+	for(const auto &part: m_mesh_parts)
+	{
+		for(auto idx = 0u; idx < part.m_indices_count; ++idx)
+			indices.push_back(part.m_base_vertex + vertex_data.indices[part.m_base_index + idx]);
+	}
+
+	const auto proxy = simplify_for_shadows(vertex_data.positions, vertex_data.normals, indices, s_shadow_proxy_grid_cells);
+
+	const auto num_triangles = indices.size() / 3;
+	if(proxy.num_triangles() == 0 or float(proxy.num_triangles()) > float(num_triangles) * s_shadow_proxy_max_ratio)
+		return;  // not worth it
+
+	Log::debug("shadow proxy: {} -> {} triangles", num_triangles, proxy.num_triangles());
+
+	const auto positions_size_bytes = GLsizeiptr(proxy.positions.size() * sizeof(proxy.positions[0]));
+	const auto normals_size_bytes   = GLsizeiptr(proxy.normals.size() * sizeof(proxy.normals[0]));
+
+	glCreateBuffers     (1, &m_proxy_vbo_name);
+	glNamedBufferStorage(m_proxy_vbo_name, positions_size_bytes + normals_size_bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glNamedBufferSubData(m_proxy_vbo_name, 0, positions_size_bytes, proxy.positions.data());
+	glNamedBufferSubData(m_proxy_vbo_name, positions_size_bytes, normals_size_bytes, proxy.normals.data());
+
+	glCreateBuffers     (1, &m_proxy_ibo_name);
+	glNamedBufferStorage(m_proxy_ibo_name, GLsizeiptr(proxy.indices.size() * sizeof(proxy.indices[0])), proxy.indices.data(), GL_DYNAMIC_STORAGE_BIT);
+	m_proxy_indices_count = GLsizei(proxy.indices.size());
+
+	// same attribute indices as the full model; no texcoords (attrib 1) or tangents (attrib 3)
+	glCreateVertexArrays(1, &m_proxy_vao_name);
+	glVertexArrayVertexBuffer (m_proxy_vao_name, 0 /* bindingindex*/, m_proxy_vbo_name, 0, sizeof(proxy.positions[0]));
+	glVertexArrayVertexBuffer (m_proxy_vao_name, 2 /* bindingindex*/, m_proxy_vbo_name, positions_size_bytes, sizeof(proxy.normals[0]));
+	glVertexArrayElementBuffer(m_proxy_vao_name, m_proxy_ibo_name);
+
+	glEnableVertexArrayAttrib (m_proxy_vao_name, 0 /*attribindex*/); // positions
+	glEnableVertexArrayAttrib (m_proxy_vao_name, 2 /*attribindex*/); // normals
+	glVertexArrayAttribFormat (m_proxy_vao_name, 0 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
+	glVertexArrayAttribFormat (m_proxy_vao_name, 2 /*attribindex */, 3 /* size */, GL_FLOAT, GL_FALSE, 0 /*relativeoffset*/);
+	glVertexArrayAttribBinding(m_proxy_vao_name, 0 /*attribindex*/, 0 /*bindingindex*/);
+	glVertexArrayAttribBinding(m_proxy_vao_name, 2 /*attribindex*/, 2 /*bindingindex*/);
+}
+
 /* The first available input attribute index is 4. */
 void StaticModel::AddAttributeBuffer(GLuint attrib_index, GLuint binding_index, GLint format_size, GLenum data_type, GLuint buffer_id, GLsizei stride, GLuint divisor)
 {
@@ -557,6 +646,8 @@ void StaticModel::GenPrimitive(VertexData& vertex_data, bool generate_tangents)
 	mesh_part.m_indices_count = vertex_data.indices.size();
 
 	m_mesh_parts.push_back(mesh_part);
+
+	CreateShadowProxy(vertex_data);
 }
 
 void StaticModel::Release()
@@ -570,6 +661,14 @@ void StaticModel::Release()
 	glDeleteVertexArrays(1, &m_vao_name);
 	m_vao_name = 0;
 
+	glDeleteBuffers(1, &m_proxy_vbo_name);
+	glDeleteBuffers(1, &m_proxy_ibo_name);
+	glDeleteVertexArrays(1, &m_proxy_vao_name);
+	m_proxy_vbo_name = 0;
+	m_proxy_ibo_name = 0;
+	m_proxy_vao_name = 0;
+	m_proxy_indices_count = 0;
+
 	m_draw_mode = DrawMode::TRIANGLES;
 
 	m_mesh_parts.clear();
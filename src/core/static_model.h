@@ -59,6 +59,10 @@ public:
 		m_vbo_name  (other.m_vbo_name),
 		m_ibo_name  (other.m_ibo_name),
 		m_draw_mode (other.m_draw_mode),
+		m_proxy_vao_name(other.m_proxy_vao_name),
+		m_proxy_vbo_name(other.m_proxy_vbo_name),
+		m_proxy_ibo_name(other.m_proxy_ibo_name),
+		m_proxy_indices_count(other.m_proxy_indices_count),
 		_aabb(other._aabb),
 		_sphere(other._sphere),
 		_ok(false)
@@ -67,6 +71,10 @@ public:
 		other.m_vbo_name   = 0;
 		other.m_ibo_name   = 0;
 		other.m_draw_mode  = DrawMode::TRIANGLES;
+		other.m_proxy_vao_name = 0;
+		other.m_proxy_vbo_name = 0;
+		other.m_proxy_ibo_name = 0;
+		other.m_proxy_indices_count = 0;
 	}
 
 	StaticModel& operator=(StaticModel&& other) noexcept
@@ -81,6 +89,10 @@ public:
 			std::swap(m_vbo_name,   other.m_vbo_name);
 			std::swap(m_ibo_name,   other.m_ibo_name);
 			std::swap(m_draw_mode,  other.m_draw_mode);
+			std::swap(m_proxy_vao_name, other.m_proxy_vao_name);
+			std::swap(m_proxy_vbo_name, other.m_proxy_vbo_name);
+			std::swap(m_proxy_ibo_name, other.m_proxy_ibo_name);
+			std::swap(m_proxy_indices_count, other.m_proxy_indices_count);
 			std::swap(_aabb,        other._aabb);
 			std::swap(_sphere,        other._sphere);
 		}
@@ -104,6 +116,11 @@ public:
 	virtual void Render(uint32_t num_instances = 0) const;
 	virtual void Render(Shader &shader, uint32_t num_instances = 0) const;
 
+	// a simplified version, for shadow maps (see shadow_proxy.h); a single draw, without materials
+	//   only made if it's considerably smaller, and the model has no alpha-tested materials
+	inline bool has_shadow_proxy() const { return m_proxy_vao_name != 0; }
+	void RenderShadowProxy() const;
+
 	// TODO: convert these to a "mesh primitive factory"
 	virtual void GenCone       (float    height      = 3.0f, float radius         = 1.5f, uint32_t slices = 10, uint32_t stacks = 10);
 	virtual void GenCube       (float    radius      = 1.0f, float texcoord_scale = 1.0f);
@@ -137,6 +154,7 @@ protected:
 	virtual bool LoadMaterials(const aiScene* scene, const std::filesystem::path& filepath);
 	virtual bool LoadMaterialTextures(const aiScene* scene, const aiMaterial* material, uint32_t material_index, aiTextureType type, Material::TextureType texture_type, const std::string& directory);
 	virtual void CreateBuffers(VertexData& vertex_data);
+	void CreateShadowProxy(const VertexData& vertex_data);
 
 	virtual void CalcTangentSpace(VertexData& vertex_data);
 	virtual void GenPrimitive(VertexData& vertex_data, bool generate_tangents = true);
@@ -150,6 +168,10 @@ protected:
 	GLuint   m_vbo_name;
 	GLuint   m_ibo_name;
 	DrawMode m_draw_mode;
+	GLuint   m_proxy_vao_name { 0 };
+	GLuint   m_proxy_vbo_name { 0 };
+	GLuint   m_proxy_ibo_name { 0 };
+	GLsizei  m_proxy_indices_count { 0 };
 	InstanceAttributes m_inst_attrs;
 	bounds::AABB _aabb;
 	bounds::Sphere _sphere;
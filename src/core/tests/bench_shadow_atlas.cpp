@@ -0,0 +1,538 @@
+#include "shadow_atlas.h"
+#include "light_manager.h"
+#include "camera.h"
+#include "scene.h"
+#include "component/light_general.h"
+#include "component/transform.h"
+#include "log.h"
+using namespace RGL;
+
+#include "gl_stubs.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <print>
+#include <random>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// headless shadow atlas churn benchmark
+//   drives LightManager & ShadowAtlas (update_allocations, defragment, need_render) from a camera path and
+//   a light animation, at a fixed frame rate in simulated time. No GL context; the buffer calls are stubbed.
+//
+// usage: shadow_atlas_benchmark [options] [<camera path> <light animation>]
+//   without files, a synthetic scene is used ('--write <prefix>' saves it; also serves as an example of the formats)
+//
+//   --fps <n>                          simulated frame rate (60)
+//   --eval-ms <ms>                     interval between allocation updates (0, i.e. every frame)
+//   --min-change-ms <ms>               ShadowAtlas::set_min_change_interval()
+//   --max-distance <m>                 ShadowAtlas::set_max_distance()
+//   --view-distance <m>                lights further away are not relevant (100)
+//   --render-interval <tier>:<frames>:<ms>   ShadowAtlas::set_render_interval(); may be repeated
+//
+// camera path, one key per line (linearly interpolated):
+//   <time> <x> <y> <z> <forward x> <forward y> <forward z>
+// light animation:
+//   point <name> <x> <y> <z> <intensity>
+//   spot  <name> <x> <y> <z> <intensity> <dir x> <dir y> <dir z> <outer angle (degrees)>
+//   sun   <name> <dir x> <dir y> <dir z> <intensity>
+//   key   <time> <name> <x> <y> <z>       position key (linearly interpolated)
+
+namespace
+{
+
+using namespace std::chrono;
+using namespace std::literals;
+
+// -- input --------------------------------------------------------------------------------
+
+struct CameraKey
+{
+	float time;
+	glm::vec3 position;
+	glm::vec3 forward;
+};
+
+struct PositionKey
+{
+	float time;
+	glm::vec3 position;
+};
+
+struct AnimatedLight
+{
+	std::string name;
+	std::string type;
+	glm::vec3 position { 0 };
+	glm::vec3 direction { 0, -1, 0 };
+	float intensity { 100.f };
+	float outer_angle { 25.f };
+	std::vector<PositionKey> keys;
+
+	LightID light_id { NO_LIGHT_ID };
+};
+
+template<typename Key>
+float duration_of(const std::vector<Key> &keys)
+{
+	return keys.empty()? 0.f: keys.back().time;
+}
+
+// index of the key at or before 'time', and the blend factor towards the next one
+template<typename Key>
+std::pair<size_t, float> key_at(const std::vector<Key> &keys, float time)
+{
+	assert(not keys.empty());
+	const auto next = std::ranges::upper_bound(keys, time, {}, &Key::time);
+	if(next == keys.begin())
+		return { 0, 0.f };
+	if(next == keys.end())
+		return { keys.size() - 1, 0.f };
+	const auto index = size_t(next - keys.begin()) - 1;
+	const auto span = next->time - keys[index].time;
+	return { index, span > 0? (time - keys[index].time) / span: 0.f };
+}
+
+bool read_camera_path(const std::string &path, std::vector<CameraKey> &keys)
+{
+	std::ifstream file(path);
+	if(not file)
+		return false;
+
+	std::string line;
+	while(std::getline(file, line))
+	{
+		if(line.empty() or line[0] == '#')
+			continue;
+		std::istringstream fields(line);
+		CameraKey key;
+		fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.forward.x >> key.forward.y >> key.forward.z;
+		if(fields)
+			keys.push_back(key);
+	}
+	std::ranges::sort(keys, {}, &CameraKey::time);
+	return not keys.empty();
+}
+
+bool read_light_animation(const std::string &path, std::vector<AnimatedLight> &lights)
+{
+	std::ifstream file(path);
+	if(not file)
+		return false;
+
+	std::string line;
+	while(std::getline(file, line))
+	{
+		if(line.empty() or line[0] == '#')
+			continue;
+		std::istringstream fields(line);
+		std::string kind;
+		fields >> kind;
+
+		if(kind == "key")
+		{
+			PositionKey key;
+			std::string name;
+			fields >> key.time >> name >> key.position.x >> key.position.y >> key.position.z;
+			auto found = std::ranges::find(lights, name, &AnimatedLight::name);
+			if(not fields or found == lights.end())
+			{
+				std::print(stderr, "{}: bad key: {}\n", path, line);
+				return false;
+			}
+			found->keys.push_back(key);
+			continue;
+		}
+
+		AnimatedLight light;
+		light.type = kind;
+		fields >> light.name;
+		if(kind == "point")
+			fields >> light.position.x >> light.position.y >> light.position.z >> light.intensity;
+		else if(kind == "spot")
+			fields >> light.position.x >> light.position.y >> light.position.z >> light.intensity
+				   >> light.direction.x >> light.direction.y >> light.direction.z >> light.outer_angle;
+		else if(kind == "sun")
+			fields >> light.direction.x >> light.direction.y >> light.direction.z >> light.intensity;
+		if(not fields or (kind != "point" and kind != "spot" and kind != "sun"))
+		{
+			std::print(stderr, "{}: bad light: {}\n", path, line);
+			return false;
+		}
+		lights.push_back(light);
+	}
+
+	for(auto &light: lights)
+		std::ranges::sort(light.keys, {}, &PositionKey::time);
+
+	return true;
+}
+
+// a grid of point lights (every 8th one moving, some spots), and a camera circling it
+void synthetic_scene(std::vector<CameraKey> &camera_path, std::vector<AnimatedLight> &lights)
+{
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> intensity(20.f, 200.f);
+
+	static constexpr auto grid_size = 20;
+	static constexpr auto spacing = 6.f;
+	static constexpr auto extent = grid_size * spacing;
+
+	for(auto z = 0; z < grid_size; ++z)
+	{
+		for(auto x = 0; x < grid_size; ++x)
+		{
+			const auto index = z * grid_size + x;
+
+			AnimatedLight light;
+			light.name = std::format("L{}", index);
+			light.type = index % 5 == 0? "spot": "point";
+			light.position = { float(x) * spacing - extent/2, 2.f, float(z) * spacing - extent/2 };
+			light.intensity = intensity(rng);
+
+			if(index % 8 == 0)
+			{
+				for(auto second = 0; second <= 60; second += 2)
+				{
+					const auto offset = glm::vec3(std::sin(float(second) * 0.3f), 0, std::cos(float(second) * 0.3f)) * spacing;
+					light.keys.push_back({ float(second), light.position + offset });
+				}
+			}
+			lights.push_back(light);
+		}
+	}
+
+	for(auto second = 0; second <= 60; ++second)
+	{
+		const auto angle = float(second) / 60.f * glm::two_pi<float>();
+		const auto position = glm::vec3(std::sin(angle), 0.1f, std::cos(angle)) * (extent * 0.4f);
+		camera_path.push_back({ float(second), position, glm::normalize(-position) });
+	}
+}
+
+bool write_scene(const std::string &prefix, const std::vector<CameraKey> &camera_path, const std::vector<AnimatedLight> &lights)
+{
+	std::ofstream camera_file(prefix + ".camera");
+	std::ofstream lights_file(prefix + ".lights");
+	if(not camera_file or not lights_file)
+		return false;
+
+	for(const auto &key: camera_path)
+		std::print(camera_file, "{} {} {} {} {} {} {}\n", key.time, key.position.x, key.position.y, key.position.z, key.forward.x, key.forward.y, key.forward.z);
+
+	for(const auto &light: lights)
+	{
+		const auto &p = light.position;
+		const auto &d = light.direction;
+		if(light.type == "point")
+			std::print(lights_file, "point {} {} {} {} {}\n", light.name, p.x, p.y, p.z, light.intensity);
+		else if(light.type == "spot")
+			std::print(lights_file, "spot {} {} {} {} {} {} {} {} {}\n", light.name, p.x, p.y, p.z, light.intensity, d.x, d.y, d.z, light.outer_angle);
+		else
+			std::print(lights_file, "sun {} {} {} {} {}\n", light.name, d.x, d.y, d.z, light.intensity);
+	}
+	for(const auto &light: lights)
+	{
+		for(const auto &key: light.keys)
+			std::print(lights_file, "key {} {} {} {} {}\n", key.time, light.name, key.position.x, key.position.y, key.position.z);
+	}
+
+	return true;
+}
+
+// -- statistics -------------------------------------------------------------------------
+
+template<typename T>
+T percentile(std::vector<T> samples, float p)
+{
+	if(samples.empty())
+		return T{};
+	const auto index = size_t(p * float(samples.size() - 1) + 0.5f);
+	std::ranges::nth_element(samples, samples.begin() + ptrdiff_t(index));
+	return samples[index];
+}
+
+struct Options
+{
+	float fps { 60.f };
+	milliseconds eval_interval { 0 };
+	milliseconds min_change_interval { 1000 };
+	float max_distance { 50.f };
+	float view_distance { 100.f };
+	struct RenderInterval
+	{
+		uint32_t size_idx;
+		uint32_t skip_frames;
+		milliseconds interval;
+	};
+	std::vector<RenderInterval> render_intervals;
+	std::string write_prefix;
+	std::string camera_path;
+	std::string light_animation;
+};
+
+bool parse_options(int argc, char **argv, Options &options)
+{
+	auto number = [](std::string_view text, auto &value) {
+		const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+		return ec == std::errc{} and end == text.data() + text.size();
+	};
+
+	for(auto idx = 1; idx < argc; ++idx)
+	{
+		const std::string_view arg = argv[idx];
+		const std::string_view value = idx + 1 < argc? argv[idx + 1]: "";
+
+		auto ok = true;
+		int64_t ms { 0 };
+		if(arg == "--fps")
+			ok = number(value, options.fps);
+		else if(arg == "--eval-ms")
+			ok = number(value, ms), options.eval_interval = milliseconds(ms);
+		else if(arg == "--min-change-ms")
+			ok = number(value, ms), options.min_change_interval = milliseconds(ms);
+		else if(arg == "--max-distance")
+			ok = number(value, options.max_distance);
+		else if(arg == "--view-distance")
+			ok = number(value, options.view_distance);
+		else if(arg == "--render-interval")
+		{
+			Options::RenderInterval ri;
+			const auto colon1 = value.find(':');
+			const auto colon2 = value.find(':', colon1 + 1);
+			ok = colon1 != value.npos and colon2 != value.npos
+				and number(value.substr(0, colon1), ri.size_idx)
+				and number(value.substr(colon1 + 1, colon2 - colon1 - 1), ri.skip_frames)
+				and number(value.substr(colon2 + 1), ms);
+			ri.interval = milliseconds(ms);
+			options.render_intervals.push_back(ri);
+		}
+		else if(arg == "--write")
+			options.write_prefix = value;
+		else if(not arg.starts_with("--") and options.camera_path.empty())
+		{
+			options.camera_path = arg;
+			continue;
+		}
+		else if(not arg.starts_with("--") and options.light_animation.empty())
+		{
+			options.light_animation = arg;
+			continue;
+		}
+		else
+			ok = false;
+
+		if(not ok or value.empty())
+		{
+			std::print(stderr, "bad argument: {} {}\n", arg, value);
+			return false;
+		}
+		++idx;
+	}
+
+	return options.camera_path.empty() == options.light_animation.empty();
+}
+
+} // anonymous
+
+
+int main(int argc, char **argv)
+{
+	Options options;
+	if(not parse_options(argc, argv, options))
+	{
+		std::print(stderr, "usage: {} [options] [<camera path> <light animation>]\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<CameraKey> camera_path;
+	std::vector<AnimatedLight> animated_lights;
+	if(options.camera_path.empty())
+		synthetic_scene(camera_path, animated_lights);
+	else if(not read_camera_path(options.camera_path, camera_path) or not read_light_animation(options.light_animation, animated_lights))
+	{
+		std::print(stderr, "failed reading input\n");
+		return 1;
+	}
+	if(not options.write_prefix.empty() and not write_scene(options.write_prefix, camera_path, animated_lights))
+	{
+		std::print(stderr, "failed writing '{}'\n", options.write_prefix);
+		return 1;
+	}
+
+	Log::set_level(Log::ERROR);
+	gl_stubs::stub_gl_buffers();
+
+	entt::registry entities;
+	Scene scene(entities);  // empty; i.e. shadow maps are only re-rendered when the light changed, or when due
+	LightManager light_mgr(entities);
+	light_mgr.set_upload_policy({ .gpu_scatter = false });
+
+	for(auto &light: animated_lights)
+	{
+		std::expected<LightID, LightError> light_id;
+		if(light.type == "point")
+			light_id = light_mgr.add(PointLightParams{ .intensity = light.intensity, .shadow_caster = true, .position = light.position });
+		else if(light.type == "spot")
+			light_id = light_mgr.add(SpotLightParams{
+				.intensity = light.intensity,
+				.shadow_caster = true,
+				.position = light.position,
+				.direction = glm::normalize(light.direction),
+				.outer_angle = glm::radians(light.outer_angle),
+			});
+		else
+			light_id = light_mgr.add(DirectionalLightParams{ .intensity = light.intensity, .shadow_caster = true, .direction = glm::normalize(light.direction) });
+		if(light_id)
+			light.light_id = *light_id;
+	}
+	light_mgr.flush();
+
+	ShadowAtlas atlas(8192, light_mgr);
+	atlas.set_min_change_interval(options.min_change_interval);
+	atlas.set_max_distance(options.max_distance);
+	for(const auto &[size_idx, skip_frames, interval]: options.render_intervals)
+		atlas.set_render_interval(size_idx, skip_frames, interval);
+
+	Camera camera(60.f, 0.1f, 200.f);
+	camera.setSize(1920, 1080);
+
+	const auto path_duration = std::max(duration_of(camera_path), 1.f);
+	const auto num_frames = size_t(path_duration * options.fps);
+	const auto frame_time = duration_cast<steady_clock::duration>(duration<float>(1.f / options.fps));
+
+	const auto start_time = steady_clock::time_point{} + 1h;  // simulated time; some head room for "long ago"
+	auto next_eval = start_time;
+
+	ShadowAtlas::Counters totals;
+	std::vector<microseconds> planning_times;
+	std::vector<uint64_t> texels_rendered;
+	planning_times.reserve(num_frames);
+	texels_rendered.reserve(num_frames);
+	size_t defrag_moves { 0 };
+	size_t defrag_bytes { 0 };
+
+	std::vector<LightIndex> relevant_lights;
+	relevant_lights.reserve(light_mgr.size());
+
+	for(auto frame = 0u; frame < num_frames; ++frame)
+	{
+		const auto now = start_time + frame * frame_time;
+		const auto t = float(frame) / options.fps;
+
+		// camera & lights at 't'
+		{
+			const auto [index, blend] = key_at(camera_path, t);
+			const auto &key = camera_path[index];
+			const auto &next_key = camera_path[std::min(index + 1, camera_path.size() - 1)];
+			camera.setPosition(glm::mix(key.position, next_key.position, blend));
+			camera.setOrientation(glm::normalize(glm::mix(key.forward, next_key.forward, blend)));
+		}
+		for(const auto &light: animated_lights)
+		{
+			if(light.keys.empty() or light.light_id == NO_LIGHT_ID)
+				continue;
+			const auto [index, blend] = key_at(light.keys, t);
+			const auto &next_key = light.keys[std::min(index + 1, light.keys.size() - 1)];
+			const auto position = glm::mix(light.keys[index].position, next_key.position, blend);
+			entities.patch<component::Transform>(entt::entity(light.light_id), [&position](auto &transform) {
+				transform.set_position(position);
+			});
+		}
+		light_mgr.flush();
+
+		// same as ZigApp::collectRelevantLights()
+		relevant_lights.clear();
+		for(const auto &[light_index, L]: std::views::enumerate(light_mgr))
+		{
+			if(not IS_ENABLED(L))
+				continue;
+			const auto edge_distance = std::max(0.f, glm::distance(L.position, camera.position()) - L.affect_radius);
+			if(IS_DIR_LIGHT(L) or edge_distance < options.view_distance)
+				relevant_lights.push_back(LightIndex(light_index));
+		}
+
+		if(now >= next_eval)
+		{
+			next_eval = now + options.eval_interval;
+
+			const auto T0 = steady_clock::now();
+			atlas.update_allocations(relevant_lights, camera.position(), camera.forwardVector(), now);
+			planning_times.push_back(duration_cast<microseconds>(steady_clock::now() - T0));
+
+			totals += atlas.last_counters();
+		}
+
+		if(const auto sun_id = light_mgr.sun_id(); sun_id != NO_LIGHT_ID and atlas.allocated_lights().contains(sun_id))
+			atlas.update_csm_params(sun_id, camera);
+
+		atlas.defragment();
+		defrag_moves += atlas.defrag_stats().moves;
+		defrag_bytes += atlas.defrag_stats().bytes;
+
+		atlas.update_slots_ssbo();
+
+		// same as ZigApp::renderShadowMaps(), except all allocated lights are considered affecting the view
+		uint64_t texels { 0 };
+		for(const auto &[light_id, atlas_light]: atlas.allocated_lights())
+		{
+			const auto &[general, transform] = entities.get<component::LightGeneral, component::Transform>(entt::entity(light_id));
+			if(not general.enabled)
+				continue;
+
+			const auto light_hash = light_mgr.hash(light_id, general, transform);
+
+			const auto need_render = atlas.need_render(atlas_light, now, light_hash, scene);
+			if(not need_render)
+				continue;
+
+			for(auto slot_idx = 0u; slot_idx < atlas_light.num_slots; ++slot_idx)
+			{
+				if((need_render & (1u << slot_idx)) > 0)
+				{
+					const uint64_t size = atlas_light.slots[slot_idx].size;
+					texels += size * size;
+				}
+			}
+			atlas.on_rendered(atlas_light, now, light_hash, need_render);
+		}
+		texels_rendered.push_back(texels);
+	}
+
+	const auto seconds = float(num_frames) / options.fps;
+	auto per_second = [seconds](uint32_t count) { return float(count) / seconds; };
+
+	std::print("ShadowAtlas churn: {} lights, {} frames ({:.1f} s @ {} fps)\n", light_mgr.size(), num_frames, seconds, options.fps);
+	std::print("  per second:  allocated {:.2f}  promoted {:.2f}  demoted {:.2f}  dropped {:.2f}  denied {:.2f}\n",
+			   per_second(totals.allocated), per_second(totals.promoted), per_second(totals.demoted), per_second(totals.dropped), per_second(totals.denied));
+
+	uint64_t texels_total { 0 };
+	for(const auto texels: texels_rendered)
+		texels_total += texels;
+	std::print("  Mtexels re-rendered per frame:  mean {:.2f}  p50 {:.2f}  p99 {:.2f}  max {:.2f}\n",
+			   double(texels_total) / double(std::max(num_frames, size_t(1))) / 1e6,
+			   double(percentile(texels_rendered, 0.5f)) / 1e6,
+			   double(percentile(texels_rendered, 0.99f)) / 1e6,
+			   double(percentile(texels_rendered, 1.f)) / 1e6);
+
+	std::print("  planning time ({} updates):  p50 {}  p90 {}  p99 {}  max {}\n",
+			   planning_times.size(),
+			   percentile(planning_times, 0.5f),
+			   percentile(planning_times, 0.9f),
+			   percentile(planning_times, 0.99f),
+			   percentile(planning_times, 1.f));
+
+	std::print("  defragmentation:  {} slots moved, {:.1f} MB copied\n", defrag_moves, double(defrag_bytes) / double(1 << 20));
+
+	return 0;
+}
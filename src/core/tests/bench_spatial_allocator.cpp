@@ -0,0 +1,193 @@
+#include "spatial_allocator.h"
+using namespace RGL;
+
+#include <chrono>
+#include <print>
+#include <random>
+#include <vector>
+
+// micro benchmarks of SpatialAllocator (free lists) vs. the previous recursive search
+//   8192 atlas, 1024 .. 128 slots (the shadow atlas' defaults)
+
+namespace
+{
+
+// the previous implementation: a depth-first search from the root, for every allocation
+class RecursiveAllocator
+{
+public:
+	using NodeIndex = uint32_t;
+	static constexpr auto BadIndex = NodeIndex(-1);
+
+	RecursiveAllocator(uint32_t size, uint32_t min_shift, uint32_t max_shift) :
+		_size(size),
+		_max_level(max_shift),
+		_min_level(min_shift)
+	{
+		_nodes.resize(((1u << 2*(_min_level + 1)) - 1) / 3);
+	}
+
+	void reset() { std::ranges::fill(_nodes, Node{}); }
+
+	NodeIndex allocate(uint32_t size, uint32_t min_size)
+	{
+		const auto max_level = level_from_size(min_size);
+		auto index = BadIndex;
+		for(auto lvl = level_from_size(size); index == BadIndex and lvl <= max_level; ++lvl)
+			index = find_available(lvl, 0, 0);
+
+		if(index != BadIndex)
+		{
+			_nodes[index].allocated = true;
+			for(auto parent = index; parent > 0; )
+			{
+				parent = (parent - 1) >> 2;
+				++_nodes[parent].children_allocated;
+			}
+		}
+		return index;
+	}
+
+	bool free(NodeIndex index)
+	{
+		if(not _nodes[index].allocated)
+			return false;
+		_nodes[index].allocated = false;
+		while(index > 0)
+		{
+			index = (index - 1) >> 2;
+			--_nodes[index].children_allocated;
+		}
+		return true;
+	}
+
+private:
+	uint32_t level_from_size(uint32_t size) const { return uint32_t(std::countr_zero(_size / size)); }
+
+	NodeIndex find_available(uint32_t target_level, uint32_t current_level, NodeIndex index)
+	{
+		const auto &n = _nodes[index];
+		if(n.allocated)
+			return BadIndex;
+		if(current_level == target_level)
+			return n.children_allocated == 0? index: BadIndex;
+
+		for(auto child = 1u; child <= 4; ++child)
+		{
+			if(const auto found = find_available(target_level, current_level + 1, (index << 2) + child); found != BadIndex)
+				return found;
+		}
+		return BadIndex;
+	}
+
+private:
+	struct Node
+	{
+		bool     allocated { false };
+		uint32_t children_allocated { 0 };
+	};
+	std::vector<Node> _nodes;
+	uint32_t _size;
+	uint32_t _max_level;
+	uint32_t _min_level;
+};
+
+static constexpr uint32_t s_atlas_size = 8192;
+static constexpr uint32_t s_min_shift  = 6;   // 128
+static constexpr uint32_t s_max_shift  = 3;   // 1024
+
+template<typename Fn>
+void measure(std::string_view name, size_t num_ops, Fn &&fn)
+{
+	using namespace std::chrono;
+
+	fn();  // warm up
+
+	static constexpr auto rounds = 20;
+	const auto start = steady_clock::now();
+	for(auto round = 0; round < rounds; ++round)
+		fn();
+	const auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+	std::print("  {:<32} {:8.1f} ns/op\n", name, double(elapsed.count()) / double(rounds * num_ops));
+}
+
+// allocate a slot distribution until the atlas is full, like ShadowAtlas::generate_slots()
+template<typename Allocator>
+size_t fill(Allocator &allocator, std::vector<uint32_t> *live=nullptr)
+{
+	static constexpr uint32_t distribution[] = { 16, 64, 256 };  // 1024, 512, 256; the rest 128
+
+	allocator.reset();
+
+	size_t ops { 0 };
+	auto size = s_atlas_size >> s_max_shift;
+	for(const auto count: distribution)
+	{
+		for(auto idx = 0u; idx < count; ++idx, ++ops)
+		{
+			const auto index = allocator.allocate(size, size);
+			if(live and index != Allocator::BadIndex)
+				live->push_back(index);
+		}
+		size >>= 1;
+	}
+	for(auto index = allocator.allocate(size, size); index != Allocator::BadIndex; index = allocator.allocate(size, size), ++ops)
+	{
+		if(live)
+			live->push_back(index);
+	}
+
+	return ops + 1;
+}
+
+// random frees & (demotable) allocations of a full atlas
+template<typename Allocator>
+size_t churn(Allocator &allocator, std::vector<uint32_t> &live, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<uint32_t> size_shift(s_max_shift, s_min_shift);
+
+	static constexpr size_t num_ops = 4096;
+	for(auto op = 0u; op < num_ops; ++op)
+	{
+		if(not live.empty() and (op & 1))
+		{
+			const auto victim = rng() % live.size();
+			(void)allocator.free(live[victim]);
+			live[victim] = live.back();
+			live.pop_back();
+		}
+		else
+		{
+			const auto size = s_atlas_size >> size_shift(rng);
+			const auto index = allocator.allocate(size, s_atlas_size >> s_min_shift);
+			if(index != Allocator::BadIndex)
+				live.push_back(index);
+		}
+	}
+	return num_ops;
+}
+
+} // anonymous
+
+
+int main()
+{
+	SpatialAllocator<uint32_t> free_lists(s_atlas_size, s_min_shift, s_max_shift);
+	RecursiveAllocator recursive(s_atlas_size, s_min_shift, s_max_shift);
+
+	std::print("SpatialAllocator {}² @ {}..{} px\n", s_atlas_size, s_atlas_size >> s_min_shift, s_atlas_size >> s_max_shift);
+
+	const auto fill_ops = fill(free_lists);
+	measure("fill (free lists)", fill_ops, [&] { fill(free_lists); });
+	measure("fill (recursive)",  fill_ops, [&] { fill(recursive); });
+
+	std::vector<uint32_t> live;
+	live.reserve(8192);
+	const auto churn_ops = fill_ops + 4096;
+	measure("fill + churn (free lists)", churn_ops, [&] { live.clear(); fill(free_lists, &live); churn(free_lists, live, 42); });
+	measure("fill + churn (recursive)",  churn_ops, [&] { live.clear(); fill(recursive, &live); churn(recursive, live, 42); });
+
+	return 0;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "glad/glad.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// GL buffer stubs for headless tests & benchmarks, i.e. no GL context
+//   host memory backs the buffers, so mapping works
+
+namespace gl_stubs
+{
+
+inline std::vector<std::vector<std::byte>> s_buffers;
+
+inline std::vector<std::byte> &buffer_data(GLuint id)
+{
+	assert(id > 0 and id <= s_buffers.size());
+	return s_buffers[id - 1];
+}
+
+inline void stub_gl_buffers()
+{
+	glad_glCreateBuffers = [](GLsizei n, GLuint *ids) {
+		for(auto idx = 0; idx < n; ++idx)
+		{
+			s_buffers.emplace_back();
+			ids[idx] = GLuint(s_buffers.size());
+		}
+	};
+	glad_glDeleteBuffers = [](GLsizei n, const GLuint *ids) {
+		for(auto idx = 0; idx < n; ++idx)
+			buffer_data(ids[idx]) = {};
+	};
+	glad_glBindBuffer     = [](GLenum, GLuint) {};
+	glad_glBindBufferBase = [](GLenum, GLuint, GLuint) {};
+	glad_glNamedBufferData = [](GLuint id, GLsizeiptr size, const void *data, GLenum) {
+		auto &buffer = buffer_data(id);
+		buffer.resize(size_t(size));
+		if(data)
+			std::memcpy(buffer.data(), data, size_t(size));
+	};
+	glad_glNamedBufferStorage = [](GLuint id, GLsizeiptr size, const void *data, GLbitfield) {
+		glad_glNamedBufferData(id, size, data, 0);
+	};
+	glad_glNamedBufferSubData = [](GLuint id, GLintptr offset, GLsizeiptr size, const void *data) {
+		auto &buffer = buffer_data(id);
+		buffer.resize(std::max(buffer.size(), size_t(offset + size)));
+		std::memcpy(buffer.data() + offset, data, size_t(size));
+	};
+	glad_glClearNamedBufferData = [](GLuint id, GLenum, GLenum, GLenum, const void *) {
+		std::ranges::fill(buffer_data(id), std::byte(0));
+	};
+	glad_glCopyNamedBufferSubData = [](GLuint src, GLuint dest, GLintptr src_offset, GLintptr dest_offset, GLsizeiptr size) {
+		std::memcpy(buffer_data(dest).data() + dest_offset, buffer_data(src).data() + src_offset, size_t(size));
+	};
+	glad_glGetNamedBufferSubData = [](GLuint id, GLintptr offset, GLsizeiptr size, void *data) {
+		std::memcpy(data, buffer_data(id).data() + offset, size_t(size));
+	};
+	glad_glMapNamedBuffer = [](GLuint id, GLenum) -> void * {
+		return buffer_data(id).data();
+	};
+	glad_glMapNamedBufferRange = [](GLuint id, GLintptr offset, GLsizeiptr, GLbitfield) -> void * {
+		return buffer_data(id).data() + offset;
+	};
+	glad_glUnmapNamedBuffer = [](GLuint) -> GLboolean { return GL_TRUE; };
+	glad_glFlushMappedNamedBufferRange = [](GLuint, GLintptr, GLsizeiptr) {};
+	glad_glMemoryBarrier = [](GLbitfield) {};
+	glad_glFenceSync = [](GLenum, GLbitfield) -> GLsync { return reinterpret_cast<GLsync>(1); };
+	glad_glClientWaitSync = [](GLsync, GLbitfield, GLuint64) -> GLenum { return GL_ALREADY_SIGNALED; };
+	glad_glDeleteSync = [](GLsync) {};
+	// the defragmentation's slot copies
+	glad_glCopyImageSubData = [](GLuint, GLenum, GLint, GLint, GLint, GLint, GLuint, GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei) {};
+}
+
+} // gl_stubs
@@ -0,0 +1,58 @@
+#include "blur_kernel.h"
+using namespace RGL;
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+#include <cmath>
+#include <numeric>
+
+
+suite<fixed_string("blur_kernel")> blur_kernel_suite([]{
+
+	"radius"_test = [] {
+		static_assert(blur_kernel::radius(1.f) == 3);
+		static_assert(blur_kernel::radius(1.5f) == 5);
+		static_assert(blur_kernel::radius(3.f) == 9);
+		static_assert(blur_kernel::num_folded(3) == 2);
+		static_assert(blur_kernel::num_folded(4) == 2);
+	};
+
+	"normalized"_test = [] {
+		constexpr auto kernel = blur_kernel::make<2.f>();
+
+		const auto sides = std::accumulate(kernel.weights.begin() + 1, kernel.weights.end(), 0.f);
+		expect(std::abs(kernel.weights[0] + 2*sides - 1.f) < 1e-5f);
+		// matches the gaussian's shape
+		expect(std::abs(kernel.weights[2] / kernel.weights[0] - std::exp(-0.5f)) < 1e-5f);
+
+		const auto folded = std::accumulate(kernel.folded_weights.begin(), kernel.folded_weights.end(), 0.f);
+		expect(std::abs(folded - sides) < 1e-6f);
+	};
+
+	"folded_taps"_test = [] {
+		constexpr auto kernel = blur_kernel::make<1.5f>();  // radius 5, i.e. an odd last tap
+
+		// a linearly interpolated signal; the folded fetches must yield the same sum as the single taps
+		const float signal[] = { 3.f, -1.f, 4.f, 1.f, -5.f, 9.f, 2.f };
+		auto sample = [&signal](float pos) {
+			const auto idx = size_t(pos);
+			const auto frac = pos - float(idx);
+			return idx + 1 < std::size(signal)? signal[idx]*(1 - frac) + signal[idx + 1]*frac: signal[idx];
+		};
+
+		float taps = 0;
+		for(auto idx = 1u; idx < kernel.weights.size(); ++idx)
+			taps += kernel.weights[idx] * signal[idx];
+
+		float folded = 0;
+		for(auto idx = 0u; idx < kernel.folded_weights.size(); ++idx)
+		{
+			expect(kernel.folded_offsets[idx] >= float(1 + 2*idx) and kernel.folded_offsets[idx] <= float(2 + 2*idx));
+			folded += kernel.folded_weights[idx] * sample(kernel.folded_offsets[idx]);
+		}
+
+		expect(std::abs(taps - folded) < 1e-5f);
+		expect(kernel.folded_offsets.back() == 5.f);
+	};
+});
@@ -0,0 +1,85 @@
+#include "caster_volume.h"
+using namespace RGL;
+
+#include <glm/mat4x4.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/matrix.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+
+suite<fixed_string("CasterVolume")> caster_volume_suite([]{
+
+	auto box_corners = [](const glm::vec3 &min, const glm::vec3 &max) {
+		CasterVolume::Corners corners;
+		for(auto idx = 0u; idx < 8; ++idx)
+			corners[idx] = glm::vec3(idx & 4? max.x: min.x, idx & 2? max.y: min.y, idx & 1? max.z: min.z);
+		return corners;
+	};
+	// a 10 x 2 x 10 slab of receivers, e.g. the floor
+	const auto floor = box_corners({ -5, 0, -5 }, { 5, 2, 5 });
+
+	"point_above"_test = [&] {
+		CasterVolume volume;
+		volume.set_point(floor, { 0, 10, 0 });
+
+		expect(volume.contains(glm::vec3(0, 5, 0)));    // between the light and the receivers
+		expect(volume.contains(glm::vec3(1, 1, 1)));    // among the receivers
+		expect(not volume.contains(glm::vec3(8, 5, 0)));   // beside
+		expect(not volume.contains(glm::vec3(0, -3, 0)));  // below the receivers
+		expect(not volume.contains(glm::vec3(0, 12, 0)));  // behind the light
+
+		expect(not volume.contains(bounds::Sphere({ 6, 5, 0 }, 1)));
+		expect(volume.contains(bounds::Sphere({ 6, 5, 0 }, 3)));  // reaches into the volume
+	};
+
+	"point_inside"_test = [&] {
+		// nothing outside the receiver volume can shadow it
+		CasterVolume volume;
+		volume.set_point(floor, { 0, 1, 0 });
+
+		expect(volume.contains(glm::vec3(1, 1, 1)));
+		expect(volume.contains(glm::vec3(0, 1.9f, 0)));
+		expect(not volume.contains(glm::vec3(0, 5, 0)));
+		expect(volume.planes().size() == 6u);
+	};
+
+	"directional"_test = [&] {
+		CasterVolume volume;
+		volume.set_directional(floor, { 0, -1, 0 });
+
+		expect(volume.contains(glm::vec3(0, 100, 0)));     // any distance towards the light
+		expect(volume.contains(glm::vec3(3, 50, -3)));
+		expect(not volume.contains(glm::vec3(8, 50, 0)));
+		expect(not volume.contains(glm::vec3(0, -3, 0)));  // "after" the receivers
+
+		volume.set_directional(floor, { 1, -1, 0 });
+		expect(volume.contains(glm::vec3(-40, 45, 0)));
+		expect(not volume.contains(glm::vec3(40, 45, 0)));
+	};
+
+	"camera_frustum"_test = [&] {
+		// a camera at the origin, looking down -Z; the light is behind it
+		const auto inv_projection = glm::inverse(glm::perspective(glm::radians(90.f), 1.f, 1.f, 10.f));
+		CasterVolume::Corners view;
+		for(auto idx = 0u; idx < 8; ++idx)
+		{
+			const auto corner = inv_projection * glm::vec4(idx & 4? 1: -1, idx & 2? 1: -1, idx & 1? 1: -1, 1);
+			view[idx] = glm::vec3(corner) / corner.w;
+		}
+
+		CasterVolume volume;
+		volume.set_point(view, { 0, 0, 5 });
+
+		expect(volume.contains(glm::vec3(0, 0, 2)));        // behind the camera, but in front of the light
+		expect(volume.contains(glm::vec3(0, 0, -5)));       // in view
+		expect(not volume.contains(glm::vec3(0, 0, 7)));    // behind the light
+		expect(not volume.contains(glm::vec3(20, 0, -5)));  // outside the view
+
+		// cleared; contains everything
+		volume.clear();
+		expect(volume.contains(glm::vec3(20, 0, -5)));
+	};
+});
@@ -0,0 +1,100 @@
+#include "cluster_grid.h"
+using namespace RGL;
+
+#include <glm/trigonometric.hpp>
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+
+suite<fixed_string("ClusterGrid")> cluster_grid_suite([]{
+
+	const auto screen_size = glm::uvec2(1920, 1080);
+	const auto fov = glm::radians(60.f);
+
+	auto grid_count = [&](const ClusterGridConfig &config) {
+		return cluster_grid(config, screen_size, fov, 0.1f, 100.f).count();
+	};
+
+	"grid"_test = [&] {
+		const auto grid = cluster_grid({}, screen_size, fov, 0.1f, 100.f);
+		expect(grid.resolution.x == 16u);
+		expect(grid.block_size == 120u);
+		expect(grid.resolution.y == 9u);
+		expect(grid.resolution.z > 0u);
+		expect(grid.count() < uint32_t(CLUSTER_MAX_COUNT));
+
+		// thinner slices -> more of them
+		const auto fine = cluster_grid({ .depth_scale = 0.5f }, screen_size, fov, 0.1f, 100.f);
+		expect(fine.resolution.z > grid.resolution.z);
+	};
+
+	const ClusterGridTuner::Feedback balanced {
+		.num_clusters = 1000, .avg_lights = 10, .max_lights = 40, .overflowed = 0, .cull_time = 100, .shading_time = 1000,
+	};
+
+	"balanced"_test = [&] {
+		ClusterGridTuner tuner;
+		for(auto idx = 0u; idx < 200; ++idx)
+			expect(not tuner.update({}, balanced, grid_count));
+	};
+
+	"overflow"_test = [&] {
+		ClusterGridTuner tuner;
+		auto feedback = balanced;
+		feedback.overflowed = 3;
+		feedback.max_lights = 300;
+
+		// immediately refined
+		const auto next = tuner.update({}, feedback, grid_count);
+		expect(next.has_value());
+		if(next)
+			expect(grid_count(*next) > grid_count({}));
+
+		// then nothing, while cooling down
+		for(auto idx = 0u; idx < tuner.policy().cooldown_updates; ++idx)
+			expect(not tuner.update(*next, feedback, grid_count));
+		expect(tuner.update(*next, feedback, grid_count).has_value());
+	};
+
+	"dense_settle"_test = [&] {
+		ClusterGridTuner tuner;
+		auto feedback = balanced;
+		feedback.avg_lights = 30;
+
+		for(auto idx = 1u; idx < tuner.policy().settle_updates; ++idx)
+			expect(not tuner.update({}, feedback, grid_count));
+		expect(tuner.update({}, feedback, grid_count).has_value());
+	};
+
+	"sparse"_test = [&] {
+		ClusterGridTuner tuner;
+		auto feedback = balanced;
+		feedback.avg_lights = 1;
+		feedback.cull_time = 500;
+		feedback.shading_time = 500;
+
+		std::optional<ClusterGridConfig> next;
+		for(auto idx = 0u; idx < tuner.policy().settle_updates and not next; ++idx)
+			next = tuner.update({}, feedback, grid_count);
+		expect(next.has_value());
+		if(next)
+			expect(grid_count(*next) < grid_count({}));
+	};
+
+	"sparse_cheap_cull"_test = [&] {
+		// few lights, but the cull is cheap anyway; not worth a rebuild
+		ClusterGridTuner tuner;
+		auto feedback = balanced;
+		feedback.avg_lights = 1;
+		for(auto idx = 0u; idx < 200; ++idx)
+			expect(not tuner.update({}, feedback, grid_count));
+	};
+
+	"budget"_test = [&] {
+		ClusterGridTuner tuner({ .max_clusters = grid_count({}) });
+		auto feedback = balanced;
+		feedback.overflowed = 1;
+		expect(not tuner.update({}, feedback, grid_count));
+	};
+});
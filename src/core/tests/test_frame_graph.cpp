@@ -0,0 +1,165 @@
+#include "frame_graph.h"
+using namespace RGL;
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+
+suite<fixed_string("FrameGraph")> frame_graph_suite([]{
+
+	using A = FrameGraph::Access;
+	using Builder = FrameGraph::Builder;
+
+	static const auto nop = [](const FrameGraph::Resources &) {};
+	static const FrameGraph::TextureDesc full_desc { .size = { 1920, 1080 } };
+	static const FrameGraph::TextureDesc half_desc { .size = { 960, 540 }, .color = RenderTarget::Color::HalfFloat | RenderTarget::Color::Texture };
+
+	"culling"_test = [] {
+		RenderTargetPool pool;
+		FrameGraph graph(pool);
+		FrameGraph::Handle unused, used;
+
+		graph.add_pass("unused", [&](Builder &b) { unused = b.create("unused", full_desc); b.write(unused); }, nop);
+		graph.add_pass("producer", [&](Builder &b) { used = b.create("used", full_desc); b.write(used); }, nop);
+		graph.add_pass("present", [&](Builder &b) { b.read(used); b.side_effect(); }, nop);
+		graph.compile();
+
+		expect(graph.is_culled(0));
+		expect(not graph.is_culled(1));
+		expect(not graph.is_culled(2));
+		expect(graph.stats().culled_passes == 1u);
+		expect(graph.physical_index(unused) == FrameGraph::Invalid);
+		expect(graph.physical_index(used) != FrameGraph::Invalid);
+	};
+
+	"overwritten"_test = [] {
+		RenderTargetPool pool;
+		FrameGraph graph(pool);
+		const auto buffer = graph.import_buffer("buffer");
+		const auto output = graph.import_buffer("output");
+
+		graph.add_pass("first", [&](Builder &b) { b.write(buffer, A::Storage); }, nop);
+		graph.add_pass("second", [&](Builder &b) { b.write(buffer, A::Storage); }, nop);            // overwrites all of it
+		graph.add_pass("modify", [&](Builder &b) { b.read(buffer, A::Storage); b.write(buffer, A::Storage); }, nop);
+		graph.add_pass("consume", [&](Builder &b) { b.read(buffer, A::Storage); b.write(output, A::Storage); }, nop);
+		graph.mark_output(output);
+		graph.compile();
+
+		expect(graph.is_culled(0));
+		expect(not graph.is_culled(1));
+		expect(not graph.is_culled(2));
+		expect(not graph.is_culled(3));
+	};
+
+	"barriers"_test = [] {
+		RenderTargetPool pool;
+		FrameGraph graph(pool);
+		const auto buffer = graph.import_buffer("buffer");
+		FrameGraph::Handle image, target;
+
+		graph.add_pass("store", [&](Builder &b) {
+			image = b.create("image", half_desc);
+			b.write(buffer, A::Storage);
+			b.write(image, A::Image);
+		}, nop);
+		graph.add_pass("read 1", [&](Builder &b) { b.read(buffer, A::Storage); b.read(image, A::Sampled); b.side_effect(); }, nop);
+		graph.add_pass("read 2", [&](Builder &b) { b.read(buffer, A::Storage); b.read(image, A::Sampled); b.side_effect(); }, nop);
+		graph.add_pass("indirect", [&](Builder &b) { b.read(buffer, A::Indirect); b.side_effect(); }, nop);
+		graph.add_pass("draw", [&](Builder &b) {
+			target = b.create("target", full_desc);
+			b.read(image, A::Sampled);
+			b.write(target, A::Attachment);
+		}, nop);
+		graph.add_pass("present", [&](Builder &b) { b.read(target, A::Sampled); b.side_effect(); }, nop);
+		graph.compile();
+
+		expect(graph.barrier(0) == 0u);
+		expect(graph.barrier(1) == GLbitfield(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT));
+		expect(graph.barrier(2) == 0u);  // already issued
+		expect(graph.barrier(3) == GLbitfield(GL_COMMAND_BARRIER_BIT));
+		expect(graph.barrier(4) == 0u);
+		expect(graph.barrier(5) == 0u);  // framebuffer writes are coherent
+		expect(graph.stats().barriers == 2u);
+	};
+
+	"aliasing"_test = [] {
+		RenderTargetPool pool;
+		FrameGraph graph(pool);
+		FrameGraph::Handle first, second, overlapping, other_desc;
+
+		graph.add_pass("write first", [&](Builder &b) { first = b.create("first", full_desc); b.write(first); }, nop);
+		graph.add_pass("read first", [&](Builder &b) {
+			b.read(first);
+			overlapping = b.create("overlapping", full_desc);
+			b.write(overlapping);
+		}, nop);
+		graph.add_pass("write second", [&](Builder &b) {
+			second = b.create("second", full_desc);
+			b.read(overlapping);
+			b.write(second);
+		}, nop);
+		graph.add_pass("read second", [&](Builder &b) {
+			b.read(second);
+			other_desc = b.create("other", half_desc);
+			b.write(other_desc);
+		}, nop);
+		graph.add_pass("present", [&](Builder &b) { b.read(other_desc); b.side_effect(); }, nop);
+		graph.compile();
+
+		expect(graph.physical_index(first) == graph.physical_index(second));
+		expect(graph.physical_index(overlapping) != graph.physical_index(first));
+		expect(graph.physical_index(other_desc) != graph.physical_index(first));
+		expect(graph.physical_index(other_desc) != graph.physical_index(overlapping));
+
+		const auto &stats = graph.stats();
+		expect(stats.transient_textures == 4u);
+		expect(stats.physical_textures == 3u);
+		expect(stats.physical_bytes == stats.transient_bytes - RenderTargetPool::estimated_size(full_desc));
+	};
+
+	"aliasing_hazard"_test = [] {
+		RenderTargetPool pool;
+		FrameGraph graph(pool);
+		FrameGraph::Handle first, second;
+
+		graph.add_pass("store", [&](Builder &b) { first = b.create("first", full_desc); b.write(first, A::Image); }, nop);
+		graph.add_pass("sample", [&](Builder &b) { b.read(first, A::Sampled); b.side_effect(); }, nop);
+		graph.add_pass("draw", [&](Builder &b) { second = b.create("second", full_desc); b.write(second, A::Attachment); }, nop);
+		graph.add_pass("present", [&](Builder &b) { b.read(second); b.side_effect(); }, nop);
+		graph.compile();
+
+		// the same memory; the image stores must complete before the draw
+		expect(graph.physical_index(first) == graph.physical_index(second));
+		expect(graph.barrier(1) == GLbitfield(GL_TEXTURE_FETCH_BARRIER_BIT));
+		expect(graph.barrier(2) == GLbitfield(GL_FRAMEBUFFER_BARRIER_BIT));
+	};
+
+	"frames"_test = [] {
+		RenderTargetPool pool;
+		FrameGraph graph(pool);
+		uint32_t physical[2];
+
+		for(auto frame = 0u; frame < 2; ++frame)
+		{
+			graph.clear();
+			FrameGraph::Handle texture;
+			graph.add_pass("draw", [&](Builder &b) { texture = b.create("texture", full_desc); b.write(texture); }, nop);
+			graph.add_pass("present", [&](Builder &b) { b.read(texture); b.side_effect(); }, nop);
+			graph.compile();
+			physical[frame] = graph.physical_index(texture);
+		}
+
+		// the same assignment every frame, i.e. the same pooled render target
+		expect(physical[0] == physical[1]);
+		expect(graph.stats().physical_textures == 1u);
+	};
+
+	"estimated_size"_test = [] {
+		namespace C = RenderTarget::Color;
+		namespace D = RenderTarget::Depth;
+
+		expect(RenderTargetPool::estimated_size({ .size = { 16, 16 }, .color = C::Float, .depth = D::None }) == 16u*16*16);
+		expect(RenderTargetPool::estimated_size({ .size = { 16, 16 }, .color = C::Float2, .depth = D::Float }) == 16u*16*8);
+		expect(RenderTargetPool::estimated_size({ .size = { 16, 16 }, .color = C::HalfFloat | C::Texture }) == 16u*16*8*4/3);
+	};
+});
@@ -0,0 +1,65 @@
+#include "bounds.h"
+using namespace RGL;
+
+#include <glm/trigonometric.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+
+suite<fixed_string("Intersect")> intersect_suite([]{
+
+	// a spot at the origin, pointing down -Z
+	const bounds::Cone cone({ 0, 0, 0 }, { 0, 0, -1 }, 10, glm::radians(20.f));
+
+	auto box_at = [](const glm::vec3 &center, float half_size = 0.5f) {
+		return bounds::AABB(center - half_size, center + half_size);
+	};
+
+	"cone_inside"_test = [&] {
+		expect(intersect::check(box_at({ 0, 0, -5 }), cone));
+		expect(intersect::check(box_at({ 0, 0, 0 }), cone));   // apex
+		expect(intersect::check(box_at({ 1.5f, 0, -5 }), cone));  // near the rim (tan(20) * 5 = 1.8)
+	};
+
+	"cone_outside"_test = [&] {
+		expect(not intersect::check(box_at({ 5, 0, -5 }), cone));    // beside
+		expect(not intersect::check(box_at({ 0, 0, 5 }), cone));     // behind
+		expect(not intersect::check(box_at({ 0, 0, -12 }), cone));   // beyond the range
+		expect(not intersect::check(box_at({ 0, -4, -3 }), cone));   // beside, within range
+	};
+
+	// a 4 x 2 x 0.2 slab, rotated 45 degrees around Z
+	const auto rotation = glm::mat3_cast(glm::angleAxis(glm::radians(45.f), glm::vec3(0, 0, 1)));
+	const bounds::OBB obb({ 0, 0, 0 }, rotation, { 2, 1, 0.1f });
+
+	"obb_inside"_test = [&] {
+		expect(intersect::check(box_at({ 0, 0, 0 }), obb));
+		expect(intersect::check(box_at({ 1.2f, 1.2f, 0 }, 0.1f), obb));   // along the long, diagonal axis
+		expect(intersect::check(bounds::AABB({ -10, -10, -10 }, { 10, 10, 10 }), obb));  // enclosed
+	};
+
+	"obb_outside"_test = [&] {
+		expect(not intersect::check(box_at({ 0, 0, 1 }), obb));          // above the slab
+		expect(not intersect::check(box_at({ 1.5f, -1.5f, 0 }, 0.1f), obb));  // off the short axis; inside the OBB's AABB
+		expect(not intersect::check(box_at({ 5, 5, 0 }), obb));
+	};
+
+	// a 2 x 2 one-sided area light at the origin, facing +Z, affecting 3 units
+	const auto area_light = bounds::OBB::areaLight({ 0, 0, 0 }, { 0, 0, 1 }, { 1, 0, 0 }, { 1, 1 }, 3, false);
+
+	"area_light_front"_test = [&] {
+		expect(intersect::check(box_at({ 0, 0, 1 }), area_light));
+		expect(intersect::check(box_at({ 3, 0, 0.5f }), area_light));  // beside the surface, in front
+		expect(not intersect::check(box_at({ 0, 0, 4 }), area_light));  // beyond the range
+	};
+
+	"area_light_behind"_test = [&] {
+		expect(not intersect::check(box_at({ 0, 0, -1 }), area_light));
+		expect(not intersect::check(box_at({ 2, 1, -2 }), area_light));
+
+		const auto double_sided = bounds::OBB::areaLight({ 0, 0, 0 }, { 0, 0, 1 }, { 1, 0, 0 }, { 1, 1 }, 3, true);
+		expect(intersect::check(box_at({ 0, 0, -1 }), double_sided));
+	};
+});
@@ -0,0 +1,94 @@
+#include "light_packing.h"
+using namespace RGL;
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+
+suite<fixed_string("LightPacking")> lp_suite([]{
+
+	"oct_roundtrip"_test = [] {
+		const glm::vec3 directions[] {
+			{ 1, 0, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+			{ 0.3f, -0.4f, -0.866f }, { -0.577f, 0.577f, 0.577f }, { -0.1f, -0.2f, -0.97f },
+		};
+		for(const auto &dir: directions)
+		{
+			const auto n = glm::normalize(dir);
+			const auto decoded = lights::oct_decode(lights::oct_encode(n));
+			expect(glm::dot(n, decoded) > 0.99999f) << std::format("({}, {}, {}) -> ({}, {}, {})", n.x, n.y, n.z, decoded.x, decoded.y, decoded.z);
+		}
+	};
+
+	"rect_shape"_test = [] {
+		GPULight L {};
+		L.type_flags = LIGHT_TYPE_RECT | LIGHT_ENABLED;
+		const glm::vec3 right { 1.5f, 0, 0.25f };
+		const glm::vec3 up    { 0, 0.75f, 0 };
+		L.shape_data[0] = glm::vec4(+ right - up, 1);
+		L.shape_data[1] = glm::vec4(- right - up, 1);
+		L.shape_data[2] = glm::vec4(+ right + up, 1);
+		L.shape_data[3] = glm::vec4(- right + up, 1);
+
+		GPULightPacked P;
+		lights::pack(L, P);
+
+		const auto s01 = glm::unpackHalf2x16(P.shape_data[0]);
+		const auto s23 = glm::unpackHalf2x16(P.shape_data[1]);
+		const auto s45 = glm::unpackHalf2x16(P.shape_data[2]);
+		expect(glm::vec3(s01, s23.x) == right);
+		expect(glm::vec3(s23.y, s45) == up);
+	};
+
+	"spot_cull_bounds"_test = [] {
+		GPULight L {};
+		L.type_flags = LIGHT_TYPE_SPOT | LIGHT_ENABLED;
+		L.position = { 1, 2, 3 };
+		L.direction = { 0, -1, 0 };
+		L.affect_radius = 10;
+		L.spot_bounds_radius = 4;
+		L.outer_angle = glm::radians(30.f);
+
+		GPULightCull C;
+		lights::pack(L, C);
+		expect(C.position == glm::vec3(1, -2, 3));
+		expect(C.radius == 4.f);
+		const auto cone = glm::unpackHalf2x16(C.shape);
+		expect(std::abs(cone.x - std::cos(L.outer_angle)) < 1e-3f);
+	};
+
+	"rect_cull_bounds"_test = [] {
+		GPULight L {};
+		L.type_flags = LIGHT_TYPE_RECT | LIGHT_ENABLED;
+		L.intensity = 10;
+		L.affect_radius = 5;
+		const glm::vec3 right { 3, 0, 0 };
+		const glm::vec3 up    { 0, 4, 0 };
+		L.shape_data[0] = glm::vec4(+ right - up, 1);
+		L.shape_data[1] = glm::vec4(- right - up, 1);
+		L.shape_data[2] = glm::vec4(+ right + up, 1);
+		L.shape_data[3] = glm::vec4(- right + up, 1);
+
+		GPULightCull C;
+		lights::pack(L, C);
+		expect(C.radius == 10.f);  // affect radius + half diagonal
+		expect(glm::unpackHalf2x16(C.shape) == glm::vec2(3, 4));
+		expect(glm::dot(lights::oct_decode(C.tangent), glm::vec3(1, 0, 0)) > 0.9999f);
+		expect(lights::oct_decode(C.direction).z < -0.9999f);  // the emitting side
+
+		L.intensity = 0.01f;
+		lights::pack(L, C);
+		expect(not IS_ENABLED(C));
+	};
+
+	"cluster_range"_test = [] {
+		const auto range = lights::unpack_cluster_range(lights::pack_cluster_range(123456, 42));
+		expect(range.start_index == 123456u);
+		expect(range.count == 42u);
+
+		// overflowing counts must still read as overflowing
+		const auto overflowed = lights::unpack_cluster_range(lights::pack_cluster_range(10, 100000));
+		expect(overflowed.start_index == 10u);
+		expect(overflowed.count > uint32_t(CLUSTER_MAX_LIGHTS));
+	};
+});
@@ -0,0 +1,211 @@
+#include "shadow_atlas.h"
+#include "light_manager.h"
+#include "component/transform.h"
+#include "log.h"
+using namespace RGL;
+
+#include "gl_stubs.h"
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+using namespace std::chrono;
+
+
+namespace
+{
+
+struct StubbedGL
+{
+	StubbedGL() { gl_stubs::stub_gl_buffers(); }  // before any buffer is created
+};
+
+// shadow casting lights, all with a low value, i.e. all desire the smallest tier
+//   (more slots than it has), while the larger tiers are free
+struct AtlasFixture : StubbedGL
+{
+	AtlasFixture()
+	{
+		Log::set_level(Log::ERROR);
+		light_mgr.set_upload_policy({ .gpu_scatter = false });
+		atlas.set_max_distance(1000.f);
+	}
+
+	template<typename LightParams>
+	void add_lights(uint32_t count, const LightParams &params, ShadowAtlas::SlotConfig config=ShadowAtlas::SlotConfig::Single)
+	{
+		for(auto idx = 0u; idx < count; ++idx)
+		{
+			const auto light_id = light_mgr.add(params);
+			expect(light_id.has_value());
+			light_ids.push_back(*light_id);
+			if(config != ShadowAtlas::SlotConfig::Single)
+				atlas.set_point_projection(*light_id, config);
+		}
+		// value = (1.2 * radius / edge distance)^2  ->  0.09
+		const auto radius = light_mgr.affect_radius(light_ids.front());
+		for(const auto light_id: light_ids)
+		{
+			entities.patch<component::Transform>(entt::entity(light_id), [radius](auto &transform) {
+				transform.set_position({ 0, 0, -5*radius });
+			});
+		}
+		light_mgr.flush();
+	}
+
+	std::vector<LightIndex> all_lights() const
+	{
+		std::vector<LightIndex> relevant_lights;
+		for(auto idx = 0u; idx < light_mgr.size(); ++idx)
+			relevant_lights.push_back(LightIndex(idx));
+		return relevant_lights;
+	}
+
+	void update(const std::vector<LightIndex> &relevant_lights)
+	{
+		atlas.update_allocations(relevant_lights, { 0, 0, 0 }, { 0, 0, -1 }, now);
+		now += 100ms;
+	}
+
+	entt::registry entities;
+	LightManager light_mgr { entities };
+	ShadowAtlas atlas { 1024, light_mgr };
+	std::vector<LightID> light_ids;
+	steady_clock::time_point now { steady_clock::time_point{} + 1h };
+};
+
+struct Fragmented
+{
+	std::vector<LightID> split_lights;   // the lights in the split sibling group
+	std::vector<glm::uvec4> vacated;      // the slots freed in two other groups
+};
+
+// fills the smallest tier, splits a larger slot for two more lights, then frees a slot in two other sibling groups
+//   i.e. the split group is the cheapest to merge back (two moves)
+Fragmented fragment(AtlasFixture &F)
+{
+	F.add_lights(600, SpotLightParams{ .shadow_caster = true });
+	F.update(F.all_lights());
+	expect(F.atlas.last_counters().denied > 0u);
+
+	F.atlas.defragment();
+	expect(F.atlas.defrag_stats().splits == 1u);
+
+	// the allocated lights, and two of the denied ones
+	std::vector<LightIndex> relevant_lights;
+	auto num_denied = 2u;
+	for(const auto light_id: F.light_ids)
+	{
+		if(F.atlas.allocated_lights().contains(light_id))
+			relevant_lights.push_back(F.light_mgr.light_index(light_id));
+		else if(num_denied > 0)
+		{
+			--num_denied;
+			relevant_lights.push_back(F.light_mgr.light_index(light_id));
+		}
+	}
+	F.update(relevant_lights);
+	expect(F.atlas.last_counters().denied == 0u);
+
+	// group the slots by their parent (sibling group)
+	std::map<std::pair<uint32_t, uint32_t>, std::vector<LightID>> groups;
+	for(const auto &[light_id, atlas_light]: F.atlas.allocated_lights())
+	{
+		const auto &rect = atlas_light.slots[0].rect;
+		groups[{ rect.x / (rect.z * 2), rect.y / (rect.w * 2) }].push_back(light_id);
+	}
+
+	Fragmented fragmented;
+	for(const auto &[parent, group]: groups)
+	{
+		if(group.size() == 2)
+		{
+			expect(fragmented.split_lights.empty());
+			fragmented.split_lights = group;
+		}
+		else if(group.size() == 4 and fragmented.vacated.size() < 2)
+		{
+			fragmented.vacated.push_back(F.atlas.allocated_lights().at(group.front()).slots[0].rect);
+			F.atlas.remove_allocation(group.front());
+		}
+	}
+	expect(fragmented.split_lights.size() == 2u);
+	expect(fragmented.vacated.size() == 2u);
+
+	return fragmented;
+}
+
+bool moved_to_vacated(const AtlasFixture &F, const Fragmented &fragmented)
+{
+	return std::ranges::all_of(fragmented.split_lights, [&](LightID light_id) {
+		return std::ranges::contains(fragmented.vacated, F.atlas.allocated_lights().at(light_id).slots[0].rect);
+	});
+}
+
+} // anonymous
+
+
+suite<fixed_string("ShadowAtlas")> shadow_atlas_suite([]{
+
+	"denied_gets_split_slot"_test = [] {
+		AtlasFixture F;
+		F.add_lights(100, PointLightParams{ .shadow_caster = true }, ShadowAtlas::SlotConfig::Cube);
+
+		F.update(F.all_lights());
+		expect(F.atlas.last_counters().denied > 0u);
+		const auto num_allocated = F.atlas.allocated_lights().size();
+
+		// frames without a (new) plan applied, e.g. the async planning isn't done yet
+		for(auto frame = 0u; frame < 3; ++frame)
+			F.atlas.defragment();
+
+		F.update(F.all_lights());
+		expect(F.atlas.allocated_lights().size() > num_allocated);
+	};
+
+	"merge_moves_dirty_slots_without_copying"_test = [] {
+		AtlasFixture F;
+		const auto fragmented = fragment(F);
+
+		// never rendered, i.e. all dirty; nothing to copy, so the budget doesn't limit the moves
+		F.atlas.set_defrag_budget(1);
+		F.atlas.defragment();
+		const auto &stats = F.atlas.defrag_stats();
+		expect(stats.moves == 2u);
+		expect(stats.bytes == 0u);
+		expect(stats.merges == 1u);
+		expect(stats.pending == 0u);
+		expect(moved_to_vacated(F, fragmented));
+	};
+
+	"merge_respects_budget"_test = [] {
+		AtlasFixture F;
+		const auto fragmented = fragment(F);
+
+		for(const auto &[light_id, atlas_light]: F.atlas.allocated_lights())
+			atlas_light.on_rendered(F.now, 0);
+
+		// i.e. one (copied) move per call
+		F.atlas.set_defrag_budget(1);
+		F.atlas.defragment();
+		const auto &stats = F.atlas.defrag_stats();
+		expect(stats.moves == 1u);
+		expect(stats.bytes > 0u);
+		expect(stats.merges == 0u);
+		expect(stats.pending == 1u);
+
+		F.atlas.defragment();
+		expect(stats.moves == 1u);
+		expect(stats.merges == 1u);
+		expect(stats.pending == 0u);
+		expect(moved_to_vacated(F, fragmented));
+
+		// nothing left to merge in that tier
+		F.atlas.defragment();
+		expect(stats.moves == 0u);
+	};
+});
@@ -0,0 +1,90 @@
+#include "shadow_proxy.h"
+using namespace RGL;
+
+#include <glm/geometric.hpp>
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+
+suite<fixed_string("ShadowProxy")> shadow_proxy_suite([]{
+
+	// a flat grid of 'size' x 'size' quads (two triangles each), in the XZ plane, 1 unit per quad
+	auto make_grid = [](uint32_t size, std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices) {
+		for(auto z = 0u; z <= size; ++z)
+		{
+			for(auto x = 0u; x <= size; ++x)
+				positions.push_back(glm::vec3(x, 0, z));
+		}
+		for(auto z = 0u; z < size; ++z)
+		{
+			for(auto x = 0u; x < size; ++x)
+			{
+				const auto v0 = z*(size + 1) + x;
+				const auto v1 = v0 + size + 1;
+				indices.insert(indices.end(), { v0, v1, v0 + 1,  v0 + 1, v1, v1 + 1 });
+			}
+		}
+	};
+
+	"fine_grid"_test = [&] {
+		// a cell per vertex; nothing to merge
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		make_grid(10, positions, indices);
+
+		const auto proxy = simplify_for_shadows(positions, {}, indices, 100);
+		expect(proxy.num_triangles() == 200u);
+		expect(proxy.positions.size() == positions.size());
+	};
+
+	"coarse_grid"_test = [&] {
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		make_grid(16, positions, indices);
+
+		const auto proxy = simplify_for_shadows(positions, {}, indices, 4);
+		expect(proxy.num_triangles() > 0u);
+		expect(proxy.num_triangles() <= 2u*4*4);   // at most two per cell
+		expect(proxy.positions.size() <= 5u*5);
+		expect(proxy.normals.size() == proxy.positions.size());
+
+		for(auto idx = 0u; idx < proxy.indices.size(); idx += 3)
+		{
+			const auto a = proxy.indices[idx];
+			const auto b = proxy.indices[idx + 1];
+			const auto c = proxy.indices[idx + 2];
+			expect(a < proxy.positions.size() and b < proxy.positions.size() and c < proxy.positions.size());
+			expect(a != b and b != c and c != a);
+			// the winding (i.e. facing +Y) is kept
+			const auto normal = glm::cross(proxy.positions[b] - proxy.positions[a], proxy.positions[c] - proxy.positions[a]);
+			expect(normal.y > 0.f);
+		}
+		for(const auto &pos: proxy.positions)
+			expect(pos.x >= 0.f and pos.x <= 16.f and pos.z >= 0.f and pos.z <= 16.f and pos.y == 0.f);
+		for(const auto &normal: proxy.normals)
+			expect(glm::abs(glm::length(normal) - 1.f) < 1e-4f);
+	};
+
+	"collapsed"_test = [&] {
+		// a single cell; every triangle collapses
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		make_grid(4, positions, indices);
+
+		const auto proxy = simplify_for_shadows(positions, {}, indices, 1);
+		expect(proxy.num_triangles() == 0u);
+		expect(proxy.positions.size() == 1u);
+	};
+
+	"duplicates"_test = [&] {
+		// the same triangle twice, and once reversed (i.e. back-facing, kept)
+		const std::vector<glm::vec3> positions { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 0, 1 } };
+		const std::vector<glm::vec3> normals { { 0, 1, 0 }, { 0, 1, 0 }, { 0, 1, 0 } };
+		const std::vector<uint32_t> indices { 0, 1, 2,  1, 2, 0,  0, 2, 1 };
+
+		const auto proxy = simplify_for_shadows(positions, normals, indices, 8);
+		expect(proxy.num_triangles() == 2u);
+		expect(proxy.normals[0] == glm::vec3(0, 1, 0));
+	};
+});
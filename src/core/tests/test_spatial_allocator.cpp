@@ -93,6 +93,37 @@ suite<fixed_string("SpatialAllocator")> sa_suite([]{
 		expect(a.allocate(256) != SpatialAllocator<>::BadIndex);
 	};
 
+	"free_merge"_test = [] {
+		SpatialAllocator a(1024u, 4u, 2u);
+		std::vector<decltype(a)::NodeIndex> small;
+		for(auto idx = 0u; idx < 256; ++idx)
+		{
+			auto index = a.allocate(64);
+			expect(index != SpatialAllocator<>::BadIndex);
+			small.push_back(index);
+		}
+		expect(a.allocate(64) == SpatialAllocator<>::BadIndex);
+		expect(a.allocate(256) == SpatialAllocator<>::BadIndex);
+
+		// all freed -> merged back into the largest slots
+		for(const auto &index: small)
+			expect(a.free(index));
+		expect(not a.free(small[0])) << "double free";
+		for(auto idx = 0u; idx < 16; ++idx)
+			expect(a.allocate(256) != SpatialAllocator<>::BadIndex);
+		expect(a.allocate(64) == SpatialAllocator<>::BadIndex);
+	};
+
+	"first_fit"_test = [] {
+		// lowest index first, i.e. the same slots as a depth-first search
+		SpatialAllocator a(1024u, 4u, 2u);
+		const auto first = a.allocate(128);
+		expect(first == 21u) << first;  // first node of level 3
+		expect(a.allocate(128) == first + 1);
+		expect(a.free(first));
+		expect(a.allocate(128) == first);
+	};
+
 	"rects"_test = [] {
 		SpatialAllocator a(8192u);
 		auto check_rect = [&a](auto node, const decltype(a)::Rect &re) {
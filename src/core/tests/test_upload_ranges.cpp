@@ -0,0 +1,67 @@
+#include "upload_ranges.h"
+using namespace RGL::buffer;
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+
+suite<fixed_string("UploadRanges")> ur_suite([]{
+
+	static constexpr size_t elem_size = 128;
+
+	auto check_ranges = [](const std::vector<UploadRange> &ranges, const std::initializer_list<UploadRange> &expected) {
+		expect(ranges.size() == expected.size()) << std::format("num ranges: {} != {}", ranges.size(), expected.size());
+		if(ranges.size() != expected.size())
+			return;
+		for(auto idx = 0u; idx < ranges.size(); ++idx)
+		{
+			const auto &e = *(expected.begin() + idx);
+			expect(ranges[idx].start == e.start and ranges[idx].end == e.end)
+				<< std::format("range[{}]: [{}, {}) != [{}, {})", idx, ranges[idx].start, ranges[idx].end, e.start, e.end);
+		}
+	};
+
+	"empty"_test = [] {
+		std::vector<UploadRange> ranges { { 1, 2 } };
+		coalesce({}, elem_size, {}, ranges);
+		expect(ranges.empty());
+	};
+
+	"contiguous"_test = [&check_ranges] {
+		const std::vector<uint32_t> dirty { 3, 4, 5, 6 };
+		std::vector<UploadRange> ranges;
+		coalesce(dirty, elem_size, { .call_overhead_bytes = 0 }, ranges);
+		check_ranges(ranges, { { 3, 7 } });
+	};
+
+	"no_gap_merge"_test = [&check_ranges] {
+		const std::vector<uint32_t> dirty { 1, 2, 10, 20 };
+		std::vector<UploadRange> ranges;
+		coalesce(dirty, elem_size, { .call_overhead_bytes = 0 }, ranges);
+		check_ranges(ranges, { { 1, 3 }, { 10, 11 }, { 20, 21 } });
+	};
+
+	"gap_merge"_test = [&check_ranges] {
+		const std::vector<uint32_t> dirty { 1, 2, 5, 20, 23 };
+		std::vector<UploadRange> ranges;
+		// gaps of up to 3 elements are merged
+		coalesce(dirty, elem_size, { .call_overhead_bytes = 3*elem_size }, ranges);
+		check_ranges(ranges, { { 1, 6 }, { 20, 24 } });
+		expect(coalesced_count(ranges) == 9);
+	};
+
+	"max_calls"_test = [&check_ranges] {
+		const std::vector<uint32_t> dirty { 0, 10, 12, 30, 31, 50 };
+		std::vector<UploadRange> ranges;
+		coalesce(dirty, elem_size, { .call_overhead_bytes = 0, .max_calls = 3 }, ranges);
+		// smallest gaps: 10 -> 12 (1), 0 -> 10 (9)
+		check_ranges(ranges, { { 0, 13 }, { 30, 32 }, { 50, 51 } });
+	};
+
+	"max_calls_single"_test = [&check_ranges] {
+		const std::vector<uint32_t> dirty { 2, 40, 100 };
+		std::vector<UploadRange> ranges;
+		coalesce(dirty, elem_size, { .call_overhead_bytes = 0, .max_calls = 1 }, ranges);
+		check_ranges(ranges, { { 2, 101 } });
+	};
+});
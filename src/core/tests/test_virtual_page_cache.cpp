@@ -0,0 +1,92 @@
+#include "virtual_page_cache.h"
+using namespace RGL;
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+
+suite<fixed_string("VirtualPageCache")> virtual_page_cache_suite([]{
+
+	"map"_test = [] {
+		VirtualPageCache cache(4);
+
+		const auto first = cache.request(10, 1);
+		expect(first.physical != VirtualPageCache::Unmapped);
+		expect(first.render);
+		expect(cache.num_mapped() == 1u);
+
+		// requested again, before rendered
+		const auto again = cache.request(10, 1);
+		expect(again.physical == first.physical);
+		expect(again.render);
+
+		cache.set_valid(10);
+		expect(cache.is_valid(10));
+		const auto cached = cache.request(10, 2);
+		expect(cached.physical == first.physical);
+		expect(not cached.render);
+	};
+
+	"evict_lru"_test = [] {
+		VirtualPageCache cache(2);
+
+		const auto a = cache.request(1, 1);
+		const auto b = cache.request(2, 2);
+		cache.set_valid(1);
+		cache.set_valid(2);
+		(void)cache.request(1, 3);  // 2 is now the least recently requested
+
+		const auto c = cache.request(3, 4);
+		expect(c.physical == b.physical);
+		expect(c.evicted == 2u);
+		expect(cache.lookup(2) == VirtualPageCache::Unmapped);
+		expect(cache.lookup(1) == a.physical);
+	};
+
+	"exhausted"_test = [] {
+		VirtualPageCache cache(2);
+
+		(void)cache.request(1, 5);
+		(void)cache.request(2, 5);
+		// all requested this frame; nothing to evict
+		const auto c = cache.request(3, 5);
+		expect(c.physical == VirtualPageCache::Unmapped);
+		expect(cache.num_mapped() == 2u);
+	};
+
+	"invalidate"_test = [] {
+		VirtualPageCache cache(8);
+
+		for(auto page = 0u; page < 4; ++page)
+		{
+			(void)cache.request(page, 1);
+			cache.set_valid(page);
+		}
+		cache.invalidate(1, 2);
+		expect(cache.is_valid(0));
+		expect(not cache.is_valid(1));
+		expect(not cache.is_valid(2));
+		expect(cache.is_valid(3));
+
+		// still mapped, just re-rendered
+		const auto physical = cache.lookup(1);
+		const auto req = cache.request(1, 2);
+		expect(req.physical == physical);
+		expect(req.render);
+	};
+
+	"release"_test = [] {
+		VirtualPageCache cache(4);
+
+		for(auto page = 0u; page < 4; ++page)
+			(void)cache.request(page, 1);
+		cache.release(0, 2);
+		expect(cache.num_mapped() == 2u);
+		expect(cache.lookup(0) == VirtualPageCache::Unmapped);
+
+		// the freed pages are reused, even in the same frame
+		expect(cache.request(8, 1).physical != VirtualPageCache::Unmapped);
+		expect(cache.request(9, 1).physical != VirtualPageCache::Unmapped);
+		expect(cache.request(10, 1).physical == VirtualPageCache::Unmapped);
+	};
+});
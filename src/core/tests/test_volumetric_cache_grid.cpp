@@ -0,0 +1,92 @@
+#include "volumetric_cache_grid.h"
+using namespace RGL;
+
+#include <boost/ut.hpp>
+using namespace boost::ut;
+
+
+suite<fixed_string("VolumetricCacheGrid")> volumetric_cache_grid_suite([]{
+
+	"initial"_test = [] {
+		VolumetricCacheGrid grid({ 8, 4, 8 }, 4.f);
+		grid.recenter({ 0, 0, 0 });
+
+		expect(grid.num_invalid() == grid.num_slots());
+		expect(grid.origin() == glm::ivec3(-4, -2, -4));
+		expect(grid.contains({ 3, 1, 3 }));
+		expect(not grid.contains({ 4, 0, 0 }));
+		expect(not grid.is_valid({ 0, 0, 0 }));
+	};
+
+	"take_budget"_test = [] {
+		VolumetricCacheGrid grid({ 8, 4, 8 }, 4.f);
+		grid.recenter({ 0, 0, 0 });
+
+		const auto taken = grid.take_invalid(10);
+		expect(taken.size() == 10u);
+		expect(grid.num_invalid() == grid.num_slots() - 10);
+		for(const auto &brick: taken)
+		{
+			expect(grid.is_valid(brick));
+			// the nearest the center
+			expect(brick.x >= -2 and brick.x < 2 and brick.z >= -2 and brick.z < 2);
+		}
+
+		while(not grid.take_invalid(64).empty())
+			;
+		expect(grid.num_invalid() == 0u);
+		expect(grid.take_validity_changed());
+		expect(not grid.take_validity_changed());
+	};
+
+	"recenter"_test = [] {
+		VolumetricCacheGrid grid({ 8, 4, 8 }, 4.f);
+		grid.recenter({ 0, 0, 0 });
+		while(not grid.take_invalid(64).empty())
+			;
+
+		// within the hysteresis; nothing changes
+		expect(not grid.recenter({ 5, 0, 0 }));
+		expect(grid.num_invalid() == 0u);
+
+		// two bricks along X; two "columns" entered the window
+		expect(grid.recenter({ 8, 0, 0 }));
+		expect(grid.num_invalid() == 2u*4*8);
+		expect(grid.is_valid({ 0, 0, 0 }));
+		expect(grid.is_valid({ 3, 0, 0 }));
+		expect(not grid.is_valid({ 4, 0, 0 }));
+		expect(not grid.is_valid({ 5, 1, -4 }));
+
+		// further than the window; everything is stale
+		while(not grid.take_invalid(64).empty())
+			;
+		expect(grid.recenter({ 100, 0, 0 }));
+		expect(grid.num_invalid() == grid.num_slots());
+	};
+
+	"invalidate_sphere"_test = [] {
+		VolumetricCacheGrid grid({ 8, 4, 8 }, 4.f);
+		grid.recenter({ 0, 0, 0 });
+		while(not grid.take_invalid(64).empty())
+			;
+
+		grid.invalidate(bounds::Sphere({ 2, 2, 2 }, 1.f));  // inside a single brick
+		expect(grid.num_invalid() == 1u);
+		expect(not grid.is_valid({ 0, 0, 0 }));
+
+		grid.invalidate(bounds::Sphere({ 0, 0, 0 }, 1.f));  // at the corner of 8 bricks
+		expect(grid.num_invalid() == 8u);
+
+		grid.invalidate(bounds::Sphere({ 0, 0, 0 }, 1000.f));
+		expect(grid.num_invalid() == grid.num_slots());
+	};
+
+	"toroidal_slots"_test = [] {
+		VolumetricCacheGrid grid({ 8, 4, 8 }, 4.f);
+
+		expect(grid.slot({ 0, 0, 0 }) == grid.slot({ 8, 4, -8 }));
+		expect(grid.slot({ -1, 0, 0 }) == grid.slot({ 7, 0, 0 }));
+		expect(grid.slot_coord({ -1, -1, -9 }) == glm::uvec3(7, 3, 7));
+		expect(grid.brick_of({ -0.5f, 3.9f, 4.f }) == glm::ivec3(-1, 0, 1));
+	};
+});
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace RGL::buffer
+{
+
+// an element range [start, end) to upload in a single call
+struct UploadRange
+{
+	uint32_t start;
+	uint32_t end;
+
+	inline uint32_t count() const { return end - start; }
+};
+
+struct UploadCost
+{
+	// the cost of issuing one upload call, expressed in bytes;
+	//   i.e. a gap smaller than this is cheaper to re-upload than to skip
+	size_t call_overhead_bytes { 2048 };
+	// max number of upload calls (0 = no limit)
+	size_t max_calls { 0 };
+};
+
+/*
+ Coalesce a list of sorted (and unique) element indices into as few upload ranges as the cost model motivates.
+
+  1. adjacent indices are always merged
+  2. indices separated by a gap whose size (in bytes) is below 'call_overhead_bytes' are merged
+     (the gap elements are uploaded as well, so the source must be a complete mirror)
+  3. if there's still more than 'max_calls' ranges, the smallest gaps are merged until there's 'max_calls' ranges
+*/
+inline void coalesce(std::span<const uint32_t> sorted_indices, size_t elem_size, const UploadCost &cost, std::vector<UploadRange> &ranges)
+{
+	ranges.clear();
+	if(sorted_indices.empty())
+		return;
+
+	assert(elem_size > 0);
+
+	const auto max_gap = uint32_t(cost.call_overhead_bytes / elem_size);
+
+	ranges.push_back({ sorted_indices[0], sorted_indices[0] + 1 });
+
+	for(const auto index: sorted_indices.subspan(1))
+	{
+		auto &last = ranges.back();
+		assert(index >= last.end);  // must be sorted & unique
+
+		if(index - last.end <= max_gap)
+			last.end = index + 1;
+		else
+			ranges.push_back({ index, index + 1 });
+	}
+
+	if(cost.max_calls == 0 or ranges.size() <= cost.max_calls)
+		return;
+
+	// too many calls; merge across the smallest gaps
+	//   gap[N] is the gap between range[N] and range[N + 1]
+	//   (local, i.e. reentrant; only allocates when the call limit is exceeded)
+	std::vector<uint32_t> gap_order(ranges.size() - 1);
+	for(auto idx = 0u; idx < gap_order.size(); ++idx)
+		gap_order[idx] = idx;
+
+	auto gap_size = [&ranges](uint32_t gap_index) {
+		return ranges[gap_index + 1].start - ranges[gap_index].end;
+	};
+
+	const auto num_merges = ranges.size() - cost.max_calls;
+	std::ranges::nth_element(gap_order, gap_order.begin() + std::ptrdiff_t(num_merges - 1), [&gap_size](auto a, auto b) {
+		return gap_size(a) < gap_size(b);
+	});
+	gap_order.resize(num_merges);
+	std::ranges::sort(gap_order);
+
+	// stitch the ranges together, in place
+	size_t write_idx = 0;
+	auto merge_iter = gap_order.begin();
+	for(auto read_idx = 1u; read_idx < ranges.size(); ++read_idx)
+	{
+		if(merge_iter != gap_order.end() and *merge_iter == read_idx - 1)
+		{
+			ranges[write_idx].end = ranges[read_idx].end;
+			++merge_iter;
+		}
+		else
+			ranges[++write_idx] = ranges[read_idx];
+	}
+	ranges.resize(write_idx + 1);
+
+	assert(ranges.size() == cost.max_calls);
+}
+
+// total number of elements covered by 'ranges'
+inline size_t coalesced_count(std::span<const UploadRange> ranges)
+{
+	size_t count { 0 };
+	for(const auto &range: ranges)
+		count += range.count();
+	return count;
+}
+
+} // RGL::buffer
@@ -0,0 +1,216 @@
+#pragma once
+
+#include "container_types.h"
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace RGL
+{
+
+/*
+ Maps virtual pages to a fixed pool of physical pages, for the virtual shadow maps.
+   A requested page that isn't mapped gets a free physical page or, if the pool is full, the least
+   recently requested one (but never one requested in the same frame).
+   A page's content stays valid (i.e. cached) until invalidated, e.g. when its light changed.
+*/
+class VirtualPageCache
+{
+public:
+	using PageID     = uint32_t;  // virtual page; (map index * pages per map) + page index
+	using PhysicalID = uint32_t;
+	static constexpr PhysicalID Unmapped = PhysicalID(-1);
+
+	struct Request
+	{
+		PhysicalID physical { Unmapped };  // Unmapped if the pool is exhausted (this frame)
+		bool       render { false };       // newly mapped or invalidated
+		PageID     evicted { Unmapped };   // page that lost its physical page, if any
+	};
+
+public:
+	explicit VirtualPageCache(uint32_t num_physical);
+
+	[[nodiscard]] Request request(PageID page, uint64_t frame);
+
+	// the page was rendered, i.e. its content is valid
+	void set_valid(PageID page);
+	// content must be re-rendered (when requested again), the mapping is kept
+	void invalidate(PageID first, uint32_t count);
+	// unmapped, the physical pages are freed; e.g. the light is no longer shadowed
+	void release(PageID first, uint32_t count);
+
+	[[nodiscard]] PhysicalID lookup(PageID page) const;
+	[[nodiscard]] bool is_valid(PageID page) const;
+
+	[[nodiscard]] inline uint32_t num_physical() const { return uint32_t(_owner.size()); }
+	[[nodiscard]] inline uint32_t num_mapped() const { return uint32_t(_mapped.size()); }
+
+private:
+	// least recently requested list of mapped physical pages; head = most recent
+	void lru_unlink(PhysicalID physical);
+	void lru_push_front(PhysicalID physical);
+
+private:
+	struct Mapping
+	{
+		PhysicalID physical;
+		bool       valid { false };
+	};
+	dense_map<PageID, Mapping> _mapped;
+
+	std::vector<PageID>     _owner;       // per physical page; Unmapped if free
+	std::vector<uint64_t>   _last_used;   // per physical page; frame
+	std::vector<PhysicalID> _prev;
+	std::vector<PhysicalID> _next;
+	PhysicalID _lru_head { Unmapped };
+	PhysicalID _lru_tail { Unmapped };
+	std::vector<PhysicalID> _free;
+};
+
+inline VirtualPageCache::VirtualPageCache(uint32_t num_physical) :
+	_owner(num_physical, Unmapped),
+	_last_used(num_physical, 0),
+	_prev(num_physical, Unmapped),
+	_next(num_physical, Unmapped)
+{
+	assert(num_physical > 0);
+
+	_mapped.reserve(num_physical);
+
+	// first allocated is the lowest index
+	_free.reserve(num_physical);
+	for(auto physical = num_physical; physical > 0; --physical)
+		_free.push_back(physical - 1);
+}
+
+inline VirtualPageCache::Request VirtualPageCache::request(PageID page, uint64_t frame)
+{
+	Request result;
+
+	if(auto found = _mapped.find(page); found != _mapped.end())
+	{
+		const auto physical = found->second.physical;
+		_last_used[physical] = frame;
+		lru_unlink(physical);
+		lru_push_front(physical);
+
+		result.physical = physical;
+		result.render = not found->second.valid;
+		return result;
+	}
+
+	PhysicalID physical { Unmapped };
+	if(not _free.empty())
+	{
+		physical = _free.back();
+		_free.pop_back();
+	}
+	else
+	{
+		// evict the least recently requested; unless all were requested this frame
+		if(_lru_tail == Unmapped or _last_used[_lru_tail] >= frame)
+			return result;
+
+		physical = _lru_tail;
+		result.evicted = _owner[physical];
+		_mapped.erase(result.evicted);
+		lru_unlink(physical);
+	}
+
+	_owner[physical] = page;
+	_last_used[physical] = frame;
+	lru_push_front(physical);
+	_mapped[page] = { physical, false };
+
+	result.physical = physical;
+	result.render = true;
+	return result;
+}
+
+inline void VirtualPageCache::set_valid(PageID page)
+{
+	if(auto found = _mapped.find(page); found != _mapped.end())
+		found->second.valid = true;
+}
+
+inline void VirtualPageCache::invalidate(PageID first, uint32_t count)
+{
+	// the smaller of the two to iterate
+	if(count < _mapped.size())
+	{
+		for(auto page = first; page < first + count; ++page)
+		{
+			if(auto found = _mapped.find(page); found != _mapped.end())
+				found->second.valid = false;
+		}
+	}
+	else
+	{
+		for(auto &[page, mapping]: _mapped)
+		{
+			if(page >= first and page < first + count)
+				mapping.valid = false;
+		}
+	}
+}
+
+inline void VirtualPageCache::release(PageID first, uint32_t count)
+{
+	for(auto physical = 0u; physical < _owner.size(); ++physical)
+	{
+		const auto page = _owner[physical];
+		if(page == Unmapped or page < first or page >= first + count)
+			continue;
+
+		_mapped.erase(page);
+		_owner[physical] = Unmapped;
+		lru_unlink(physical);
+		_free.push_back(physical);
+	}
+}
+
+inline VirtualPageCache::PhysicalID VirtualPageCache::lookup(PageID page) const
+{
+	const auto found = _mapped.find(page);
+	return found != _mapped.end()? found->second.physical: Unmapped;
+}
+
+inline bool VirtualPageCache::is_valid(PageID page) const
+{
+	const auto found = _mapped.find(page);
+	return found != _mapped.end() and found->second.valid;
+}
+
+inline void VirtualPageCache::lru_unlink(PhysicalID physical)
+{
+	const auto prev = _prev[physical];
+	const auto next = _next[physical];
+
+	if(prev != Unmapped)
+		_next[prev] = next;
+	else if(_lru_head == physical)
+		_lru_head = next;
+
+	if(next != Unmapped)
+		_prev[next] = prev;
+	else if(_lru_tail == physical)
+		_lru_tail = prev;
+
+	_prev[physical] = _next[physical] = Unmapped;
+}
+
+inline void VirtualPageCache::lru_push_front(PhysicalID physical)
+{
+	_prev[physical] = Unmapped;
+	_next[physical] = _lru_head;
+	if(_lru_head != Unmapped)
+		_prev[_lru_head] = physical;
+	_lru_head = physical;
+	if(_lru_tail == Unmapped)
+		_lru_tail = physical;
+}
+
+} // RGL
@@ -0,0 +1,306 @@
+#include "virtual_shadow_maps.h"
+
+#include "light_manager.h"
+#include "buffer_binds.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <bit>
+
+namespace RGL
+{
+
+static constexpr buffer::UploadCost s_page_table_upload_cost { .call_overhead_bytes = 1024, .max_calls = 32 };
+
+VirtualShadowMaps::VirtualShadowMaps(LightManager &lights, uint32_t page_size, uint32_t pool_pages_per_dim) :
+	Texture2d(),
+	_lights(lights),
+	_page_size(page_size),
+	_pool_pages_per_dim(pool_pages_per_dim),
+	_cache(pool_pages_per_dim*pool_pages_per_dim),
+	_page_table_ssbo("vsm-page-table")
+{
+	assert(std::has_single_bit(page_size) and page_size >= 32);
+	assert(pool_pages_per_dim*page_size <= 16384);
+
+	_page_table_ssbo.bindAt(SSBO_BIND_VSM_PAGE_TABLE);
+
+	_lights_maps.reserve(MAX_LIGHTS);
+	_candidates.reserve(64);
+	_chosen.reserve(MAX_LIGHTS);
+	_render_queue.reserve(_page_budget);
+	_page_table.resize(MAX_MAPS*PAGES_PER_MAP);
+
+	clear();
+}
+
+bool VirtualShadowMaps::create()
+{
+	const auto size = _pool_pages_per_dim*_page_size;
+
+	namespace C = RenderTarget::Color;
+	namespace D = RenderTarget::Depth;
+	// only depth; the (atlas') normals aren't used by the virtual maps
+	Texture2d::create("vsm-page-pool", size, size, C::None, D::Texture | D::Float);
+
+	return bool(this);
+}
+
+void VirtualShadowMaps::clear()
+{
+	for(const auto &[light_id, vlight]: _lights_maps)
+	{
+		release_maps(vlight);
+		_lights.clear_shadow_index(light_id);
+	}
+	_lights_maps.clear();
+
+	_map_owner.fill(NO_LIGHT_ID);
+	_free_maps.clear();
+	for(auto map_index = MAX_MAPS; map_index > 0; --map_index)
+		_free_maps.push_back(map_index - 1);
+
+	std::ranges::fill(_page_table, PAGE_UNMAPPED);
+	_dirty_pages.clear();
+	_table_uploaded = false;
+	_render_queue.clear();
+}
+
+void VirtualShadowMaps::update_lights(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos)
+{
+	_candidates.clear();
+
+	for(const auto &light_index: relevant_lights)
+	{
+		const auto light_id = _lights.light_id(light_index);
+		const auto light_ent = entt::entity(light_id);
+		const auto &[general, transform] = _lights.entities().get<component::LightGeneral, component::Transform>(light_ent);
+
+		if(not general.enabled or not general.shadow_caster)
+			continue;
+		if(general.light_type != LightType::Point and general.light_type != LightType::Spot)
+			continue;
+
+		const auto affect_radius = _lights.affect_radius(light_id, general);
+		const auto edge_distance = std::max(0.f, glm::distance(transform.position(), view_pos) - affect_radius);
+		const auto num_maps = uint_fast8_t(general.light_type == LightType::Point? 6: 1);
+
+		_candidates.push_back({ edge_distance, light_id, num_maps });
+	}
+
+	// nearest first, as many as there are maps for
+	std::ranges::sort(_candidates, [](const auto &a, const auto &b) { return a.distance < b.distance; });
+
+	_chosen.clear();
+	auto maps_left = MAX_MAPS;
+	for(const auto &candidate: _candidates)
+	{
+		if(_chosen.size() == MAX_LIGHTS)
+			break;
+		if(candidate.num_maps > maps_left)
+			continue;
+		maps_left -= candidate.num_maps;
+		_chosen.insert(candidate.light_id);
+	}
+
+	// release the lights not chosen
+	for(auto iter = _lights_maps.begin(); iter != _lights_maps.end(); )
+	{
+		if(not _chosen.contains(iter->first))
+		{
+			release_maps(iter->second);
+			_lights.clear_shadow_index(iter->first);
+			iter = _lights_maps.erase(iter);
+		}
+		else
+			++iter;
+	}
+
+	uint32_t rank { 0 };
+	for(const auto &candidate: _candidates)
+	{
+		if(not _chosen.contains(candidate.light_id))
+			continue;
+
+		auto found = _lights_maps.find(candidate.light_id);
+		if(found == _lights_maps.end())
+		{
+			VirtualLight vlight;
+			vlight.light_id = candidate.light_id;
+			vlight.num_maps = candidate.num_maps;
+			for(auto face = 0u; face < vlight.num_maps; ++face)
+			{
+				assert(not _free_maps.empty());
+				vlight.map_index[face] = _free_maps.back();
+				_free_maps.pop_back();
+				_map_owner[vlight.map_index[face]] = vlight.light_id;
+			}
+			found = _lights_maps.emplace(candidate.light_id, vlight).first;
+		}
+
+		auto &vlight = found->second;
+		vlight.rank = rank++;
+
+		// the light changed; its pages must be re-rendered (but are shown until then)
+		if(const auto light_hash = _lights.hash(vlight.light_id); light_hash != vlight.hash)
+		{
+			for(auto face = 0u; face < vlight.num_maps; ++face)
+				_cache.invalidate(vlight.map_index[face]*PAGES_PER_MAP, PAGES_PER_MAP);
+			vlight.hash = light_hash;
+		}
+	}
+}
+
+bool VirtualShadowMaps::remove_light(LightID light_id)
+{
+	auto found = _lights_maps.find(light_id);
+	if(found == _lights_maps.end())
+		return false;
+
+	release_maps(found->second);
+	_lights_maps.erase(found);
+	_lights.clear_shadow_index(light_id);
+
+	return true;
+}
+
+void VirtualShadowMaps::release_maps(const VirtualLight &vlight)
+{
+	for(auto face = 0u; face < vlight.num_maps; ++face)
+	{
+		const auto map_index = vlight.map_index[face];
+		const auto first = map_index*PAGES_PER_MAP;
+
+		_cache.release(first, PAGES_PER_MAP);
+		for(auto page = first; page < first + PAGES_PER_MAP; ++page)
+			set_table_entry(page, PAGE_UNMAPPED);
+
+		_map_owner[map_index] = NO_LIGHT_ID;
+		_free_maps.push_back(map_index);
+	}
+}
+
+void VirtualShadowMaps::process_requests(uint64_t frame, std::span<const uint32_t, REQUEST_WORDS> requests)
+{
+	_render_queue.clear();
+	_counters = {};
+
+	for(auto word = 0u; word < REQUEST_WORDS; ++word)
+	{
+		auto bits = requests[word];
+		while(bits)
+		{
+			const auto page = PageID((word << 5) + uint32_t(std::countr_zero(bits)));
+			bits &= bits - 1u;
+
+			const auto map_index = page / PAGES_PER_MAP;
+			const auto owner = _map_owner[map_index];
+			if(owner == NO_LIGHT_ID)  // released since the request was made
+				continue;
+
+			++_counters.requested;
+
+			const auto request = _cache.request(page, frame);
+			if(request.evicted != VirtualPageCache::Unmapped)
+			{
+				set_table_entry(request.evicted, PAGE_UNMAPPED);
+				++_counters.evicted;
+			}
+			if(request.physical == VirtualPageCache::Unmapped)
+			{
+				++_counters.exhausted;
+				continue;
+			}
+			if(not request.render)
+			{
+				++_counters.cached;
+				continue;
+			}
+
+			const auto &vlight = _lights_maps[owner];
+			const auto face = uint_fast8_t(std::ranges::find(vlight.map_index, map_index) - vlight.map_index.begin());
+			assert(face < vlight.num_maps);
+
+			const auto pool_x = request.physical % _pool_pages_per_dim;
+			const auto pool_y = request.physical / _pool_pages_per_dim;
+
+			_render_queue.push_back({
+				.light_id = owner,
+				.map_index = map_index,
+				.face = face,
+				.page = page,
+				.rect = glm::uvec4(pool_x*_page_size, pool_y*_page_size, _page_size, _page_size),
+				.crop = page_crop(page),
+			});
+		}
+	}
+
+	// the nearest lights' pages first; the remaining pages are rendered when requested again
+	if(_render_queue.size() > _page_budget)
+	{
+		std::ranges::stable_sort(_render_queue, [this](const auto &a, const auto &b) {
+			return _lights_maps[a.light_id].rank < _lights_maps[b.light_id].rank;
+		});
+		_counters.deferred = uint32_t(_render_queue.size() - _page_budget);
+		_render_queue.resize(_page_budget);
+	}
+	_counters.rendered = uint32_t(_render_queue.size());
+}
+
+void VirtualShadowMaps::on_rendered(const PageRender &page, bool has_dynamic)
+{
+	const auto physical = _cache.lookup(page.page);
+	if(physical == VirtualPageCache::Unmapped)
+		return;
+
+	set_table_entry(page.page, encode_physical(physical));
+
+	// dynamic objects might've moved; re-render the page next time it's requested
+	if(not has_dynamic)
+		_cache.set_valid(page.page);
+}
+
+void VirtualShadowMaps::update_page_table_ssbo()
+{
+	if(not _table_uploaded)
+	{
+		_page_table_ssbo.set(_page_table);
+		_table_uploaded = true;
+		_dirty_pages.clear();
+		return;
+	}
+	if(_dirty_pages.empty())
+		return;
+
+	std::ranges::sort(_dirty_pages);
+	const auto [first, last] = std::ranges::unique(_dirty_pages);
+	_dirty_pages.erase(first, last);
+
+	buffer::coalesce(_dirty_pages, sizeof(uint32_t), s_page_table_upload_cost, _upload_ranges);
+	for(const auto &range: _upload_ranges)
+		_page_table_ssbo.set(_page_table.begin() + range.start, _page_table.begin() + range.end, range.start);
+
+	_dirty_pages.clear();
+}
+
+glm::mat4 VirtualShadowMaps::page_crop(PageID page) const
+{
+	// scale the page's part of the face's NDC to [-1, 1]
+	const auto page_in_map = page % PAGES_PER_MAP;
+	const auto page_x = page_in_map % PAGES_PER_DIM;
+	const auto page_y = page_in_map / PAGES_PER_DIM;
+
+	const auto scale = float(PAGES_PER_DIM);
+	const auto center_x = -1.f + (2.f*float(page_x) + 1.f) / scale;
+	const auto center_y = -1.f + (2.f*float(page_y) + 1.f) / scale;
+
+	glm::mat4 crop(1);
+	crop[0][0] = scale;
+	crop[1][1] = scale;
+	crop[3][0] = -scale*center_x;  // in clip space, i.e. times w
+	crop[3][1] = -scale*center_y;
+	return crop;
+}
+
+} // RGL
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "rendertarget_2d.h"
+#include "container_types.h"
+#include "virtual_page_cache.h"
+#include "lights.h"
+#include "ssbo.h"
+#include "upload_ranges.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <array>
+#include <span>
+#include <vector>
+
+namespace RGL
+{
+class LightManager;
+
+/*
+ Virtual (paged) shadow maps; an alternative to the atlas for point & spot lights.
+
+   Each shadow map (i.e. a cube face or a spot light) is a large virtual map, divided into pages.
+   Only pages needed by the visible samples are mapped to a physical page, of a fixed size pool texture.
+   The needed pages are marked from the depth pre-pass (see vsm_mark_pages.comp), read back a frame or
+   two later and passed to process_requests().
+
+   Rendered pages are cached (see VirtualPageCache) until the light changes, or evicted by other pages.
+   Pages with dynamic objects are re-rendered when requested.
+   An invalidated page keeps showing its previous content until it's re-rendered.
+
+   The lights' ShadowSlotInfo entries are written by ShadowAtlas::update_slots_ssbo() (see set_virtual_maps()),
+   with 'atlas_rect' = (map index, 0, 0, 0); i.e. a zero width signals a virtual map to the shaders.
+*/
+class VirtualShadowMaps : public RenderTarget::Texture2d
+{
+public:
+	static constexpr uint32_t MAX_LIGHTS      = 16;
+	static constexpr uint32_t MAX_MAPS        = 64;       // point lights use 6 maps, spot lights 1
+	static constexpr uint32_t PAGES_PER_DIM   = 64;       // e.g. 64 * 128 = 8192 virtual resolution
+	static constexpr uint32_t PAGES_PER_MAP   = PAGES_PER_DIM*PAGES_PER_DIM;
+	static constexpr uint32_t REQUEST_WORDS   = MAX_MAPS*PAGES_PER_MAP / 32;  // bit per page
+	static constexpr uint32_t PAGE_UNMAPPED   = 0xffffffff;  // page table entry; otherwise x | y << 16 (pool page coordinate)
+
+	using PageID = VirtualPageCache::PageID;
+
+	struct VirtualLight
+	{
+		LightID light_id;
+		uint_fast8_t num_maps;
+		std::array<uint32_t, 6> map_index;   // per face
+		size_t hash { 0 };
+		uint32_t rank;                       // 0 = nearest
+	};
+
+	struct PageRender
+	{
+		LightID light_id;
+		uint32_t map_index;
+		uint_fast8_t face;
+		PageID page;          // virtual page
+		glm::uvec4 rect;      // in the pool texture
+		glm::mat4 crop;       // the page's part of the face projection, i.e. crop * light_view_projection
+	};
+
+	struct Counters
+	{
+		uint32_t requested { 0 };
+		uint32_t cached { 0 };     // requested, already rendered
+		uint32_t rendered { 0 };   // queued to render
+		uint32_t deferred { 0 };   // over the page budget
+		uint32_t evicted { 0 };
+		uint32_t exhausted { 0 };  // the pool had no page to give
+	};
+
+public:
+	VirtualShadowMaps(LightManager &lights, uint32_t page_size=128, uint32_t pool_pages_per_dim=32);
+
+	bool create();
+
+	inline uint32_t page_size() const { return _page_size; }
+	inline uint32_t virtual_size() const { return PAGES_PER_DIM*_page_size; }
+	// max number of pages rendered per frame
+	inline void set_page_budget(uint32_t pages) { _page_budget = std::max(pages, 1u); }
+
+	// picks the (nearest) shadow-casting point & spot lights, maps are assigned/released accordingly
+	void update_lights(const std::vector<LightIndex> &relevant_lights, const glm::vec3 &view_pos);
+	[[nodiscard]] inline const dense_map<LightID, VirtualLight> &lights() const { return _lights_maps; }
+	bool remove_light(LightID light_id);
+
+	// the page request bits of 'frame' (see vsm_mark_pages.comp), builds the render queue
+	void process_requests(uint64_t frame, std::span<const uint32_t, REQUEST_WORDS> requests);
+	[[nodiscard]] inline const std::vector<PageRender> &pages_to_render() const { return _render_queue; }
+	// call after rendering a page returned by pages_to_render()
+	void on_rendered(const PageRender &page, bool has_dynamic);
+	[[nodiscard]] inline const Counters &last_counters() const { return _counters; }
+
+	void update_page_table_ssbo();
+
+	void clear();
+
+private:
+	void release_maps(const VirtualLight &vlight);
+	glm::mat4 page_crop(PageID page) const;
+	inline uint32_t encode_physical(VirtualPageCache::PhysicalID physical) const
+	{
+		return (physical % _pool_pages_per_dim) | ((physical / _pool_pages_per_dim) << 16);
+	}
+	inline void set_table_entry(PageID page, uint32_t entry)
+	{
+		if(_page_table[page] != entry)
+		{
+			_page_table[page] = entry;
+			_dirty_pages.push_back(page);
+		}
+	}
+
+private:
+	LightManager &_lights;
+	uint32_t _page_size;
+	uint32_t _pool_pages_per_dim;
+	uint32_t _page_budget { 64 };
+
+	VirtualPageCache _cache;
+
+	dense_map<LightID, VirtualLight> _lights_maps;
+	std::array<LightID, MAX_MAPS> _map_owner;
+	std::vector<uint32_t> _free_maps;
+
+	struct Candidate
+	{
+		float distance;
+		LightID light_id;
+		uint_fast8_t num_maps;
+	};
+	std::vector<Candidate> _candidates;
+	dense_set<LightID> _chosen;
+
+	std::vector<PageRender> _render_queue;
+	Counters _counters;
+
+	std::vector<uint32_t> _page_table;   // mirror of the SSBO
+	std::vector<uint32_t> _dirty_pages;
+	std::vector<buffer::UploadRange> _upload_ranges;
+	bool _table_uploaded { false };
+	buffer::Storage<uint32_t> _page_table_ssbo;
+};
+
+} // RGL
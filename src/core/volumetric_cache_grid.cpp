@@ -0,0 +1,186 @@
+#include "volumetric_cache_grid.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vector_relational.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+namespace RGL
+{
+
+static inline int positive_mod(int value, int divisor)
+{
+	const auto r = value % divisor;
+	return r < 0? r + divisor: r;
+}
+
+VolumetricCacheGrid::VolumetricCacheGrid(const glm::uvec3 &dims, float brick_size) :
+	_dims(glm::max(dims, glm::uvec3(1))),
+	_brick_size(brick_size),
+	_valid(num_slots(), 0)
+{
+	assert(brick_size > 0);
+}
+
+bool VolumetricCacheGrid::recenter(const glm::vec3 &center, uint32_t hysteresis)
+{
+	const auto half = glm::ivec3(_dims / 2u);
+	const auto new_origin = brick_of(center) - half;
+
+	if(_placed)
+	{
+		const auto offset = glm::abs(new_origin - _origin);
+		if(uint32_t(std::max(std::max(offset.x, offset.y), offset.z)) <= hysteresis)
+			return false;
+	}
+
+	const auto prev_origin = _origin;
+	const auto was_placed = _placed;
+	_origin = new_origin;
+	_placed = true;
+
+	// only the slots now holding a different world brick are stale
+	//   (the bricks still inside the window keep their slot)
+	for(auto slot_idx = 0u; slot_idx < num_slots(); ++slot_idx)
+	{
+		if(not _valid[slot_idx])
+			continue;
+
+		const auto brick = slot_brick(slot_idx);
+		const auto prev_rel = brick - prev_origin;
+		const auto was_inside = was_placed
+			and glm::all(glm::greaterThanEqual(prev_rel, glm::ivec3(0)))
+			and glm::all(glm::lessThan(prev_rel, glm::ivec3(_dims)));
+		if(not was_inside)
+			set_valid(slot_idx, false);
+	}
+
+	return true;
+}
+
+void VolumetricCacheGrid::invalidate(const bounds::Sphere &sphere)
+{
+	if(sphere.empty())
+		return;
+
+	const auto radius = glm::vec3(sphere.radius());
+	const auto lo = glm::max(brick_of(sphere.center() - radius), _origin);
+	const auto hi = glm::min(brick_of(sphere.center() + radius), _origin + glm::ivec3(_dims) - 1);
+
+	for(auto z = lo.z; z <= hi.z; ++z)
+	{
+		for(auto y = lo.y; y <= hi.y; ++y)
+		{
+			for(auto x = lo.x; x <= hi.x; ++x)
+				set_valid(slot(glm::ivec3(x, y, z)), false);
+		}
+	}
+}
+
+void VolumetricCacheGrid::invalidate_all()
+{
+	for(auto slot_idx = 0u; slot_idx < num_slots(); ++slot_idx)
+		set_valid(slot_idx, false);
+}
+
+std::span<const glm::ivec3> VolumetricCacheGrid::take_invalid(uint32_t max_bricks)
+{
+	_taken.clear();
+	if(max_bricks == 0)
+		return _taken;
+
+	for(auto slot_idx = 0u; slot_idx < num_slots(); ++slot_idx)
+	{
+		if(not _valid[slot_idx])
+			_taken.push_back(slot_brick(slot_idx));
+	}
+
+	// nearest the center first (i.e. the camera)
+	const auto center = glm::vec3(_origin) + glm::vec3(_dims)/2.f - 0.5f;
+	auto distance = [&center](const glm::ivec3 &brick) {
+		const auto delta = glm::vec3(brick) - center;
+		return glm::dot(delta, delta);
+	};
+	const auto count = std::min(size_t(max_bricks), _taken.size());
+	std::partial_sort(_taken.begin(), _taken.begin() + ptrdiff_t(count), _taken.end(), [&distance](const auto &A, const auto &B) {
+		return distance(A) < distance(B);
+	});
+	_taken.resize(count);
+
+	for(const auto &brick: _taken)
+		set_valid(slot(brick), true);
+
+	return _taken;
+}
+
+uint32_t VolumetricCacheGrid::num_invalid() const
+{
+	return uint32_t(std::ranges::count(_valid, 0u));
+}
+
+glm::ivec3 VolumetricCacheGrid::brick_of(const glm::vec3 &pos) const
+{
+	return glm::ivec3(glm::floor(pos / _brick_size));
+}
+
+bool VolumetricCacheGrid::contains(const glm::ivec3 &brick) const
+{
+	const auto rel = brick - _origin;
+	return _placed
+		and glm::all(glm::greaterThanEqual(rel, glm::ivec3(0)))
+		and glm::all(glm::lessThan(rel, glm::ivec3(_dims)));
+}
+
+bool VolumetricCacheGrid::is_valid(const glm::ivec3 &brick) const
+{
+	return contains(brick) and _valid[slot(brick)] != 0;
+}
+
+uint32_t VolumetricCacheGrid::slot(const glm::ivec3 &brick) const
+{
+	const auto coord = slot_coord(brick);
+	return coord.x + _dims.x*(coord.y + _dims.y*coord.z);
+}
+
+glm::uvec3 VolumetricCacheGrid::slot_coord(const glm::ivec3 &brick) const
+{
+	return {
+		uint32_t(positive_mod(brick.x, int(_dims.x))),
+		uint32_t(positive_mod(brick.y, int(_dims.y))),
+		uint32_t(positive_mod(brick.z, int(_dims.z))),
+	};
+}
+
+bool VolumetricCacheGrid::take_validity_changed()
+{
+	const auto changed = _validity_changed;
+	_validity_changed = false;
+	return changed;
+}
+
+glm::ivec3 VolumetricCacheGrid::slot_brick(uint32_t slot_idx) const
+{
+	const auto coord = glm::ivec3(slot_idx % _dims.x, (slot_idx / _dims.x) % _dims.y, slot_idx / (_dims.x*_dims.y));
+	// the brick in the window that maps to this slot
+	const auto base = glm::ivec3(slot_coord(_origin));
+	const auto rel = glm::ivec3(
+		positive_mod(coord.x - base.x, int(_dims.x)),
+		positive_mod(coord.y - base.y, int(_dims.y)),
+		positive_mod(coord.z - base.z, int(_dims.z))
+	);
+	return _origin + rel;
+}
+
+void VolumetricCacheGrid::set_valid(uint32_t slot_idx, bool valid)
+{
+	const auto value = valid? 1u: 0u;
+	if(_valid[slot_idx] != value)
+	{
+		_valid[slot_idx] = value;
+		_validity_changed = true;
+	}
+}
+
+} // RGL
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "bounds.h"
+
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace RGL
+{
+
+/*
+ Bookkeeping of the static lights' scattering cache (see PP::Volumetrics).
+
+   A world-aligned window of bricks, around the camera.
+   The bricks are addressed toroidally, i.e. a world brick is stored in the slot (brick mod dims),
+   so when the window is recentred only the bricks that entered it need baking.
+
+   A brick is valid when its baked content is up to date; the inject pass evaluates all lights directly
+   where the brick isn't valid.
+*/
+class VolumetricCacheGrid
+{
+public:
+	VolumetricCacheGrid(const glm::uvec3 &dims, float brick_size);
+
+	[[nodiscard]] inline const glm::uvec3 &dims() const { return _dims; }
+	[[nodiscard]] inline float brick_size() const { return _brick_size; }
+	// world brick of the window's min corner
+	[[nodiscard]] inline const glm::ivec3 &origin() const { return _origin; }
+	[[nodiscard]] inline uint32_t num_slots() const { return _dims.x*_dims.y*_dims.z; }
+
+	// centers the window on 'center', if it's more than 'hysteresis' bricks off; returns true if it moved
+	bool recenter(const glm::vec3 &center, uint32_t hysteresis=1);
+	void invalidate(const bounds::Sphere &sphere);
+	void invalidate_all();
+
+	// the invalid bricks nearest the window's center, at most 'max_bricks'
+	//   they're valid afterwards, i.e. they must be baked
+	[[nodiscard]] std::span<const glm::ivec3> take_invalid(uint32_t max_bricks);
+	[[nodiscard]] uint32_t num_invalid() const;
+
+	[[nodiscard]] glm::ivec3 brick_of(const glm::vec3 &pos) const;
+	[[nodiscard]] bool contains(const glm::ivec3 &brick) const;
+	[[nodiscard]] bool is_valid(const glm::ivec3 &brick) const;  // false if outside the window
+	[[nodiscard]] uint32_t slot(const glm::ivec3 &brick) const;
+	[[nodiscard]] glm::uvec3 slot_coord(const glm::ivec3 &brick) const;
+
+	// per slot, 1 = valid
+	[[nodiscard]] inline std::span<const uint32_t> validity() const { return _valid; }
+	// whether validity() changed since the last call
+	[[nodiscard]] bool take_validity_changed();
+
+private:
+	// the world brick held by 'slot' (in the current window)
+	glm::ivec3 slot_brick(uint32_t slot) const;
+	void set_valid(uint32_t slot, bool valid);
+
+private:
+	glm::uvec3 _dims;
+	float _brick_size;
+	glm::ivec3 _origin { 0 };
+	bool _placed { false };
+	std::vector<uint32_t> _valid;
+	std::vector<glm::ivec3> _taken;
+	bool _validity_changed { true };
+};
+
+} // RGL